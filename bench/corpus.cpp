@@ -0,0 +1,111 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+// xorshift32; good enough to keep the generated text from being periodic.
+static uint32_t NextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static const char* const kWords[] = {
+    "auto", "const", "return", "if", "for", "while", "std::string", "size_t", "buffer", "offset",
+    "length", "document", "piece", "line", "=", "+=", "==", "(", ")", "{", "}", ";", "->", "0", "1",
+    "42", "nullptr", "true", "false", "// note:", "value", "index", "count", "result", "Render",
+};
+
+std::string GenerateText(size_t bytes, bool crlf, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    std::string text;
+    text.reserve(bytes + 64);
+    while (text.size() < bytes) {
+        text.append((NextRandom(state) % 4) * 4, ' ');
+        size_t words = 1 + NextRandom(state) % 8;
+        for (size_t w = 0; w < words; ++w) {
+            if (w) text += ' ';
+            text += kWords[NextRandom(state) % (sizeof(kWords) / sizeof(kWords[0]))];
+        }
+        text += crlf ? "\r\n" : "\n";
+    }
+    // A cut "\r\n" would leave a lone CR, and a CRLF file would read as mixed.
+    text.resize(bytes);
+    if (!text.empty() && text.back() == '\r') text.back() = ' ';
+    return text;
+}
+
+std::string GenerateBinary(size_t bytes, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    std::string data = GenerateText(bytes, false, seed);
+    for (size_t i = NextRandom(state) % 512; i < data.size(); i += 64 + NextRandom(state) % 448) {
+        data[i] = (char)(NextRandom(state) % 32);
+    }
+    if (!data.empty()) data[0] = '\0';    // IsTextData looks at the first 512 bytes
+    return data;
+}
+
+static bool WriteGenerated(const std::string& path, uint64_t bytes, uint32_t seed,
+                           std::string (*generate)(size_t, uint32_t)) {
+    const uint64_t kChunk = 1024 * 1024;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    for (uint64_t written = 0; out && written < bytes; written += kChunk) {
+        std::string chunk = generate((size_t)std::min(kChunk, bytes - written), seed++);
+        out.write(chunk.data(), (std::streamsize)chunk.size());
+    }
+    return (bool)out;
+}
+
+static std::string GenerateLf(size_t bytes, uint32_t seed) {
+    return GenerateText(bytes, false, seed);
+}
+
+static std::string GenerateCrlf(size_t bytes, uint32_t seed) {
+    return GenerateText(bytes, true, seed);
+}
+
+bool WriteTextFile(const std::string& path, uint64_t bytes, bool crlf, uint32_t seed) {
+    return WriteGenerated(path, bytes, seed, crlf ? GenerateCrlf : GenerateLf);
+}
+
+bool WriteBinaryFile(const std::string& path, uint64_t bytes, uint32_t seed) {
+    return WriteGenerated(path, bytes, seed, GenerateBinary);
+}
+
+static size_t WriteFiles(const fs::path& dir, int count, uint32_t& seed) {
+    size_t written = 0;
+    for (int i = 0; i < count; ++i) {
+        static const char* const kExtensions[] = { ".cpp", ".h", ".txt", ".md" };
+        std::string name = "file" + std::to_string(i) + kExtensions[i % 4];
+        if (WriteTextFile((dir / name).string(), 512 + seed % 4096, false, seed)) ++written;
+        NextRandom(seed);
+    }
+    return written;
+}
+
+static size_t WriteLevel(const fs::path& dir, int depth, int fanout, int filesPerDir, uint32_t& seed) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    size_t files = WriteFiles(dir, filesPerDir, seed);
+    if (depth <= 0) return files;
+    for (int i = 0; i < fanout; ++i) {
+        files += WriteLevel(dir / ("dir" + std::to_string(i)), depth - 1, fanout, filesPerDir, seed);
+    }
+    return files;
+}
+
+size_t WriteTree(const std::string& root, int depth, int fanout, int filesPerDir, int chainDepth) {
+    uint32_t seed = 7;
+    size_t files = WriteLevel(root, depth, fanout, filesPerDir, seed);
+
+    fs::path chain = fs::path(root) / "chain";
+    for (int i = 0; i < chainDepth; ++i) chain /= "level" + std::to_string(i);
+    std::error_code ec;
+    fs::create_directories(chain, ec);
+    if (!ec) files += WriteFiles(chain, 1, seed);
+    return files;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Generated inputs for edifier_bench. Content is deterministic for a given seed so
+// runs on different releases measure the same bytes.
+
+// Source-like text: indented lines of identifiers, numbers and punctuation,
+// averaging about 40 bytes, ending in LF or CRLF.
+std::string GenerateText(size_t bytes, bool crlf, uint32_t seed);
+
+// Text with a NUL and other control bytes every few hundred bytes, like an object
+// file or a database page.
+std::string GenerateBinary(size_t bytes, uint32_t seed);
+
+// Write GenerateText or GenerateBinary output to path a megabyte at a time, so
+// huge corpora never sit in memory whole. False if the file can't be written.
+bool WriteTextFile(const std::string& path, uint64_t bytes, bool crlf, uint32_t seed);
+bool WriteBinaryFile(const std::string& path, uint64_t bytes, uint32_t seed);
+
+// Directory tree under root: depth levels of fanout subdirectories, each holding
+// filesPerDir small source files, plus a single chain of chainDepth nested
+// directories. Returns the number of files written.
+size_t WriteTree(const std::string& root, int depth, int fanout, int filesPerDir, int chainDepth);
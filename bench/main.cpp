@@ -0,0 +1,399 @@
+// edifier_bench: times edifier_core's hot paths against generated corpora and
+// reports throughput and heap allocations per call, as a table and as JSON for
+// comparing releases.
+//
+//   edifier_bench [--json FILE|-] [--filter TEXT] [--min-time SECONDS] [--huge-mb N] [--keep]
+
+#include "corpus.h"
+#include "document.h"
+#include "file_io.h"
+#include "fuzzy_finder.h"
+#include "session_journal.h"
+#include "syntax.h"
+#include "text_stats.h"
+#include "undo_history.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef EDIFIER_BUILD_TYPE
+#define EDIFIER_BUILD_TYPE ""
+#endif
+
+namespace fs = std::filesystem;
+
+// Every heap allocation in the process, worker threads included, so work a call
+// hands to the job system is counted against it. Over-aligned new isn't replaced
+// and goes uncounted; nothing in the core uses it.
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+struct BenchOptions {
+    std::string jsonPath;          // "-" for stdout
+    std::string filter;            // run only names containing this
+    double minTime = 0.5;          // seconds of timed calls per benchmark
+    uint64_t hugeBytes = 256ull * 1024 * 1024;
+    bool keep = false;             // leave the corpus directory behind
+};
+
+struct BenchResult {
+    std::string name;
+    std::string corpus;
+    uint64_t iterations = 0;
+    double nsPerCall = 0.0;
+    double allocsPerCall = 0.0;
+    uint64_t bytesPerCall = 0;     // 0 when throughput isn't meaningful
+    uint64_t itemsPerCall = 0;     // files, edits, ...; 0 when not counted
+};
+
+using Clock = std::chrono::steady_clock;
+
+// One untimed call to warm caches, then calls until minTime has passed (at least
+// three). Allocations are averaged over the timed calls.
+static BenchResult RunBench(const BenchOptions& options, const std::string& name, const std::string& corpus,
+                            uint64_t bytesPerCall, uint64_t itemsPerCall, const std::function<void()>& call) {
+    BenchResult result;
+    result.name = name;
+    result.corpus = corpus;
+    result.bytesPerCall = bytesPerCall;
+    result.itemsPerCall = itemsPerCall;
+
+    call();
+
+    uint64_t allocationsBefore = g_allocations.load();
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    while (result.iterations < 3 || elapsed < options.minTime) {
+        call();
+        ++result.iterations;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    result.nsPerCall = elapsed * 1e9 / (double)result.iterations;
+    result.allocsPerCall = (double)(g_allocations.load() - allocationsBefore) / (double)result.iterations;
+    return result;
+}
+
+static double MegabytesPerSecond(const BenchResult& r) {
+    return r.bytesPerCall ? (double)r.bytesPerCall / (1024.0 * 1024.0) / (r.nsPerCall / 1e9) : 0.0;
+}
+
+static double ItemsPerSecond(const BenchResult& r) {
+    return r.itemsPerCall ? (double)r.itemsPerCall / (r.nsPerCall / 1e9) : 0.0;
+}
+
+static void PrintResult(std::ostream& out, const BenchResult& r) {
+    char throughput[32] = "-";
+    char rate[32] = "-";
+    if (r.bytesPerCall) snprintf(throughput, sizeof(throughput), "%.1f", MegabytesPerSecond(r));
+    if (r.itemsPerCall) snprintf(rate, sizeof(rate), "%.0f", ItemsPerSecond(r));
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-20s %-8s %12.3f ms %10s MB/s %12s items/s %12.1f allocs  (%llu calls)",
+             r.name.c_str(), r.corpus.c_str(), r.nsPerCall / 1e6, throughput, rate, r.allocsPerCall,
+             (unsigned long long)r.iterations);
+    out << line << "\n";
+}
+
+static void AppendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20) continue;
+        out += c;
+    }
+    out += '"';
+}
+
+static std::string ResultsJson(const std::vector<BenchResult>& results, const BenchOptions& options) {
+    std::string json = "{\n  \"version\": 1,\n  \"build_type\": ";
+    AppendJsonString(json, EDIFIER_BUILD_TYPE);
+#if defined(__clang__)
+    std::string compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    std::string compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#else
+    std::string compiler = "unknown";
+#endif
+    json += ",\n  \"compiler\": ";
+    AppendJsonString(json, compiler);
+
+    char number[256];
+    snprintf(number, sizeof(number), ",\n  \"timestamp\": %lld,\n  \"min_time\": %.3f,\n  \"huge_bytes\": %llu,\n  \"results\": [",
+             (long long)std::time(nullptr), options.minTime, (unsigned long long)options.hugeBytes);
+    json += number;
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        json += i ? ",\n    {\"name\": " : "\n    {\"name\": ";
+        AppendJsonString(json, r.name);
+        json += ", \"corpus\": ";
+        AppendJsonString(json, r.corpus);
+        snprintf(number, sizeof(number),
+                 ", \"iterations\": %llu, \"ns_per_call\": %.1f, \"allocs_per_call\": %.2f, \"bytes_per_call\": %llu, "
+                 "\"mb_per_sec\": %.2f, \"items_per_call\": %llu, \"items_per_sec\": %.1f}",
+                 (unsigned long long)r.iterations, r.nsPerCall, r.allocsPerCall, (unsigned long long)r.bytesPerCall,
+                 MegabytesPerSecond(r), (unsigned long long)r.itemsPerCall, ItemsPerSecond(r));
+        json += number;
+    }
+    json += "\n  ]\n}\n";
+    return json;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            options.minTime = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--huge-mb" && hasValue) {
+            options.hugeBytes = (uint64_t)std::max(1, std::atoi(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            std::cerr << "Usage: edifier_bench [--json FILE|-] [--filter TEXT] [--min-time SECONDS] [--huge-mb N] [--keep]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) return 2;
+
+    // The table goes to stderr when the JSON takes stdout.
+    std::ostream& log = options.jsonPath == "-" ? std::cerr : std::cout;
+
+    std::error_code ec;
+    fs::path dir = fs::temp_directory_path(ec) /
+                   ("edifier-bench-" + std::to_string((long long)Clock::now().time_since_epoch().count()));
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Cannot create corpus directory " << dir.string() << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    struct FileCorpus {
+        const char* name;
+        std::string path;
+        uint64_t size;
+        bool text;
+    };
+    const uint64_t kSmall = 16 * 1024;
+    const uint64_t kCrlf = 32ull * 1024 * 1024;
+    const uint64_t kBinary = 8ull * 1024 * 1024;
+    std::vector<FileCorpus> files = {
+        { "small", (dir / "small.cpp").string(), kSmall, true },
+        { "huge", (dir / "huge.txt").string(), options.hugeBytes, true },
+        { "crlf", (dir / "crlf.txt").string(), kCrlf, true },
+        { "binary", (dir / "binary.dat").string(), kBinary, false },
+    };
+
+    log << "Writing corpus to " << dir.string() << "\n";
+    bool written = WriteTextFile(files[0].path, kSmall, false, 1) &&
+                   WriteTextFile(files[1].path, options.hugeBytes, false, 2) &&
+                   WriteTextFile(files[2].path, kCrlf, true, 3) &&
+                   WriteBinaryFile(files[3].path, kBinary, 4);
+    std::string treeRoot = (dir / "tree").string();
+    size_t treeFiles = WriteTree(treeRoot, 5, 4, 6, 64);
+    if (!written || treeFiles == 0) {
+        std::cerr << "Failed to write the corpus under " << dir.string() << "\n";
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    auto run = [&](const std::string& name, const std::string& corpus, uint64_t bytes, uint64_t items,
+                   const std::function<void()>& call) {
+        if (!options.filter.empty() && (name + "/" + corpus).find(options.filter) == std::string::npos) return;
+        results.push_back(RunBench(options, name, corpus, bytes, items, call));
+        PrintResult(log, results.back());
+    };
+
+    // Raw reads; the file is in the page cache after the first call.
+    for (const auto& f : files) {
+        run("ReadFileContent", f.name, f.size, 0, [&] {
+            std::string content = ReadFileContent(f.path);
+            if (content.size() != f.size) std::abort();
+        });
+    }
+
+    for (const auto& f : files) {
+        run("IsTextFile", f.name, 0, 1, [&] { (void)IsTextFile(f.path); });
+    }
+
+    // What a tab open costs off the UI thread: read or map, line endings, stats.
+    // Binary files stop at the sniff and load a placeholder, so no throughput.
+    for (const auto& f : files) {
+        run("LoadFile", f.name, f.text ? f.size : 0, 0, [&] {
+            LoadedFile loaded = LoadFile(f.path);
+            if (!loaded.ok) std::abort();
+        });
+    }
+
+    // Full recount, as on open and revert.
+    for (const auto& f : files) {
+        Document doc;
+        if (!LoadDocument(f.path, doc)) continue;
+        run("CountDocumentStats", f.name, doc.Length(), 0, [&] { (void)CountDocumentStats(doc); });
+    }
+
+    // The per-keystroke path: an edit through the piece table with incremental
+    // stats, at scattered positions so the pieces fragment as they would in use.
+    for (const auto& f : files) {
+        Document doc;
+        if (!LoadDocument(f.path, doc)) continue;
+        TextStats stats = CountDocumentStats(doc);
+        uint32_t state = 12345;
+        const size_t kEditsPerCall = 1000;
+        run("ApplyEdit", f.name, 0, kEditsPerCall, [&] {
+            for (size_t i = 0; i < kEditsPerCall; ++i) {
+                state = state * 1664525u + 1013904223u;
+                size_t pos = doc.Length() ? (size_t)(((uint64_t)state << 16) % doc.Length()) : 0;
+                size_t removed = (i % 4 == 3) ? std::min<size_t>(1, doc.Length() - pos) : 0;
+                const char* text = (i % 8 == 7) ? "\n" : "x";
+                TextStats before = StatsBeforeEdit(doc, pos, removed);
+                EditDelta delta = doc.Replace(pos, removed, text, removed ? 0 : 1);
+                StatsAfterEdit(stats, before, doc, delta.pos, delta.inserted);
+            }
+        });
+    }
+
+    // ApplyEdit with the hot-exit journal on: the UI thread only queues each delta,
+    // and the writer group-commits behind it, so this should match ApplyEdit.
+    for (const auto& f : files) {
+        Document doc;
+        FileFormat format;
+        if (!f.text || !LoadDocument(f.path, doc, &format)) continue;
+        SessionJournal journal;
+        if (!journal.Open((dir / "session").string())) continue;
+        uint64_t id = journal.NewJournal();
+        journal.WriteSnapshot(id, JournalBase(), format, doc.Snapshot());
+        TextStats stats = CountDocumentStats(doc);
+        uint32_t state = 12345;
+        const size_t kEditsPerCall = 1000;
+        run("JournalEdit", f.name, 0, kEditsPerCall, [&] {
+            for (size_t i = 0; i < kEditsPerCall; ++i) {
+                state = state * 1664525u + 1013904223u;
+                size_t pos = doc.Length() ? (size_t)(((uint64_t)state << 16) % doc.Length()) : 0;
+                size_t removed = (i % 4 == 3) ? std::min<size_t>(1, doc.Length() - pos) : 0;
+                const char* text = (i % 8 == 7) ? "\n" : "x";
+                TextStats before = StatsBeforeEdit(doc, pos, removed);
+                EditDelta delta = doc.Replace(pos, removed, text, removed ? 0 : 1);
+                StatsAfterEdit(stats, before, doc, delta.pos, delta.inserted);
+                journal.AppendEdit(id, delta.pos, delta.removed, text, delta.inserted);
+            }
+        });
+    }
+
+    // Syntax states for a whole file from scratch, as after jumping to its end.
+    const LanguageDef* cpp = LanguageForPath("bench.cpp");
+    for (const auto& f : files) {
+        Document doc;
+        if (!f.text || !LoadDocument(f.path, doc)) continue;
+        run("LexDocument", f.name, doc.Length(), 0, [&] {
+            SyntaxHighlighter syntax;
+            syntax.SetLanguage(cpp);
+            if (!syntax.Update(doc, (size_t)-1, (size_t)-1)) std::abort();
+        });
+    }
+
+    // An edit on a fully lexed file, then the relex a frame does: from the edited
+    // line until the states converge, with a viewport's worth of lines after it.
+    for (const auto& f : files) {
+        Document doc;
+        if (!f.text || !LoadDocument(f.path, doc)) continue;
+        SyntaxHighlighter syntax;
+        syntax.SetLanguage(cpp);
+        syntax.Update(doc, (size_t)-1, (size_t)-1);
+        uint32_t state = 54321;
+        const size_t kEditsPerCall = 1000;
+        run("SyntaxEdit", f.name, 0, kEditsPerCall, [&] {
+            for (size_t i = 0; i < kEditsPerCall; ++i) {
+                state = state * 1664525u + 1013904223u;
+                size_t pos = doc.Length() ? (size_t)(((uint64_t)state << 16) % doc.Length()) : 0;
+                const char* text = (i % 8 == 7) ? "\n" : (i % 16 == 5) ? "\"" : "x";
+                EditDelta delta = doc.Replace(pos, 0, text, 1);
+                syntax.OnEdit(doc, delta);
+                if (!syntax.Update(doc, doc.LineOfOffset(pos) + 100, (size_t)-1)) std::abort();
+            }
+        });
+    }
+
+    // Replace All on a whole file and its undo: the history keeps the old text as
+    // pieces, so neither step should cost a copy of the file.
+    for (const auto& f : files) {
+        Document doc;
+        if (!f.text || !LoadDocument(f.path, doc)) continue;
+        UndoHistory history;
+        const size_t length = doc.Length();
+        const std::string replaced = "replaced\n";
+        run("UndoRewrite", f.name, 0, 1, [&] {
+            history.RecordRewrite(doc, replaced.size());
+            doc.Replace(0, doc.Length(), replaced.data(), replaced.size());
+            UndoRecord record;
+            if (!history.Undo(doc, record)) std::abort();
+            if (record.text.ByReference()) {
+                doc.Replace(record.pos, record.replaceLen, record.text.pieces);
+            } else {
+                doc.Replace(record.pos, record.replaceLen, record.text.bytes.data(), record.text.bytes.size());
+            }
+            if (doc.Length() != length) std::abort();
+            history.Trim(doc);
+        });
+    }
+
+    // Whole-tree listing with the explorer's skip rules, as Quick Open does it.
+    run("TreeScan", "deep", 0, treeFiles, [&] {
+        std::shared_ptr<const PathIndex> index = PathIndex::Build(treeRoot);
+        if (!index || index->Size() != treeFiles) std::abort();
+    });
+
+    if (!options.jsonPath.empty()) {
+        std::string json = ResultsJson(results, options);
+        if (options.jsonPath == "-") {
+            std::cout << json;
+        } else {
+            std::ofstream out(options.jsonPath, std::ios::binary | std::ios::trunc);
+            out << json;
+            if (!out) {
+                std::cerr << "Cannot write " << options.jsonPath << "\n";
+                return 1;
+            }
+        }
+    }
+
+    if (!options.keep) fs::remove_all(dir, ec);
+    return 0;
+}
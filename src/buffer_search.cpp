@@ -0,0 +1,283 @@
+#include "buffer_search.h"
+
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Searched as one run, then extended to the end of its last line.
+static const size_t kScanBlock = 1024 * 1024;
+
+// doc[pos, pos + len) as one contiguous run: in place when it lies inside a single
+// piece, which covers all of an unedited file, else copied into scratch.
+static const char* ContiguousRange(const Document& doc, size_t pos, size_t len, std::string& scratch) {
+    const char* first = nullptr;
+    size_t firstLen = 0;
+    doc.ForEachChunk(pos, len, [&](const char* data, size_t n) {
+        if (!first) {
+            first = data;
+            firstLen = n;
+        }
+    });
+    if (first && firstLen == len) return first;
+
+    scratch.clear();
+    doc.CopyRange(pos, len, scratch);
+    return scratch.data();
+}
+
+// Start of the line after the one holding pos, or the document end.
+static size_t NextLineStart(const Document& doc, size_t pos) {
+    return std::min(doc.Length(), doc.LineEnd(doc.LineOfOffset(pos)) + 1);
+}
+
+bool BufferSearch::SetQuery(const SearchQuery& query, std::string* error) {
+    if (m_active && query.pattern == m_query.pattern && query.caseSensitive == m_query.caseSensitive &&
+        query.regex == m_query.regex) {
+        return true;
+    }
+
+    Clear();
+    if (!m_matcher.Compile(query, error)) return false;
+    m_query = query;
+    m_active = true;
+    return true;
+}
+
+void BufferSearch::Clear() {
+    m_active = false;
+    m_query = SearchQuery();
+    m_matches.clear();
+    m_matches.shrink_to_fit();
+    m_scanned = 0;
+    m_length = 0;
+    m_generation = (uint64_t)-1;
+    m_truncated = false;
+}
+
+void BufferSearch::Restart(const Document& doc) {
+    m_matches.clear();
+    m_scanned = 0;
+    m_length = doc.Length();
+    m_generation = doc.Generation();
+    m_truncated = false;
+}
+
+// Appends the matches in [begin, end), both line starts (or the document end).
+// Once out holds limit matches the rest of that line is still collected, then the
+// scan stops; the return value is where it stopped, end when it didn't.
+size_t BufferSearch::Scan(const Document& doc, size_t begin, size_t end, std::vector<TextRange>& out, size_t limit) {
+    size_t pos = begin;
+    while (pos < end) {
+        size_t blockEnd = std::min(end, pos + kScanBlock);
+        if (blockEnd < end) blockEnd = std::min(end, NextLineStart(doc, blockEnd - 1));
+
+        size_t len = blockEnd - pos;
+        const char* data = ContiguousRange(doc, pos, len, m_scratch);
+
+        // A block ending at a line start doesn't own that position: an empty regex
+        // match there belongs to the next line.
+        const bool ownsEnd = blockEnd == doc.Length();
+        size_t stop = len;
+        size_t resume = blockEnd;
+        size_t from = 0;
+        size_t matchPos, matchLen;
+        while (from <= stop && m_matcher.Find(data, stop, from, matchPos, matchLen)) {
+            if (matchPos == len && !ownsEnd) break;
+            out.push_back(TextRange{ pos + matchPos, matchLen });
+            from = matchPos + std::max<size_t>(matchLen, 1);
+
+            if (out.size() >= limit && resume == blockEnd) {
+                const char* newline = (const char*)std::memchr(data + matchPos, '\n', len - matchPos);
+                stop = newline ? (size_t)(newline - data) : len;
+                resume = newline ? pos + stop + 1 : blockEnd;
+            }
+        }
+        if (resume != blockEnd) return resume;
+        pos = blockEnd;
+    }
+    return end;
+}
+
+bool BufferSearch::Update(const Document& doc, size_t budget) {
+    MEMORY_SCOPE(MemoryTag::Search);
+    if (!m_active) return true;
+    if (doc.Generation() != m_generation) Restart(doc);
+    if (Complete()) return true;
+    if (budget == 0) return false;
+
+    size_t end = std::min(m_length, m_scanned + budget);
+    if (end < m_length) end = NextLineStart(doc, end - 1);
+
+    size_t reached = Scan(doc, m_scanned, end, m_matches, kMaxMatches);
+    if (reached < end) m_truncated = true;
+    m_scanned = reached;
+    return Complete();
+}
+
+void BufferSearch::OnEdit(const Document& doc, const EditDelta& delta) {
+    MEMORY_SCOPE(MemoryTag::Search);
+    if (!m_active || m_generation == (uint64_t)-1) return;
+    // Replace bumps the generation at most twice; anything else means the document
+    // changed without us.
+    if (delta.generation - m_generation > 2 || m_length - delta.removed + delta.inserted != doc.Length()) {
+        m_generation = (uint64_t)-1;    // out of step; Update starts over
+        return;
+    }
+
+    // The lines holding the edit, in new coordinates. Text before pos is unchanged,
+    // so first is the same before and after; oldEnd is newEnd before the edit.
+    size_t first = doc.LineStart(doc.LineOfOffset(delta.pos));
+    size_t newEnd = NextLineStart(doc, delta.pos + delta.inserted);
+    size_t oldEnd = newEnd - delta.inserted + delta.removed;
+    bool atDocumentEnd = newEnd == doc.Length();
+
+    m_generation = delta.generation;
+    m_length = doc.Length();
+
+    auto byPos = [](const TextRange& m, size_t pos) { return m.pos < pos; };
+    auto lo = std::lower_bound(m_matches.begin(), m_matches.end(), first, byPos);
+
+    if (first >= m_scanned) {
+        // Not searched yet; the frontier is before the edit and doesn't move.
+        return;
+    }
+    if (oldEnd > m_scanned) {
+        // Straddles the frontier: search the edited lines with the rest.
+        m_matches.erase(lo, m_matches.end());
+        m_scanned = first;
+        m_truncated = false;
+        return;
+    }
+
+    std::vector<TextRange> found;
+    Scan(doc, first, newEnd, found, (size_t)-1);
+
+    auto hi = atDocumentEnd ? m_matches.end() : std::lower_bound(lo, m_matches.end(), oldEnd, byPos);
+    for (auto it = hi; it != m_matches.end(); ++it) it->pos = it->pos - delta.removed + delta.inserted;
+    m_scanned = m_scanned - delta.removed + delta.inserted;
+
+    size_t at = (size_t)(lo - m_matches.begin());
+    m_matches.erase(lo, hi);
+    m_matches.insert(m_matches.begin() + at, found.begin(), found.end());
+}
+
+size_t BufferSearch::NextMatch(size_t pos) const {
+    if (m_matches.empty()) return (size_t)-1;
+    auto it = std::lower_bound(m_matches.begin(), m_matches.end(), pos,
+                               [](const TextRange& m, size_t p) { return m.pos < p; });
+    return it == m_matches.end() ? 0 : (size_t)(it - m_matches.begin());
+}
+
+size_t BufferSearch::PrevMatch(size_t pos) const {
+    if (m_matches.empty()) return (size_t)-1;
+    auto it = std::lower_bound(m_matches.begin(), m_matches.end(), pos,
+                               [](const TextRange& m, size_t p) { return m.pos < p; });
+    return it == m_matches.begin() ? m_matches.size() - 1 : (size_t)(it - m_matches.begin()) - 1;
+}
+
+// Every match in doc: the kept list when it covers the document, else that list
+// (a valid prefix) extended into all by a scan without a cap.
+const std::vector<TextRange>& BufferSearch::AllMatches(const Document& doc, std::vector<TextRange>& all) {
+    if (doc.Generation() != m_generation) Restart(doc);
+    if (m_scanned == m_length) return m_matches;
+    all = m_matches;
+    Scan(doc, m_scanned, m_length, all, (size_t)-1);
+    return all;
+}
+
+std::string BufferSearch::ReplaceAll(const Document& doc, const std::string& replacement, size_t& count) {
+    count = 0;
+    if (!m_active) return std::string();
+
+    std::vector<TextRange> all;
+    const std::vector<TextRange>* matches = &AllMatches(doc, all);
+    count = matches->size();
+    if (count == 0) return std::string();
+
+    size_t removed = 0;
+    for (const TextRange& m : *matches) removed += m.len;
+
+    std::string text;
+    text.reserve(doc.Length() - removed + count * replacement.size());
+
+    // One walk over the pieces; a match may straddle two of them.
+    size_t next = 0;
+    size_t chunkPos = 0;
+    size_t resume = 0;     // end of the last replaced match
+    doc.ForEachChunk(0, doc.Length(), [&](const char* data, size_t n) {
+        size_t chunkEnd = chunkPos + n;
+        size_t pos = std::max(chunkPos, resume);
+        while (pos < chunkEnd) {
+            if (next < count && (*matches)[next].pos < chunkEnd) {
+                const TextRange& m = (*matches)[next++];
+                text.append(data + (pos - chunkPos), m.pos - pos);
+                text += replacement;
+                pos = resume = m.pos + m.len;
+            } else {
+                text.append(data + (pos - chunkPos), chunkEnd - pos);
+                pos = chunkEnd;
+            }
+        }
+        chunkPos = chunkEnd;
+    });
+    for (; next < count; ++next) text += replacement;   // empty matches at the very end
+    return text;
+}
+
+DocumentSnapshot BufferSearch::ReplaceAllPieces(const Document& doc, const std::string& replacement, size_t& count) {
+    count = 0;
+    DocumentSnapshot snapshot;
+    if (!m_active) return snapshot;
+
+    std::vector<TextRange> all;
+    const std::vector<TextRange>& matches = AllMatches(doc, all);
+    count = matches.size();
+    if (count == 0) return snapshot;
+
+    std::shared_ptr<TextBuffer> inserted = MakeTextBuffer(replacement);
+    const Document::Piece insertedPiece = { inserted.get(), 0, inserted->size, inserted->newlines.size() };
+    auto replace = [&] {
+        if (insertedPiece.length == 0) return;
+        snapshot.pieces.push_back(insertedPiece);
+        snapshot.length += insertedPiece.length;
+    };
+    auto keep = [&](const Document::Piece& piece, size_t from, size_t to) {
+        if (to <= from) return;
+        Document::Piece part = piece;
+        part.start += from;
+        part.length = to - from;
+        if (part.length != piece.length) {
+            part.newlines = Document::CountNewlines(piece.buffer, part.start, part.start + part.length);
+        }
+        snapshot.pieces.push_back(part);
+        snapshot.length += part.length;
+    };
+
+    // The same walk as ReplaceAll, over pieces instead of their bytes.
+    size_t next = 0;
+    size_t piecePos = 0;
+    size_t resume = 0;
+    for (const Document::Piece& piece : doc.GetPieces()) {
+        size_t pieceEnd = piecePos + piece.length;
+        size_t pos = std::max(piecePos, resume);
+        while (pos < pieceEnd) {
+            if (next < count && matches[next].pos < pieceEnd) {
+                const TextRange& m = matches[next++];
+                keep(piece, pos - piecePos, m.pos - piecePos);
+                replace();
+                pos = resume = m.pos + m.len;
+            } else {
+                keep(piece, pos - piecePos, piece.length);
+                pos = pieceEnd;
+            }
+        }
+        piecePos = pieceEnd;
+    }
+    for (; next < count; ++next) replace();
+
+    // Buffers left without a piece are dropped by the document once it takes these.
+    snapshot.buffers = doc.Buffers();
+    snapshot.buffers.push_back(std::move(inserted));
+    return snapshot;
+}
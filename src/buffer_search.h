@@ -0,0 +1,75 @@
+#pragma once
+
+#include "document.h"
+#include "text_search.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Matches of the find bar's query in one document. The text is searched with the
+// same TextMatcher as Find in Files (SSE2 literal scan, regex per line), in slices
+// handed out by Update so a large buffer never stalls a frame.
+//
+// Edits are folded in from their EditDelta instead of searching again: matches
+// never span lines, so only the lines an edit touched are rescanned and the
+// matches after them are shifted.
+class BufferSearch {
+public:
+    // Matches kept per document. Past this the scan stops and Truncated() is set;
+    // Replace All still covers the whole document.
+    static const size_t kMaxMatches = 100000;
+
+    // Search for query from the start. A no-op if query is already set. False,
+    // with a message in error, when it doesn't compile; the search is then cleared.
+    bool SetQuery(const SearchQuery& query, std::string* error = nullptr);
+    void Clear();
+    bool Active() const { return m_active; }
+
+    // Search up to budget more bytes. Restarts if the document changed without an
+    // OnEdit (reload, revert). True once the whole document has been searched.
+    bool Update(const Document& doc, size_t budget);
+
+    // Call after every edit, with the delta Document::Replace returned.
+    void OnEdit(const Document& doc, const EditDelta& delta);
+
+    const std::vector<TextRange>& Matches() const { return m_matches; }
+    bool Complete() const { return m_active && (m_truncated || m_scanned == m_length); }
+    bool Truncated() const { return m_truncated; }
+    size_t Scanned() const { return m_scanned; }
+
+    // Heap held by the match list and scratch space.
+    size_t MemoryUsage() const { return m_matches.capacity() * sizeof(TextRange) + m_scratch.capacity(); }
+
+    // First match starting at or after pos, else the first one; npos if none.
+    size_t NextMatch(size_t pos) const;
+    // Last match starting before pos, else the last one; npos if none.
+    size_t PrevMatch(size_t pos) const;
+
+    // The document with every match replaced by replacement (inserted literally),
+    // written in one pass into a string allocated once at its exact final size.
+    // Uses the match list when it covers the document, else finds all matches first.
+    std::string ReplaceAll(const Document& doc, const std::string& replacement, size_t& count);
+
+    // The same as pieces, for Document::Replace: the text between matches keeps
+    // pointing into the document's buffers and every replacement into one buffer
+    // holding it once. Nothing is copied, so it suits a mapped file of any size.
+    DocumentSnapshot ReplaceAllPieces(const Document& doc, const std::string& replacement, size_t& count);
+
+private:
+    const std::vector<TextRange>& AllMatches(const Document& doc, std::vector<TextRange>& all);
+    size_t Scan(const Document& doc, size_t begin, size_t end, std::vector<TextRange>& out, size_t limit);
+    void Restart(const Document& doc);
+
+    SearchQuery m_query;
+    TextMatcher m_matcher;
+    bool m_active = false;
+
+    std::vector<TextRange> m_matches;      // by position, non-overlapping
+    size_t m_scanned = 0;                  // [0, m_scanned) is searched; always a line start
+    size_t m_length = 0;                   // document length the state refers to
+    uint64_t m_generation = (uint64_t)-1;
+    bool m_truncated = false;
+    std::string m_scratch;                 // lines that straddle pieces are copied here
+};
@@ -0,0 +1,566 @@
+#include "document.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Add buffers grow in chunks of this size; a single larger insertion gets its own chunk.
+static const size_t kAddChunkSize = 64 * 1024;
+
+static void IndexNewlines(TextBuffer& buffer, size_t from) {
+    const char* p = buffer.data + from;
+    const char* end = buffer.data + buffer.size;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) break;
+        buffer.newlines.push_back((size_t)(nl - buffer.data));
+        p = nl + 1;
+    }
+}
+
+Document::Document() {
+    m_nodes.resize(1);
+}
+
+Document::Document(std::string text) : Document() {
+    SetText(std::move(text));
+}
+
+std::shared_ptr<TextBuffer> MakeTextBuffer(std::string text) {
+    auto buffer = std::make_shared<TextBuffer>();
+    buffer->storage = std::move(text);
+    buffer->data = buffer->storage.data();
+    buffer->size = buffer->storage.size();
+    buffer->capacity = buffer->size;
+    IndexNewlines(*buffer, 0);
+    return buffer;
+}
+
+size_t BufferHeapBytes(const TextBuffer& buffer) {
+    size_t index = buffer.newlines.capacity() * sizeof(size_t) + buffer.lineBlocks.capacity() * sizeof(uint64_t);
+    if (buffer.mapping) return index;
+    return index + (buffer.block ? buffer.capacity : buffer.storage.capacity());
+}
+
+void Document::SetText(std::string text) {
+    SetOriginal(MakeTextBuffer(std::move(text)));
+}
+
+void Document::SetOriginal(std::shared_ptr<TextBuffer> original) {
+    m_nodes.resize(1);
+    m_nodes[0] = Node();
+    m_freeNodes.clear();
+    m_root = 0;
+    m_buffers.clear();
+    m_bufferPieces.clear();
+    m_bufferPieces[original.get()] = 0;
+    m_unreferenced = false;
+    m_addBuffer = nullptr;
+    ++m_generation;
+
+    if (original->size > 0) {
+        m_root = NewNode({ original.get(), 0, original->size, CountNewlines(original.get(), 0, original->size) });
+    }
+    m_buffers.push_back(std::move(original));
+}
+
+// Newlines in [0, pos) of a sparsely indexed buffer: whole blocks from the index,
+// the rest counted in place.
+static size_t NewlinesBefore(const TextBuffer& buffer, size_t pos) {
+    size_t block = pos / kLineBlockSize;
+    size_t count = (size_t)buffer.lineBlocks[block];
+    const char* p = buffer.data + block * kLineBlockSize;
+    const char* end = buffer.data + pos;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) break;
+        ++count;
+        p = nl + 1;
+    }
+    return count;
+}
+
+// Offset of the k-th newline (from 1) at or after start. The buffer's size if there
+// is none, which only a mapping cut short under the editor can cause.
+static size_t NewlineAfter(const TextBuffer& buffer, size_t start, size_t k) {
+    if (buffer.lineBlocks.empty()) {
+        const auto& nl = buffer.newlines;
+        size_t first = std::lower_bound(nl.begin(), nl.end(), start) - nl.begin();
+        return first + k - 1 < nl.size() ? nl[first + k - 1] : buffer.size;
+    }
+    // Skip to the block that holds it, then count through that.
+    uint64_t index = NewlinesBefore(buffer, start) + k - 1;
+    const auto& blocks = buffer.lineBlocks;
+    size_t block = std::upper_bound(blocks.begin(), blocks.end(), index) - blocks.begin() - 1;
+    size_t skip = (size_t)(index - blocks[block]);
+    const char* p = buffer.data + block * kLineBlockSize;
+    const char* end = buffer.data + buffer.size;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) break;
+        if (skip-- == 0) return (size_t)(nl - buffer.data);
+        p = nl + 1;
+    }
+    return buffer.size;
+}
+
+size_t Document::CountNewlines(const TextBuffer* buffer, size_t start, size_t end) {
+    if (!buffer->lineBlocks.empty()) {
+        size_t before = NewlinesBefore(*buffer, start);
+        size_t upTo = NewlinesBefore(*buffer, end);
+        return upTo > before ? upTo - before : 0;
+    }
+    const auto& nl = buffer->newlines;
+    auto first = std::lower_bound(nl.begin(), nl.end(), start);
+    auto last = std::lower_bound(first, nl.end(), end);
+    return (size_t)(last - first);
+}
+
+uint32_t Document::NewNode(const Piece& piece) {
+    // xorshift keeps treap priorities cheap and deterministic per document
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    uint32_t index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+
+    Node& n = m_nodes[index];
+    n = Node();
+    n.piece = piece;
+    n.priority = m_seed;
+    n.length = piece.length;
+    n.newlines = piece.newlines;
+    ++m_bufferPieces[piece.buffer];
+    return index;
+}
+
+void Document::FreeSubtree(uint32_t t) {
+    if (!t) return;
+    FreeSubtree(m_nodes[t].left);
+    FreeSubtree(m_nodes[t].right);
+    if (--m_bufferPieces[m_nodes[t].piece.buffer] == 0) m_unreferenced = true;
+    m_freeNodes.push_back(t);
+}
+
+// Undo and redo bring snapshot buffers in with every replace; without this a long
+// session would keep each of them alive for as long as the tab is open.
+void Document::PruneBuffers() {
+    if (!m_unreferenced || m_buffers.empty()) return;
+    m_unreferenced = false;
+    const TextBuffer* original = m_buffers.front().get();
+    auto unused = [&](const std::shared_ptr<TextBuffer>& buffer) {
+        const TextBuffer* b = buffer.get();
+        if (b == original || b == m_addBuffer || m_bufferPieces[b] != 0) return false;
+        m_bufferPieces.erase(b);
+        return true;
+    };
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), unused), m_buffers.end());
+}
+
+void Document::Update(uint32_t t) {
+    Node& n = m_nodes[t];
+    n.length = n.piece.length + m_nodes[n.left].length + m_nodes[n.right].length;
+    n.newlines = n.piece.newlines + m_nodes[n.left].newlines + m_nodes[n.right].newlines;
+}
+
+uint32_t Document::Merge(uint32_t a, uint32_t b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (m_nodes[a].priority > m_nodes[b].priority) {
+        uint32_t merged = Merge(m_nodes[a].right, b);
+        m_nodes[a].right = merged;
+        Update(a);
+        return a;
+    }
+    uint32_t merged = Merge(a, m_nodes[b].left);
+    m_nodes[b].left = merged;
+    Update(b);
+    return b;
+}
+
+// Split t so that l holds the first pos bytes and r the rest. A piece straddling
+// pos is cut in two; only its newline count is recomputed, via the buffer index.
+void Document::Split(uint32_t t, size_t pos, uint32_t& l, uint32_t& r) {
+    if (!t) {
+        l = r = 0;
+        return;
+    }
+
+    size_t leftLen = m_nodes[m_nodes[t].left].length;
+    size_t pieceLen = m_nodes[t].piece.length;
+
+    if (pos <= leftLen) {
+        uint32_t a, b;
+        Split(m_nodes[t].left, pos, a, b);
+        m_nodes[t].left = b;
+        Update(t);
+        l = a;
+        r = t;
+    } else if (pos >= leftLen + pieceLen) {
+        uint32_t a, b;
+        Split(m_nodes[t].right, pos - leftLen - pieceLen, a, b);
+        m_nodes[t].right = a;
+        Update(t);
+        l = t;
+        r = b;
+    } else {
+        size_t cut = pos - leftLen;
+        Piece head = m_nodes[t].piece;
+        Piece tail = head;
+        head.length = cut;
+        head.newlines = CountNewlines(head.buffer, head.start, head.start + cut);
+        tail.start += cut;
+        tail.length -= cut;
+        tail.newlines -= head.newlines;
+
+        uint32_t tailNode = NewNode(tail);  // may reallocate m_nodes
+        uint32_t rightSub = m_nodes[t].right;
+        m_nodes[t].piece = head;
+        m_nodes[t].right = 0;
+        Update(t);
+        l = t;
+        r = Merge(tailNode, rightSub);
+    }
+}
+
+// Grow the last piece of subtree t in place when it ends exactly at the add-buffer
+// tail. Consecutive keystrokes then extend one piece instead of allocating nodes.
+bool Document::ExtendRightmost(uint32_t t, const TextBuffer* buffer, size_t tail, size_t len, size_t newlines) {
+    if (!t) return false;
+    Node& n = m_nodes[t];
+    bool extended;
+    if (n.right) {
+        extended = ExtendRightmost(n.right, buffer, tail, len, newlines);
+    } else {
+        extended = n.piece.buffer == buffer && n.piece.start + n.piece.length == tail;
+        if (extended) {
+            n.piece.length += len;
+            n.piece.newlines += newlines;
+        }
+    }
+    if (extended) Update(t);
+    return extended;
+}
+
+Document::Piece Document::AppendToAddBuffer(const char* text, size_t len) {
+    if (!m_addBuffer || m_addBuffer->capacity - m_addBuffer->size < len) {
+        auto chunk = std::make_shared<TextBuffer>();
+        chunk->capacity = std::max(kAddChunkSize, len);
+        chunk->block.reset(new char[chunk->capacity]);
+        chunk->data = chunk->block.get();
+        m_buffers.push_back(chunk);
+        m_bufferPieces[chunk.get()] = 0;
+        m_addBuffer = chunk.get();
+    }
+
+    Piece piece;
+    piece.buffer = m_addBuffer;
+    piece.start = m_addBuffer->size;
+    piece.length = len;
+
+    std::memcpy(m_addBuffer->block.get() + m_addBuffer->size, text, len);
+    size_t indexed = m_addBuffer->newlines.size();
+    m_addBuffer->size += len;
+    IndexNewlines(*m_addBuffer, piece.start);
+    piece.newlines = m_addBuffer->newlines.size() - indexed;
+    return piece;
+}
+
+void Document::Insert(size_t pos, const char* text, size_t len) {
+    if (len == 0) return;
+    pos = std::min(pos, Length());
+
+    const TextBuffer* oldTail = m_addBuffer;
+    size_t oldTailSize = oldTail ? oldTail->size : 0;
+    Piece piece = AppendToAddBuffer(text, len);
+
+    uint32_t l, r;
+    Split(m_root, pos, l, r);
+    bool sameChunk = piece.buffer == oldTail && piece.start == oldTailSize;
+    if (!sameChunk || !ExtendRightmost(l, piece.buffer, piece.start, piece.length, piece.newlines)) {
+        l = Merge(l, NewNode(piece));
+    }
+    m_root = Merge(l, r);
+    ++m_generation;
+}
+
+void Document::Erase(size_t pos, size_t len) {
+    size_t total = Length();
+    if (pos >= total || len == 0) return;
+    len = std::min(len, total - pos);
+
+    uint32_t l, mid, r;
+    Split(m_root, pos, l, mid);
+    Split(mid, len, mid, r);
+    FreeSubtree(mid);
+    m_root = Merge(l, r);
+    PruneBuffers();
+    ++m_generation;
+}
+
+// The snapshot's pieces are linked in as they are; its buffers join ours so they
+// stay alive as long as the pieces do.
+void Document::Insert(size_t pos, const DocumentSnapshot& text) {
+    if (text.length == 0) return;
+    pos = std::min(pos, Length());
+
+    for (const auto& buffer : text.buffers) {
+        if (m_bufferPieces.emplace(buffer.get(), 0).second) m_buffers.push_back(buffer);
+    }
+
+    uint32_t l, r;
+    Split(m_root, pos, l, r);
+    for (const Piece& piece : text.pieces) {
+        if (piece.length) l = Merge(l, NewNode(piece));
+    }
+    m_root = Merge(l, r);
+    // A whole-document snapshot brings buffers none of its pieces use.
+    for (const auto& buffer : text.buffers) {
+        if (m_bufferPieces[buffer.get()] == 0) m_unreferenced = true;
+    }
+    PruneBuffers();
+    ++m_generation;
+}
+
+EditDelta Document::Replace(size_t pos, size_t len, const DocumentSnapshot& text) {
+    EditDelta delta;
+    delta.pos = std::min(pos, Length());
+    delta.removed = std::min(len, Length() - delta.pos);
+    delta.inserted = text.length;
+
+    Erase(delta.pos, delta.removed);
+    Insert(delta.pos, text);
+    delta.generation = m_generation;
+    return delta;
+}
+
+EditDelta Document::Replace(size_t pos, size_t len, const char* text, size_t textLen) {
+    EditDelta delta;
+    delta.pos = std::min(pos, Length());
+    delta.removed = std::min(len, Length() - delta.pos);
+    delta.inserted = textLen;
+
+    Erase(delta.pos, delta.removed);
+    Insert(delta.pos, text, textLen);
+    delta.generation = m_generation;
+    return delta;
+}
+
+DocumentMemory Document::Memory() const {
+    DocumentMemory memory;
+    memory.pieces = m_nodes.capacity() * sizeof(Node) + m_freeNodes.capacity() * sizeof(uint32_t);
+    for (const auto& buffer : m_buffers) {
+        memory.newlineIndex += buffer->newlines.capacity() * sizeof(size_t) +
+                               buffer->lineBlocks.capacity() * sizeof(uint64_t);
+        if (buffer->block) {
+            memory.addUsed += buffer->size;
+            memory.addCapacity += buffer->capacity;
+        } else if (buffer->mapping) {
+            memory.mapped += buffer->size;
+        } else {
+            memory.original += buffer->storage.capacity();
+        }
+    }
+    return memory;
+}
+
+size_t Document::Length() const {
+    return m_nodes[m_root].length;
+}
+
+size_t Document::LineCount() const {
+    return m_nodes[m_root].newlines + 1;
+}
+
+size_t Document::LineStart(size_t line) const {
+    if (line == 0) return 0;
+    if (line > m_nodes[m_root].newlines) return Length();
+
+    // Find the line-th newline; the line starts right after it.
+    size_t k = line;
+    size_t base = 0;
+    uint32_t t = m_root;
+    while (t) {
+        const Node& n = m_nodes[t];
+        size_t leftNewlines = m_nodes[n.left].newlines;
+        if (k <= leftNewlines) {
+            t = n.left;
+            continue;
+        }
+        k -= leftNewlines;
+        base += m_nodes[n.left].length;
+        if (k <= n.piece.newlines) {
+            size_t nl = NewlineAfter(*n.piece.buffer, n.piece.start, k);
+            return base + std::min(nl - n.piece.start, n.piece.length - 1) + 1;
+        }
+        k -= n.piece.newlines;
+        base += n.piece.length;
+        t = n.right;
+    }
+    return Length();
+}
+
+size_t Document::LineEnd(size_t line) const {
+    if (line + 1 >= LineCount()) return Length();
+    return LineStart(line + 1) - 1;
+}
+
+size_t Document::LineOfOffset(size_t offset) const {
+    offset = std::min(offset, Length());
+    size_t line = 0;
+    uint32_t t = m_root;
+    while (t) {
+        const Node& n = m_nodes[t];
+        size_t leftLen = m_nodes[n.left].length;
+        if (offset < leftLen) {
+            t = n.left;
+            continue;
+        }
+        offset -= leftLen;
+        line += m_nodes[n.left].newlines;
+        if (offset < n.piece.length) {
+            return line + CountNewlines(n.piece.buffer, n.piece.start, n.piece.start + offset);
+        }
+        offset -= n.piece.length;
+        line += n.piece.newlines;
+        t = n.right;
+    }
+    return line;
+}
+
+char Document::CharAt(size_t pos) const {
+    uint32_t t = m_root;
+    while (t) {
+        const Node& n = m_nodes[t];
+        size_t leftLen = m_nodes[n.left].length;
+        if (pos < leftLen) {
+            t = n.left;
+            continue;
+        }
+        pos -= leftLen;
+        if (pos < n.piece.length) return n.piece.buffer->data[n.piece.start + pos];
+        pos -= n.piece.length;
+        t = n.right;
+    }
+    return '\0';
+}
+
+// Calls fn(piece, from, to) with the part [from, to) of each piece, in piece offsets,
+// that overlaps [pos, pos + len).
+template <typename Fn>
+void Document::WalkRange(size_t pos, size_t len, Fn&& fn) const {
+    size_t total = Length();
+    if (pos >= total || len == 0) return;
+    size_t end = std::min(total, pos + len);
+
+    // Iterative in-order walk that descends straight to pos, then streams pieces.
+    std::vector<std::pair<uint32_t, size_t>> stack;  // node, offset of its subtree
+    uint32_t t = m_root;
+    size_t base = 0;
+    while (t || !stack.empty()) {
+        while (t) {
+            const Node& n = m_nodes[t];
+            size_t pieceStart = base + m_nodes[n.left].length;
+            if (pos >= pieceStart + n.piece.length) {
+                // Entire left subtree and this piece lie before the range.
+                base = pieceStart + n.piece.length;
+                t = n.right;
+                continue;
+            }
+            stack.push_back({ t, base });
+            t = n.left;
+        }
+        if (stack.empty()) break;
+
+        auto [node, subtreeBase] = stack.back();
+        stack.pop_back();
+        const Node& n = m_nodes[node];
+        size_t pieceStart = subtreeBase + m_nodes[n.left].length;
+        if (pieceStart >= end) break;
+
+        size_t from = std::max(pos, pieceStart);
+        size_t to = std::min(end, pieceStart + n.piece.length);
+        if (from < to) fn(n.piece, from - pieceStart, to - pieceStart);
+
+        base = pieceStart + n.piece.length;
+        t = n.right;
+    }
+}
+
+void Document::VisitRange(size_t pos, size_t len, ChunkVisitor visit, void* ctx) const {
+    WalkRange(pos, len, [&](const Piece& piece, size_t from, size_t to) {
+        visit(ctx, piece.buffer->data + piece.start + from, to - from);
+    });
+}
+
+void Document::CopyRange(size_t pos, size_t len, std::string& out) const {
+    ForEachChunk(pos, len, [&out](const char* data, size_t n) {
+        out.append(data, n);
+    });
+}
+
+std::string Document::GetText() const {
+    std::string text;
+    text.reserve(Length());
+    CopyRange(0, Length(), text);
+    return text;
+}
+
+std::vector<Document::Piece> Document::GetPieces() const {
+    std::vector<Piece> pieces;
+    std::vector<uint32_t> stack;
+    uint32_t t = m_root;
+    while (t || !stack.empty()) {
+        while (t) {
+            stack.push_back(t);
+            t = m_nodes[t].left;
+        }
+        t = stack.back();
+        stack.pop_back();
+        pieces.push_back(m_nodes[t].piece);
+        t = m_nodes[t].right;
+    }
+    return pieces;
+}
+
+DocumentSnapshot Document::Snapshot() const {
+    DocumentSnapshot snapshot;
+    snapshot.pieces = GetPieces();
+    snapshot.buffers = m_buffers;
+    snapshot.generation = m_generation;
+    snapshot.length = Length();
+    return snapshot;
+}
+
+DocumentSnapshot Document::Snapshot(size_t pos, size_t len) const {
+    DocumentSnapshot snapshot;
+    WalkRange(pos, len, [&](const Piece& piece, size_t from, size_t to) {
+        Piece part = piece;
+        if (from != 0 || to != piece.length) {
+            part.start = piece.start + from;
+            part.length = to - from;
+            part.newlines = CountNewlines(piece.buffer, part.start, part.start + part.length);
+        }
+        snapshot.pieces.push_back(part);
+        snapshot.length += part.length;
+    });
+
+    // Only the buffers those pieces point into.
+    std::vector<const TextBuffer*> used;
+    for (const Piece& piece : snapshot.pieces) {
+        if (used.empty() || used.back() != piece.buffer) used.push_back(piece.buffer);
+    }
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    for (const auto& buffer : m_buffers) {
+        if (std::binary_search(used.begin(), used.end(), buffer.get())) snapshot.buffers.push_back(buffer);
+    }
+    snapshot.generation = m_generation;
+    return snapshot;
+}
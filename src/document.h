@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MappedFile;
+
+// Block size of a sparse newline index.
+const size_t kLineBlockSize = 4096;
+
+// Backing storage referenced by document pieces. The original buffer is immutable
+// once loaded; add buffers are fixed-capacity chunks that are only ever appended to,
+// so bytes a piece points at never move or change.
+//
+// Lines are found through one of two indexes. Heap buffers list every newline. A
+// mapped original would need 8 bytes of heap per line for that, so it only counts
+// them per block instead and lookups scan at most a block of the mapping.
+struct TextBuffer {
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+    std::vector<size_t> newlines;      // offsets of every '\n' in [0, size), ascending
+    std::vector<uint64_t> lineBlocks;  // or: newlines before each kLineBlockSize block, then the total
+
+    std::string storage;               // owned bytes of a heap-loaded original
+    std::unique_ptr<char[]> block;     // owned bytes of an add-buffer chunk
+    std::shared_ptr<MappedFile> mapping;  // keeps a memory-mapped original alive
+};
+
+// Heap-owned buffer holding text, with its newline index built. Safe to call off the
+// UI thread; the result can then be handed to Document::SetOriginal without copying.
+std::shared_ptr<TextBuffer> MakeTextBuffer(std::string text);
+
+// Heap a buffer would free if nothing referenced it. Mappings count as nothing:
+// their pages are the file's and the kernel drops them under pressure.
+size_t BufferHeapBytes(const TextBuffer& buffer);
+
+// One applied edit: [pos, pos + removed) was replaced by `inserted` bytes.
+struct EditDelta {
+    size_t pos = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+    uint64_t generation = 0;   // document generation after the edit
+};
+
+// A span of document bytes, e.g. a search match.
+struct TextRange {
+    size_t pos = 0;
+    size_t len = 0;
+};
+
+struct DocumentSnapshot;
+
+// Where a document's memory goes, by kind of buffer.
+struct DocumentMemory {
+    size_t original = 0;       // loaded text copied to the heap
+    size_t mapped = 0;         // loaded text left in a file mapping; not heap
+    size_t addUsed = 0;        // typed or pasted text
+    size_t addCapacity = 0;    // add chunks as allocated, used or not
+    size_t newlineIndex = 0;
+    size_t pieces = 0;         // the piece tree
+
+    size_t Heap() const { return original + addCapacity + newlineIndex + pieces; }
+};
+
+// Piece table over an immutable original buffer plus append-only add buffers.
+// Pieces live in an implicit treap keyed by document offset, so insertions,
+// deletions and line lookups are O(log n) in the number of pieces and never copy
+// document text. This is the single source of truth for a tab's contents.
+class Document {
+public:
+    struct Piece {
+        const TextBuffer* buffer = nullptr;
+        size_t start = 0;
+        size_t length = 0;
+        size_t newlines = 0;
+    };
+
+    Document();
+    explicit Document(std::string text);
+
+    // Replace the whole document with a fresh original buffer. Takes ownership of
+    // the string, so loading a file costs no extra copy.
+    void SetText(std::string text);
+
+    // Replace the whole document with a prepared original buffer (e.g. a file
+    // mapping). The buffer's newline index must already be complete.
+    void SetOriginal(std::shared_ptr<TextBuffer> original);
+
+    void Insert(size_t pos, const char* text, size_t len);
+    void Erase(size_t pos, size_t len);
+    EditDelta Replace(size_t pos, size_t len, const char* text, size_t textLen);
+
+    // Insert or replace with the pieces of a snapshot, e.g. text kept by the undo
+    // history. No text is copied, however long it is.
+    void Insert(size_t pos, const DocumentSnapshot& text);
+    EditDelta Replace(size_t pos, size_t len, const DocumentSnapshot& text);
+
+    // Bumped by every mutation; cheap "did anything change" check for caches.
+    uint64_t Generation() const { return m_generation; }
+
+    size_t Length() const;
+    size_t LineCount() const;                  // always >= 1
+    size_t LineStart(size_t line) const;       // offset of the first byte of a line
+    size_t LineEnd(size_t line) const;         // offset of the line's '\n', or Length()
+    size_t LineOfOffset(size_t offset) const;
+
+    char CharAt(size_t pos) const;
+    void CopyRange(size_t pos, size_t len, std::string& out) const;  // appends to out
+    std::string GetText() const;
+    std::vector<Piece> GetPieces() const;
+    DocumentSnapshot Snapshot() const;
+    DocumentSnapshot Snapshot(size_t pos, size_t len) const;   // just [pos, pos + len) and its buffers
+
+    // Every buffer the document holds: the original, add chunks, and buffers that
+    // came in with snapshot pieces. Buffers no piece points into any more are let go
+    // after each erase, except the original and the chunk being appended to.
+    const std::vector<std::shared_ptr<TextBuffer>>& Buffers() const { return m_buffers; }
+    bool Holds(const TextBuffer* buffer) const { return m_bufferPieces.count(buffer) != 0; }
+
+    // Heap held by the buffers and the piece tree, shared buffers included.
+    size_t MemoryUsage() const { return Memory().Heap(); }
+    DocumentMemory Memory() const;
+
+    // Newlines among buffer bytes [start, end), from the buffer's index.
+    static size_t CountNewlines(const TextBuffer* buffer, size_t start, size_t end);
+
+    // Calls fn(const char* data, size_t len) for each contiguous run in [pos, pos + len).
+    template <typename Fn>
+    void ForEachChunk(size_t pos, size_t len, Fn&& fn) const {
+        VisitRange(pos, len, [](void* ctx, const char* data, size_t n) {
+            (*static_cast<Fn*>(ctx))(data, n);
+        }, &fn);
+    }
+
+private:
+    struct Node {
+        Piece piece;
+        uint32_t left = 0;
+        uint32_t right = 0;
+        uint32_t priority = 0;
+        size_t length = 0;      // subtree totals
+        size_t newlines = 0;
+    };
+
+    using ChunkVisitor = void (*)(void* ctx, const char* data, size_t len);
+    void VisitRange(size_t pos, size_t len, ChunkVisitor visit, void* ctx) const;
+    template <typename Fn>
+    void WalkRange(size_t pos, size_t len, Fn&& fn) const;
+
+    uint32_t NewNode(const Piece& piece);
+    void FreeSubtree(uint32_t t);
+    void PruneBuffers();
+    void Update(uint32_t t);
+    uint32_t Merge(uint32_t a, uint32_t b);
+    void Split(uint32_t t, size_t pos, uint32_t& l, uint32_t& r);
+    bool ExtendRightmost(uint32_t t, const TextBuffer* buffer, size_t tail, size_t len, size_t newlines);
+    Piece AppendToAddBuffer(const char* text, size_t len);
+
+    std::vector<Node> m_nodes;                          // m_nodes[0] is the null sentinel
+    std::vector<uint32_t> m_freeNodes;
+    uint32_t m_root = 0;
+    uint32_t m_seed = 0x9E3779B9u;
+    uint64_t m_generation = 0;
+
+    std::vector<std::shared_ptr<TextBuffer>> m_buffers; // original + every add chunk
+    std::unordered_map<const TextBuffer*, size_t> m_bufferPieces;  // pieces pointing into each of m_buffers
+    bool m_unreferenced = false;                        // some buffer's piece count dropped to zero
+    TextBuffer* m_addBuffer = nullptr;                  // chunk currently being appended to
+};
+
+// The document's pieces at one generation, holding their buffers. Piece bytes never
+// change once written, so a snapshot can be read on another thread while the
+// document keeps being edited or is reloaded.
+struct DocumentSnapshot {
+    std::vector<Document::Piece> pieces;
+    std::vector<std::shared_ptr<TextBuffer>> buffers;
+    uint64_t generation = 0;
+    size_t length = 0;
+
+    template <typename Fn>
+    void ForEachChunk(Fn&& fn) const {
+        for (const auto& piece : pieces) {
+            if (piece.length) fn(piece.buffer->data + piece.start, piece.length);
+        }
+    }
+};
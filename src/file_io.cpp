@@ -0,0 +1,772 @@
+#include "file_io.h"
+#include "document.h"
+#include "text_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const size_t kReadChunk = 8 * 1024 * 1024;
+
+// Newlines are indexed in windows of this size; on Linux each window is released
+// from the process right after, so opening a huge file doesn't leave it resident.
+static const size_t kIndexWindow = 64 * 1024 * 1024;
+static_assert(kIndexWindow % kLineBlockSize == 0, "newline blocks must not straddle windows");
+
+#ifndef _WIN32
+// A mapping only stays private until a page is first touched: if another program
+// truncates the file before that, reading past the new end raises SIGBUS. Every
+// mapping MapFile makes is registered here, and a fault inside one swaps the
+// missing pages for zeros, so the reader sees NULs where the file was cut instead
+// of the editor dying. The slot is marked faulted, so nothing saves those NULs as
+// the file's text, and the file watcher reports the change as usual. Slots are
+// plain atomics so the handler can scan them; mappings beyond the last slot are
+// simply not guarded. (Windows needs none of this: the file is opened without
+// FILE_SHARE_WRITE, so nobody can truncate it while it is mapped.)
+struct MappingGuard {
+    std::atomic<uintptr_t> begin{0};
+    std::atomic<size_t> size{0};
+    std::atomic<bool> faulted{false};
+};
+
+static const size_t kMappingGuards = 256;
+static MappingGuard g_mappingGuards[kMappingGuards];
+static struct sigaction g_previousSigbus;
+static uintptr_t g_pageSize = 0;    // sysconf isn't async-signal-safe; read before the handler goes in
+static std::atomic<uint64_t> g_mappingFaults{0};
+
+static void OnSigbus(int sig, siginfo_t* info, void* context) {
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    for (MappingGuard& guard : g_mappingGuards) {
+        uintptr_t begin = guard.begin.load(std::memory_order_acquire);
+        if (begin <= 1 || addr < begin || addr - begin >= guard.size.load(std::memory_order_relaxed)) continue;
+        void* zero = (void*)(addr & ~(g_pageSize - 1));
+        if (mmap(zero, g_pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            guard.faulted.store(true, std::memory_order_release);
+            g_mappingFaults.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        break;
+    }
+    // Not ours: behave as if the guard wasn't there.
+    if (g_previousSigbus.sa_flags & SA_SIGINFO) {
+        g_previousSigbus.sa_sigaction(sig, info, context);
+    } else if (g_previousSigbus.sa_handler != SIG_DFL && g_previousSigbus.sa_handler != SIG_IGN) {
+        g_previousSigbus.sa_handler(sig);
+    } else {
+        signal(SIGBUS, SIG_DFL);  // the faulting read repeats and takes the default action
+    }
+}
+
+static MappingGuard* GuardMapping(const char* data, size_t size) {
+    static bool installed = [] {
+        g_pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        struct sigaction action = {};
+        action.sa_sigaction = OnSigbus;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        return sigaction(SIGBUS, &action, &g_previousSigbus) == 0;
+    }();
+    if (!installed) return nullptr;
+    for (MappingGuard& guard : g_mappingGuards) {
+        // Claimed with a placeholder first, so the handler never pairs data with a stale size.
+        uintptr_t expected = 0;
+        if (!guard.begin.compare_exchange_strong(expected, 1, std::memory_order_relaxed)) continue;
+        guard.size.store(size, std::memory_order_relaxed);
+        guard.faulted.store(false, std::memory_order_relaxed);
+        guard.begin.store((uintptr_t)data, std::memory_order_release);
+        return &guard;
+    }
+    return nullptr;
+}
+#endif
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+#else
+    if (guard) static_cast<MappingGuard*>(guard)->begin.store(0, std::memory_order_release);
+    if (data) munmap(const_cast<char*>(data), size);
+#endif
+}
+
+bool MappedFile::Faulted() const {
+#ifdef _WIN32
+    return false;
+#else
+    return guard && static_cast<MappingGuard*>(guard)->faulted.load(std::memory_order_acquire);
+#endif
+}
+
+uint64_t MappingFaults() {
+#ifdef _WIN32
+    return 0;
+#else
+    return g_mappingFaults.load(std::memory_order_acquire);
+#endif
+}
+
+bool SnapshotFaulted(const DocumentSnapshot& snapshot) {
+    for (const auto& buffer : snapshot.buffers) {
+        if (buffer->mapping && buffer->mapping->Faulted()) return true;
+    }
+    return false;
+}
+
+std::shared_ptr<MappedFile> MapFile(const std::string& filepath) {
+    auto mapped = std::make_shared<MappedFile>();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    mapped->file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) return nullptr;
+
+    mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapped->mapping) return nullptr;
+
+    mapped->data = static_cast<const char*>(MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->data) return nullptr;
+    mapped->size = (size_t)size.QuadPart;
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file referenced
+    if (addr == MAP_FAILED) return nullptr;
+
+    mapped->data = static_cast<const char*>(addr);
+    mapped->size = (size_t)st.st_size;
+    mapped->guard = GuardMapping(mapped->data, mapped->size);
+#endif
+    return mapped;
+}
+
+// Mapped files are only scanned once, so their style comes from counting newlines:
+// a lone '\r' without '\n' goes unnoticed there, which is harmless as nothing is rewritten.
+// The index is the sparse kind, per block. Hash and stats are taken in the same
+// pass, while each window is resident.
+static bool IndexMappedNewlines(TextBuffer& buffer, FileFormat& format, ContentHash& hash, TextStatsCounter& stats,
+                                LoadProgress* progress) {
+    uint64_t crlf = 0;
+    uint64_t newlines = 0;
+    buffer.lineBlocks.reserve(buffer.size / kLineBlockSize + 2);
+    for (size_t window = 0; window < buffer.size; window += kIndexWindow) {
+        if (progress && progress->cancelled) return false;
+        const char* begin = buffer.data + window;
+        const char* end = buffer.data + std::min(buffer.size, window + kIndexWindow);
+#ifdef __linux__
+        madvise(const_cast<char*>(begin), end - begin, MADV_SEQUENTIAL);
+#endif
+        for (const char* block = begin; block < end; block += kLineBlockSize) {
+            buffer.lineBlocks.push_back(newlines);
+            const char* blockEnd = std::min(end, block + kLineBlockSize);
+            for (const char* p = block; p < blockEnd;) {
+                const char* nl = static_cast<const char*>(std::memchr(p, '\n', blockEnd - p));
+                if (!nl) break;
+                ++newlines;
+                crlf += nl > buffer.data && nl[-1] == '\r';
+                p = nl + 1;
+            }
+        }
+        hash.Update(begin, end - begin);
+        stats.Add(begin, end - begin);
+#ifdef __linux__
+        // Clean file-backed pages: dropping them only costs a page-cache refault later.
+        madvise(const_cast<char*>(begin), end - begin, MADV_DONTNEED);
+#endif
+        if (progress) progress->done += (uint64_t)(end - begin);
+    }
+#ifdef __linux__
+    madvise(const_cast<char*>(buffer.data), buffer.size, MADV_RANDOM);
+#endif
+    buffer.lineBlocks.push_back(newlines);
+    format.eol = crlf == 0 ? LineEnding::LF
+               : crlf == newlines ? LineEnding::CRLF : LineEnding::Mixed;
+    return true;
+}
+
+static const uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+static const uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+static const uint64_t kPrime3 = 0x165667b19e3779f9ull;
+static const uint64_t kPrime4 = 0x85ebca77c2b2ae63ull;
+static const uint64_t kPrime5 = 0x27d4eb2f165667c5ull;
+
+static uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t Load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t HashRound(uint64_t acc, uint64_t input) {
+    return Rotl(acc + input * kPrime2, 31) * kPrime1;
+}
+
+void ContentHash::Stripe(const char* p) {
+    for (int i = 0; i < 4; ++i) m_lanes[i] = HashRound(m_lanes[i], Load64(p + i * 8));
+}
+
+void ContentHash::Update(const char* data, size_t len) {
+    m_total += len;
+    if (m_tailLen) {
+        size_t n = std::min(len, sizeof(m_tail) - m_tailLen);
+        std::memcpy(m_tail + m_tailLen, data, n);
+        m_tailLen += n;
+        data += n;
+        len -= n;
+        if (m_tailLen < sizeof(m_tail)) return;
+        Stripe(m_tail);
+        m_tailLen = 0;
+    }
+    for (; len >= 32; data += 32, len -= 32) Stripe(data);
+    std::memcpy(m_tail, data, len);
+    m_tailLen = len;
+}
+
+uint64_t ContentHash::Digest() const {
+    uint64_t h;
+    if (m_total >= 32) {
+        h = Rotl(m_lanes[0], 1) + Rotl(m_lanes[1], 7) + Rotl(m_lanes[2], 12) + Rotl(m_lanes[3], 18);
+        for (uint64_t lane : m_lanes) h = (h ^ HashRound(0, lane)) * kPrime1 + kPrime4;
+    } else {
+        h = kPrime5;
+    }
+    h += m_total;
+
+    const char* p = m_tail;
+    const char* end = m_tail + m_tailLen;
+    for (; p + 8 <= end; p += 8) h = Rotl(h ^ HashRound(0, Load64(p)), 27) * kPrime1 + kPrime4;
+    if (p + 4 <= end) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        h = Rotl(h ^ (v * kPrime1), 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) h = Rotl(h ^ ((unsigned char)*p * kPrime5), 11) * kPrime1;
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+FileFingerprint StatFile(const std::string& filepath) {
+    FileFingerprint fingerprint;
+    std::error_code ec;
+    fingerprint.size = fs::file_size(filepath, ec);
+    if (ec) return FileFingerprint();
+    fingerprint.modified = fs::last_write_time(filepath, ec);
+    fingerprint.exists = !ec;
+    return fingerprint;
+}
+
+static bool HashFile(const std::string& filepath, uint64_t& hash) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) return false;
+    ContentHash hasher;
+    std::vector<char> buffer(1024 * 1024);
+    while (file) {
+        file.read(buffer.data(), (std::streamsize)buffer.size());
+        hasher.Update(buffer.data(), (size_t)file.gcount());
+    }
+    if (file.bad()) return false;
+    hash = hasher.Digest();
+    return true;
+}
+
+DiskChange CheckFileOnDisk(const std::string& filepath, const FileFingerprint& known, FileFingerprint& now) {
+    now = StatFile(filepath);
+    if (!now.exists) return known.exists ? DiskChange::Deleted : DiskChange::None;
+    if (!known.exists || now.size != known.size) return DiskChange::Changed;
+    if (now.modified == known.modified) {
+        now.hash = known.hash;
+        now.hashed = known.hashed;
+        return DiskChange::None;
+    }
+    if (!known.hashed || !HashFile(filepath, now.hash)) return DiskChange::Changed;
+    now.hashed = true;
+    return now.hash == known.hash ? DiskChange::Touched : DiskChange::Changed;
+}
+
+static LineEnding DetectLineEnding(const LineEndingCounts& counts) {
+    if (counts.cr == 0) return LineEnding::LF;
+    if (counts.crlf == counts.cr && counts.crlf == counts.lf) return LineEnding::CRLF;
+    return LineEnding::Mixed;
+}
+
+// Drop every '\r' in place, copying the runs between them with memmove. Only used
+// on consistent CRLF text, where each '\r' is half of a line break.
+static void StripCarriageReturns(std::string& text) {
+    char* out = text.data();
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* cr = static_cast<const char*>(std::memchr(p, '\r', end - p));
+        if (!cr) cr = end;
+        size_t n = (size_t)(cr - p);
+        if (out != p) std::memmove(out, p, n);
+        out += n;
+        p = cr + 1;
+    }
+    text.resize((size_t)(out - text.data()));
+}
+
+const char* LineEndingName(LineEnding eol) {
+    switch (eol) {
+    case LineEnding::LF: return "LF";
+    case LineEnding::CRLF: return "CRLF";
+    case LineEnding::Mixed: return "Mixed";
+    }
+    return "LF";
+}
+
+const char* InsertedNewline(const FileFormat& format) {
+    return format.eol == LineEnding::CRLF && !format.normalized ? "\r\n" : "\n";
+}
+
+static const char* const kTextExtensions[] = {
+    ".txt", ".md", ".markdown", ".log", ".cfg", ".ini", ".json", ".xml",
+    ".html", ".htm", ".css", ".js", ".ts", ".jsx", ".tsx",
+    ".cpp", ".c", ".h", ".hpp", ".cc", ".cxx", ".py", ".java",
+    ".cs", ".rb", ".go", ".rs", ".swift", ".kt", ".scala",
+    ".sh", ".bash", ".zsh", ".fish", ".ps1", ".bat", ".cmd",
+    ".yaml", ".yml", ".toml", ".env", ".gitignore", ".dockerignore"
+};
+
+// Known text extensions (and no extension at all) are trusted without sampling.
+static bool HasTextExtension(const std::string& filepath) {
+    std::string ext = fs::path(filepath).extension().string();
+    if (ext.empty()) return true;
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
+    for (const char* known : kTextExtensions) {
+        if (ext == known) return true;
+    }
+    return false;
+}
+
+// Binary check via sampling: a NUL byte in the first 512 bytes.
+static bool SampleLooksLikeText(const char* data, size_t len) {
+    return std::memchr(data, '\0', std::min<size_t>(len, 512)) == nullptr;
+}
+
+bool IsTextFile(const std::string& filepath) {
+    if (filepath.empty() || !fs::exists(filepath)) return false;
+    if (HasTextExtension(filepath)) return true;
+
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    char buffer[512];
+    file.read(buffer, sizeof(buffer));
+    return SampleLooksLikeText(buffer, (size_t)file.gcount());
+}
+
+bool IsTextData(const std::string& filepath, const char* data, size_t len) {
+    return HasTextExtension(filepath) || SampleLooksLikeText(data, len);
+}
+
+// Read the whole file, handing each chunk to scan (if set) as soon as it is in.
+static std::string ReadFileChunks(const std::string& filepath, LoadProgress* progress,
+                                  const std::function<void(const char*, size_t)>& scan) {
+    if (filepath.empty() || !fs::exists(filepath)) {
+        std::cerr << "File does not exist: " << filepath << "\n";
+        return "";
+    }
+
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filepath << "\n";
+        return "";
+    }
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    if (progress) progress->total = (uint64_t)size;
+
+    std::string content((size_t)size, '\0');
+    for (size_t offset = 0; offset < content.size(); offset += kReadChunk) {
+        if (progress && progress->cancelled) return std::string();
+        size_t n = std::min(kReadChunk, content.size() - offset);
+        file.read(content.data() + offset, (std::streamsize)n);
+        if (scan) scan(content.data() + offset, n);
+        if (progress) progress->done += n;
+    }
+    return content;
+}
+
+std::string ReadFileContent(const std::string& filepath, LoadProgress* progress) {
+    return ReadFileChunks(filepath, progress, nullptr);
+}
+
+// hash takes the file's bytes as read, before any line-ending folding; stats are of
+// the text as loaded. Both are counted chunk by chunk as the file is read.
+static std::shared_ptr<TextBuffer> LoadTextBuffer(const std::string& filepath, FileFormat& format,
+                                                  ContentHash& hash, TextStats& stats, LoadProgress* progress) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(filepath, ec);
+    if (ec) {
+        std::cerr << "Failed to open file: " << filepath << "\n";
+        return nullptr;
+    }
+
+    if (size >= kMappedFileThreshold) {
+        std::shared_ptr<MappedFile> file = MapFile(filepath);
+        if (file) {
+            if (progress) progress->total = file->size;
+            auto original = std::make_shared<TextBuffer>();
+            original->data = file->data;
+            original->size = file->size;
+            original->capacity = file->size;
+            original->mapping = file;
+            TextStatsCounter counter;
+            if (!IndexMappedNewlines(*original, format, hash, counter, progress)) return nullptr;
+            stats = counter.Stats();
+            format.mapped = true;
+            return original;
+        }
+        std::cerr << "Failed to map file, reading it instead: " << filepath << "\n";
+    }
+
+    LineEndingCounts eol;
+    bool prevCr = false;
+    TextStatsCounter counter;
+    std::string content = ReadFileChunks(filepath, progress, [&](const char* data, size_t n) {
+        hash.Update(data, n);
+        CountLineEndings(data, n, prevCr, eol);
+        counter.Add(data, n);
+    });
+    if (progress && progress->cancelled) return nullptr;
+    stats = counter.Stats();
+    format.eol = DetectLineEnding(eol);
+    if (format.eol == LineEnding::CRLF) {
+        // Each dropped '\r' was a byte and a character, and whitespace next to the
+        // '\n' it preceded, so words and lines are unchanged.
+        StripCarriageReturns(content);
+        stats.bytes -= eol.cr;
+        stats.chars -= eol.cr;
+        format.normalized = true;
+    }
+    return MakeTextBuffer(std::move(content));
+}
+
+bool LoadDocument(const std::string& filepath, Document& doc, FileFormat* format) {
+    FileFormat loaded;
+    ContentHash hash;
+    TextStats stats;
+    std::shared_ptr<TextBuffer> buffer = LoadTextBuffer(filepath, loaded, hash, stats, nullptr);
+    if (format) *format = loaded;
+    if (!buffer) return false;
+    doc.SetOriginal(std::move(buffer));
+    return true;
+}
+
+LoadedFile LoadFile(const std::string& filepath, LoadProgress* progress) {
+    LoadedFile result;
+    std::error_code ec;
+    if (!fs::exists(filepath, ec)) {
+        std::cerr << "File does not exist: " << filepath << "\n";
+        return result;
+    }
+    // Stat before reading: a change that lands mid-read then still shows up as a
+    // newer mtime on the next check.
+    result.disk = StatFile(filepath);
+
+    if (IsTextFile(filepath)) {
+        ContentHash hash;
+        result.buffer = LoadTextBuffer(filepath, result.format, hash, result.stats, progress);
+        if (!result.buffer) return result;
+        result.disk.hash = hash.Digest();
+        result.disk.hashed = true;
+    } else {
+        result.buffer = MakeTextBuffer("[Binary file: " + filepath + "]\n"
+                                       "[Size: " + std::to_string(fs::file_size(filepath, ec)) + " bytes]\n\n"
+                                       "This file appears to be binary and cannot be displayed as text.");
+        result.stats = CountTextStats(result.buffer->data, result.buffer->size);
+    }
+
+    result.ok = !(progress && progress->cancelled);
+    return result;
+}
+
+static const size_t kWriteBuffer = 1024 * 1024;
+
+static std::string LastErrorMessage() {
+#ifdef _WIN32
+    return "error " + std::to_string(GetLastError());
+#else
+    return std::strerror(errno);
+#endif
+}
+
+// Temporary sibling of the target that becomes the target on Commit. Writes are
+// gathered into large blocks; nothing touches the original until the data is on disk.
+class AtomicFileWriter {
+public:
+    explicit AtomicFileWriter(const std::string& target) : m_target(target) {
+        m_buffer.reserve(kWriteBuffer);
+    }
+
+    ~AtomicFileWriter() {
+        if (m_open) {
+            CloseFile();
+            std::remove(m_tempPath.c_str());
+        }
+    }
+
+    bool Open() {
+        fs::path target(m_target);
+        std::string base = (target.parent_path() / ("." + target.filename().string())).string();
+#ifdef _WIN32
+        static std::atomic<unsigned> counter{0};
+        for (int attempt = 0; attempt < 100 && m_file == INVALID_HANDLE_VALUE; ++attempt) {
+            m_tempPath = base + ".edifier-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(counter++);
+            m_file = CreateFileA(m_tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+            if (m_file == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS) break;
+        }
+        m_open = m_file != INVALID_HANDLE_VALUE;
+#else
+        std::string pattern = base + ".edifier-XXXXXX";
+        m_fd = mkstemp(pattern.data());
+        m_tempPath = pattern;
+        m_open = m_fd >= 0;
+        if (m_open) {
+            // Keep the original's permissions (and group, where allowed); new files get 0644.
+            struct stat st;
+            if (stat(m_target.c_str(), &st) == 0) {
+                fchmod(m_fd, st.st_mode & 07777);
+                if (fchown(m_fd, st.st_uid, st.st_gid) != 0) {
+                    // Not permitted for other owners; the mode is what matters.
+                }
+            } else {
+                fchmod(m_fd, 0644);
+            }
+        }
+#endif
+        if (!m_open) m_error = "cannot create temporary file: " + LastErrorMessage();
+        return m_open;
+    }
+
+    void Write(const char* data, size_t len) {
+        if (len >= kWriteBuffer) {
+            Flush();
+            WriteRaw(data, len);
+            return;
+        }
+        if (m_buffer.size() + len > kWriteBuffer) Flush();
+        m_buffer.insert(m_buffer.end(), data, data + len);
+    }
+
+    // Flush, sync, and replace the target. Returns false with Error() set on failure.
+    bool Commit() {
+        Flush();
+        if (!m_error.empty()) return false;
+#ifdef _WIN32
+        if (!FlushFileBuffers(m_file)) m_error = "flush failed: " + LastErrorMessage();
+        CloseFile();
+        if (!m_error.empty()) return false;
+        // ReplaceFile keeps the original's attributes and ACLs.
+        bool replaced = fs::exists(m_target)
+            ? ReplaceFileA(m_target.c_str(), m_tempPath.c_str(), NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL)
+            : MoveFileExA(m_tempPath.c_str(), m_target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (!replaced) {
+            m_error = "cannot replace file: " + LastErrorMessage();
+            std::remove(m_tempPath.c_str());
+            return false;
+        }
+#else
+        if (fsync(m_fd) != 0) m_error = "fsync failed: " + LastErrorMessage();
+        CloseFile();
+        if (!m_error.empty()) return false;
+        if (std::rename(m_tempPath.c_str(), m_target.c_str()) != 0) {
+            m_error = "cannot replace file: " + LastErrorMessage();
+            std::remove(m_tempPath.c_str());
+            return false;
+        }
+        // Make the rename itself durable.
+        std::string dir = fs::path(m_target).parent_path().string();
+        int dirFd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+        if (dirFd >= 0) {
+            fsync(dirFd);
+            close(dirFd);
+        }
+#endif
+        return true;
+    }
+
+    const std::string& Error() const { return m_error; }
+
+private:
+    void Flush() {
+        if (!m_buffer.empty()) WriteRaw(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
+
+    void WriteRaw(const char* data, size_t len) {
+        if (!m_error.empty()) return;
+        while (len > 0) {
+#ifdef _WIN32
+            DWORD chunk = (DWORD)std::min<size_t>(len, 1u << 30);
+            DWORD written = 0;
+            if (!WriteFile(m_file, data, chunk, &written, NULL)) {
+                m_error = "write failed: " + LastErrorMessage();
+                return;
+            }
+#else
+            ssize_t written = write(m_fd, data, len);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                m_error = "write failed: " + LastErrorMessage();
+                return;
+            }
+#endif
+            data += written;
+            len -= (size_t)written;
+        }
+    }
+
+    void CloseFile() {
+        if (!m_open) return;
+#ifdef _WIN32
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        close(m_fd);
+        m_fd = -1;
+#endif
+        m_open = false;
+    }
+
+    std::string m_target;
+    std::string m_tempPath;
+    std::string m_error;
+    std::vector<char> m_buffer;
+    bool m_open = false;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_fd = -1;
+#endif
+};
+
+SavedFile WriteSnapshot(const DocumentSnapshot& snapshot, const std::string& filepath, const FileFormat& format) {
+    SavedFile result;
+    const char* const truncated = "the file was cut short while open; reload it first";
+    if (SnapshotFaulted(snapshot)) {
+        result.error = truncated;
+        return result;
+    }
+
+    // Saving through a symlink updates the file it points to, not the link.
+    std::error_code ec;
+    std::string target = filepath;
+    if (fs::is_symlink(filepath, ec)) {
+        fs::path resolved = fs::canonical(filepath, ec);
+        if (!ec) target = resolved.string();
+    }
+
+    AtomicFileWriter writer(target);
+    if (!writer.Open()) {
+        result.error = writer.Error();
+        return result;
+    }
+
+    const bool expand = format.normalized && format.eol == LineEnding::CRLF;
+    ContentHash hash;
+    auto write = [&writer, &hash](const char* data, size_t len) {
+        writer.Write(data, len);
+        hash.Update(data, len);
+    };
+    snapshot.ForEachChunk([&write, expand](const char* data, size_t len) {
+        if (!expand) {
+            write(data, len);
+            return;
+        }
+        const char* end = data + len;
+        while (data < end) {
+            const char* nl = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            if (!nl) {
+                write(data, end - data);
+                break;
+            }
+            write(data, nl - data);
+            write("\r\n", 2);
+            data = nl + 1;
+        }
+    });
+
+    // Reading the text can be what finds the cut; the old file then stays as it is.
+    if (SnapshotFaulted(snapshot)) {
+        result.error = truncated;
+        return result;
+    }
+    if (!writer.Commit()) {
+        result.error = writer.Error();
+        return result;
+    }
+    result.ok = true;
+    result.generation = snapshot.generation;
+    result.disk = StatFile(target);
+    result.disk.hash = hash.Digest();
+    result.disk.hashed = result.disk.exists;
+    return result;
+}
+
+bool WriteFileAtomically(const std::string& filepath,
+                         const std::function<void(const std::function<void(const char*, size_t)>& write)>& produce,
+                         std::string& error) {
+    AtomicFileWriter writer(filepath);
+    if (!writer.Open()) {
+        error = writer.Error();
+        return false;
+    }
+    produce([&writer](const char* data, size_t len) { writer.Write(data, len); });
+    if (!writer.Commit()) {
+        error = writer.Error();
+        return false;
+    }
+    return true;
+}
+
+bool WriteDocument(const Document& doc, const std::string& filepath, const FileFormat& format) {
+    SavedFile saved = WriteSnapshot(doc.Snapshot(), filepath, format);
+    if (!saved.ok) std::cerr << "Failed to save " << filepath << ": " << saved.error << "\n";
+    return saved.ok;
+}
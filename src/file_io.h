@@ -0,0 +1,165 @@
+#pragma once
+
+#include "text_stats.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+class Document;
+struct DocumentSnapshot;
+struct TextBuffer;
+
+// Files at or above this size are memory-mapped instead of read into memory.
+// Pages are then loaded lazily by the OS as the view touches them.
+const uint64_t kMappedFileThreshold = 64ull * 1024 * 1024;
+
+enum class LineEnding { LF, CRLF, Mixed };
+
+// How a file was loaded, so it can be written back the way it was found.
+struct FileFormat {
+    bool mapped = false;             // backed by a read-only mapping of the file
+    LineEnding eol = LineEnding::LF;
+    bool normalized = false;         // CRLF was folded to LF in memory; saving expands it again
+};
+
+const char* LineEndingName(LineEnding eol);
+
+// Line break the editor should insert into a document loaded with this format.
+const char* InsertedNewline(const FileFormat& format);
+
+// Shared between a background load and the UI showing it.
+struct LoadProgress {
+    std::atomic<uint64_t> done{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<bool> cancelled{false};
+
+    float Fraction() const {
+        uint64_t t = total.load();
+        return t ? (float)((double)done.load() / (double)t) : 0.0f;
+    }
+};
+
+// Streaming 64-bit hash of file bytes (xxHash64's rounds), the same however the
+// bytes are split across Update calls. Not cryptographic: it only tells whether a
+// file still holds what was loaded or saved.
+class ContentHash {
+public:
+    void Update(const char* data, size_t len);
+    uint64_t Digest() const;
+
+private:
+    void Stripe(const char* p);
+
+    uint64_t m_lanes[4] = { 0x60ea27eeadc0b5d6ull, 0xc2b2ae3d27d4eb4full, 0ull, 0x61c8864e7a143579ull };
+    char m_tail[32];
+    size_t m_tailLen = 0;
+    uint64_t m_total = 0;
+};
+
+// A file as a tab last saw it on disk, to tell a real change from a touch.
+struct FileFingerprint {
+    bool exists = false;
+    uint64_t size = 0;
+    std::filesystem::file_time_type modified;
+    uint64_t hash = 0;
+    bool hashed = false;             // hash covers the bytes; not for binary placeholders
+};
+
+// Size and modification time only; cheap enough for every watcher event.
+FileFingerprint StatFile(const std::string& filepath);
+
+enum class DiskChange { None, Touched, Changed, Deleted };
+
+// Compare filepath with what was known of it, filling now. Size and mtime decide
+// unless only the mtime moved; then the bytes are hashed, so a touch or a rewrite
+// with the same content comes back Touched and needs no reload. Blocking.
+DiskChange CheckFileOnDisk(const std::string& filepath, const FileFingerprint& known, FileFingerprint& now);
+
+// Everything a tab needs from disk, produced off the UI thread. The buffer goes to
+// Document::SetOriginal as-is.
+struct LoadedFile {
+    bool ok = false;
+    std::shared_ptr<TextBuffer> buffer;
+    FileFormat format;
+    TextStats stats;
+    FileFingerprint disk;            // the bytes the buffer was loaded from
+};
+
+// Read-only view of a whole file. Unmapped when the last reference goes away, so
+// document pieces can point straight into it. If the file is truncated while
+// mapped, the lost tail reads as NUL bytes rather than faulting, and Faulted()
+// turns true: the view no longer holds the file's text.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;            // HANDLEs
+    void* mapping = nullptr;
+#else
+    void* guard = nullptr;           // SIGBUS guard slot, released with the mapping
+#endif
+    ~MappedFile();
+
+    bool Faulted() const;
+};
+
+// Null for empty or unreadable files.
+std::shared_ptr<MappedFile> MapFile(const std::string& filepath);
+
+// Faults absorbed by any mapping so far. Cheap enough to poll every frame; only a
+// change calls for looking at which mappings they were in.
+uint64_t MappingFaults();
+
+// True if some of the snapshot's text reads from a mapping that has faulted, so
+// part of it is NULs instead of the file's bytes. Nothing should write it out.
+bool SnapshotFaulted(const DocumentSnapshot& snapshot);
+
+bool IsTextFile(const std::string& filepath);
+
+// IsTextFile's rule for bytes already in memory: trusted extension, or no NUL in
+// the first 512 bytes. Lets a reader that has the data skip a second open.
+bool IsTextData(const std::string& filepath, const char* data, size_t len);
+
+// Raw file bytes, line endings untouched. Read in chunks so progress can be
+// reported; returns early if the load is cancelled.
+std::string ReadFileContent(const std::string& filepath, LoadProgress* progress = nullptr);
+
+// Blocking; meant for a worker thread. Binary files load as a short placeholder text.
+// ok is false if the file can't be read or the load was cancelled.
+LoadedFile LoadFile(const std::string& filepath, LoadProgress* progress = nullptr);
+
+// Load a file into doc. Small files are read into an owned buffer; consistent CRLF
+// files are folded to LF in place. Large files are backed by a read-only mapping
+// with edits layered on top by the piece table and keep their bytes as-is, as do
+// files with mixed line endings.
+bool LoadDocument(const std::string& filepath, Document& doc, FileFormat* format = nullptr);
+
+// Outcome of a save, produced on the worker that wrote the file.
+struct SavedFile {
+    bool ok = false;
+    std::string error;
+    uint64_t generation = 0;         // document generation that is now on disk
+    FileFingerprint disk;            // the bytes written
+};
+
+// Durable replace of filepath with the snapshot's text: write a temporary file in
+// the same directory, fsync it, carry over the original's permissions, and rename
+// it over the target (then fsync the directory). A crash or full disk mid-write
+// leaves the original untouched, as does a snapshot that SnapshotFaulted rejects.
+// Blocking; meant for a worker thread.
+SavedFile WriteSnapshot(const DocumentSnapshot& snapshot, const std::string& filepath, const FileFormat& format);
+
+// The same durable replace for other files (caches, session state): produce is
+// called once with a sink that takes the new contents in any number of pieces.
+bool WriteFileAtomically(const std::string& filepath,
+                         const std::function<void(const std::function<void(const char*, size_t)>& write)>& produce,
+                         std::string& error);
+
+// Stream every piece of the document to filepath, expanding LF back to CRLF when
+// the format says it was normalized. Goes through WriteSnapshot, so a document still
+// backed by a mapping of the old file never sees it truncated underneath it.
+bool WriteDocument(const Document& doc, const std::string& filepath, const FileFormat& format = FileFormat());
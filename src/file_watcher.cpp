@@ -0,0 +1,180 @@
+#include "file_watcher.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// A burst ends once no event has come for kQuietMs, or kMaxBatchMs after it began,
+// so a long-running build still gets reported while it writes.
+static const int kQuietMs = 50;
+static const int kMaxBatchMs = 500;
+
+// Without inotify, how often every watched file is reported.
+static const int kPollSeconds = 2;
+
+static std::string DirectoryOf(const std::string& path) {
+    std::string dir = fs::path(path).parent_path().string();
+    return dir.empty() ? "." : dir;
+}
+
+FileWatcher::~FileWatcher() {
+    Stop();
+}
+
+void FileWatcher::Stop() {
+    if (m_watcher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_stopMutex);
+            m_stopping = true;
+        }
+        m_stopSignal.notify_all();
+#ifdef __linux__
+        char wake = 1;
+        if (write(m_wakePipe[1], &wake, 1) < 0) {
+            // The reader polls the pipe; nothing else to do if it is already gone.
+        }
+#endif
+        m_watcher.join();
+    }
+#ifdef __linux__
+    if (m_inotifyFd >= 0) close(m_inotifyFd);
+    if (m_wakePipe[0] >= 0) close(m_wakePipe[0]);
+    if (m_wakePipe[1] >= 0) close(m_wakePipe[1]);
+    m_inotifyFd = -1;
+    m_wakePipe[0] = m_wakePipe[1] = -1;
+#endif
+    m_dirWatches.clear();
+    m_watchDirs.clear();
+    m_stopped = true;
+}
+
+void FileWatcher::Start() {
+    if (m_watcher.joinable() || m_stopped) return;
+#ifdef __linux__
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) return;
+    if (pipe(m_wakePipe) != 0) {
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return;
+    }
+#endif
+    m_watcher = std::thread([this] { WatchLoop(); });
+}
+
+void FileWatcher::SetFiles(const std::vector<std::string>& paths) {
+    if (m_stopped || paths == m_files) return;
+    m_files = paths;
+    if (!m_files.empty()) Start();
+
+#ifdef __linux__
+    if (m_inotifyFd < 0) return;
+    std::unordered_map<std::string, int> dirs;
+    for (const std::string& path : m_files) {
+        std::string dir = DirectoryOf(path);
+        if (dirs.count(dir)) continue;
+        auto it = m_dirWatches.find(dir);
+        if (it != m_dirWatches.end()) {
+            dirs.emplace(dir, it->second);
+            continue;
+        }
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                              IN_ATTRIB | IN_ONLYDIR;
+        int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), mask);
+        if (wd < 0) continue;  // e.g. out of watches: files there just aren't reloaded
+        dirs.emplace(dir, wd);
+        m_watchDirs[wd] = dir;
+    }
+    for (const auto& [dir, wd] : m_dirWatches) {
+        if (dirs.count(dir)) continue;
+        inotify_rm_watch(m_inotifyFd, wd);
+        m_watchDirs.erase(wd);
+    }
+    m_dirWatches = std::move(dirs);
+#endif
+}
+
+void FileWatcher::OnEvents(const std::vector<Event>& events, bool everything) {
+    std::vector<std::string> changed;
+    for (const std::string& path : m_files) {
+        if (!everything) {
+            std::string dir = DirectoryOf(path);
+            std::string name = fs::path(path).filename().string();
+            bool hit = std::any_of(events.begin(), events.end(), [&](const Event& event) {
+                auto it = m_watchDirs.find(event.watch);
+                return event.name == name && it != m_watchDirs.end() && it->second == dir;
+            });
+            if (!hit) continue;
+        }
+        if (std::find(changed.begin(), changed.end(), path) == changed.end()) changed.push_back(path);
+    }
+    if (!changed.empty() && m_onChanged) m_onChanged(changed);
+}
+
+void FileWatcher::WatchLoop() {
+    PROFILE_THREAD("FileWatcher");
+#ifdef __linux__
+    alignas(inotify_event) char buffer[16 * 1024];
+    std::vector<Event> events;
+    bool overflow = false;
+    auto drain = [&] {
+        for (;;) {
+            ssize_t n = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            for (char* p = buffer; p < buffer + n;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->mask & IN_Q_OVERFLOW) overflow = true;
+                if (!(event->mask & IN_IGNORED) && event->wd >= 0 && event->len > 0) {
+                    events.push_back({ event->wd, event->name });
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+    };
+
+    for (;;) {
+        pollfd fds[2] = { { m_inotifyFd, POLLIN, 0 }, { m_wakePipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+
+        events.clear();
+        overflow = false;
+        drain();
+        auto start = std::chrono::steady_clock::now();
+        for (;;) {
+            int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= kMaxBatchMs) break;
+            fds[0].revents = fds[1].revents = 0;
+            if (poll(fds, 2, std::min(kQuietMs, kMaxBatchMs - elapsed)) <= 0) break;
+            if (fds[1].revents) return;
+            drain();
+        }
+        if (events.empty() && !overflow) continue;
+
+        PROFILE_ZONE("FileEvents");
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.watch != b.watch ? a.watch < b.watch : a.name < b.name;
+        });
+        events.erase(std::unique(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.watch == b.watch && a.name == b.name;
+        }), events.end());
+        Jobs().PostToMain([this, batch = events, overflow] { OnEvents(batch, overflow); });
+    }
+#else
+    std::unique_lock<std::mutex> lock(m_stopMutex);
+    while (!m_stopSignal.wait_for(lock, std::chrono::seconds(kPollSeconds), [this] { return m_stopping; })) {
+        Jobs().PostToMain([this] { OnEvents({}, true); });
+    }
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Tells the UI thread which open files may have been changed by another program.
+// On Linux one inotify thread watches the directory of every file (not the file:
+// an atomic save renames a new inode over it, which would end a watch on the old
+// one) and gathers bursts of events, e.g. a git checkout, into one report. Elsewhere
+// the thread reports every file every few seconds. Either way a report is only a
+// hint; the caller compares each file with what it loaded before reloading it.
+//
+// Everything except the watcher thread runs on the UI thread; reports come back
+// through Jobs().PostToMain.
+class FileWatcher {
+public:
+    using ChangedFn = std::function<void(const std::vector<std::string>& paths)>;
+
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Called on the UI thread with the watched paths that may have changed.
+    void SetCallback(ChangedFn onChanged) { m_onChanged = std::move(onChanged); }
+
+    // Watch exactly these files. Cheap when the list is the one last passed, so it
+    // can be called every frame.
+    void SetFiles(const std::vector<std::string>& paths);
+
+    // Stop the watcher thread for good. Call before the job system goes away.
+    void Stop();
+
+private:
+    struct Event {
+        int watch = -1;
+        std::string name;
+    };
+
+    void Start();
+    void OnEvents(const std::vector<Event>& events, bool everything);
+    void WatchLoop();
+
+    ChangedFn m_onChanged;
+    std::vector<std::string> m_files;                          // as last passed to SetFiles
+    std::unordered_map<std::string, int> m_dirWatches;         // directory -> watch
+    std::unordered_map<int, std::string> m_watchDirs;
+
+    int m_inotifyFd = -1;
+    int m_wakePipe[2] = { -1, -1 };
+    std::thread m_watcher;
+    std::mutex m_stopMutex;
+    std::condition_variable m_stopSignal;
+    bool m_stopping = false;
+    bool m_stopped = false;
+};
@@ -0,0 +1,30 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+static bool s_requested = false;
+static Clock::time_point s_deadline;
+
+void RequestFrame() {
+    RequestFrameIn(0.0);
+}
+
+void RequestFrameIn(double seconds) {
+    Clock::time_point when = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(std::max(0.0, seconds)));
+    if (!s_requested || when < s_deadline) s_deadline = when;
+    s_requested = true;
+}
+
+double SecondsUntilRequestedFrame() {
+    if (!s_requested) return -1.0;
+    double seconds = std::chrono::duration<double>(s_deadline - Clock::now()).count();
+    return std::max(0.0, seconds);
+}
+
+void ClearFrameRequests() {
+    s_requested = false;
+}
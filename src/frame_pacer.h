@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Frame scheduling for the on-demand render loop. The loop sleeps until there is
+// input, a worker posts to the main thread (the job system wakes it), or a frame
+// requested here falls due. Anything that changes on screen without an event of
+// its own (progress bars, the caret blink, results streaming in) asks for the
+// frame it needs. UI thread only.
+
+// Render another frame as soon as possible.
+void RequestFrame();
+
+// Render a frame within seconds. The earliest request wins.
+void RequestFrameIn(double seconds);
+
+// Seconds until the earliest requested frame: 0 when one is due, negative when
+// none is requested and the loop can sleep until the next event.
+double SecondsUntilRequestedFrame();
+
+// Forget the requests made so far. The loop calls this before building a frame,
+// so that frame's widgets ask again for whatever they still need.
+void ClearFrameRequests();
+
+// Frames drawn since startup, and display refreshes that went by without one.
+struct FrameStats {
+    uint64_t rendered = 0;
+    uint64_t skipped = 0;
+};
@@ -0,0 +1,320 @@
+#include "fuzzy_finder.h"
+#include "job_system.h"
+#include "text_search.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EDIFIER_FUZZY_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Paths per parallel chunk; each chunk keeps its own top K.
+static const size_t kChunkSize = 16384;
+
+// Scoring, after fzf: every matched character is worth kScoreMatch plus a bonus
+// for where it sits; gaps between matched characters cost a little.
+static const int kNoMatch = INT_MIN;
+static const int kScoreMatch = 16;
+static const int kPenaltyGapStart = 3;
+static const int kPenaltyGapExtension = 1;
+static const int kBonusPathBoundary = 10;   // first character of a path component
+static const int kBonusBoundary = 8;        // after '_', '-', '.' or ' '
+static const int kBonusCamel = 7;           // lower-to-upper or letter-to-digit step
+static const int kBonusConsecutive = 4;
+static const int kBonusInName = 2;          // per character matched in the file name
+
+static inline unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static inline unsigned CountTrailingZeros(uint32_t v) {
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(v);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return (unsigned)index;
+#else
+    unsigned n = 0;
+    while (!(v & 1u)) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+// One bit per letter, plus shared bits for digits, separators and the rest. A path
+// can only match if its mask covers the query's.
+static inline uint32_t CharBit(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return 1u << (c - 'a');
+    if (c >= '0' && c <= '9') return 1u << 26;
+    if (c == '_' || c == '-' || c == ' ') return 1u << 27;
+    if (c == '.') return 1u << 28;
+    if (c == '/') return 1u << 29;
+    if (c >= 0x80) return 1u << 31;
+    return 1u << 30;
+}
+
+static int BoundaryBonus(const char* path, size_t i) {
+    if (i == 0) return kBonusPathBoundary;
+    unsigned char prev = (unsigned char)path[i - 1];
+    unsigned char cur = (unsigned char)path[i];
+    if (prev == '/') return kBonusPathBoundary;
+    if (prev == '_' || prev == '-' || prev == '.' || prev == ' ') return kBonusBoundary;
+    if (prev >= 'a' && prev <= 'z' && cur >= 'A' && cur <= 'Z') return kBonusCamel;
+    if (!(prev >= '0' && prev <= '9') && cur >= '0' && cur <= '9') return kBonusCamel;
+    return 0;
+}
+
+// Finds the leftmost occurrence of query as a subsequence (memchr does the scanning),
+// walks back from its end to the shortest window holding it, and scores that window.
+static int ScorePath(const char* folded, const char* original, size_t len, size_t nameStart,
+                     const std::string& query) {
+    const size_t n = query.size();
+    const char* p = folded;
+    const char* end = folded + len;
+    size_t first = 0;
+    for (size_t q = 0; q < n; ++q) {
+        const char* hit = (const char*)std::memchr(p, query[q], end - p);
+        if (!hit) return kNoMatch;
+        if (q == 0) first = hit - folded;
+        p = hit + 1;
+    }
+    const size_t last = (size_t)(p - folded) - 1;
+
+    size_t start = last;
+    size_t remaining = n;
+    for (size_t i = last + 1; i-- > first;) {
+        if (folded[i] == query[remaining - 1]) {
+            start = i;
+            if (--remaining == 0) break;
+        }
+    }
+
+    int score = 0;
+    int runBonus = 0;
+    bool inRun = false, inGap = false;
+    size_t q = 0;
+    for (size_t i = start; i <= last && q < n; ++i) {
+        if (folded[i] == query[q]) {
+            int bonus = BoundaryBonus(original, i);
+            if (inRun) bonus = std::max(bonus, std::max(runBonus, kBonusConsecutive));
+            else runBonus = bonus;
+            score += kScoreMatch + (q == 0 ? bonus * 2 : bonus);
+            if (i >= nameStart) score += kBonusInName;
+            inRun = true;
+            inGap = false;
+            ++q;
+        } else {
+            score -= inGap ? kPenaltyGapExtension : kPenaltyGapStart;
+            inRun = false;
+            inGap = true;
+        }
+    }
+    return score;
+}
+
+std::string PathIndex::Path(uint32_t index) const {
+    return m_paths.substr(m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+}
+
+std::string PathIndex::FullPath(uint32_t index) const {
+    return (fs::path(m_root) / fs::path(Path(index)).make_preferred()).string();
+}
+
+std::shared_ptr<const PathIndex> PathIndex::Build(const std::string& root, const std::atomic<bool>* cancel) {
+    struct Listing {
+        std::vector<std::string> dirs;
+        std::vector<std::string> files;
+    };
+
+    std::vector<std::string> files;
+    std::vector<std::string> level(1);    // relative; "" is the root
+    while (!level.empty()) {
+        if (cancel && *cancel) return nullptr;
+
+        std::vector<Listing> listings(level.size());
+        Jobs().ParallelFor(level.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const std::string& dir = level[i];
+                std::error_code ec;
+                fs::path path = dir.empty() ? fs::path(root) : fs::path(root) / fs::path(dir).make_preferred();
+                fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
+                for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                    ProjectEntry kind = ClassifyProjectEntry(*it);
+                    if (kind == ProjectEntry::Skip) continue;
+                    std::string name = it->path().filename().string();
+                    std::string relative = dir.empty() ? name : dir + "/" + name;
+                    if (kind == ProjectEntry::Directory) listings[i].dirs.push_back(std::move(relative));
+                    else listings[i].files.push_back(std::move(relative));
+                }
+            }
+        });
+
+        level.clear();
+        for (auto& listing : listings) {
+            for (auto& dir : listing.dirs) level.push_back(std::move(dir));
+            for (auto& file : listing.files) files.push_back(std::move(file));
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    auto index = std::make_shared<PathIndex>();
+    index->m_root = root;
+    size_t total = 0;
+    for (const auto& file : files) total += file.size();
+    index->m_paths.reserve(total);
+    index->m_folded.reserve(total);
+    index->m_offsets.reserve(files.size() + 1);
+    index->m_nameStart.reserve(files.size());
+    index->m_masks.reserve(files.size());
+
+    for (const auto& file : files) {
+        index->m_offsets.push_back((uint32_t)index->m_paths.size());
+        size_t slash = file.rfind('/');
+        index->m_nameStart.push_back(slash == std::string::npos ? 0 : (uint32_t)slash + 1);
+        uint32_t mask = 0;
+        for (unsigned char c : file) {
+            unsigned char folded = FoldCase(c);
+            index->m_folded.push_back((char)folded);
+            mask |= CharBit(folded);
+        }
+        index->m_masks.push_back(mask);
+        index->m_paths += file;
+    }
+    index->m_offsets.push_back((uint32_t)index->m_paths.size());
+    return index;
+}
+
+void FuzzyFinder::SetIndex(std::shared_ptr<const PathIndex> index) {
+    m_index = std::move(index);
+    m_levels.clear();
+    m_allPaths.clear();
+    if (!m_index) return;
+    for (uint32_t i = 0; i < m_index->Size() && m_allPaths.size() < kMaxResults; ++i) {
+        m_allPaths.push_back(FuzzyResult{ i, 0 });
+    }
+}
+
+size_t FuzzyFinder::MatchCount() const {
+    if (!m_index) return 0;
+    return m_levels.empty() ? m_index->Size() : m_levels.back().matches.size();
+}
+
+const std::vector<FuzzyResult>& FuzzyFinder::Search(const std::string& query) {
+    // Case and spaces don't matter, and either slash matches the stored '/'.
+    std::string folded;
+    for (unsigned char c : query) {
+        if (c == ' ') continue;
+        folded.push_back(c == '\\' ? '/' : (char)FoldCase(c));
+    }
+    if (!m_index || folded.empty()) {
+        m_levels.clear();
+        return m_allPaths;
+    }
+
+    // Keep only the levels this query extends; the deepest one holds a superset
+    // of its matches.
+    while (!m_levels.empty() && folded.compare(0, m_levels.back().query.size(), m_levels.back().query) != 0) {
+        m_levels.pop_back();
+    }
+    if (!m_levels.empty() && m_levels.back().query == folded) return m_levels.back().top;
+
+    Level level;
+    level.query = folded;
+    Narrow(folded, m_levels.empty() ? nullptr : &m_levels.back().matches, level);
+    m_levels.push_back(std::move(level));
+    return m_levels.back().top;
+}
+
+// Scores every path in base (or the whole index) against query in parallel
+// chunks, collecting all matches and the kMaxResults best.
+void FuzzyFinder::Narrow(const std::string& query, const std::vector<uint32_t>* base, Level& level) const {
+    const PathIndex& index = *m_index;
+    uint32_t queryMask = 0;
+    for (unsigned char c : query) queryMask |= CharBit(c);
+
+    // Higher score first; among equals the shorter path, then index order.
+    auto better = [&index](const FuzzyResult& a, const FuzzyResult& b) {
+        if (a.score != b.score) return a.score > b.score;
+        uint32_t lengthA = index.m_offsets[a.path + 1] - index.m_offsets[a.path];
+        uint32_t lengthB = index.m_offsets[b.path + 1] - index.m_offsets[b.path];
+        if (lengthA != lengthB) return lengthA < lengthB;
+        return a.path < b.path;
+    };
+
+    struct ChunkResult {
+        std::vector<uint32_t> matches;
+        std::vector<FuzzyResult> top;
+    };
+    const size_t total = base ? base->size() : index.Size();
+    std::vector<ChunkResult> chunks((total + kChunkSize - 1) / kChunkSize);
+
+    Jobs().ParallelFor(total, kChunkSize, [&](size_t begin, size_t end) {
+        ChunkResult& out = chunks[begin / kChunkSize];
+        auto consider = [&](uint32_t path) {
+            uint32_t offset = index.m_offsets[path];
+            int score = ScorePath(index.m_folded.data() + offset, index.m_paths.data() + offset,
+                                  index.m_offsets[path + 1] - offset, index.m_nameStart[path], query);
+            if (score == kNoMatch) return;
+            out.matches.push_back(path);
+
+            // Bounded heap with the weakest of the best at the front.
+            FuzzyResult result{ path, score };
+            if (out.top.size() < kMaxResults) {
+                out.top.push_back(result);
+                std::push_heap(out.top.begin(), out.top.end(), better);
+            } else if (better(result, out.top.front())) {
+                std::pop_heap(out.top.begin(), out.top.end(), better);
+                out.top.back() = result;
+                std::push_heap(out.top.begin(), out.top.end(), better);
+            }
+        };
+
+        if (base) {
+            for (size_t k = begin; k < end; ++k) {
+                uint32_t path = (*base)[k];
+                if ((index.m_masks[path] & queryMask) == queryMask) consider(path);
+            }
+        } else {
+            const uint32_t* masks = index.m_masks.data();
+            size_t i = begin;
+#ifdef EDIFIER_FUZZY_SSE2
+            const __m128i want = _mm_set1_epi32((int)queryMask);
+            for (; i + 4 <= end; i += 4) {
+                __m128i block = _mm_loadu_si128((const __m128i*)(masks + i));
+                __m128i covered = _mm_cmpeq_epi32(_mm_and_si128(block, want), want);
+                uint32_t bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(covered));
+                while (bits) {
+                    consider((uint32_t)(i + CountTrailingZeros(bits)));
+                    bits &= bits - 1;
+                }
+            }
+#endif
+            for (; i < end; ++i) {
+                if ((masks[i] & queryMask) == queryMask) consider((uint32_t)i);
+            }
+        }
+    });
+
+    size_t matchCount = 0;
+    for (const auto& chunk : chunks) matchCount += chunk.matches.size();
+    level.matches.reserve(matchCount);
+    for (auto& chunk : chunks) {
+        level.matches.insert(level.matches.end(), chunk.matches.begin(), chunk.matches.end());
+        level.top.insert(level.top.end(), chunk.top.begin(), chunk.top.end());
+    }
+    if (level.top.size() > kMaxResults) {
+        std::nth_element(level.top.begin(), level.top.begin() + kMaxResults, level.top.end(), better);
+        level.top.resize(kMaxResults);
+    }
+    std::sort(level.top.begin(), level.top.end(), better);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Every file path under a root, packed for fast scanning: the relative paths back
+// to back, an ASCII-lowercased copy, and a 32-bit mask of the characters each
+// path contains. Immutable once built, so searches can share it with a rebuild.
+class PathIndex {
+public:
+    // Lists root with the same skipping rules as Find in Files. Directories are
+    // listed a level at a time, each level spread over the job system. Null if
+    // cancelled.
+    static std::shared_ptr<const PathIndex> Build(const std::string& root, const std::atomic<bool>* cancel = nullptr);
+
+    const std::string& Root() const { return m_root; }
+    size_t Size() const { return m_nameStart.size(); }
+
+    std::string Path(uint32_t index) const;        // relative, '/' separated
+    std::string FullPath(uint32_t index) const;
+    uint32_t NameStart(uint32_t index) const { return m_nameStart[index]; }
+
+private:
+    friend class FuzzyFinder;
+
+    std::string m_root;
+    std::string m_paths;
+    std::string m_folded;
+    std::vector<uint32_t> m_offsets;      // Size() + 1 entries into m_paths and m_folded
+    std::vector<uint32_t> m_nameStart;    // offset of the file name within each path
+    std::vector<uint32_t> m_masks;
+};
+
+struct FuzzyResult {
+    uint32_t path = 0;
+    int score = 0;
+};
+
+// Quick-open ranking. A query matches a path when its characters appear in order,
+// ignoring ASCII case; scoring favours matches at word and path boundaries, runs
+// of consecutive characters and matches in the file name, like fzf's.
+//
+// Every path passes through a SIMD mask test (four at a time) before the real
+// match, and the work is split over the job system with a per-chunk top K. The
+// full match set of each query prefix is kept, so typing one more character only
+// rescans the previous matches, and backspace reuses a shorter prefix's set.
+class FuzzyFinder {
+public:
+    static const size_t kMaxResults = 100;
+
+    // Replace the searched paths. Cached match sets are dropped.
+    void SetIndex(std::shared_ptr<const PathIndex> index);
+    const PathIndex* Index() const { return m_index.get(); }
+
+    // Best matches for query, highest score first. Cheap when query is unchanged.
+    const std::vector<FuzzyResult>& Search(const std::string& query);
+
+    // Paths matching the last query, not just the ones ranked.
+    size_t MatchCount() const;
+
+private:
+    struct Level {
+        std::string query;                 // folded
+        std::vector<uint32_t> matches;     // every matching path, in index order
+        std::vector<FuzzyResult> top;
+    };
+
+    void Narrow(const std::string& query, const std::vector<uint32_t>* base, Level& level) const;
+
+    std::shared_ptr<const PathIndex> m_index;
+    std::vector<Level> m_levels;           // each query extends the one before
+    std::vector<FuzzyResult> m_allPaths;   // first kMaxResults paths, for an empty query
+};
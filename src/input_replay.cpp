@@ -0,0 +1,387 @@
+#include "input_replay.h"
+#include "imgui_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+static const struct {
+    const char* name;
+    ImGuiKey key;
+} kModifierKeys[] = {
+    { "Ctrl", ImGuiMod_Ctrl },
+    { "Shift", ImGuiMod_Shift },
+    { "Alt", ImGuiMod_Alt },
+    { "Super", ImGuiMod_Super },
+};
+
+static const char* KeyName(ImGuiKey key) {
+    for (const auto& mod : kModifierKeys) {
+        if (key == mod.key) return mod.name;
+    }
+    if (key < ImGuiKey_NamedKey_BEGIN || key >= ImGuiKey_GamepadStart) return nullptr;
+    return ImGui::GetKeyName(key);
+}
+
+static ImGuiKey KeyFromName(const std::string& name) {
+    static std::unordered_map<std::string, ImGuiKey> keys;
+    if (keys.empty()) {
+        for (const auto& mod : kModifierKeys) keys[mod.name] = mod.key;
+        for (int key = ImGuiKey_NamedKey_BEGIN; key < ImGuiKey_GamepadStart; ++key) {
+            const char* keyName = ImGui::GetKeyName((ImGuiKey)key);
+            if (keyName && *keyName) keys.emplace(keyName, (ImGuiKey)key);
+        }
+    }
+    auto it = keys.find(name);
+    return it == keys.end() ? ImGuiKey_None : it->second;
+}
+
+static std::string ExpandPath(const std::string& path) {
+    if (path.compare(0, 4, "$TMP") != 0) return path;
+    std::error_code ec;
+    return fs::temp_directory_path(ec).string() + path.substr(4);
+}
+
+// Everything after the command word, without surrounding blanks.
+static std::string RestOfLine(const std::string& line, const std::string& command) {
+    size_t start = line.find(command) + command.size();
+    start = line.find_first_not_of(" \t", start);
+    if (start == std::string::npos) return std::string();
+    size_t end = line.find_last_not_of(" \t\r");
+    return line.substr(start, end + 1 - start);
+}
+
+static bool ParseSize(const std::string& text, uint64_t& bytes) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) return false;
+    double scale = 1.0;
+    if (*end == 'K' || *end == 'k') scale = 1024.0;
+    else if (*end == 'M' || *end == 'm') scale = 1024.0 * 1024.0;
+    else if (*end == 'G' || *end == 'g') scale = 1024.0 * 1024.0 * 1024.0;
+    else if (*end) return false;
+    bytes = (uint64_t)(value * scale);
+    return true;
+}
+
+// Numbered lines of mixed-length words; the same bytes for the same size.
+static bool GenerateTextFile(const std::string& path, uint64_t bytes) {
+    std::error_code ec;
+    if (fs::exists(path, ec) && fs::file_size(path, ec) == bytes) return true;
+
+    static const char* const kWords[] = { "the", "piece", "table", "keeps", "every", "edit", "cheap", "while",
+                                          "frames", "stay", "under", "budget", "{", "}", "return", "0;" };
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string chunk;
+    uint64_t written = 0;
+    uint32_t state = 1;
+    for (uint64_t line = 1; out && written < bytes; ++line) {
+        chunk += std::to_string(line);
+        for (int w = 0; w < 8; ++w) {
+            state = state * 1664525u + 1013904223u;
+            chunk += ' ';
+            chunk += kWords[(state >> 16) % 16];
+        }
+        chunk += '\n';
+        if (chunk.size() >= 1 << 20 || written + chunk.size() >= bytes) {
+            size_t n = (size_t)std::min<uint64_t>(chunk.size(), bytes - written);
+            out.write(chunk.data(), (std::streamsize)n);
+            written += n;
+            chunk.clear();
+        }
+    }
+    return (bool)out;
+}
+
+// UTF-8 to code points; invalid bytes come through as U+FFFD.
+static void DecodeUtf8(const std::string& text, std::vector<unsigned int>& out) {
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = (unsigned char)text[i];
+        size_t n = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+        if (n == 0 || i + n > text.size()) {
+            out.push_back(0xFFFD);
+            ++i;
+            continue;
+        }
+        unsigned int cp = n == 1 ? c : c & (0x7F >> n);
+        for (size_t k = 1; k < n; ++k) cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3F);
+        out.push_back(cp);
+        i += n;
+    }
+}
+
+struct ScriptParser {
+    std::vector<std::string> lines;
+    std::vector<ReplayFrame>& frames;
+    ReplayFrame pending;
+    std::string error;
+
+    explicit ScriptParser(std::vector<ReplayFrame>& out) : frames(out) {}
+
+    void EndFrame(float deltaTime) {
+        pending.deltaTime = deltaTime;
+        frames.push_back(pending);
+        pending.events.clear();
+    }
+
+    bool Fail(size_t line, const std::string& message) {
+        error = "line " + std::to_string(line + 1) + ": " + message;
+        return false;
+    }
+
+    // Lines [begin, end), with repeat blocks expanded.
+    bool Run(size_t begin, size_t end);
+    bool RunLine(size_t index);
+};
+
+bool ScriptParser::Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        std::istringstream in(lines[i]);
+        std::string command;
+        in >> command;
+        if (command != "repeat") {
+            if (!RunLine(i)) return false;
+            continue;
+        }
+
+        long count = -1;
+        in >> count;
+        if (count < 0) return Fail(i, "repeat needs a count");
+        size_t depth = 1, close = i + 1;
+        for (; close < end; ++close) {
+            std::istringstream inner(lines[close]);
+            std::string word;
+            inner >> word;
+            if (word == "repeat") ++depth;
+            else if (word == "end" && --depth == 0) break;
+        }
+        if (close == end) return Fail(i, "repeat without end");
+        for (long n = 0; n < count; ++n) {
+            if (!Run(i + 1, close)) return false;
+        }
+        i = close;
+    }
+    return true;
+}
+
+bool ScriptParser::RunLine(size_t index) {
+    const std::string& line = lines[index];
+    std::istringstream in(line);
+    std::string command;
+    in >> command;
+    if (command.empty() || command[0] == '#') return true;
+
+    ReplayEvent event;
+    if (command == "frame") {
+        float seconds = 1.0f / 60.0f;
+        in >> seconds;
+        EndFrame(std::max(seconds, 1e-6f));
+    } else if (command == "size") {
+        float w = 0, h = 0;
+        if (!(in >> w >> h) || w <= 0 || h <= 0) return Fail(index, "size needs a width and height");
+        pending.displaySize = ImVec2(w, h);
+    } else if (command == "key") {
+        std::string name, state;
+        in >> name >> state;
+        event.code = KeyFromName(name);
+        if (event.code == ImGuiKey_None) return Fail(index, "unknown key " + name);
+        if (state != "down" && state != "up") return Fail(index, "key needs down or up");
+        event.down = state == "down";
+        pending.events.push_back(event);
+    } else if (command == "press") {
+        std::string chord;
+        in >> chord;
+        std::vector<ImGuiKey> keys;
+        std::stringstream parts(chord);
+        for (std::string part; std::getline(parts, part, '+');) {
+            ImGuiKey key = KeyFromName(part);
+            if (key == ImGuiKey_None) return Fail(index, "unknown key " + part);
+            keys.push_back(key);
+        }
+        if (keys.empty()) return Fail(index, "press needs a key");
+        for (ImGuiKey key : keys) {
+            event.code = key;
+            event.down = true;
+            pending.events.push_back(event);
+        }
+        EndFrame(1.0f / 60.0f);
+        for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+            event.code = *it;
+            event.down = false;
+            pending.events.push_back(event);
+        }
+        EndFrame(1.0f / 60.0f);
+    } else if (command == "char") {
+        event.type = ReplayEvent::Type::Char;
+        if (!(in >> event.code) || event.code <= 0) return Fail(index, "char needs a code point");
+        pending.events.push_back(event);
+    } else if (command == "type") {
+        std::vector<unsigned int> codepoints;
+        DecodeUtf8(RestOfLine(line, command), codepoints);
+        event.type = ReplayEvent::Type::Char;
+        for (unsigned int cp : codepoints) {
+            event.code = (int)cp;
+            pending.events.push_back(event);
+            EndFrame(1.0f / 60.0f);
+        }
+    } else if (command == "mouse" || command == "wheel") {
+        event.type = command == "mouse" ? ReplayEvent::Type::MousePos : ReplayEvent::Type::MouseWheel;
+        if (!(in >> event.x >> event.y)) return Fail(index, command + " needs x and y");
+        pending.events.push_back(event);
+    } else if (command == "button") {
+        std::string state;
+        event.type = ReplayEvent::Type::MouseButton;
+        if (!(in >> event.code >> state) || event.code < 0 || event.code > 4 || (state != "down" && state != "up")) {
+            return Fail(index, "button needs 0-4 and down or up");
+        }
+        event.down = state == "down";
+        pending.events.push_back(event);
+    } else if (command == "focus") {
+        int focused = 1;
+        in >> focused;
+        event.type = ReplayEvent::Type::Focus;
+        event.down = focused != 0;
+        pending.events.push_back(event);
+    } else if (command == "open" || command == "folder") {
+        event.type = command == "open" ? ReplayEvent::Type::OpenFile : ReplayEvent::Type::OpenFolder;
+        event.path = ExpandPath(RestOfLine(line, command));
+        if (event.path.empty()) return Fail(index, command + " needs a path");
+        pending.events.push_back(event);
+    } else if (command == "generate") {
+        std::string path, size;
+        uint64_t bytes = 0;
+        if (!(in >> path >> size) || !ParseSize(size, bytes)) return Fail(index, "generate needs a path and a size");
+        path = ExpandPath(path);
+        if (!GenerateTextFile(path, bytes)) return Fail(index, "cannot write " + path);
+    } else {
+        return Fail(index, "unknown command " + command);
+    }
+    return true;
+}
+
+bool LoadReplayScript(const std::string& path, std::vector<ReplayFrame>& frames, std::string* error) {
+    frames.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        if (error) *error = "Cannot open " + path;
+        return false;
+    }
+
+    ScriptParser parser(frames);
+    for (std::string line; std::getline(in, line);) parser.lines.push_back(line);
+    if (!parser.Run(0, parser.lines.size())) {
+        if (error) *error = path + ": " + parser.error;
+        return false;
+    }
+    if (!parser.pending.events.empty()) parser.EndFrame(1.0f / 60.0f);
+    return true;
+}
+
+void FeedReplayInput(const ReplayFrame& frame) {
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = frame.displaySize;
+    io.DeltaTime = frame.deltaTime;
+    for (const ReplayEvent& event : frame.events) {
+        switch (event.type) {
+        case ReplayEvent::Type::Key: io.AddKeyEvent((ImGuiKey)event.code, event.down); break;
+        case ReplayEvent::Type::Char: io.AddInputCharacter((unsigned int)event.code); break;
+        case ReplayEvent::Type::MousePos: io.AddMousePosEvent(event.x, event.y); break;
+        case ReplayEvent::Type::MouseButton: io.AddMouseButtonEvent(event.code, event.down); break;
+        case ReplayEvent::Type::MouseWheel: io.AddMouseWheelEvent(event.x, event.y); break;
+        case ReplayEvent::Type::Focus: io.AddFocusEvent(event.down); break;
+        case ReplayEvent::Type::OpenFile:
+        case ReplayEvent::Type::OpenFolder: break;
+        }
+    }
+}
+
+bool InputRecorder::Start(const std::string& path, std::string* error) {
+    Stop();
+    m_out.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_out) {
+        if (error) *error = "Cannot write " + path;
+        return false;
+    }
+    m_out << "# Edifier input recording; replay with Edifier --replay FILE\n";
+    m_displaySize = ImVec2(0, 0);
+    return true;
+}
+
+void InputRecorder::Stop() {
+    if (m_out.is_open()) m_out.close();
+}
+
+void InputRecorder::CaptureFrame() {
+    if (!Active()) return;
+    ImGuiIO& io = ImGui::GetIO();
+    if (io.DisplaySize.x != m_displaySize.x || io.DisplaySize.y != m_displaySize.y) {
+        m_displaySize = io.DisplaySize;
+        m_out << "size " << m_displaySize.x << " " << m_displaySize.y << "\n";
+    }
+
+    // With multi-viewports on, mouse positions are in desktop coordinates; the
+    // replay has a single window at the origin.
+    ImVec2 origin = ImGui::GetMainViewport()->Pos;
+    for (const ImGuiInputEvent& event : ImGui::GetCurrentContext()->InputEventsQueue) {
+        switch (event.Type) {
+        case ImGuiInputEventType_Key:
+            if (const char* name = KeyName(event.Key.Key)) {
+                m_out << "key " << name << (event.Key.Down ? " down\n" : " up\n");
+            }
+            break;
+        case ImGuiInputEventType_Text:
+            m_out << "char " << event.Text.Char << "\n";
+            break;
+        case ImGuiInputEventType_MousePos:
+            // -FLT_MAX marks "no mouse"; keep it as a far-off position.
+            m_out << "mouse " << std::max(event.MousePos.PosX - origin.x, -1e6f) << " "
+                  << std::max(event.MousePos.PosY - origin.y, -1e6f) << "\n";
+            break;
+        case ImGuiInputEventType_MouseButton:
+            m_out << "button " << event.MouseButton.Button << (event.MouseButton.Down ? " down\n" : " up\n");
+            break;
+        case ImGuiInputEventType_MouseWheel:
+            m_out << "wheel " << event.MouseWheel.WheelX << " " << event.MouseWheel.WheelY << "\n";
+            break;
+        case ImGuiInputEventType_Focus:
+            m_out << "focus " << (event.AppFocused.Focused ? 1 : 0) << "\n";
+            break;
+        default:
+            break;
+        }
+    }
+    m_out << "frame " << io.DeltaTime << "\n";
+}
+
+void InputRecorder::RecordOpenFile(const std::string& path) {
+    if (Active()) m_out << "open " << path << "\n";
+}
+
+void InputRecorder::RecordOpenFolder(const std::string& path) {
+    if (Active()) m_out << "folder " << path << "\n";
+}
+
+FrameTimeSummary SummarizeFrameTimes(std::vector<double> milliseconds) {
+    FrameTimeSummary summary;
+    summary.frames = milliseconds.size();
+    if (milliseconds.empty()) return summary;
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+    double total = 0.0;
+    for (double ms : milliseconds) total += ms;
+    auto rank = [&](double p) {
+        size_t index = (size_t)std::ceil(p * (double)milliseconds.size());
+        return milliseconds[std::min(milliseconds.size(), std::max<size_t>(index, 1)) - 1];
+    };
+    summary.mean = total / (double)milliseconds.size();
+    summary.p50 = rank(0.50);
+    summary.p95 = rank(0.95);
+    summary.p99 = rank(0.99);
+    summary.max = milliseconds.back();
+    return summary;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "imgui.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Input recordings and scripts for repeatable performance runs. `Edifier --record
+// FILE` writes the ImGui input stream of a session, frame by frame, together with
+// the files and folder it opened; `Edifier --replay FILE` feeds it back through the
+// same frame functions without a window and reports frame CPU time.
+//
+// Both are one command per line ('#' starts a comment):
+//
+//   size W H                  display size for the frames that follow
+//   key NAME down|up          ImGui key name ("A", "Enter", "PageDown") or Ctrl/Shift/Alt/Super
+//   char CODEPOINT            text input
+//   mouse X Y                 position relative to the main window
+//   button N down|up
+//   wheel X Y
+//   focus 0|1                 window lost / gained focus
+//   open PATH                 open a file, as from a dialog
+//   folder PATH               open a folder
+//   frame [SECONDS]           run one frame with everything queued since the last
+//
+// Hand-written scripts can also use:
+//
+//   press CHORD               e.g. "Ctrl+S": keys down for a frame, then up for one
+//   type TEXT                 the rest of the line, one character per frame
+//   repeat N ... end          the enclosed lines N times; may nest
+//   generate PATH SIZE        write deterministic text of SIZE bytes (K/M/G suffix)
+//                             to PATH unless a file of that size is there
+//
+// "$TMP" at the start of a path stands for the system temporary directory.
+
+struct ReplayEvent {
+    enum class Type { Key, Char, MousePos, MouseButton, MouseWheel, Focus, OpenFile, OpenFolder };
+
+    Type type = Type::Key;
+    int code = 0;              // ImGuiKey, code point or mouse button
+    bool down = false;         // Key, MouseButton; Focus: gained
+    float x = 0.0f, y = 0.0f;  // MousePos, MouseWheel
+    std::string path;          // OpenFile, OpenFolder
+};
+
+struct ReplayFrame {
+    float deltaTime = 1.0f / 60.0f;
+    ImVec2 displaySize = ImVec2(1400, 900);
+    std::vector<ReplayEvent> events;    // applied before the frame starts
+};
+
+// Parse a recording or script into frames, expanding press, type and repeat and
+// running generate. Events after the last "frame" get a frame of their own.
+bool LoadReplayScript(const std::string& path, std::vector<ReplayFrame>& frames, std::string* error = nullptr);
+
+// Queue the frame's input events and display size in ImGui's IO. Open events are
+// left to the caller.
+void FeedReplayInput(const ReplayFrame& frame);
+
+// Writes the recording format as the session runs.
+class InputRecorder {
+public:
+    bool Start(const std::string& path, std::string* error = nullptr);
+    void Stop();
+    bool Active() const { return m_out.is_open(); }
+
+    // Write the input ImGui has queued for the coming NewFrame, then the frame
+    // line. Call after the platform backend's NewFrame.
+    void CaptureFrame();
+
+    void RecordOpenFile(const std::string& path);
+    void RecordOpenFolder(const std::string& path);
+
+private:
+    std::ofstream m_out;
+    ImVec2 m_displaySize = ImVec2(0, 0);
+};
+
+// Frame CPU times of a replay, in milliseconds.
+struct FrameTimeSummary {
+    size_t frames = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Nearest-rank percentiles.
+FrameTimeSummary SummarizeFrameTimes(std::vector<double> milliseconds);
@@ -0,0 +1,123 @@
+#include "job_system.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+JobSystem::JobSystem(unsigned workerCount) {
+    workerCount = std::max(1u, workerCount);
+    for (unsigned i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_jobsReady.notify_all();
+    for (auto& worker : m_workers) worker.join();
+}
+
+void JobSystem::Submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        if (m_stopping) return;
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobsReady.notify_one();
+}
+
+void JobSystem::ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) return;
+    chunkSize = std::max<size_t>(1, chunkSize);
+    const size_t chunks = (count + chunkSize - 1) / chunkSize;
+    if (chunks == 1) {
+        fn(0, count);
+        return;
+    }
+
+    // Helpers may start after the call has returned; they then find no chunk left
+    // and never touch fn, which lives on the caller's stack.
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count = 0, chunkSize = 0, chunks = 0;
+        const std::function<void(size_t, size_t)>* fn = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->count = count;
+    shared->chunkSize = chunkSize;
+    shared->chunks = chunks;
+    shared->fn = &fn;
+
+    auto run = [](Shared& s) {
+        for (size_t chunk = s.next++; chunk < s.chunks; chunk = s.next++) {
+            size_t begin = chunk * s.chunkSize;
+            (*s.fn)(begin, std::min(begin + s.chunkSize, s.count));
+            if (++s.done == s.chunks) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(m_workers.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        Submit([shared, run] { run(*shared); });
+    }
+    run(*shared);
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->finished.wait(lock, [&] { return shared->done.load() == chunks; });
+}
+
+void JobSystem::PostToMain(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(m_callbacksMutex);
+    m_callbacks.push_back(std::move(callback));
+    if (m_wake) m_wake();
+}
+
+void JobSystem::SetMainThreadWaker(std::function<void()> wake) {
+    std::lock_guard<std::mutex> lock(m_callbacksMutex);
+    m_wake = std::move(wake);
+}
+
+void JobSystem::RunMainThreadCallbacks() {
+    PROFILE_ZONE("MainThreadCallbacks");
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_callbacksMutex);
+        ready.swap(m_callbacks);
+    }
+    // Callbacks may post or submit more work; that lands in the next frame.
+    for (auto& callback : ready) callback();
+}
+
+void JobSystem::WorkerLoop(unsigned index) {
+    PROFILE_THREAD("Jobs " + std::to_string(index));
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobsMutex);
+            m_jobsReady.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        PROFILE_ZONE("Job");
+        job();
+    }
+}
+
+JobSystem& Jobs() {
+    // Loads are mostly I/O bound, so allow a few even on small machines.
+    static JobSystem jobs(std::min(8u, std::max(2u, std::thread::hardware_concurrency())));
+    return jobs;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for work that must not stall a frame: file loads,
+// saves, directory scans. Workers never touch UI state; they hand results back with
+// PostToMain, and the render loop runs those callbacks once per frame.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned workerCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Run job on a worker. Jobs start in submission order; several run at once.
+    void Submit(std::function<void()> job);
+
+    // Run fn(begin, end) over [0, count) in chunks of chunkSize and return when all
+    // are done. The calling thread takes chunks too, and idle workers help, so a pool
+    // busy with long jobs slows this down but never stalls it. Safe to call from a job.
+    void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& fn);
+
+    // Queue callback for the next RunMainThreadCallbacks. Safe from any thread.
+    void PostToMain(std::function<void()> callback);
+
+    // Called on the posting thread after each PostToMain, so a render loop sleeping
+    // until the next event can be woken (e.g. glfwPostEmptyEvent). Null to stop.
+    void SetMainThreadWaker(std::function<void()> wake);
+
+    // Run every queued callback. Call from the UI thread only.
+    void RunMainThreadCallbacks();
+
+    unsigned WorkerCount() const { return (unsigned)m_workers.size(); }
+
+private:
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_jobsMutex;
+    std::condition_variable m_jobsReady;
+    bool m_stopping = false;
+
+    std::vector<std::function<void()>> m_callbacks;
+    std::function<void()> m_wake;
+    std::mutex m_callbacksMutex;       // guards m_callbacks and m_wake
+};
+
+// Process-wide pool, created on first use. Jobs still queued at exit are dropped;
+// running ones are joined.
+JobSystem& Jobs();
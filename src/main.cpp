@@ -9,6 +9,23 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "icon.h"
+#include "document.h"
+#include "text_view.h"
+#include "text_stats.h"
+#include "file_io.h"
+#include "job_system.h"
+#include "project_tree.h"
+#include "file_watcher.h"
+#include "session_journal.h"
+#include "text_search.h"
+#include "trigram_index.h"
+#include "fuzzy_finder.h"
+#include "buffer_search.h"
+#include "syntax.h"
+#include "frame_pacer.h"
+#include "profiler.h"
+#include "memory_stats.h"
+#include "input_replay.h"
 
 #include <iostream>
 #include <vector>
@@ -17,6 +34,15 @@
 #include <algorithm>
 #include <filesystem>
 #include <memory>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -29,12 +55,40 @@
 
 namespace fs = std::filesystem;
 
+#if EDIFIER_MEMORY_STATS
+// Every heap allocation is charged to the subsystem whose MEMORY_SCOPE it was made
+// in, for the Memory window. Over-aligned new isn't replaced and goes uncounted;
+// nothing here uses it.
+void* operator new(size_t size) {
+    if (void* p = TaggedAlloc(size, CurrentMemoryTag())) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return TaggedAlloc(size, CurrentMemoryTag()); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TaggedAlloc(size, CurrentMemoryTag()); }
+void operator delete(void* p) noexcept { TaggedFree(p); }
+void operator delete[](void* p) noexcept { TaggedFree(p); }
+void operator delete(void* p, size_t) noexcept { TaggedFree(p); }
+void operator delete[](void* p, size_t) noexcept { TaggedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { TaggedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { TaggedFree(p); }
+
+// ImGui allocates through its own hooks. Outside any scope its blocks are its own;
+// inside one (loading fonts) they go to that scope.
+static void* ImGuiAlloc(size_t size, void*) {
+    MemoryTag tag = CurrentMemoryTag();
+    return TaggedAlloc(size, tag == MemoryTag::Other ? MemoryTag::ImGui : tag);
+}
+static void ImGuiFree(void* p, void*) { TaggedFree(p); }
+#endif
+
 enum ThemeType { THEME_DARK, THEME_LIGHT, THEME_GREY, THEME_CUSTOM };
 ThemeType currentTheme = THEME_GREY;
 
 static GLFWwindow* g_window = nullptr;
 static bool showThemeEditor = false;
 static ImVec4 originalThemeColors[ImGuiCol_COUNT];
+static ImVec4 originalSyntaxColors[(int)TokenKind::Count];
 static bool themeBackupSaved = false;
 
 // GTK is initialized once at startup, not per-dialog.
@@ -42,16 +96,54 @@ static bool themeBackupSaved = false;
 static bool g_gtkInitialized = false;
 #endif
 
+static uint64_t NextTabId() {
+    static uint64_t next = 1;
+    return next++;
+}
+
 // A single open file / tab representation
 struct FileTab {
+    uint64_t id = NextTabId();       // stable across tab reordering; background jobs refer to tabs by it
     std::string filePath;
-    std::string content;
-    std::vector<char> editBuffer;
+    Document document;               // single source of truth for the tab's text
+    TextViewState view;              // caret, selection and scroll of the editor widget
     bool isModified = false;
-    std::filesystem::file_time_type lastModified;
+    uint64_t savedGeneration = 0;    // document generation that matches the file on disk
+    FileFingerprint disk;            // the file as last loaded or saved
     bool isReadonly = false;
-    int cachedWordCount = 0;
-    size_t cachedCharCount = 0;
+    FileFormat format;               // mapping and line endings, restored on save
+    TextStats stats;
+    std::shared_ptr<LoadProgress> loading;  // set while the file is read on a worker
+    std::shared_ptr<LoadProgress> reloading;  // same, for a reload the tab stays editable through
+    bool stub = false;               // restored from the session or evicted; read when next activated
+    std::string loadError;           // why a stub's last read failed; it waits for a retry
+    std::chrono::steady_clock::time_point lastActive;  // last frame it was shown; least recent is evicted first
+    bool diskCheck = false;          // a comparison with the file on disk is running
+    bool diskRecheck = false;        // the file changed again meanwhile, or was busy
+    bool deletedOnDisk = false;
+    bool changedOnDisk = false;      // changed on disk while modified here; asks which to keep
+    FileFingerprint diskChanged;     // what is on disk then, kept if the user keeps theirs
+    bool reloadChosen = false;       // the user picked the disk version; asks again if reading it fails
+    bool truncatedOnDisk = false;    // the file was cut short under its mapping; only a reload can fix the text
+    const TextBuffer* loadedBuffer = nullptr;  // the document's original, as read from loadedDisk
+    FileFingerprint loadedDisk;
+    uint64_t journal = 0;            // session journal holding the unsaved text, 0 when none
+    uint64_t journaledGeneration = 0;  // document generation the journal reproduces
+    size_t journaledBytes = 0;       // edit bytes appended since the journal's snapshot
+    uint64_t journalTicket = 0;      // the journal's latest snapshot, as queued
+    bool journalBased = false;       // that snapshot refers to ranges of the loaded file
+    std::chrono::steady_clock::time_point journalRetryAt;  // a failed journal is rewritten no sooner
+    uint64_t evictTicket = 0;        // journal snapshot to see on disk before the text is dropped
+    uint64_t evictGeneration = 0;    // document generation that snapshot holds
+    bool saving = false;             // a write of this tab is in flight
+    std::string queuedSavePath;      // save requested while one was in flight, or before the tab loaded
+    bool closeAfterSave = false;     // "Save" in the close prompt: goes once the file is written, not before
+    std::string saveError;           // last failed save, shown until the next success
+    size_t jumpLine = (size_t)-1;    // search hit to reveal once loading finishes
+    size_t jumpColumn = 0;
+    size_t jumpLength = 0;
+    BufferSearch search;             // find bar matches, kept current by ApplyTabEdit
+    SyntaxHighlighter syntax;        // lexer states per line, lexed up to the viewport each frame
 };
 
 struct AppState {
@@ -74,29 +166,111 @@ struct AppState {
     bool focusEditor = false;
 
     std::string projectRoot;
+    std::string pendingRoot;  // "Set as Root" picked while the tree was being drawn
+
+    // Explorer selection, as a tree node; its row is an O(1) lookup.
+    uint32_t explorerSelection = ProjectTree::kNone;
+    bool explorerScrollToSelection = false;
+    std::string explorerActivePath;   // active tab path the selection last followed
+    float explorerRowHeight = 20.0f;  // measured by the list clipper
+
+    int pendingSaves = 0;    // background writes not yet reported back
+    size_t tabMemory = 0;    // document and undo heap of the loaded tabs, as of the last frame
+
+    // Find in Files. Hits stream in from the session while it runs.
+    bool showFindInFiles = false;
+    bool focusFindQuery = false;
+    char findQuery[256] = "";
+    bool findCaseSensitive = false;
+    bool findRegex = false;
+    std::string findError;
+    std::unique_ptr<SearchSession> findSession;
+    std::vector<std::string> findFiles;
+    std::vector<SearchHit> findHits;
+    int findSelection = -1;
+    bool findIndexed = false;    // only the index's candidate files were searched
+
+    // Find / replace in the active tab (Ctrl+F, Ctrl+H).
+    bool showFindBar = false;
+    bool showReplace = false;
+    bool focusFindBar = false;
+    char findBarQuery[256] = "";
+    char findBarReplacement[256] = "";
+    bool findBarCaseSensitive = false;
+    bool findBarRegex = false;
+    std::string findBarError;
+    std::string findBarStatus;   // result of the last Replace All
+    bool findBarJump = false;    // select the first match at or after findBarOrigin once found
+    size_t findBarOrigin = 0;
+    bool findBarHasFocus = false;
+
+    bool showFrameStats = false;
+
+    // Profiler window
+    bool showProfiler = false;
+    bool profilerPaused = false;
+    float profilerExportSeconds = 10.0f;
+    std::string profilerStatus;           // result of the last trace export
+
+    // Memory window
+    bool showMemory = false;
+    std::string memoryStatus;             // result of the last snapshot export
+    size_t drawListUsed = 0;              // main viewport draw lists, last frame
+    size_t drawListCapacity = 0;
+    std::vector<ProfileTrack> profileTracks;
+
+    // Quick open (Ctrl+P)
+    bool showQuickOpen = false;
+    bool focusQuickOpen = false;
+    char quickOpenQuery[256] = "";
+    std::string quickOpenLastQuery;
+    int quickOpenSelection = 0;
+    bool pathIndexBuilding = false;
 };
 
 AppState g_appState;
+ProjectTree g_projectTree;
+ProjectTree g_browserTree(false);  // the File Browser dialog's current directory
+TrigramIndex g_projectIndex;       // follows projectRoot; narrows Find in Files
+FileWatcher g_fileWatcher;         // files of the open tabs, for changes made by other programs
+SessionJournal g_sessionJournal;   // open tabs and unsaved text, restored on the next start
+FuzzyFinder g_fuzzyFinder;         // quick open over projectRoot's paths
+FrameStats g_frameStats;
+static std::atomic<bool> g_pathIndexCancel{false};
+InputRecorder g_inputRecorder;     // --record
+static bool g_headless = false;    // --replay: native dialogs return nothing
+
+// Document and undo heap the tabs may hold together before the least recently shown
+// ones are evicted to stubs. Set with --tab-memory-mb.
+static size_t g_tabMemoryBudget = 1024ull * 1024 * 1024;
+
+// Zone around each main loop iteration; the Profiler window graphs these.
+static const char* const kFrameZone = "Frame";
 
 // Forward declarations
 void RenderExplorer();
-void RenderFileSystemTree(const fs::path& path);
+void RenderFileSystemTree();
 void OpenFolder(const std::string& folderpath);
 void SetupInitialStyle();
+void SetupSyntaxColors(ThemeType theme);
 void ThemeEditorMenu();
 void HandleKeyboardShortcuts();
 void SetupInitialDockingLayout();
 std::string OpenFileDialog();
 void OpenFile(const std::string& filepath);
+void OpenFileAtLine(const std::string& filepath, size_t line, size_t column, size_t length);
+void RenderFindInFiles();
+void RenderQuickOpen();
+void RenderProfiler();
+void RenderMemory();
 void SaveFileAs(int tabIndex);
 void SaveFile(int tabIndex);
 void CloseTab(int tabIndex);
+int FindTab(uint64_t id);
 void RenderEditor();
 void SaveAll();
 void RenderMenuBar();
 void RenderMainDockSpace();
-bool IsTextFile(const std::string& filepath);
-std::string ReadFileContent(const std::string& filepath);
 
 
 
@@ -141,11 +315,13 @@ void OpenFolder(const std::string& folderpath) {
         return;
     }
 
+    g_inputRecorder.RecordOpenFolder(folderpath);
     g_appState.projectRoot = folderpath;
     g_appState.currentPath = folderpath;
 }
 
 std::string OpenFileDialog() {
+    if (g_headless) return "";
 #ifdef _WIN32
     char filename[MAX_PATH] = "";
     OPENFILENAMEA ofn = {};
@@ -189,6 +365,7 @@ std::string OpenFileDialog() {
 }
 
 std::string SaveFileDialog(const std::string& defaultName = "") {
+    if (g_headless) return "";
 #ifdef _WIN32
     char filename[MAX_PATH] = "";
     if (!defaultName.empty()) {
@@ -244,6 +421,7 @@ std::string SaveFileDialog(const std::string& defaultName = "") {
 }
 
 std::string OpenFolderDialog() {
+    if (g_headless) return "";
 #ifdef _WIN32
     std::string result = "";
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
@@ -311,95 +489,138 @@ std::string OpenFolderDialog() {
     return "";
 }
 
-void RenderFileSystemTree(const fs::path& path) {
-
-    if (path.empty() || !fs::exists(path) || !fs::is_directory(path)) {
-        return;
+// Keeps the explorer selection within the scroll view after keyboard movement.
+static void ScrollExplorerToRow(uint32_t row, float rowHeight) {
+    float top = row * rowHeight;
+    float viewHeight = ImGui::GetWindowHeight();
+    if (top < ImGui::GetScrollY()) {
+        ImGui::SetScrollY(top);
+    } else if (top + rowHeight > ImGui::GetScrollY() + viewHeight) {
+        ImGui::SetScrollY(top + rowHeight - viewHeight);
     }
-    std::vector<fs::directory_entry> directories;
-    std::vector<fs::directory_entry> files;
-
-    try {
-        for (const auto& entry : fs::directory_iterator(path)) {
-            // Hidden file filtering is Linux-only (leading dot convention).
-            // On Windows, hidden status is a filesystem attribute, not a naming convention.
-#ifdef __linux__
-            if (entry.path().filename().string().rfind(".", 0) == 0) continue;
-#endif
+}
 
-            try {
-                if (entry.is_directory()) {
-                    directories.push_back(entry);
-                } else {
-                    files.push_back(entry);
-                }
-            } catch (const fs::filesystem_error& e) {
-                std::cerr << "Error accessing entry: " << e.what() << "\n";
-                continue;
+static void HandleExplorerKeys(const std::vector<ProjectTree::Row>& rows) {
+    uint32_t row = g_projectTree.RowOf(g_appState.explorerSelection);
+    if (rows.empty()) return;
+    if (row == ProjectTree::kNone) {
+        if (!ImGui::IsKeyPressed(ImGuiKey_DownArrow) && !ImGui::IsKeyPressed(ImGuiKey_UpArrow)) return;
+        row = 0;
+    } else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) {
+        row = std::min<uint32_t>(row + 1, (uint32_t)rows.size() - 1);
+    } else if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) {
+        row = row > 0 ? row - 1 : 0;
+    } else {
+        uint32_t index = rows[row].node;
+        const ProjectTree::Node& node = g_projectTree.GetNode(index);
+        if (ImGui::IsKeyPressed(ImGuiKey_RightArrow) && node.isDirectory) {
+            if (!node.expanded) g_projectTree.SetExpanded(index, true);
+            else if (row + 1 < rows.size() && rows[row + 1].depth > rows[row].depth) ++row;
+        } else if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+            if (node.isDirectory && node.expanded) {
+                g_projectTree.SetExpanded(index, false);
+            } else if (node.parent != ProjectTree::kRoot && node.parent != ProjectTree::kNone) {
+                row = g_projectTree.RowOf(node.parent);
             }
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Enter)) {
+            if (node.isDirectory) g_projectTree.SetExpanded(index, !node.expanded);
+            else OpenFile(node.path);
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error reading directory " << path << ": " << e.what() << "\n";
-        return;
-    } catch (const std::exception& e) {
-        std::cerr << "Unexpected error in file tree: " << e.what() << "\n";
-        return;
     }
 
-    auto sortFunc = [](const fs::directory_entry& a, const fs::directory_entry& b) {
-        return a.path().filename().string() < b.path().filename().string();
-    };
-    std::sort(directories.begin(), directories.end(), sortFunc);
-    std::sort(files.begin(), files.end(), sortFunc);
+    if (row < rows.size() && rows[row].kind == ProjectTree::RowKind::Entry) {
+        g_appState.explorerSelection = rows[row].node;
+        g_appState.explorerScrollToSelection = true;
+    }
+}
 
-    for (const auto& dir : directories) {
-        std::string dirname = dir.path().filename().string();
-        std::string pathStr = dir.path().string();
+// Draws the flattened rows of the cached tree through a list clipper, so only the
+// rows on screen cost anything; a directory with 100k entries scrolls like a short one.
+void RenderFileSystemTree() {
+    PROFILE_ZONE("RenderFileSystemTree");
+    g_projectTree.RequestExpanded();
 
-        ImGui::PushID(pathStr.c_str()); 
-        
-        bool nodeOpen = ImGui::TreeNodeEx(dirname.c_str(), ImGuiTreeNodeFlags_SpanAvailWidth);
-        
-        if (ImGui::BeginPopupContextItem()) {
-            if (ImGui::MenuItem("Set as Root")) {
-                OpenFolder(pathStr);
-            }
-            ImGui::EndPopup();
+    // Follow the active tab: look its node up once per switch, not per frame.
+    const std::string* activePath = nullptr;
+    if (g_appState.activeTab >= 0 && g_appState.activeTab < (int)g_appState.tabs.size()) {
+        activePath = &g_appState.tabs[g_appState.activeTab].filePath;
+    }
+    if (activePath && *activePath != g_appState.explorerActivePath) {
+        g_appState.explorerActivePath = *activePath;
+        uint32_t node = g_projectTree.FindNode(*activePath);
+        if (node != ProjectTree::kNone) {
+            g_appState.explorerSelection = node;
+            g_appState.explorerScrollToSelection = true;
         }
+    }
 
-        if (nodeOpen) {
-            RenderFileSystemTree(dir.path());
-            ImGui::TreePop();
-        }
-        ImGui::PopID();
+    if (ImGui::IsWindowFocused()) HandleExplorerKeys(g_projectTree.Rows());
+
+    const std::vector<ProjectTree::Row>& rows = g_projectTree.Rows();
+    const float indent = ImGui::GetTreeNodeToLabelSpacing();
+    const float baseX = ImGui::GetCursorPosX();
+
+    if (g_appState.explorerScrollToSelection) {
+        uint32_t row = g_projectTree.RowOf(g_appState.explorerSelection);
+        if (row != ProjectTree::kNone) ScrollExplorerToRow(row, g_appState.explorerRowHeight);
+        g_appState.explorerScrollToSelection = false;
     }
 
-    for (const auto& file : files) {
-        std::string filename = file.path().filename().string();
-        std::string pathStr = file.path().string();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)rows.size());
+    while (clipper.Step()) {
+        for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; ++r) {
+            const ProjectTree::Row& row = rows[r];
+            const ProjectTree::Node& node = g_projectTree.GetNode(row.node);
+            ImGui::SetCursorPosX(baseX + row.depth * indent);
 
-        bool isSelected = false;
-        if (g_appState.activeTab >= 0 && g_appState.activeTab < (int)g_appState.tabs.size()) {
-            if (g_appState.tabs[g_appState.activeTab].filePath == pathStr) {
-                isSelected = true;
+            if (row.kind == ProjectTree::RowKind::Status) {
+                if (node.state == ProjectTree::ScanState::Failed) {
+                    ImGui::TextDisabled("Error: %s", node.error.c_str());
+                } else {
+                    ImGui::TextDisabled("Loading...");
+                }
+                continue;
             }
-        }
 
-        ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanAvailWidth;
-        if (isSelected) flags |= ImGuiTreeNodeFlags_Selected;
+            ImGui::PushID((int)row.node);
+            ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanAvailWidth | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+            if (row.node == g_appState.explorerSelection) flags |= ImGuiTreeNodeFlags_Selected;
 
-        ImGui::PushID(pathStr.c_str());
-        
-        ImGui::TreeNodeEx(filename.c_str(), flags);
-        if (ImGui::IsItemClicked() || ImGui::IsItemActivated()) {
-            OpenFile(pathStr);
+            if (node.isDirectory) {
+                ImGui::SetNextItemOpen(node.expanded);
+                bool nodeOpen = ImGui::TreeNodeEx(node.name.c_str(), flags);
+                if (nodeOpen != node.expanded) {
+                    g_projectTree.SetExpanded(row.node, nodeOpen);  // rows are rebuilt next frame
+                    g_appState.explorerSelection = row.node;
+                }
+
+                if (ImGui::BeginPopupContextItem()) {
+                    if (ImGui::MenuItem("Set as Root")) {
+                        g_appState.pendingRoot = node.path;  // applied after the walk
+                    }
+                    if (ImGui::MenuItem("Refresh")) {
+                        g_projectTree.Refresh(row.node);
+                    }
+                    ImGui::EndPopup();
+                }
+            } else {
+                ImGui::TreeNodeEx(node.name.c_str(), flags | ImGuiTreeNodeFlags_Leaf);
+                if (ImGui::IsItemClicked() || ImGui::IsItemActivated()) {
+                    g_appState.explorerSelection = row.node;
+                    OpenFile(node.path);
+                }
+            }
+
+            ImGui::PopID();
         }
-        
-        ImGui::PopID();
     }
+    if (clipper.ItemsHeight > 0.0f) g_appState.explorerRowHeight = clipper.ItemsHeight;
+    clipper.End();
 }
 
 void RenderExplorer() {
+    PROFILE_ZONE("RenderExplorer");
     ImGui::Begin("Explorer");
 
     if (g_appState.projectRoot.empty()) {
@@ -425,179 +646,966 @@ void RenderExplorer() {
         ImGui::Separator();
         
         ImGui::BeginChild("FileTree");
-        RenderFileSystemTree(g_appState.projectRoot);
+        if (g_projectTree.RootPath() != g_appState.projectRoot) {
+            g_projectTree.SetRoot(g_appState.projectRoot);
+            g_appState.explorerSelection = ProjectTree::kNone;
+            g_appState.explorerActivePath.clear();
+        }
+        RenderFileSystemTree();
         ImGui::EndChild();
+
+        if (!g_appState.pendingRoot.empty()) {
+            OpenFolder(g_appState.pendingRoot);
+            g_appState.pendingRoot.clear();
+        }
     }
 
     ImGui::End();
 }
 
-bool IsTextFile(const std::string& filepath) {
-    if (filepath.empty() || !fs::exists(filepath)) return false;
-    
-    std::string ext = fs::path(filepath).extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
+// Replaces the running search (its threads are joined) with one for the current query.
+static void StartFindInFiles() {
+    g_appState.findSession.reset();
+    g_appState.findFiles.clear();
+    g_appState.findHits.clear();
+    g_appState.findError.clear();
+    g_appState.findSelection = -1;
 
-    std::vector<std::string> textExtensions = {
-        ".txt", ".md", ".markdown", ".log", ".cfg", ".ini", ".json", ".xml",
-        ".html", ".htm", ".css", ".js", ".ts", ".jsx", ".tsx",
-        ".cpp", ".c", ".h", ".hpp", ".cc", ".cxx", ".py", ".java",
-        ".cs", ".rb", ".go", ".rs", ".swift", ".kt", ".scala",
-        ".sh", ".bash", ".zsh", ".fish", ".ps1", ".bat", ".cmd",
-        ".yaml", ".yml", ".toml", ".env", ".gitignore", ".dockerignore"
-    };
+    if (g_appState.projectRoot.empty()) {
+        g_appState.findError = "Open a folder to search it";
+        return;
+    }
 
-    if (std::find(textExtensions.begin(), textExtensions.end(), ext) != textExtensions.end()) {
-        return true;
+    SearchQuery query;
+    query.pattern = g_appState.findQuery;
+    query.caseSensitive = g_appState.findCaseSensitive;
+    query.regex = g_appState.findRegex;
+    TextMatcher matcher;
+    if (!matcher.Compile(query, &g_appState.findError)) return;
+
+    // With a usable index only its candidates are read; otherwise walk everything.
+    // Candidates include files changed outside the editor that it hasn't re-read yet.
+    std::vector<std::string> candidates;
+    g_appState.findIndexed = g_projectIndex.Root() == g_appState.projectRoot &&
+                             g_projectIndex.Candidates(matcher, candidates);
+    if (g_appState.findIndexed) {
+        g_appState.findSession = std::make_unique<SearchSession>(g_appState.projectRoot, matcher, std::move(candidates));
+    } else {
+        g_appState.findSession = std::make_unique<SearchSession>(g_appState.projectRoot, matcher);
     }
+}
 
-    if (ext.empty()) return true;
+// Hits are collected from the session every frame while it runs and drawn through a
+// list clipper, so a hundred thousand results scroll as cheaply as ten.
+void RenderFindInFiles() {
+    PROFILE_ZONE("RenderFindInFiles");
+    if (!g_appState.showFindInFiles) return;
+    ImGui::Begin("Find in Files", &g_appState.showFindInFiles);
+
+    SearchSession* session = g_appState.findSession.get();
+    if (session) session->TakeResults(g_appState.findFiles, g_appState.findHits);
+    bool running = session && !session->Done();
+
+    // Hits and index progress arrive from other threads without waking the loop.
+    if (running) RequestFrameIn(0.05);
+    else if (g_projectIndex.Indexing()) RequestFrameIn(0.25);
+
+    if (g_appState.focusFindQuery) {
+        ImGui::SetKeyboardFocusHere();
+        g_appState.focusFindQuery = false;
+    }
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    bool submit = ImGui::InputTextWithHint("##findQuery", "Search in project", g_appState.findQuery,
+                                           sizeof(g_appState.findQuery), ImGuiInputTextFlags_EnterReturnsTrue);
+
+    ImGui::Checkbox("Match Case", &g_appState.findCaseSensitive);
+    ImGui::SameLine();
+    ImGui::Checkbox("Regex", &g_appState.findRegex);
+    ImGui::SameLine();
+    if (running) {
+        if (ImGui::Button("Cancel", ImVec2(100, 0))) session->Cancel();
+    } else if (ImGui::Button("Search", ImVec2(100, 0))) {
+        submit = true;
+    }
+
+    ImGui::SameLine();
+    if (!g_appState.findError.empty()) {
+        ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", g_appState.findError.c_str());
+    } else if (session) {
+        ImGui::Text("%zu results in %zu files | %llu files searched%s%s%s",
+                    g_appState.findHits.size(), g_appState.findFiles.size(),
+                    (unsigned long long)session->FilesScanned(), g_appState.findIndexed ? " (indexed)" : "",
+                    running ? " | Searching..." : "", session->Truncated() ? " | Result limit reached" : "");
+    }
+    if (g_projectIndex.Indexing() && g_projectIndex.FilesToIndex() > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("| Indexing %llu/%llu", (unsigned long long)g_projectIndex.FilesIndexed(),
+                            (unsigned long long)g_projectIndex.FilesToIndex());
+    }
 
-    // Binary check via sampling
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open()) return false;
+    if (submit) {
+        StartFindInFiles();
+        session = g_appState.findSession.get();
+    }
 
-    char buffer[512];
-    file.read(buffer, sizeof(buffer));
-    std::streamsize bytesRead = file.gcount();
-    file.close();
+    ImGui::Separator();
+    ImGui::BeginChild("FindResults");
+
+    const std::string root = session ? session->Root() : std::string();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)g_appState.findHits.size());
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const SearchHit& hit = g_appState.findHits[i];
+            const std::string& path = g_appState.findFiles[hit.file];
+            size_t skip = (!root.empty() && path.compare(0, root.size(), root) == 0) ? root.size() : 0;
+            while (skip < path.size() && (path[skip] == '/' || path[skip] == '\\')) ++skip;
+
+            // The text is drawn over an unlabeled selectable: file contents may contain "##".
+            ImGui::PushID(i);
+            float x = ImGui::GetCursorPosX();
+            if (ImGui::Selectable("##hit", i == g_appState.findSelection)) {
+                g_appState.findSelection = i;
+                OpenFileAtLine(path, hit.line, hit.column, hit.length);
+            }
+            ImGui::SameLine(x);
+            ImGui::TextDisabled("%s:%u:", path.c_str() + skip, hit.line + 1);
+            ImGui::SameLine();
+            ImGui::TextUnformatted(hit.preview.data(), hit.preview.data() + hit.preview.size());
+            ImGui::PopID();
+        }
+    }
+    clipper.End();
 
-    for (std::streamsize i = 0; i < bytesRead; ++i) {
-        unsigned char c = static_cast<unsigned char>(buffer[i]);
-        if (c < 32 && c != 9 && c != 10 && c != 13) {
-            if (c == 0) return false;
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+// Lists projectRoot on a worker. The finder keeps serving the previous list until
+// the new one arrives, so reopening the palette is instant.
+static void BuildPathIndex() {
+    if (g_appState.pathIndexBuilding || g_appState.projectRoot.empty()) return;
+    g_appState.pathIndexBuilding = true;
+
+    std::string root = g_appState.projectRoot;
+    Jobs().Submit([root] {
+        PROFILE_ZONE("BuildPathIndex");
+        MEMORY_SCOPE(MemoryTag::Search);
+        std::shared_ptr<const PathIndex> index = PathIndex::Build(root, &g_pathIndexCancel);
+        Jobs().PostToMain([root, index] {
+            g_appState.pathIndexBuilding = false;
+            if (index && root == g_appState.projectRoot) g_fuzzyFinder.SetIndex(index);
+        });
+    });
+}
+
+static void OpenQuickOpen() {
+    g_appState.showQuickOpen = true;
+    g_appState.focusQuickOpen = true;
+    g_appState.quickOpenQuery[0] = '\0';
+    g_appState.quickOpenLastQuery.clear();
+    g_appState.quickOpenSelection = 0;
+
+    // Relisted on every open so new files show up.
+    const PathIndex* index = g_fuzzyFinder.Index();
+    if (index && index->Root() != g_appState.projectRoot) g_fuzzyFinder.SetIndex(nullptr);
+    BuildPathIndex();
+}
+
+// Ctrl+P palette. Each keystroke re-ranks through the finder, which only rescans the
+// previous query's matches when the new query extends it.
+void RenderQuickOpen() {
+    PROFILE_ZONE("RenderQuickOpen");
+    if (!g_appState.showQuickOpen) return;
+
+    ImGuiViewport* viewport = ImGui::GetMainViewport();
+    float width = std::min(600.0f, viewport->WorkSize.x * 0.8f);
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + (viewport->WorkSize.x - width) * 0.5f, viewport->WorkPos.y + 40.0f));
+    ImGui::SetNextWindowSize(ImVec2(width, 0.0f));
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings |
+                             ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
+                             ImGuiWindowFlags_AlwaysAutoResize;
+    ImGui::Begin("Quick Open", &g_appState.showQuickOpen, flags);
+
+    if (g_appState.projectRoot.empty()) {
+        ImGui::TextDisabled("Open a folder to search its files");
+        if (ImGui::IsKeyPressed(ImGuiKey_Escape)) g_appState.showQuickOpen = false;
+        ImGui::End();
+        return;
+    }
+
+    if (g_appState.focusQuickOpen) {
+        ImGui::SetKeyboardFocusHere();
+        g_appState.focusQuickOpen = false;
+    }
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    bool submit = ImGui::InputTextWithHint("##quickOpen", "Go to file...", g_appState.quickOpenQuery,
+                                           sizeof(g_appState.quickOpenQuery), ImGuiInputTextFlags_EnterReturnsTrue);
+
+    const std::vector<FuzzyResult>& results = g_fuzzyFinder.Search(g_appState.quickOpenQuery);
+    if (g_appState.quickOpenLastQuery != g_appState.quickOpenQuery) {
+        g_appState.quickOpenLastQuery = g_appState.quickOpenQuery;
+        g_appState.quickOpenSelection = 0;
+    }
+
+    bool moved = false;
+    if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) {
+        ++g_appState.quickOpenSelection;
+        moved = true;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) {
+        --g_appState.quickOpenSelection;
+        moved = true;
+    }
+    g_appState.quickOpenSelection = std::max(0, std::min(g_appState.quickOpenSelection, (int)results.size() - 1));
+    if (ImGui::IsKeyPressed(ImGuiKey_Escape)) g_appState.showQuickOpen = false;
+
+    ImGui::TextDisabled("%zu matching files%s", g_fuzzyFinder.MatchCount(),
+                        g_appState.pathIndexBuilding ? " | Listing files..." : "");
+
+    const PathIndex* index = g_fuzzyFinder.Index();
+    int picked = -1;
+    ImGui::BeginChild("QuickOpenResults", ImVec2(0.0f, 320.0f));
+    for (int i = 0; index && i < (int)results.size(); ++i) {
+        std::string path = index->Path(results[i].path);
+        size_t nameStart = index->NameStart(results[i].path);
+
+        ImGui::PushID(i);
+        float x = ImGui::GetCursorPosX();
+        bool selected = i == g_appState.quickOpenSelection;
+        if (ImGui::Selectable("##pick", selected)) picked = i;
+        if (selected && moved) ImGui::SetScrollHereY();
+        ImGui::SameLine(x);
+        ImGui::TextUnformatted(path.c_str() + nameStart);
+        if (nameStart > 0) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%.*s", (int)nameStart - 1, path.c_str());
         }
+        ImGui::PopID();
+    }
+    ImGui::EndChild();
+
+    if (submit && !results.empty()) picked = g_appState.quickOpenSelection;
+    if (picked >= 0 && index) {
+        OpenFile(index->FullPath(results[picked].path));
+        g_appState.showQuickOpen = false;
     }
 
-    return true;
+    ImGui::End();
 }
 
-std::string ReadFileContent(const std::string& filepath) {
-    if (filepath.empty() || !fs::exists(filepath)) {
-        std::cerr << "File does not exist: " << filepath << "\n";
-        return "";
+// Profiler window: recent frame times and where the main thread spent them, how
+// busy each background thread was, and trace export for a closer look in
+// chrome://tracing or Perfetto.
+static const double kProfilerWindowSeconds = 5.0;
+static const int kProfilerGraphFrames = 300;
+
+struct ZoneStats {
+    std::string name;
+    double total = 0.0;     // ms over all frames in the window
+    double max = 0.0;       // ms in the worst frame
+    double last = 0.0;      // ms in the newest frame
+    size_t calls = 0;
+    double current = 0.0;   // ms in the frame being summed
+    size_t frame = (size_t)-1;
+};
+
+static void FinishZoneFrame(ZoneStats& stats, size_t lastFrame) {
+    stats.max = std::max(stats.max, stats.current);
+    if (stats.frame == lastFrame) stats.last = stats.current;
+    stats.current = 0.0;
+}
+
+void RenderProfiler() {
+    if (!g_appState.showProfiler) return;
+    PROFILE_ZONE("RenderProfiler");
+    ImGui::Begin("Profiler", &g_appState.showProfiler);
+
+#if !EDIFIER_PROFILER
+    ImGui::TextDisabled("Built without the profiler (EDIFIER_PROFILER=0).");
+    ImGui::End();
+    return;
+#endif
+
+    std::vector<ProfileTrack>& tracks = g_appState.profileTracks;
+    uint64_t now = ProfileNow();
+    uint64_t span = (uint64_t)(kProfilerWindowSeconds * 1e9);
+    if (!g_appState.profilerPaused) CollectProfile(now > span ? now - span : 0, tracks);
+
+    const ProfileTrack* mainTrack = nullptr;
+    for (const auto& track : tracks) {
+        if (track.name == "Main") mainTrack = &track;
     }
-    
-    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filepath << "\n";
-        return "";
+
+    // The current frame is still open, so the newest Frame zone is the last one drawn.
+    std::vector<const ProfileEvent*> frames;
+    if (mainTrack) {
+        for (const auto& event : mainTrack->events) {
+            if (event.depth == 0 && event.name && strcmp(event.name, kFrameZone) == 0) frames.push_back(&event);
+        }
     }
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    std::vector<float> frameTimes;
+    size_t firstGraphed = frames.size() > (size_t)kProfilerGraphFrames ? frames.size() - kProfilerGraphFrames : 0;
+    float worst = 0.0f, sum = 0.0f;
+    for (size_t i = firstGraphed; i < frames.size(); ++i) {
+        float ms = (float)(frames[i]->end - frames[i]->start) / 1e6f;
+        frameTimes.push_back(ms);
+        worst = std::max(worst, ms);
+        sum += ms;
+    }
+
+    ImGui::Checkbox("Pause", &g_appState.profilerPaused);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(120);
+    ImGui::InputFloat("seconds", &g_appState.profilerExportSeconds, 1.0f, 5.0f, "%.0f");
+    g_appState.profilerExportSeconds = std::max(1.0f, std::min(g_appState.profilerExportSeconds, 600.0f));
+    ImGui::SameLine();
+    if (ImGui::Button("Export Trace...")) {
+        std::string path = SaveFileDialog("edifier-trace.json");
+        if (!path.empty()) {
+            std::string error;
+            if (WriteChromeTrace(path, g_appState.profilerExportSeconds, &error)) g_appState.profilerStatus = "Wrote " + path;
+            else g_appState.profilerStatus = error;
+        }
+    }
+    if (!g_appState.profilerStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", g_appState.profilerStatus.c_str());
+    }
 
-    const size_t maxSize = 10 * 1024 * 1024; // 10MB
-    if (size > (std::streamsize)maxSize) {
-        std::string content(maxSize, '\0');
-        file.read(&content[0], maxSize);
-        content += "\n\n[File truncated - original size: " + std::to_string(size) + " bytes]";
-        return content;
+    char overlay[96];
+    if (frameTimes.empty()) {
+        snprintf(overlay, sizeof(overlay), "no frames recorded");
+    } else {
+        snprintf(overlay, sizeof(overlay), "last %.2f ms | avg %.2f ms | max %.2f ms", frameTimes.back(),
+                 sum / (float)frameTimes.size(), worst);
+    }
+    ImGui::PlotLines("##FrameTimes", frameTimes.data(), (int)frameTimes.size(), 0, overlay, 0.0f,
+                     std::max(worst * 1.1f, 1000.0f / 60.0f), ImVec2(-FLT_MIN, 80));
+
+    // Main thread zones, summed per frame. Events and frames both come in end
+    // order, so one pass pairs each zone with the frame around it.
+    std::vector<ZoneStats> zones;
+    std::unordered_map<std::string, size_t> zoneIndex;
+    if (mainTrack && !frames.empty()) {
+        size_t f = 0;
+        for (const auto& event : mainTrack->events) {
+            if (event.depth == 0 || !event.name) continue;
+            while (f < frames.size() && frames[f]->end < event.end) ++f;
+            if (f == frames.size()) break;
+            if (event.start < frames[f]->start) continue;
+
+            auto found = zoneIndex.emplace(event.name, zones.size());
+            if (found.second) {
+                zones.emplace_back();
+                zones.back().name = event.name;
+            }
+            ZoneStats& stats = zones[found.first->second];
+            if (stats.frame != f) {
+                if (stats.frame != (size_t)-1) FinishZoneFrame(stats, frames.size() - 1);
+                stats.frame = f;
+            }
+            double ms = (double)(event.end - event.start) / 1e6;
+            stats.current += ms;
+            stats.total += ms;
+            ++stats.calls;
+        }
+        for (auto& stats : zones) FinishZoneFrame(stats, frames.size() - 1);
+        std::sort(zones.begin(), zones.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.total > b.total; });
+    }
+
+    const ImGuiTableFlags tableFlags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp;
+    if (ImGui::BeginTable("ProfilerZones", 5, tableFlags)) {
+        ImGui::TableSetupColumn("Main thread zone", 0, 3.0f);
+        ImGui::TableSetupColumn("Last (ms)");
+        ImGui::TableSetupColumn("Avg (ms)");
+        ImGui::TableSetupColumn("Max (ms)");
+        ImGui::TableSetupColumn("Calls / frame");
+        ImGui::TableHeadersRow();
+        double frameCount = (double)std::max<size_t>(1, frames.size());
+        for (const auto& stats : zones) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.last);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.total / frameCount);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.max);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", (double)stats.calls / frameCount);
+        }
+        ImGui::EndTable();
+    }
+
+    // Background threads: share of the window spent inside top-level zones.
+    bool backgroundBusy = false;
+    if (ImGui::BeginTable("ProfilerThreads", 4, tableFlags)) {
+        ImGui::TableSetupColumn("Thread", 0, 2.0f);
+        ImGui::TableSetupColumn("Busy");
+        ImGui::TableSetupColumn("Zones");
+        ImGui::TableSetupColumn("Longest zone", 0, 2.0f);
+        ImGui::TableHeadersRow();
+        uint64_t windowStart = now > span ? now - span : 0;
+        for (const auto& track : tracks) {
+            if (&track == mainTrack || track.events.empty()) continue;
+            uint64_t busy = 0;
+            const ProfileEvent* longest = nullptr;
+            for (const auto& event : track.events) {
+                if (event.depth != 0) continue;
+                busy += event.end - std::max(event.start, windowStart);
+                if (!longest || event.end - event.start > longest->end - longest->start) longest = &event;
+            }
+            if (track.events.back().end + 1000000000ull > now) backgroundBusy = true;
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(track.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f%%", 100.0 * (double)busy / (double)span);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", track.events.size());
+            ImGui::TableNextColumn();
+            if (longest) {
+                ImGui::Text("%s %.2f ms", longest->name ? longest->name : "?",
+                            (double)(longest->end - longest->start) / 1e6);
+            }
+        }
+        ImGui::EndTable();
     }
 
-    std::string content((size_t)size, '\0');
-    if(!content.empty()) { 
-        file.read(content.data(), size);
+    // Worker zones finish without waking the loop; keep their rows moving.
+    if (backgroundBusy && !g_appState.profilerPaused) RequestFrameIn(0.25);
+
+    ImGui::End();
+}
+
+// Memory window: the process's resident set, heap by subsystem as counted by the
+// tagged allocator, ImGui's draw lists, and what each tab holds. Counters move
+// without waking the loop, so the window refreshes itself while open.
+static const double kMemoryRefreshSeconds = 0.5;
+
+static std::string FormatBytes(double bytes) {
+    static const char* const units[] = { "B", "KB", "MB", "GB", "TB" };
+    int unit = 0;
+    while (std::fabs(bytes) >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit ? "%.1f %s" : "%.0f %s", bytes, units[unit]);
+    return text;
+}
+
+// Draw lists of the main viewport as Render left them.
+static void RecordDrawListMemory() {
+    size_t used = 0, capacity = 0;
+    if (ImDrawData* draw = ImGui::GetDrawData()) {
+        for (int i = 0; i < draw->CmdListsCount; ++i) {
+            const ImDrawList* list = draw->CmdLists[i];
+            used += list->VtxBuffer.Size * sizeof(ImDrawVert) + list->IdxBuffer.Size * sizeof(ImDrawIdx) +
+                    list->CmdBuffer.Size * sizeof(ImDrawCmd);
+            capacity += list->VtxBuffer.Capacity * sizeof(ImDrawVert) + list->IdxBuffer.Capacity * sizeof(ImDrawIdx) +
+                        list->CmdBuffer.Capacity * sizeof(ImDrawCmd);
+        }
+    }
+    g_appState.drawListUsed = used;
+    g_appState.drawListCapacity = capacity;
+}
+
+static MemoryReport CollectMemoryReport() {
+    MemoryReport report;
+    report.resident = ProcessResidentBytes();
+    CollectMemoryCounters(report.counters, &report.counting);
+    report.drawListUsed = g_appState.drawListUsed;
+    report.drawListCapacity = g_appState.drawListCapacity;
+    report.tabBudget = g_tabMemoryBudget;
+    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+        const FileTab& tab = g_appState.tabs[i];
+        MemoryTabReport entry;
+        entry.name = tab.filePath.empty() ? "Untitled " + std::to_string(i + 1) : tab.filePath;
+        entry.loaded = !tab.stub && !tab.loading;
+        if (entry.loaded) {
+            entry.document = tab.document.Memory();
+            entry.undo = tab.view.history.MemoryUsage();
+            entry.syntax = tab.syntax.MemoryUsage();
+            entry.search = tab.search.MemoryUsage();
+        }
+        report.tabs.push_back(std::move(entry));
     }
+    return report;
+}
 
-    std::string normalized;
-    normalized.reserve(content.size());
-    for (size_t i = 0; i < content.size(); ++i) {
-        if (content[i] == '\r') {
-            if (i + 1 < content.size() && content[i + 1] == '\n') {
-                normalized += '\n';
-                ++i;
+void RenderMemory() {
+    if (!g_appState.showMemory) return;
+    PROFILE_ZONE("RenderMemory");
+    ImGui::Begin("Memory", &g_appState.showMemory);
+
+    MemoryReport report = CollectMemoryReport();
+    if (ImGui::Button("Export Snapshot...")) {
+        std::string path = SaveFileDialog("edifier-memory.json");
+        if (!path.empty()) {
+            std::string error;
+            if (WriteMemoryReport(report, path, &error)) g_appState.memoryStatus = "Wrote " + path;
+            else g_appState.memoryStatus = error;
+        }
+    }
+    if (!g_appState.memoryStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", g_appState.memoryStatus.c_str());
+    }
+
+    int64_t heap = 0, blocks = 0;
+    for (const auto& counter : report.counters) {
+        heap += counter.bytes;
+        blocks += counter.blocks;
+    }
+    ImGui::Text("Resident: %s", report.resident ? FormatBytes((double)report.resident).c_str() : "unknown");
+    ImGui::SameLine();
+    ImGui::TextDisabled("| Counted heap: %s in %lld blocks | Tabs: %s / %s", FormatBytes((double)heap).c_str(),
+                        (long long)blocks, FormatBytes((double)g_appState.tabMemory).c_str(),
+                        FormatBytes((double)g_tabMemoryBudget).c_str());
+    ImGui::Text("Draw lists: %s used of %s", FormatBytes((double)report.drawListUsed).c_str(),
+                FormatBytes((double)report.drawListCapacity).c_str());
+
+    const ImGuiTableFlags tableFlags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp;
+    if (!report.counting) {
+        ImGui::TextDisabled("Allocations are not counted in this build (EDIFIER_MEMORY_STATS=0).");
+    } else if (ImGui::BeginTable("MemorySubsystems", 4, tableFlags)) {
+        ImGui::TableSetupColumn("Subsystem", 0, 2.0f);
+        ImGui::TableSetupColumn("Live");
+        ImGui::TableSetupColumn("Blocks");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < report.counters.size(); ++i) {
+            const MemoryCounter& counter = report.counters[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(MemoryTagName((MemoryTag)i));
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FormatBytes((double)counter.bytes).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%lld", (long long)counter.blocks);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)counter.allocations);
+        }
+        ImGui::EndTable();
+    }
+
+    // Typed text lives in fixed-size add chunks, so capacity past used is slack.
+    if (ImGui::BeginTable("MemoryTabs", 7, tableFlags)) {
+        ImGui::TableSetupColumn("Tab", 0, 3.0f);
+        ImGui::TableSetupColumn("Loaded text");
+        ImGui::TableSetupColumn("Typed (used / held)", 0, 1.5f);
+        ImGui::TableSetupColumn("Index + pieces");
+        ImGui::TableSetupColumn("Undo");
+        ImGui::TableSetupColumn("Syntax + search");
+        ImGui::TableSetupColumn("Heap");
+        ImGui::TableHeadersRow();
+        for (const auto& tab : report.tabs) {
+            const DocumentMemory& doc = tab.document;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(fs::path(tab.name).filename().string().c_str());
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", tab.name.c_str());
+            ImGui::TableNextColumn();
+            if (!tab.loaded) {
+                ImGui::TextDisabled("not loaded");
+                continue;
+            }
+            if (doc.mapped) {
+                ImGui::Text("%s mapped", FormatBytes((double)doc.mapped).c_str());
             } else {
-                normalized += '\n';
+                ImGui::TextUnformatted(FormatBytes((double)doc.original).c_str());
             }
-        } else {
-            normalized += content[i];
+            ImGui::TableNextColumn();
+            ImGui::Text("%s / %s", FormatBytes((double)doc.addUsed).c_str(), FormatBytes((double)doc.addCapacity).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FormatBytes((double)(doc.newlineIndex + doc.pieces)).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FormatBytes((double)tab.undo).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FormatBytes((double)(tab.syntax + tab.search)).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FormatBytes((double)(doc.Heap() + tab.undo + tab.syntax + tab.search)).c_str());
         }
+        ImGui::EndTable();
     }
 
-    return normalized;
+    RequestFrameIn(kMemoryRefreshSeconds);
+    ImGui::End();
 }
 
+// Full recount of word/char/line statistics, used on open and revert.
+// Edits keep the stats current incrementally in ApplyTabEdit.
+void UpdateFileStats(FileTab& tab) {
+    tab.stats = CountDocumentStats(tab.document);
+}
 
+// Single entry point for every document edit. The widget hands over the exact
+// delta, so modified state and stats are derived from it instead of diffing buffers.
+// Undo of a large edit passes pieces instead of text.
+EditDelta ApplyTabEdit(FileTab& tab, size_t pos, size_t removeLen, const char* text, size_t len,
+                       const DocumentSnapshot* pieces = nullptr) {
+    MEMORY_SCOPE(MemoryTag::Documents);
+    uint64_t generation = tab.document.Generation();
+    TextStats before = StatsBeforeEdit(tab.document, pos, removeLen);
+    EditDelta delta = pieces ? tab.document.Replace(pos, removeLen, *pieces)
+                             : tab.document.Replace(pos, removeLen, text, len);
+    StatsAfterEdit(tab.stats, before, tab.document, delta.pos, delta.inserted);
+    tab.search.OnEdit(tab.document, delta);
+    tab.syntax.OnEdit(tab.document, delta);
+
+    // Text edits extend the journal; piece edits leave it behind, and
+    // UpdateSessionJournal writes a snapshot instead.
+    if (tab.journal && tab.journaledGeneration == generation && !pieces) {
+        g_sessionJournal.AppendEdit(tab.journal, delta.pos, delta.removed, text, len);
+        tab.journaledGeneration = delta.generation;
+        tab.journaledBytes += len;
+    }
+
+    tab.isModified = delta.generation != tab.savedGeneration;
+    if (tab.isModified) g_appState.needsSave = true;
+    return delta;
+}
 
-// Helper to update word/char statistics for a tab.
-void UpdateFileStats(FileTab& tab) {
-    tab.cachedCharCount = tab.content.length();
-    int wc = 0;
-    bool inword = false;
-    for(char c : tab.content) {
-        if(std::isspace(static_cast<unsigned char>(c))) {
-            inword = false;
-        } else if(!inword) {
-            inword = true;
-            ++wc;
+static void RefreshNeedsSave() {
+    g_appState.needsSave = false;
+    for (const auto& t : g_appState.tabs) {
+        if (t.isModified) {
+            g_appState.needsSave = true;
+            break;
         }
     }
-    tab.cachedWordCount = wc;
 }
 
-// Sync the live edit buffer back to tab.content before any save operation.
-// HandleKeyboardShortcuts runs before RenderEditor each frame, so without this the
-// most recent frame's keystrokes would not yet be reflected in tab.content.
-void SyncTabContent(int tabIndex) {
-    if (tabIndex < 0 || tabIndex >= (int)g_appState.tabs.size()) return;
-    FileTab& tab = g_appState.tabs[tabIndex];
-    if (!tab.editBuffer.empty()) {
-        std::string synced(tab.editBuffer.data());
-        if (synced != tab.content) {
-            tab.content = synced;
-            UpdateFileStats(tab);
-        }
+// Bytes of the active tab searched per frame while the find bar is open, so a huge
+// file's match count fills in over a few frames instead of stalling one.
+static const size_t kFindBarSliceBytes = 8 * 1024 * 1024;
+
+// Syntax states are only needed down to the bottom of the viewport; lines past the
+// top one cover any window height. Jumping deep into a large file fills them in a
+// slice per frame, the view drawing from normal state until they arrive.
+static const size_t kSyntaxLookaheadLines = 256;
+static const size_t kSyntaxSliceBytes = 512 * 1024;
+
+static FileTab* ActiveLoadedTab() {
+    if (g_appState.activeTab < 0 || g_appState.activeTab >= (int)g_appState.tabs.size()) return nullptr;
+    FileTab& tab = g_appState.tabs[g_appState.activeTab];
+    return tab.loading || tab.stub ? nullptr : &tab;
+}
+
+static void OpenFindBar(bool replace) {
+    g_appState.showFindBar = true;
+    g_appState.showReplace = replace;
+    g_appState.focusFindBar = true;
+    g_appState.findBarStatus.clear();
+
+    // A short single-line selection becomes the query.
+    FileTab* tab = ActiveLoadedTab();
+    if (!tab) return;
+    size_t selMin = std::min(tab->view.cursor, tab->view.anchor);
+    size_t selMax = std::max(tab->view.cursor, tab->view.anchor);
+    if (selMax == selMin || selMax - selMin >= sizeof(g_appState.findBarQuery)) return;
+
+    std::string selected;
+    tab->document.CopyRange(selMin, selMax - selMin, selected);
+    if (selected.find('\n') != std::string::npos) return;
+    std::memcpy(g_appState.findBarQuery, selected.c_str(), selected.size() + 1);
+    g_appState.findBarJump = true;
+    g_appState.findBarOrigin = selMin;
+}
+
+static void CloseFindBar() {
+    g_appState.showFindBar = false;
+    g_appState.findBarHasFocus = false;
+    for (auto& tab : g_appState.tabs) tab.search.Clear();
+    if (FileTab* tab = ActiveLoadedTab()) tab->view.focusRequested = true;
+}
+
+static void SelectMatch(FileTab& tab, size_t index) {
+    if (index == (size_t)-1) return;
+    const TextRange& match = tab.search.Matches()[index];
+    tab.view.anchor = match.pos;
+    tab.view.cursor = match.pos + match.len;
+    tab.view.preferredColumn = (size_t)-1;
+    tab.view.scrollToCursor = true;
+}
+
+// Index of the match the selection covers exactly, or npos.
+static size_t SelectedMatch(const FileTab& tab) {
+    size_t selMin = std::min(tab.view.cursor, tab.view.anchor);
+    size_t selMax = std::max(tab.view.cursor, tab.view.anchor);
+    size_t index = tab.search.NextMatch(selMin);
+    if (index == (size_t)-1) return index;
+    const TextRange& match = tab.search.Matches()[index];
+    return match.pos == selMin && match.pos + match.len == selMax ? index : (size_t)-1;
+}
+
+static void FindNext(FileTab& tab, bool backwards) {
+    // Stepping needs the matches past the caret, so finish the scan now.
+    tab.search.Update(tab.document, (size_t)-1);
+
+    size_t selMin = std::min(tab.view.cursor, tab.view.anchor);
+    size_t current = SelectedMatch(tab);
+    size_t index;
+    if (backwards) {
+        index = tab.search.PrevMatch(selMin);
+    } else if (current != (size_t)-1) {
+        index = current + 1 < tab.search.Matches().size() ? current + 1 : 0;
+    } else {
+        index = tab.search.NextMatch(selMin);
     }
+    SelectMatch(tab, index);
 }
 
-void SaveFile(int tabIndex) {
-    if (tabIndex < 0 || tabIndex >= (int)g_appState.tabs.size()) {
-        std::cerr << "Invalid tab index: " << tabIndex << "\n";
+// Replaces the selected match, if the selection is one, then moves to the next.
+static void ReplaceCurrent(FileTab& tab) {
+    if (tab.isReadonly) return;
+    size_t current = SelectedMatch(tab);
+    if (current != (size_t)-1) {
+        TextRange match = tab.search.Matches()[current];
+        TextEditFn applyEdit = [&tab](size_t pos, size_t removeLen, const char* text, size_t len,
+                                      const DocumentSnapshot* pieces) {
+            ApplyTabEdit(tab, pos, removeLen, text, len, pieces);
+        };
+        TextViewReplace(tab.document, tab.view, applyEdit, match.pos, match.len,
+                        g_appState.findBarReplacement, std::strlen(g_appState.findBarReplacement));
+    }
+    FindNext(tab, false);
+}
+
+// The rewritten text becomes the tab's new original buffer: one allocation of the
+// final size, no per-match piece-table edits.
+// A heap document is rewritten into one fresh buffer. A mapped one is spliced as
+// pieces instead, which copies none of the file and keeps it the journal's base.
+static void ReplaceAllInTab(FileTab& tab) {
+    if (tab.isReadonly) return;
+    MEMORY_SCOPE(MemoryTag::Documents);
+    size_t count = 0;
+    if (tab.format.mapped) {
+        DocumentSnapshot replaced = tab.search.ReplaceAllPieces(tab.document, g_appState.findBarReplacement, count);
+        if (count == 0) {
+            g_appState.findBarStatus = "Nothing to replace";
+            return;
+        }
+        RecordDocumentRewrite(tab.document, tab.view, replaced.length);
+        ApplyTabEdit(tab, 0, tab.document.Length(), nullptr, replaced.length, &replaced);
+        g_appState.findBarStatus = "Replaced " + std::to_string(count);
         return;
     }
 
-    // Flush editBuffer → content before writing to disk.
-    SyncTabContent(tabIndex);
+    std::string text = tab.search.ReplaceAll(tab.document, g_appState.findBarReplacement, count);
+    if (count == 0) {
+        g_appState.findBarStatus = "Nothing to replace";
+        return;
+    }
 
-    FileTab &tab = g_appState.tabs[tabIndex];
+    RecordDocumentRewrite(tab.document, tab.view, text.size());
+    tab.document.SetText(std::move(text));
+    tab.loadedBuffer = nullptr;  // the loaded original is gone from the document
+    tab.isModified = tab.document.Generation() != tab.savedGeneration;
+    if (tab.isModified) g_appState.needsSave = true;
+    UpdateFileStats(tab);
+    g_appState.findBarStatus = "Replaced " + std::to_string(count);
+}
 
-    if (tab.filePath.empty()) {
-        SaveFileAs(tabIndex);
+// Find / replace bar above the editor. The active tab's matches are found a slice
+// per frame and highlighted; ApplyTabEdit keeps them current while typing.
+static void RenderFindBar(FileTab& tab) {
+    if (g_appState.findBarHasFocus && ImGui::IsKeyPressed(ImGuiKey_Escape, false)) {
+        CloseFindBar();
         return;
     }
 
-    std::ofstream file(tab.filePath, std::ios::binary | std::ios::trunc);
-    if (!file.is_open()) {
-        std::cerr << "Failed to save file: " << tab.filePath << "\n";
+    SearchQuery query;
+    query.pattern = g_appState.findBarQuery;
+    query.caseSensitive = g_appState.findBarCaseSensitive;
+    query.regex = g_appState.findBarRegex;
+    g_appState.findBarError.clear();
+    if (query.pattern.empty()) {
+        tab.search.Clear();
+    } else {
+        tab.search.SetQuery(query, &g_appState.findBarError);
+    }
+    if (!tab.search.Update(tab.document, kFindBarSliceBytes)) RequestFrame();
+
+    if (g_appState.findBarJump) {
+        size_t index = tab.search.NextMatch(g_appState.findBarOrigin);
+        bool found = index != (size_t)-1 && tab.search.Matches()[index].pos >= g_appState.findBarOrigin;
+        if (found || !tab.search.Active() || tab.search.Complete()) {
+            SelectMatch(tab, index);
+            g_appState.findBarJump = false;
+        }
+    }
+
+    bool hasFocus = false;
+    if (g_appState.focusFindBar) {
+        ImGui::SetKeyboardFocusHere();
+        g_appState.focusFindBar = false;
+    }
+    ImGui::SetNextItemWidth(280.0f);
+    if (ImGui::InputTextWithHint("##findBarQuery", "Find", g_appState.findBarQuery, sizeof(g_appState.findBarQuery))) {
+        // Find as you type, from where the selection starts.
+        g_appState.findBarJump = true;
+        g_appState.findBarOrigin = std::min(tab.view.cursor, tab.view.anchor);
+        g_appState.findBarStatus.clear();
+    }
+    hasFocus |= ImGui::IsItemActive();
+    if (ImGui::IsItemDeactivated() && (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter))) {
+        FindNext(tab, ImGui::GetIO().KeyShift);
+        g_appState.focusFindBar = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Aa", &g_appState.findBarCaseSensitive);
+    ImGui::SameLine();
+    ImGui::Checkbox(".*", &g_appState.findBarRegex);
+    ImGui::SameLine();
+    if (ImGui::ArrowButton("##findPrev", ImGuiDir_Up)) FindNext(tab, true);
+    ImGui::SameLine();
+    if (ImGui::ArrowButton("##findNext", ImGuiDir_Down)) FindNext(tab, false);
+
+    ImGui::SameLine();
+    size_t count = tab.search.Matches().size();
+    if (!g_appState.findBarError.empty()) {
+        ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", g_appState.findBarError.c_str());
+    } else if (tab.search.Active()) {
+        const char* more = tab.search.Truncated() ? "+" : tab.search.Complete() ? "" : "...";
+        size_t current = SelectedMatch(tab);
+        if (count == 0) {
+            ImGui::TextDisabled("%s", tab.search.Complete() ? "No results" : "Searching...");
+        } else if (current != (size_t)-1) {
+            ImGui::Text("%zu of %zu%s", current + 1, count, more);
+        } else {
+            ImGui::Text("%zu matches%s", count, more);
+        }
+    }
+
+    ImGui::SameLine();
+    if (ImGui::SmallButton("X")) {
+        CloseFindBar();
         return;
     }
 
-    file << tab.content;
-    file.close();
+    if (g_appState.showReplace) {
+        ImGui::SetNextItemWidth(280.0f);
+        ImGui::InputTextWithHint("##findBarReplacement", "Replace", g_appState.findBarReplacement,
+                                 sizeof(g_appState.findBarReplacement));
+        hasFocus |= ImGui::IsItemActive();
 
-    tab.isModified = false;
-    g_appState.needsSave = false;
+        ImGui::SameLine();
+        ImGui::BeginDisabled(tab.isReadonly || !tab.search.Active());
+        if (ImGui::Button("Replace")) ReplaceCurrent(tab);
+        ImGui::SameLine();
+        if (ImGui::Button("Replace All")) ReplaceAllInTab(tab);
+        ImGui::EndDisabled();
+        if (!g_appState.findBarStatus.empty()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s", g_appState.findBarStatus.c_str());
+        }
+    }
+    g_appState.findBarHasFocus = hasFocus;
+}
 
-    for (const auto& t : g_appState.tabs) {
-        if (t.isModified) {
-            g_appState.needsSave = true;
-            break;
+static void BeginSave(FileTab& tab, const std::string& filepath);
+static void CheckTabOnDisk(FileTab& tab);
+static void MaterializeTab(FileTab& tab);
+
+// Runs on the UI thread when a background save has finished. Edits made while it
+// was writing keep the tab modified, since only the snapshot's generation is on disk.
+static void FinishSave(uint64_t tabId, const std::string& filepath, const SavedFile& saved) {
+    --g_appState.pendingSaves;
+    if (!saved.ok) std::cerr << "Failed to save " << filepath << ": " << saved.error << "\n";
+
+    int index = FindTab(tabId);
+    if (index < 0) return;
+
+    FileTab& tab = g_appState.tabs[index];
+    tab.saving = false;
+    if (saved.ok) {
+        tab.filePath = filepath;  // Save As takes effect once the file exists
+        tab.syntax.SetLanguage(LanguageForPath(filepath));
+        tab.savedGeneration = saved.generation;
+        tab.isModified = tab.document.Generation() != tab.savedGeneration;
+        tab.disk = saved.disk;
+        tab.deletedOnDisk = false;
+        tab.saveError.clear();
+        g_projectIndex.UpdateFile(filepath);
+        std::cout << "Saved: " << filepath << "\n";
+    } else {
+        tab.saveError = saved.error;
+        tab.closeAfterSave = false;    // the text is still only here
+    }
+    RefreshNeedsSave();
+
+    if (tab.closeAfterSave && tab.queuedSavePath.empty()) {
+        tab.closeAfterSave = false;
+        // Edits typed while it was written would go with it.
+        if (!tab.isModified) {
+            CloseTab(index);
+            return;
         }
     }
 
-    if (fs::exists(tab.filePath)) {
-        tab.lastModified = fs::last_write_time(tab.filePath);
+    if (!tab.queuedSavePath.empty()) {
+        std::string next = std::move(tab.queuedSavePath);
+        tab.queuedSavePath.clear();
+        BeginSave(tab, next);
+    } else if (tab.diskRecheck) {
+        CheckTabOnDisk(tab);
     }
-    
-    std::cout << "Saved: " << tab.filePath << "\n";
+}
+
+// Snapshot the document and write it on a worker. One write per tab is in flight at
+// a time; a save requested meanwhile starts when it completes, so writes land in order.
+static void BeginSave(FileTab& tab, const std::string& filepath) {
+    if (tab.saving) {
+        tab.queuedSavePath = filepath;
+        return;
+    }
+    tab.saving = true;
+    ++g_appState.pendingSaves;
+
+    uint64_t tabId = tab.id;
+    FileFormat format = tab.format;
+    auto snapshot = std::make_shared<DocumentSnapshot>(tab.document.Snapshot());
+    Jobs().Submit([tabId, filepath, format, snapshot] {
+        PROFILE_ZONE("SaveFile");
+        auto saved = std::make_shared<SavedFile>(WriteSnapshot(*snapshot, filepath, format));
+        Jobs().PostToMain([tabId, filepath, saved] { FinishSave(tabId, filepath, *saved); });
+    });
+}
+
+void SaveFile(int tabIndex) {
+    if (tabIndex < 0 || tabIndex >= (int)g_appState.tabs.size()) {
+        std::cerr << "Invalid tab index: " << tabIndex << "\n";
+        return;
+    }
+
+    FileTab &tab = g_appState.tabs[tabIndex];
+    // A restored tab has nothing to write yet; it saves once its text is back.
+    if (tab.stub) {
+        if (!tab.filePath.empty()) tab.queuedSavePath = tab.filePath;
+        MaterializeTab(tab);
+        return;
+    }
+    // A file changed on disk under unsaved edits waits for the prompt's answer.
+    if (tab.loading || tab.changedOnDisk) return;
+
+    if (tab.filePath.empty()) {
+        SaveFileAs(tabIndex);
+        return;
+    }
+
+    BeginSave(tab, tab.filePath);
 }
 
 void SaveFileAs(int tabIndex) {
     if (tabIndex < 0 || tabIndex >= (int)g_appState.tabs.size()) return;
-
-    // Flush editBuffer → content before writing to disk.
-    SyncTabContent(tabIndex);
+    if (g_appState.tabs[tabIndex].loading && !g_appState.tabs[tabIndex].stub) return;
 
     std::string defaultName = "untitled.txt";
     if (!g_appState.tabs[tabIndex].filePath.empty()) {
@@ -607,50 +1615,243 @@ void SaveFileAs(int tabIndex) {
     std::string filepath = SaveFileDialog(defaultName);
     if (filepath.empty()) return;
 
-    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
-    if (!file.is_open()) {
-        std::cerr << "Failed to Save As: " << filepath << "\n";
+    FileTab& tab = g_appState.tabs[tabIndex];
+    if (tab.stub) {
+        tab.queuedSavePath = filepath;
+        MaterializeTab(tab);
         return;
     }
+    BeginSave(tab, filepath);
+}
 
-    file << g_appState.tabs[tabIndex].content;
-    file.close();
+// Each modified tab gets its own background write, so they run in parallel.
+void SaveAll() {
+    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+        if (g_appState.tabs[i].isModified) {
+            SaveFile(i);
+        }
+    }
+}
 
-    g_appState.tabs[tabIndex].filePath = filepath;
-    g_appState.tabs[tabIndex].isModified = false;
-    g_appState.needsSave = false;
+int FindTab(uint64_t id) {
+    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+        if (g_appState.tabs[i].id == id) return i;
+    }
+    return -1;
+}
 
-    for (const auto& t : g_appState.tabs) {
-        if (t.isModified) {
-            g_appState.needsSave = true;
-            break;
+// Selects [column, column + length) on line, clamped to the text, and scrolls to it.
+static void JumpToLine(FileTab& tab, size_t line, size_t column, size_t length) {
+    const Document& doc = tab.document;
+    line = std::min(line, doc.LineCount() - 1);
+    size_t end = doc.LineEnd(line);
+    size_t start = std::min(doc.LineStart(line) + column, end);
+    tab.view.anchor = start;
+    tab.view.cursor = std::min(start + length, end);
+    tab.view.preferredColumn = (size_t)-1;
+    tab.view.scrollToCursor = true;
+    tab.view.focusRequested = true;
+}
+
+// A tab just opened from a file, whose first read hasn't come back: if that read
+// fails or is cancelled there is nothing to keep. Stubs and untitled tabs don't count.
+static bool NeverLoaded(const FileTab& tab) {
+    return !tab.stub && !tab.journal && !tab.isModified && !tab.filePath.empty() &&
+           tab.document.Generation() == 0;
+}
+
+// Runs on the UI thread once a background load is done. The tab may have been
+// closed or the load cancelled in the meantime; the result is then just dropped.
+static void FinishLoad(uint64_t tabId, const std::shared_ptr<LoadProgress>& progress, LoadedFile& result) {
+    // Cancelled at shutdown, while saves drain: the tab must stay as the journal knows it.
+    if (progress->cancelled) return;
+    int index = FindTab(tabId);
+    if (index < 0) return;
+    FileTab& tab = g_appState.tabs[index];
+    bool reload = tab.reloading == progress;
+    if (!reload && tab.loading != progress) return;
+
+    if (reload) {
+        tab.reloading.reset();
+    } else {
+        tab.loading.reset();
+    }
+    if (!result.ok) {
+        std::cerr << "Failed to load: " << tab.filePath << "\n";
+        // A tab that never had content is useless; a stub stays one until the user
+        // retries; a failed revert keeps the old text.
+        if (NeverLoaded(tab)) {
+            CloseTab(index);
+            return;
         }
+        if (tab.stub) {
+            tab.loadError = "Cannot read " + tab.filePath;
+            tab.closeAfterSave = false;
+            return;
+        }
+        if (!reload && tab.reloadChosen) {
+            tab.reloadChosen = false;
+            tab.changedOnDisk = true;
+        }
+        if (tab.truncatedOnDisk) tab.changedOnDisk = true;    // the text can't stay as it is
+        return;
     }
-    
-    if (fs::exists(filepath)) {
-        g_appState.tabs[tabIndex].lastModified = fs::last_write_time(filepath);
+    if (!reload) tab.reloadChosen = false;
+    if (reload && tab.isModified) {
+        // Edited while the reload ran: the edits win until the user says otherwise.
+        tab.changedOnDisk = true;
+        tab.diskChanged = result.disk;
+        if (tab.diskRecheck) CheckTabOnDisk(tab);
+        return;
+    }
+
+    if (tab.stub) {
+        // The view saved with the session only fits the file it was saved with.
+        if (result.disk.size != tab.disk.size || result.disk.modified != tab.disk.modified) {
+            tab.view.cursor = tab.view.anchor = 0;
+            tab.view.topLine = 0.0;
+        }
+        tab.stub = false;
+    }
+
+    // A revert is one more step of history, undone like any other; the text it
+    // replaced stays referenced, not copied.
+    if (tab.document.Generation() != 0) RecordDocumentRewrite(tab.document, tab.view, result.buffer->size);
+    tab.document.SetOriginal(std::move(result.buffer));
+    tab.format = result.format;
+    tab.view.newline = InsertedNewline(tab.format);
+    tab.stats = result.stats;
+    tab.disk = result.disk;
+    tab.loadedBuffer = tab.document.Buffers().front().get();
+    tab.loadedDisk = result.disk;
+    tab.deletedOnDisk = false;
+    tab.changedOnDisk = false;
+    tab.truncatedOnDisk = false;
+    tab.isModified = false;
+    tab.savedGeneration = tab.document.Generation();
+    if (index == g_appState.activeTab && !reload) tab.view.focusRequested = true;
+    if (tab.jumpLine != (size_t)-1) {
+        JumpToLine(tab, tab.jumpLine, tab.jumpColumn, tab.jumpLength);
+        tab.jumpLine = (size_t)-1;
+    }
+    if (!tab.queuedSavePath.empty() && !tab.saving) {
+        std::string next = std::move(tab.queuedSavePath);
+        tab.queuedSavePath.clear();
+        BeginSave(tab, next);
+    } else if (tab.diskRecheck) {
+        CheckTabOnDisk(tab);
     }
-    
-    std::cout << "Saved As: " << filepath << "\n";
 }
 
-void SaveAll() {
-    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
-        if (g_appState.tabs[i].isModified) {
-            SaveFile(i);
+// Read tab.filePath on a worker. The buffer is built there and only its pointer
+// crosses back to the UI thread. A background reload leaves the tab showing and
+// editing its current text until the new one arrives.
+static void BeginLoad(FileTab& tab, bool background = false) {
+    if (tab.loading) tab.loading->cancelled = true;
+    if (tab.reloading) tab.reloading->cancelled = true;
+    tab.reloading.reset();
+    auto progress = std::make_shared<LoadProgress>();
+    (background ? tab.reloading : tab.loading) = progress;
+
+    uint64_t tabId = tab.id;
+    std::string filepath = tab.filePath;
+    Jobs().Submit([tabId, filepath, progress] {
+        PROFILE_ZONE("LoadFile");
+        MEMORY_SCOPE(MemoryTag::Documents);
+        auto result = std::make_shared<LoadedFile>(LoadFile(filepath, progress.get()));
+        Jobs().PostToMain([tabId, progress, result] { FinishLoad(tabId, progress, *result); });
+    });
+}
+
+static void FinishDiskCheck(uint64_t tabId, const std::string& filepath, DiskChange change,
+                            const FileFingerprint& now) {
+    int index = FindTab(tabId);
+    if (index < 0) return;
+    FileTab& tab = g_appState.tabs[index];
+    tab.diskCheck = false;
+    if (tab.diskRecheck || tab.filePath != filepath) {
+        CheckTabOnDisk(tab);
+        return;
+    }
+
+    switch (change) {
+    case DiskChange::None:
+        break;
+    case DiskChange::Touched:
+        tab.disk = now;
+        break;
+    case DiskChange::Deleted:
+        tab.deletedOnDisk = true;
+        break;
+    case DiskChange::Changed:
+        tab.deletedOnDisk = false;
+        if (tab.isModified) {
+            tab.changedOnDisk = true;
+            tab.diskChanged = now;
+        } else {
+            BeginLoad(tab, true);
         }
+        break;
     }
+    RequestFrame();
 }
 
-void OpenFile(const std::string& filepath) {
-    if (filepath.empty()) return;
-    
-    if (!fs::exists(filepath)) {
-        std::cerr << "File does not exist: " << filepath << "\n";
+// Compare the tab's file with what it last loaded or saved, on a worker. Busy tabs
+// check again once their load or save is done, since that changes the baseline.
+static void CheckTabOnDisk(FileTab& tab) {
+    if (tab.filePath.empty() || tab.stub) return;
+    if (tab.loading || tab.reloading || tab.saving || tab.diskCheck) {
+        tab.diskRecheck = true;
         return;
     }
+    tab.diskCheck = true;
+    tab.diskRecheck = false;
+
+    uint64_t tabId = tab.id;
+    std::string filepath = tab.filePath;
+    FileFingerprint known = tab.changedOnDisk ? tab.diskChanged : tab.disk;
+    Jobs().Submit([tabId, filepath, known] {
+        PROFILE_ZONE("CheckFileOnDisk");
+        auto now = std::make_shared<FileFingerprint>();
+        DiskChange change = CheckFileOnDisk(filepath, known, *now);
+        Jobs().PostToMain([tabId, filepath, change, now] { FinishDiskCheck(tabId, filepath, change, *now); });
+    });
+}
+
+// Called by the watcher with files that may have changed on disk.
+static void OnFilesChanged(const std::vector<std::string>& paths) {
+    for (auto& tab : g_appState.tabs) {
+        if (std::find(paths.begin(), paths.end(), tab.filePath) != paths.end()) CheckTabOnDisk(tab);
+    }
+}
+
+// A file cut short under a tab's mapping leaves NULs in its text, which can be
+// neither saved nor journaled: a clean tab reloads, a modified one asks, with the
+// reload as its only answer.
+static void CheckMappingFaults() {
+    static uint64_t seen = 0;
+    uint64_t faults = MappingFaults();
+    if (faults == seen) return;
+    seen = faults;
+    for (auto& tab : g_appState.tabs) {
+        if (tab.truncatedOnDisk || tab.stub || tab.loading || tab.reloading) continue;
+        if (!tab.loadedBuffer || !tab.loadedBuffer->mapping || !tab.loadedBuffer->mapping->Faulted()) continue;
+        tab.truncatedOnDisk = true;
+        if (tab.isModified) {
+            tab.changedOnDisk = true;
+            tab.diskChanged = StatFile(tab.filePath);
+        } else {
+            BeginLoad(tab, true);
+        }
+    }
+}
+
+// The tab appears immediately in a loading state; several files can load at once.
+void OpenFile(const std::string& filepath) {
+    if (filepath.empty()) return;
+    g_inputRecorder.RecordOpenFile(filepath);
 
-    // Check if file is already open
+    // Check if file is already open (or still loading)
     for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
         if (g_appState.tabs[i].filePath == filepath) {
             g_appState.activeTab = i;
@@ -661,32 +1862,140 @@ void OpenFile(const std::string& filepath) {
 
     FileTab tab;
     tab.filePath = filepath;
+    tab.syntax.SetLanguage(LanguageForPath(filepath));
+    BeginLoad(tab);
+
+    g_appState.tabs.push_back(std::move(tab));
+    g_appState.activeTab = (int)g_appState.tabs.size() - 1;
+
+    g_appState.focusEditor = true;
+}
 
-    // call IsTextFile before reading content.
-    // Previously IsTextFile was defined but never invoked here, so binary files
-    // were opened and their raw bytes were dumped into the ImGui text buffer.
-    if (IsTextFile(filepath)) {
-        tab.content = ReadFileContent(filepath);
+// Open (or switch to) filepath and select a match in it; a file still loading, or
+// not loaded yet, gets the selection once its text arrives.
+void OpenFileAtLine(const std::string& filepath, size_t line, size_t column, size_t length) {
+    OpenFile(filepath);
+    int index = g_appState.activeTab;
+    if (index < 0 || g_appState.tabs[index].filePath != filepath) return;
+
+    FileTab& tab = g_appState.tabs[index];
+    if (tab.loading || tab.stub) {
+        tab.jumpLine = line;
+        tab.jumpColumn = column;
+        tab.jumpLength = length;
     } else {
-        tab.content = "[Binary file: " + filepath + "]\n"
-                      "[Size: " + std::to_string(fs::file_size(filepath)) + " bytes]\n\n"
-                      "This file appears to be binary and cannot be displayed as text.";
+        JumpToLine(tab, line, column, length);
     }
+}
 
-    tab.lastModified = fs::last_write_time(filepath);
-    tab.isReadonly = false;
-    tab.isModified = false;
-    UpdateFileStats(tab);
+// Runs on the UI thread once a journal has been read back on a worker. A tab that
+// can't get its unsaved text back, e.g. because its file changed on disk since,
+// stays a stub and keeps its journal until the user retries or discards it.
+static void FinishRestore(uint64_t tabId, const std::shared_ptr<LoadProgress>& progress, RestoredDocument& restored) {
+    int index = FindTab(tabId);
+    if (index < 0 || g_appState.tabs[index].loading != progress) return;
+
+    FileTab& tab = g_appState.tabs[index];
+    tab.loading.reset();
+    if (!restored.ok) {
+        std::cerr << "Cannot restore unsaved changes" << (tab.filePath.empty() ? "" : " of " + tab.filePath)
+                  << ": " << restored.error << "\n";
+        tab.queuedSavePath.clear();
+        tab.closeAfterSave = false;
+        tab.loadError = "Cannot restore unsaved changes: " + restored.error;
+        return;
+    }
 
-    g_appState.tabs.push_back(std::move(tab));
-    g_appState.activeTab = (int)g_appState.tabs.size() - 1;
+    tab.document = std::move(restored.document);
+    tab.format = restored.format;
+    tab.view.newline = InsertedNewline(tab.format);
+    tab.stats = restored.stats;
+    tab.disk = restored.disk;
+    tab.loadedDisk = restored.disk;
+    tab.loadedBuffer = restored.disk.exists ? tab.document.Buffers().front().get() : nullptr;
+    // A spilled tab still knows the file it loaded; a restored one only its size and time.
+    if (!restored.disk.exists && !tab.filePath.empty() && !tab.disk.hashed) tab.disk = StatFile(tab.filePath);
+    tab.savedGeneration = restored.baseGeneration;
+    tab.isModified = true;
+    tab.stub = false;
+    g_appState.needsSave = true;
+    // The journal may end in a torn record; start it over as one snapshot.
+    tab.journaledGeneration = 0;
+    if (index == g_appState.activeTab) tab.view.focusRequested = true;
+    if (tab.jumpLine != (size_t)-1) {
+        JumpToLine(tab, tab.jumpLine, tab.jumpColumn, tab.jumpLength);
+        tab.jumpLine = (size_t)-1;
+    }
+    if (!tab.queuedSavePath.empty() && !tab.saving) {
+        std::string next = std::move(tab.queuedSavePath);
+        tab.queuedSavePath.clear();
+        BeginSave(tab, next);
+    }
+    // The file wasn't watched while the tab was a stub.
+    CheckTabOnDisk(tab);
+}
+
+// Read a restored tab's text on a worker: rebuilt from its journal if it had unsaved
+// text, else loaded like any file. It stays a stub until the text arrives.
+static void MaterializeTab(FileTab& tab) {
+    if (!tab.stub || tab.loading) return;
+    tab.loadError.clear();
+    if (!tab.journal) {
+        BeginLoad(tab);
+        return;
+    }
+    auto progress = std::make_shared<LoadProgress>();
+    tab.loading = progress;
+
+    uint64_t tabId = tab.id;
+    uint64_t journal = tab.journal;
+    Jobs().Submit([tabId, journal, progress] {
+        PROFILE_ZONE("RestoreTab");
+        auto restored = std::make_shared<RestoredDocument>(g_sessionJournal.ReadJournal(journal));
+        Jobs().PostToMain([tabId, progress, restored] { FinishRestore(tabId, progress, *restored); });
+    });
+}
 
+// Reopen the tabs of the last session, in order, as stubs: a path, the file's size
+// and time, and where the view was. Nothing is read until a tab is first activated,
+// so startup costs the same however many tabs there were; only the active tab
+// starts loading right away.
+static void RestoreSession() {
+    SessionManifest manifest;
+    if (!g_sessionJournal.ReadManifest(manifest)) return;
+    int active = 0;
+    for (size_t i = 0; i < manifest.tabs.size(); ++i) {
+        const SessionTab& saved = manifest.tabs[i];
+        if (saved.path.empty() && !saved.journal) continue;
+        if ((int)i == manifest.activeTab) active = (int)g_appState.tabs.size();
+        FileTab tab;
+        tab.stub = true;
+        tab.filePath = saved.path;
+        tab.syntax.SetLanguage(LanguageForPath(saved.path));
+        tab.journal = saved.journal;
+        tab.isModified = saved.journal != 0;
+        tab.disk.exists = !saved.path.empty();
+        tab.disk.size = saved.size;
+        tab.disk.modified = fs::file_time_type(fs::file_time_type::duration(saved.modified));
+        tab.view.cursor = saved.cursor;
+        tab.view.anchor = saved.anchor;
+        tab.view.topLine = saved.topLine;
+        g_appState.tabs.push_back(std::move(tab));
+    }
+    if (g_appState.tabs.empty()) return;
+    g_appState.activeTab = active;
+    MaterializeTab(g_appState.tabs[active]);
+    RefreshNeedsSave();
     g_appState.focusEditor = true;
 }
 
 void CloseTab(int tabIndex) {
     if (tabIndex < 0 || tabIndex >= (int)g_appState.tabs.size()) return;
 
+    FileTab& closing = g_appState.tabs[tabIndex];
+    if (closing.loading) closing.loading->cancelled = true;
+    if (closing.reloading) closing.reloading->cancelled = true;
+
     g_appState.tabs.erase(g_appState.tabs.begin() + tabIndex);
     
     if (g_appState.tabs.empty()) {
@@ -793,6 +2102,29 @@ void SetupInitialStyle() {
     colors[ImGuiCol_PlotLines]            = ImVec4(0.76f, 0.87f, 0.00f, 1.00f);
     colors[ImGuiCol_PlotLinesHovered]     = ImVec4(1.00f, 0.88f, 0.05f, 1.00f);
     colors[ImGuiCol_DockingPreview]       = ImVec4(0.67f, 0.67f, 0.68f, 0.70f);
+
+    SetupSyntaxColors(THEME_GREY);
+}
+
+// Editor token colors to go with a theme's text and background.
+void SetupSyntaxColors(ThemeType theme) {
+    ImVec4* colors = g_syntaxColors;
+
+    if (theme == THEME_LIGHT) {
+        colors[(int)TokenKind::Keyword]      = ImVec4(0.00f, 0.20f, 0.70f, 1.00f);
+        colors[(int)TokenKind::Type]         = ImVec4(0.15f, 0.45f, 0.55f, 1.00f);
+        colors[(int)TokenKind::Number]       = ImVec4(0.05f, 0.50f, 0.30f, 1.00f);
+        colors[(int)TokenKind::String]       = ImVec4(0.64f, 0.08f, 0.08f, 1.00f);
+        colors[(int)TokenKind::Comment]      = ImVec4(0.40f, 0.50f, 0.40f, 1.00f);
+        colors[(int)TokenKind::Preprocessor] = ImVec4(0.55f, 0.25f, 0.60f, 1.00f);
+    } else {
+        colors[(int)TokenKind::Keyword]      = ImVec4(0.80f, 0.56f, 0.96f, 1.00f);
+        colors[(int)TokenKind::Type]         = ImVec4(0.45f, 0.80f, 0.90f, 1.00f);
+        colors[(int)TokenKind::Number]       = ImVec4(0.96f, 0.72f, 0.45f, 1.00f);
+        colors[(int)TokenKind::String]       = ImVec4(0.65f, 0.85f, 0.50f, 1.00f);
+        colors[(int)TokenKind::Comment]      = ImVec4(0.50f, 0.48f, 0.56f, 1.00f);
+        colors[(int)TokenKind::Preprocessor] = ImVec4(0.95f, 0.55f, 0.60f, 1.00f);
+    }
 }
 
 void ThemeEditorMenu() {
@@ -819,6 +2151,17 @@ void ThemeEditorMenu() {
         ImGui::ColorEdit4(name, (float*)&style.Colors[i]);
     }
 
+    // Editor token colors; plain text follows the Text color above.
+    ImGui::SeparatorText("Syntax");
+    for (int i = (int)TokenKind::Text + 1; i < (int)TokenKind::Count; i++) {
+        const char* name = TokenKindName((TokenKind)i);
+
+        if (!filter.PassFilter(name))
+            continue;
+
+        ImGui::ColorEdit4(name, (float*)&g_syntaxColors[i]);
+    }
+
     ImGui::EndChild();
 
     if (ImGui::Button("Reset Changes")) {
@@ -827,12 +2170,16 @@ void ThemeEditorMenu() {
         for (int i = 0; i < ImGuiCol_COUNT; i++) {
             style.Colors[i] = originalThemeColors[i];
         }
+        for (int i = 0; i < (int)TokenKind::Count; i++) {
+            g_syntaxColors[i] = originalSyntaxColors[i];
+        }
     }
 
     ImGui::End();
 }
 
 void HandleKeyboardShortcuts() {
+    PROFILE_ZONE("HandleKeyboardShortcuts");
     ImGuiIO& io = ImGui::GetIO();
 
     // Do NOT bail out when io.WantTextInput is true.
@@ -842,14 +2189,38 @@ void HandleKeyboardShortcuts() {
     // Pure text input (non-modifier keys) is handled by ImGui widgets themselves,
     // so no filtering is needed here.
 
-    // Ctrl+F - Open Folder
-    if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_F, false)) {
+    // Ctrl+Shift+O - Open Folder
+    if (io.KeyCtrl && io.KeyShift && ImGui::IsKeyPressed(ImGuiKey_O, false)) {
         std::string folderpath = OpenFolderDialog();
         if (!folderpath.empty()) OpenFolder(folderpath);
     }
+
+    // Ctrl+F / Ctrl+H - Find / replace in the active tab
+    if (io.KeyCtrl && !io.KeyShift && ImGui::IsKeyPressed(ImGuiKey_F, false)) {
+        OpenFindBar(false);
+    }
+    if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_H, false)) {
+        OpenFindBar(true);
+    }
+
+    // F3 / Shift+F3 - Next / previous match
+    if (g_appState.showFindBar && ImGui::IsKeyPressed(ImGuiKey_F3)) {
+        if (FileTab* tab = ActiveLoadedTab()) FindNext(*tab, io.KeyShift);
+    }
+
+    // Ctrl+Shift+F - Find in Files
+    if (io.KeyCtrl && io.KeyShift && ImGui::IsKeyPressed(ImGuiKey_F, false)) {
+        g_appState.showFindInFiles = true;
+        g_appState.focusFindQuery = true;
+    }
     
+    // Ctrl+P - Quick open
+    if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_P, false)) {
+        OpenQuickOpen();
+    }
+
     // Ctrl+O - Open File
-    if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_O, false)) {
+    if (io.KeyCtrl && !io.KeyShift && ImGui::IsKeyPressed(ImGuiKey_O, false)) {
         std::string filepath = OpenFileDialog();
         if (!filepath.empty()) OpenFile(filepath);
     }
@@ -858,7 +2229,6 @@ void HandleKeyboardShortcuts() {
     if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_N, false)) {
         FileTab t;
         t.filePath = "";
-        t.content = "";
         t.isModified = false;
         g_appState.tabs.push_back(std::move(t));
         g_appState.activeTab = (int)g_appState.tabs.size() - 1;
@@ -898,8 +2268,9 @@ void SetupInitialDockingLayout() {
         ImGui::DockBuilderSetNodeSize(dockspace_id, ImGui::GetMainViewport()->WorkSize);
         
         ImGuiID dock_main_id = dockspace_id;
-        ImGuiID dock_left, dock_right;
+        ImGuiID dock_left, dock_right, dock_bottom;
         ImGui::DockBuilderSplitNode(dock_main_id, ImGuiDir_Left, 0.20f, &dock_left, &dock_right);
+        ImGui::DockBuilderSplitNode(dock_right, ImGuiDir_Down, 0.25f, &dock_bottom, &dock_right);
 
         // Previously, I claimed a top/bottom split was performed, but dock_right was
         // never actually split — both "Files" and "Editor" were placed into the same node,
@@ -908,12 +2279,16 @@ void SetupInitialDockingLayout() {
 
         ImGui::DockBuilderDockWindow("Explorer", dock_left);
         ImGui::DockBuilderDockWindow("Editor",   dock_right);
+        ImGui::DockBuilderDockWindow("Find in Files", dock_bottom);
+        ImGui::DockBuilderDockWindow("Profiler", dock_bottom);
+        ImGui::DockBuilderDockWindow("Memory", dock_bottom);
 
         ImGui::DockBuilderFinish(dockspace_id);
     }
 }
 
 void RenderMainDockSpace() {
+    PROFILE_ZONE("RenderMainDockSpace");
     ImGuiViewport* viewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(viewport->WorkPos);
     ImGui::SetNextWindowSize(viewport->WorkSize);
@@ -947,14 +2322,18 @@ void RenderMainDockSpace() {
 }
 
 void RenderMenuBar() {
+    PROFILE_ZONE("RenderMenuBar");
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("File")) {
-            if (ImGui::MenuItem("Open Folder", "Ctrl+F")) {
+            if (ImGui::MenuItem("Open Folder", "Ctrl+Shift+O")) {
                 std::string folder = OpenFolderDialog();
                 if (!folder.empty()) {
                     OpenFolder(folder);
                 }
             }
+            if (ImGui::MenuItem("Quick Open...", "Ctrl+P")) {
+                OpenQuickOpen();
+            }
             if (ImGui::MenuItem("Open File", "Ctrl+O")) {
                 std::string path = OpenFileDialog();
                 if (!path.empty()) OpenFile(path);
@@ -964,7 +2343,6 @@ void RenderMenuBar() {
             if (ImGui::MenuItem("New File", "Ctrl+N")) {
                 FileTab t;
                 t.filePath = "";
-                t.content = "";
                 t.isModified = false;
                 g_appState.tabs.push_back(std::move(t));
                 g_appState.activeTab = (int)g_appState.tabs.size() - 1;
@@ -987,20 +2365,35 @@ void RenderMenuBar() {
                 // glfwGetCurrentContext() returns the OpenGL context, not necessarily the
                 // GLFW window we want to close — they can diverge when viewports are active
                 // and ImGui temporarily switches contexts for secondary windows.
-                glfwSetWindowShouldClose(g_window, GLFW_TRUE);
+                if (g_window) glfwSetWindowShouldClose(g_window, GLFW_TRUE);    // none in headless replay
             }
 
             ImGui::EndMenu();
         }
 
         if (ImGui::BeginMenu("View")) {
+            if (ImGui::MenuItem("Find", "Ctrl+F", false, g_appState.activeTab >= 0)) {
+                OpenFindBar(false);
+            }
+            if (ImGui::MenuItem("Replace", "Ctrl+H", false, g_appState.activeTab >= 0)) {
+                OpenFindBar(true);
+            }
+            if (ImGui::MenuItem("Find in Files", "Ctrl+Shift+F", g_appState.showFindInFiles)) {
+                g_appState.showFindInFiles = true;
+                g_appState.focusFindQuery = true;
+            }
+            ImGui::MenuItem("Frame Counter", nullptr, &g_appState.showFrameStats);
+            ImGui::MenuItem("Profiler", nullptr, &g_appState.showProfiler);
+            ImGui::MenuItem("Memory", nullptr, &g_appState.showMemory);
             if (ImGui::BeginMenu("Theme")) {
                 if (ImGui::MenuItem("Dark", nullptr, currentTheme == THEME_DARK)) {
                     ImGui::StyleColorsDark();
+                    SetupSyntaxColors(THEME_DARK);
                     currentTheme = THEME_DARK;
                 }
                 if (ImGui::MenuItem("Light", nullptr, currentTheme == THEME_LIGHT)) {
                     ImGui::StyleColorsLight();
+                    SetupSyntaxColors(THEME_LIGHT);
                     currentTheme = THEME_LIGHT;
                 }
                 if (ImGui::MenuItem("Grey", nullptr, currentTheme == THEME_GREY)) {
@@ -1015,6 +2408,9 @@ void RenderMenuBar() {
                         for (int i = 0; i < ImGuiCol_COUNT; i++) {
                             originalThemeColors[i] = style.Colors[i];
                         }
+                        for (int i = 0; i < (int)TokenKind::Count; i++) {
+                            originalSyntaxColors[i] = g_syntaxColors[i];
+                        }
 
                         themeBackupSaved = true;
                     }
@@ -1034,6 +2430,14 @@ void RenderMenuBar() {
             ImGui::EndMenu();
         }
 
+        if (g_appState.showFrameStats) {
+            char stats[64];
+            snprintf(stats, sizeof(stats), "Frames: %llu drawn | %llu skipped",
+                     (unsigned long long)g_frameStats.rendered, (unsigned long long)g_frameStats.skipped);
+            ImGui::SetCursorPosX(ImGui::GetWindowWidth() - 180 - ImGui::CalcTextSize(stats).x);
+            ImGui::TextDisabled("%s", stats);
+        }
+
         if (g_appState.needsSave) {
             ImGui::SetCursorPosX(ImGui::GetWindowWidth() - 160);
             ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "[Unsaved Changes]");
@@ -1044,6 +2448,7 @@ void RenderMenuBar() {
 }
 
 void RenderEditor() {
+    PROFILE_ZONE("RenderEditor");
     ImGui::Begin("Editor");
 
     // Render tab bar at the top
@@ -1097,6 +2502,10 @@ void RenderEditor() {
 
     if (g_appState.activeTab >= 0 && g_appState.activeTab < (int)g_appState.tabs.size()) {
         FileTab &tab = g_appState.tabs[g_appState.activeTab];
+        // A tab restored from the session is read the first time it is shown.
+        if (tab.stub && tab.loadError.empty()) MaterializeTab(tab);
+
+        if (g_appState.showFindBar && !tab.loading && !tab.stub) RenderFindBar(tab);
 
         ImVec2 availSize = ImGui::GetContentRegionAvail();
         // Clamp editor height so it cannot go negative when the panel is
@@ -1105,44 +2514,69 @@ void RenderEditor() {
 
         // Only set keyboard focus when switching tabs, not every frame
         if (g_appState.activeTab != g_appState.lastActiveTab) {
-            ImGui::SetKeyboardFocusHere();
+            tab.view.focusRequested = true;
             g_appState.lastActiveTab = g_appState.activeTab;
         }
 
-        // Use resize() instead of reserve() so that size() == capacity() and
-        // ImGui can safely write up to capacity()-1 bytes via the data() pointer.
-        // reserve() only allocates memory without extending size(), making writes past
-        // size() undefined behavior even though the memory is technically allocated.
-        const size_t requiredCapacity = std::max(tab.content.size() * 2 + 1, size_t(4096));
-        if (tab.editBuffer.size() < requiredCapacity) {
-            tab.editBuffer.resize(requiredCapacity, '\0');
-            std::copy(tab.content.begin(), tab.content.end(), tab.editBuffer.begin());
-            tab.editBuffer[tab.content.size()] = '\0';
-        } else if (tab.editBuffer.empty() ||
-                   std::string(tab.editBuffer.data()) != tab.content) {
-            // Re-sync if content was changed externally (e.g. Revert).
-            std::copy(tab.content.begin(), tab.content.end(), tab.editBuffer.begin());
-            tab.editBuffer[tab.content.size()] = '\0';
-        }
-
-        ImGuiInputTextFlags flags = ImGuiInputTextFlags_AllowTabInput;
-
-        if (ImGui::InputTextMultiline(
-                "##editor",
-                tab.editBuffer.data(),
-                tab.editBuffer.size(),   // pass size(), not capacity()
-                availSize,
-                flags))
-        {
-            std::string newContent(tab.editBuffer.data());
-            if (newContent != tab.content) {
-                tab.content = newContent;
-                tab.isModified = true;
-                g_appState.needsSave = true;
-                UpdateFileStats(tab);
+        if (tab.loading) {
+            // Nothing to edit yet: show how far the worker has got.
+            RequestFrameIn(1.0 / 30.0);
+            ImGui::SetCursorPosY(ImGui::GetCursorPosY() + availSize.y * 0.4f);
+            ImGui::Text("Loading %s...", fs::path(tab.filePath).filename().string().c_str());
+            ImGui::ProgressBar(tab.loading->Fraction(), ImVec2(-FLT_MIN, 0));
+            if (ImGui::Button("Cancel", ImVec2(100, 0))) {
+                tab.loading->cancelled = true;
+                tab.loading.reset();
+                // Only a tab that never had text goes; a stub, and any unsaved text
+                // in its journal, stays until the user closes it.
+                if (NeverLoaded(tab)) {
+                    CloseTab(g_appState.activeTab);
+                } else if (tab.stub) {
+                    tab.loadError = "Loading cancelled";
+                    tab.closeAfterSave = false;
+                } else if (tab.reloadChosen) {
+                    tab.reloadChosen = false;
+                    tab.changedOnDisk = true;
+                }
+            }
+            ImGui::End();
+            return;
+        }
+        if (tab.stub) {
+            // Its read failed: nothing was dropped, and the next attempt starts over.
+            ImGui::SetCursorPosY(ImGui::GetCursorPosY() + availSize.y * 0.4f);
+            ImGui::Text("%s is not loaded.", tab.filePath.empty() ? "This tab"
+                        : fs::path(tab.filePath).filename().string().c_str());
+            ImGui::TextDisabled("%s", tab.loadError.c_str());
+            if (ImGui::Button("Retry", ImVec2(100, 0))) MaterializeTab(tab);
+            if (tab.journal) {
+                ImGui::SameLine();
+                if (ImGui::Button("Discard Unsaved Changes")) {
+                    g_sessionJournal.Discard(tab.journal);
+                    tab.journal = 0;
+                    tab.isModified = false;
+                    RefreshNeedsSave();
+                    if (tab.filePath.empty()) {
+                        CloseTab(g_appState.activeTab);
+                    } else {
+                        MaterializeTab(tab);
+                    }
+                }
             }
+            ImGui::End();
+            return;
         }
 
+        // The widget reports each edit as a replace; the document stays the only copy.
+        TextEditFn applyEdit = [&tab](size_t pos, size_t removeLen, const char* text, size_t len,
+                                      const DocumentSnapshot* pieces) {
+            ApplyTabEdit(tab, pos, removeLen, text, len, pieces);
+        };
+        size_t syntaxThrough = (size_t)tab.view.topLine + kSyntaxLookaheadLines;
+        if (!tab.syntax.Update(tab.document, syntaxThrough, kSyntaxSliceBytes)) RequestFrame();
+        TextView("##editor", tab.document, tab.view, availSize, applyEdit, tab.isReadonly,
+                 tab.search.Active() ? &tab.search.Matches() : nullptr, &tab.syntax);
+
         ImGui::Separator();
 
         if (ImGui::Button("Save", ImVec2(100, 0))) {
@@ -1154,22 +2588,48 @@ void RenderEditor() {
         }
         ImGui::SameLine();
         if (ImGui::Button("Revert", ImVec2(100, 0))) {
-            if (!tab.filePath.empty() && fs::exists(tab.filePath)) {
-                tab.content = ReadFileContent(tab.filePath);
-                tab.lastModified = fs::last_write_time(tab.filePath);
-                tab.isModified = false;
-                tab.editBuffer.clear(); // Clear buffer to force re-sync next frame
-                UpdateFileStats(tab);
+            if (!tab.filePath.empty()) {
+                BeginLoad(tab);
             } else {
-                tab.content.clear();
+                RecordDocumentRewrite(tab.document, tab.view, 0);
+                tab.document.SetText(std::string());
+                tab.loadedBuffer = nullptr;
+                tab.format = FileFormat();
+                tab.view.newline = InsertedNewline(tab.format);
                 tab.isModified = false;
-                tab.editBuffer.clear();
+                tab.savedGeneration = tab.document.Generation();
                 UpdateFileStats(tab);
             }
         }
 
         ImGui::SameLine();
-        ImGui::Text("Words: %d | Characters: %zu", tab.cachedWordCount, tab.cachedCharCount);
+        ImGui::Text("Words: %llu | Characters: %llu | Lines: %llu | %s | %s%s",
+                    (unsigned long long)tab.stats.words, (unsigned long long)tab.stats.chars,
+                    (unsigned long long)tab.stats.Lines(), LineEndingName(tab.format.eol),
+                    LanguageName(tab.syntax.Language()), tab.format.mapped ? " | [mapped]" : "");
+        ImGui::SameLine();
+        ImGui::TextDisabled("| Tabs: %.0f / %.0f MB", g_appState.tabMemory / (1024.0 * 1024.0),
+                            g_tabMemoryBudget / (1024.0 * 1024.0));
+        if (tab.saving) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("Saving...");
+        }
+        if (tab.reloading) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("Reloading...");
+        }
+        if (tab.deletedOnDisk) {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.9f, 0.6f, 0.2f, 1.0f), "Deleted on disk");
+        }
+        if (!tab.saveError.empty()) {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "Save failed: %s", tab.saveError.c_str());
+        }
+        if (tab.journal && g_sessionJournal.Status(tab.journal).Failing()) {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "Unsaved changes not backed up");
+        }
 
     } else {
         ImVec2 windowSize = ImGui::GetWindowSize();
@@ -1181,7 +2641,6 @@ void RenderEditor() {
         if (ImGui::Button("New File", ImVec2(140, 0))) {
             FileTab t;
             t.filePath = "";
-            t.content = "";
             t.isModified = false;
             g_appState.tabs.push_back(std::move(t));
             g_appState.activeTab = (int)g_appState.tabs.size() - 1;
@@ -1221,24 +2680,32 @@ void RenderSimpleFileBrowser() {
         ImGui::Separator();
 
         ImGui::BeginChild("FileList", ImVec2(0, -60));
-        try {
-            for (const auto& entry : fs::directory_iterator(g_appState.currentPath)) {
-                std::string name = entry.path().filename().string();
-                if (entry.is_directory()) {
-                    if (ImGui::Selectable(("[DIR] " + name).c_str())) {
-                        g_appState.currentPath = entry.path().string();
-                    }
-                } else {
-                    if (ImGui::Selectable(name.c_str())) {
-                        strncpy(g_appState.filePathBuffer, entry.path().string().c_str(), 
-                               sizeof(g_appState.filePathBuffer) - 1);
-                        g_appState.filePathBuffer[sizeof(g_appState.filePathBuffer) - 1] = '\0';
-                    }
+        if (g_browserTree.RootPath() != g_appState.currentPath) g_browserTree.SetRoot(g_appState.currentPath);
+        g_browserTree.Request(ProjectTree::kRoot);
+        const ProjectTree::Node& dir = g_browserTree.GetNode(ProjectTree::kRoot);
+        if (dir.state == ProjectTree::ScanState::Failed) {
+            ImGui::Text("Error reading directory: %s", dir.error.c_str());
+        }
+        std::string nextPath;
+        for (uint32_t child : dir.children) {
+            const ProjectTree::Node& entry = g_browserTree.GetNode(child);
+            ImGui::PushID((int)child);
+            if (entry.isDirectory) {
+                ImGui::TextDisabled("[DIR]");
+                ImGui::SameLine();
+                if (ImGui::Selectable(entry.name.c_str())) {
+                    nextPath = entry.path;  // switching roots frees these nodes; do it after the loop
+                }
+            } else {
+                if (ImGui::Selectable(entry.name.c_str())) {
+                    strncpy(g_appState.filePathBuffer, entry.path.c_str(),
+                           sizeof(g_appState.filePathBuffer) - 1);
+                    g_appState.filePathBuffer[sizeof(g_appState.filePathBuffer) - 1] = '\0';
                 }
             }
-        } catch (const std::exception& e) {
-            ImGui::Text("Error reading directory: %s", e.what());
+            ImGui::PopID();
         }
+        if (!nextPath.empty()) g_appState.currentPath = nextPath;
         ImGui::EndChild();
 
         ImGui::Separator();
@@ -1262,6 +2729,7 @@ void RenderSimpleFileBrowser() {
 }
 
 void RenderDialogs() {
+    PROFILE_ZONE("RenderDialogs");
     if (g_appState.closeTabIndex >= 0) {
         ImGui::OpenPopup("Unsaved Changes");
     }
@@ -1273,8 +2741,12 @@ void RenderDialogs() {
         
         if (ImGui::Button("Save", ImVec2(120, 0))) {
             if (g_appState.closeTabIndex >= 0 && g_appState.closeTabIndex < (int)g_appState.tabs.size()) {
+                // The tab closes when the save succeeds (FinishSave), after a restored
+                // tab's text is back. A failed save or a cancelled Save As keeps it.
+                FileTab& tab = g_appState.tabs[g_appState.closeTabIndex];
+                tab.closeAfterSave = true;
                 SaveFile(g_appState.closeTabIndex);
-                CloseTab(g_appState.closeTabIndex);
+                if (!tab.saving && tab.queuedSavePath.empty()) tab.closeAfterSave = false;
             }
             g_appState.closeTabIndex = -1;
             ImGui::CloseCurrentPopup();
@@ -1298,6 +2770,48 @@ void RenderDialogs() {
         ImGui::EndPopup();
     }
 
+    // One tab at a time; the prompt stays until the user picks a version.
+    FileTab* conflict = nullptr;
+    for (auto& tab : g_appState.tabs) {
+        if (tab.changedOnDisk && !tab.loading) {
+            conflict = &tab;
+            break;
+        }
+    }
+    if (conflict && !ImGui::IsPopupOpen("File Changed on Disk")) ImGui::OpenPopup("File Changed on Disk");
+    if (ImGui::BeginPopupModal("File Changed on Disk", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        if (!conflict) {
+            ImGui::CloseCurrentPopup();
+        } else {
+            std::string name = fs::path(conflict->filePath).filename().string();
+            if (conflict->truncatedOnDisk) {
+                ImGui::Text("%s was cut short by another program.", name.c_str());
+                ImGui::Text("Part of its text here went with it, so it has to be reloaded.");
+            } else {
+                ImGui::Text("%s was changed by another program.", name.c_str());
+                ImGui::Text("It also has unsaved changes here. Which version do you want to keep?");
+            }
+            ImGui::TextDisabled("Reloading keeps your changes in the undo history.");
+            ImGui::Separator();
+
+            if (ImGui::Button("Reload from Disk", ImVec2(160, 0))) {
+                // Settled while the file is read, or the prompt would reopen next frame.
+                conflict->changedOnDisk = false;
+                conflict->reloadChosen = true;
+                BeginLoad(*conflict);
+                ImGui::CloseCurrentPopup();
+            }
+            ImGui::SameLine();
+            if (!conflict->truncatedOnDisk && ImGui::Button("Keep Mine", ImVec2(160, 0))) {
+                // The next save overwrites the file without asking again.
+                conflict->disk = conflict->diskChanged;
+                conflict->changedOnDisk = false;
+                ImGui::CloseCurrentPopup();
+            }
+        }
+        ImGui::EndPopup();
+    }
+
     if (g_appState.showAboutDialog) {
         ImGui::OpenPopup("About Edifier");
         g_appState.showAboutDialog = false;
@@ -1321,8 +2835,11 @@ void RenderDialogs() {
         
         ImGui::Separator();
         ImGui::Text("Keyboard Shortcuts:");
-        ImGui::BulletText("Ctrl+F: Open folders");
+        ImGui::BulletText("Ctrl+Shift+O: Open folders");
+        ImGui::BulletText("Ctrl+F / Ctrl+H: Find / replace in file");
         ImGui::BulletText("Ctrl+O: Open file");
+        ImGui::BulletText("Ctrl+P: Quick open");
+        ImGui::BulletText("Ctrl+Shift+F: Find in files");
         ImGui::BulletText("Ctrl+N: New file");
         ImGui::BulletText("Ctrl+S: Save");
         ImGui::BulletText("Ctrl+Shift+S: Save as");
@@ -1340,7 +2857,518 @@ void RenderDialogs() {
 }
 
 
-int main() {
+// ImGui repeats held keys on frame time, so it needs frames while one is down.
+// Modifiers don't repeat and are often held while doing nothing.
+static bool AnyRepeatingKeyDown() {
+    for (int key = ImGuiKey_Tab; key < ImGuiKey_GamepadStart; ++key) {
+        if (key >= ImGuiKey_LeftCtrl && key <= ImGuiKey_RightSuper) continue;
+        if (ImGui::IsKeyDown((ImGuiKey)key)) return true;
+    }
+    return false;
+}
+
+// Dear ImGui context, fonts and style. Multi-viewports need a platform backend, so
+// headless replay goes without them.
+static void CreateImGuiContext(bool viewports) {
+    IMGUI_CHECKVERSION();
+#if EDIFIER_MEMORY_STATS
+    ImGui::SetAllocatorFunctions(ImGuiAlloc, ImGuiFree);
+#endif
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+
+    io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    if (viewports) io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+    io.ConfigInputTextCursorBlink = false;  // would need a frame every blink; the editor caret still blinks
+
+    {
+        MEMORY_SCOPE(MemoryTag::Fonts);
+        ImFont* defaultFont = io.Fonts->AddFontDefault();
+
+        ImFont* mainFont = io.Fonts->AddFontFromFileTTF("fonts/JetBrainsMonoNerdFontMono-Bold.ttf", 16.0f);
+
+        io.FontDefault = mainFont;
+    }
+
+    SetupInitialStyle();
+    ImGuiStyle& style = ImGui::GetStyle();
+    if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+        style.WindowRounding = 0.0f;
+        style.Colors[ImGuiCol_WindowBg].w = 1.0f;
+    }
+}
+
+// Undo history budgets in bytes: per tab, and over all tabs together, where the
+// oldest records of any tab go first. Set with --undo-tab-mb / --undo-total-mb.
+static size_t g_undoTabBudget = 512ull * 1024 * 1024;
+static size_t g_undoTotalBudget = 1024ull * 1024 * 1024;
+
+static void TrimUndoHistories() {
+    size_t total = 0;
+    for (auto& tab : g_appState.tabs) {
+        tab.view.history.SetByteBudget(g_undoTabBudget);
+        tab.view.history.Trim(tab.document);
+        total += tab.view.history.MemoryUsage();
+    }
+    while (total > g_undoTotalBudget) {
+        FileTab* oldest = nullptr;
+        for (auto& tab : g_appState.tabs) {
+            if (!oldest || tab.view.history.OldestSerial() < oldest->view.history.OldestSerial()) oldest = &tab;
+        }
+        if (!oldest || oldest->view.history.OldestSerial() == UINT64_MAX) break;
+        total -= oldest->view.history.MemoryUsage();
+        oldest->view.history.EvictOldest(oldest->document);
+        total += oldest->view.history.MemoryUsage();
+    }
+}
+
+// Journaled edits past this many bytes are folded into a new snapshot.
+static const size_t kJournalCompactBytes = 4 * 1024 * 1024;
+
+// At exit, journals of documents up to this size are rewritten with all their text
+// inline: the file they were loaded from may change before the next session.
+static const size_t kInlineJournalBytes = 16 * 1024 * 1024;
+
+// A journal the writer couldn't write (disk full, permissions) is rewritten from a
+// fresh snapshot at most this often, and once more at exit.
+static const double kJournalRetrySeconds = 2.0;
+
+// Caret and scroll changes rewrite the session manifest at most this often; opening,
+// closing or switching tabs rewrites it right away.
+static const double kManifestViewInterval = 2.0;
+
+// The session's record of a tab. Assigned into an existing entry, so refreshing an
+// unchanged tab costs no allocation.
+static void DescribeTab(const FileTab& tab, SessionTab& out) {
+    out.path = tab.filePath;
+    out.journal = tab.journal;
+    out.size = tab.disk.size;
+    out.modified = (int64_t)tab.disk.modified.time_since_epoch().count();
+    out.cursor = tab.view.cursor;
+    out.anchor = tab.view.anchor;
+    out.topLine = tab.view.topLine;
+}
+
+// Start, compact or drop each tab's journal as its state changes, and rewrite the
+// session manifest when the tabs do. Edits themselves are journaled as they happen,
+// in ApplyTabEdit. flush, at exit, writes the manifest even if it was written a
+// moment ago and makes the journals of all but huge documents self-contained.
+static void UpdateSessionJournal(bool flush = false) {
+    if (!g_sessionJournal.IsOpen()) return;
+    auto now = std::chrono::steady_clock::now();
+    for (auto& tab : g_appState.tabs) {
+        if (tab.loading || tab.stub) continue;
+        if (!tab.isModified) {
+            if (tab.journal) g_sessionJournal.Discard(tab.journal);
+            tab.journal = 0;
+            continue;
+        }
+        // The writer drops edits once a journal fails, so the journal is behind the
+        // document however current the generation looks: start it over.
+        bool failed = false;
+        if (tab.journal) {
+            JournalStatus status = g_sessionJournal.Status(tab.journal);
+            failed = status.Failing() && status.failed >= tab.journalTicket;
+        }
+        if (failed && !flush && now < tab.journalRetryAt) {
+            RequestFrameIn(std::chrono::duration<double>(tab.journalRetryAt - now).count());
+            continue;
+        }
+        bool standalone = flush && tab.document.Length() <= kInlineJournalBytes;
+        if (!failed && !(standalone && tab.journalBased) && tab.journal &&
+            tab.journaledGeneration == tab.document.Generation() && tab.journaledBytes < kJournalCompactBytes) {
+            continue;
+        }
+
+        // Pieces of the loaded file become ranges of it, as long as the file still
+        // holds what was loaded; after a save they are written out in full.
+        JournalBase base;
+        if (!standalone && tab.loadedBuffer && tab.loadedDisk.hashed && tab.disk.hashed &&
+            tab.disk.size == tab.loadedDisk.size && tab.disk.hash == tab.loadedDisk.hash) {
+            base.path = tab.filePath;
+            base.disk = tab.loadedDisk;
+            base.buffer = tab.loadedBuffer;
+        }
+        if (!tab.journal) tab.journal = g_sessionJournal.NewJournal();
+        tab.journalTicket = g_sessionJournal.WriteSnapshot(tab.journal, base, tab.format, tab.document.Snapshot());
+        tab.journalBased = base.buffer != nullptr;
+        tab.journaledGeneration = tab.document.Generation();
+        tab.journaledBytes = 0;
+        tab.journalRetryAt = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double>(kJournalRetrySeconds));
+    }
+
+    // Rebuilt and compared in place, so an unchanged session costs no allocation.
+    static SessionManifest current;
+    static SessionManifest written;
+    static std::chrono::steady_clock::time_point writtenAt;
+    current.activeTab = g_appState.activeTab;
+    current.tabs.resize(g_appState.tabs.size());
+    for (size_t i = 0; i < g_appState.tabs.size(); ++i) DescribeTab(g_appState.tabs[i], current.tabs[i]);
+    if (current == written) return;
+
+    bool sameTabs = current.activeTab == written.activeTab &&
+                    std::equal(current.tabs.begin(), current.tabs.end(), written.tabs.begin(), written.tabs.end(),
+                               [](const SessionTab& a, const SessionTab& b) {
+                                   return a.path == b.path && a.journal == b.journal;
+                               });
+    if (sameTabs && !flush) {
+        double wait = kManifestViewInterval - std::chrono::duration<double>(now - writtenAt).count();
+        if (wait > 0.0) {
+            RequestFrameIn(wait);
+            return;
+        }
+    }
+    written = current;
+    writtenAt = now;
+    g_sessionJournal.WriteManifest(written);
+}
+
+static size_t TabMemoryUsage(const FileTab& tab) {
+    return tab.document.MemoryUsage() + tab.view.history.MemoryUsage();
+}
+
+// A tab can go back to being a stub when nothing is lost: a clean one rereads its
+// file, a modified one is spilled to its session journal, so it needs a current one.
+static bool CanEvict(const FileTab& tab) {
+    if (tab.stub || tab.loading || tab.reloading || tab.saving || tab.diskCheck || tab.changedOnDisk) return false;
+    if (tab.evictTicket) return false;
+    if (!tab.isModified) return !tab.filePath.empty() && !tab.deletedOnDisk;
+    return tab.journal && tab.journaledGeneration == tab.document.Generation() &&
+           !g_sessionJournal.Status(tab.journal).Failing();
+}
+
+// Drop a tab's text and undo history, keeping what a stub keeps: the path, the file
+// as last loaded or saved, and the view position.
+static void DropTabText(FileTab& tab) {
+    PROFILE_ZONE("EvictTab");
+    tab.document = Document();
+    tab.view.history.Clear();
+    tab.view.lineCache.clear();
+    tab.view.lineCache.shrink_to_fit();
+    tab.view.cacheGeneration = (uint64_t)-1;
+    tab.view.caretGeneration = (uint64_t)-1;
+    tab.search.Clear();
+    tab.syntax.Reset();
+    tab.loadedBuffer = nullptr;
+    tab.loadedDisk = FileFingerprint();
+    tab.journaledBytes = 0;
+    tab.evictTicket = 0;
+    tab.stub = true;
+}
+
+// A clean tab is dropped right away. A modified one is spilled to its journal first
+// and keeps its text until the writer reports the spill on disk; see SettleEvictions.
+static void EvictTab(FileTab& tab) {
+    if (!tab.isModified) {
+        DropTabText(tab);
+        return;
+    }
+    // Written without file ranges: the file may change before the tab comes back.
+    tab.evictTicket = g_sessionJournal.WriteSnapshot(tab.journal, JournalBase(), tab.format, tab.document.Snapshot());
+    tab.journalTicket = tab.evictTicket;
+    tab.journalBased = false;
+    tab.evictGeneration = tab.document.Generation();
+}
+
+// Finish the spills that are on disk. One that failed, or a tab edited or shown
+// meanwhile, stays loaded.
+static void SettleEvictions() {
+    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+        FileTab& tab = g_appState.tabs[i];
+        if (!tab.evictTicket) continue;
+        JournalStatus status = g_sessionJournal.Status(tab.journal);
+        bool stale = i == g_appState.activeTab || tab.document.Generation() != tab.evictGeneration;
+        if (stale || status.failed >= tab.evictTicket) {
+            tab.evictTicket = 0;
+        } else if (status.written >= tab.evictTicket) {
+            DropTabText(tab);
+        } else {
+            RequestFrameIn(0.1);
+        }
+    }
+}
+
+// Hold the loaded tabs to g_tabMemoryBudget, evicting the least recently shown first.
+// The active tab always stays, even alone over budget.
+static void EvictInactiveTabs() {
+    SettleEvictions();
+    auto now = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+        FileTab& tab = g_appState.tabs[i];
+        if (i == g_appState.activeTab) tab.lastActive = now;
+        // A tab on its way out no longer counts, or one more would be evicted for it.
+        if (!tab.stub && !tab.evictTicket) total += TabMemoryUsage(tab);
+    }
+    while (total > g_tabMemoryBudget) {
+        FileTab* oldest = nullptr;
+        for (int i = 0; i < (int)g_appState.tabs.size(); ++i) {
+            FileTab& tab = g_appState.tabs[i];
+            if (i == g_appState.activeTab || !CanEvict(tab)) continue;
+            if (!oldest || tab.lastActive < oldest->lastActive) oldest = &tab;
+        }
+        if (!oldest) break;
+        total -= std::min(total, TabMemoryUsage(*oldest));
+        EvictTab(*oldest);
+    }
+    g_appState.tabMemory = total;
+}
+
+// Keep the watcher on the files of the open tabs. The list is rebuilt in place, so
+// an unchanged set of tabs costs no allocation.
+static void WatchOpenFiles() {
+    static std::vector<std::string> paths;
+    size_t count = 0;
+    for (const auto& tab : g_appState.tabs) {
+        if (tab.filePath.empty() || tab.stub) continue;  // a stub reads the file fresh anyway
+        if (count == paths.size()) paths.emplace_back();
+        paths[count++] = tab.filePath;
+    }
+    paths.resize(count);
+    g_fileWatcher.SetFiles(paths);
+}
+
+// Worker results, undo and tab memory budgets, watched files, the session journal,
+// and the trigram index following the open folder. Runs before each frame.
+static void UpdateBackgroundState() {
+    Jobs().RunMainThreadCallbacks();
+    CheckMappingFaults();
+    TrimUndoHistories();
+    WatchOpenFiles();
+    UpdateSessionJournal();
+    EvictInactiveTabs();  // after the journal, so modified tabs have theirs current
+
+    if (g_projectIndex.Root() != g_appState.projectRoot) {
+        if (g_appState.projectRoot.empty()) g_projectIndex.Close();
+        else g_projectIndex.Open(g_appState.projectRoot);
+    }
+}
+
+// Every window of the editor, between NewFrame and Render.
+static void RenderFrameContents() {
+    HandleKeyboardShortcuts();
+
+    RenderMainDockSpace();
+    RenderMenuBar();
+    ThemeEditorMenu();
+    RenderEditor();
+    RenderExplorer();
+    RenderFindInFiles();
+    RenderQuickOpen();
+    RenderProfiler();
+    RenderMemory();
+    RenderDialogs();
+}
+
+// Cancel background work at exit. In-flight saves are waited for.
+static void ShutdownBackgroundWork() {
+    Jobs().SetMainThreadWaker(nullptr);
+    for (auto& tab : g_appState.tabs) {
+        if (tab.loading) tab.loading->cancelled = true;
+        if (tab.reloading) tab.reloading->cancelled = true;
+    }
+    // Let in-flight saves finish; quitting must never lose one. Done first, so the
+    // journal sees which tabs they left clean.
+    while (g_appState.pendingSaves > 0) {
+        Jobs().RunMainThreadCallbacks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // Whatever the last frame and those saves changed goes into the journal before it closes.
+    UpdateSessionJournal(true);
+    g_sessionJournal.Close();
+    g_fileWatcher.Stop();
+    g_appState.findSession.reset();
+    g_pathIndexCancel = true;
+    g_projectIndex.Close();
+    g_projectTree.StopWatching();
+    g_browserTree.StopWatching();
+}
+
+// Loads, saves or a path index build that a replayed frame would otherwise race.
+static bool ReplayWorkPending() {
+    if (g_appState.pendingSaves > 0 || g_appState.pathIndexBuilding) return true;
+    for (const auto& tab : g_appState.tabs) {
+        if (tab.loading) return true;
+    }
+    return false;
+}
+
+static bool WriteReplayReport(const std::string& path, const std::string& script, bool withGl,
+                              const FrameTimeSummary& summary, const std::vector<double>& frameMs) {
+    std::string json = "{\n  \"script\": \"";
+    for (char c : script) {
+        if (c == '"' || c == '\\') json += '\\';
+        json += c;
+    }
+    char number[256];
+    snprintf(number, sizeof(number),
+             "\",\n  \"backend\": \"%s\",\n  \"frames\": %zu,\n  \"mean_ms\": %.4f,\n  \"p50_ms\": %.4f,\n"
+             "  \"p95_ms\": %.4f,\n  \"p99_ms\": %.4f,\n  \"max_ms\": %.4f,\n  \"frame_ms\": [",
+             withGl ? "gl" : "null", summary.frames, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    json += number;
+    for (size_t i = 0; i < frameMs.size(); ++i) {
+        snprintf(number, sizeof(number), i ? ", %.4f" : "%.4f", frameMs[i]);
+        json += number;
+    }
+    json += "]\n}\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << json;
+    return (bool)out;
+}
+
+// Headless replay of a recording or script (input_replay.h) through the same frame
+// as the window. Background work is drained between frames and not timed, so runs
+// repeat; a frame's time covers NewFrame through Render, plus the GL draw and
+// glFinish with --gl (a hidden window). Native dialogs stay closed.
+static int RunReplay(const std::string& scriptPath, const std::string& reportPath, bool withGl) {
+    g_headless = true;
+    std::vector<ReplayFrame> frames;
+    std::string error;
+    if (!LoadReplayScript(scriptPath, frames, &error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (withGl) {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW\n";
+            return 1;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        g_window = glfwCreateWindow(1400, 900, "", nullptr, nullptr);
+        if (!g_window) {
+            std::cerr << "Failed to create GLFW window\n";
+            glfwTerminate();
+            return 1;
+        }
+        glfwMakeContextCurrent(g_window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            glfwDestroyWindow(g_window);
+            glfwTerminate();
+            return 1;
+        }
+    }
+
+    CreateImGuiContext(false);
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;    // always start from the default layout
+    if (withGl) {
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    } else {
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);    // builds the atlas; never uploaded
+    }
+
+    PROFILE_THREAD("Main");
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames.size());
+    for (const ReplayFrame& frame : frames) {
+        for (const ReplayEvent& event : frame.events) {
+            if (event.type == ReplayEvent::Type::OpenFile) OpenFile(event.path);
+            else if (event.type == ReplayEvent::Type::OpenFolder) OpenFolder(event.path);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        for (;;) {
+            UpdateBackgroundState();
+            if (!ReplayWorkPending() || std::chrono::steady_clock::now() > deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        FeedReplayInput(frame);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            PROFILE_ZONE(kFrameZone);
+            ClearFrameRequests();
+            if (withGl) ImGui_ImplOpenGL3_NewFrame();
+            ImGui::NewFrame();
+            RenderFrameContents();
+            ImGui::Render();
+
+            if (withGl) {
+                glViewport(0, 0, (int)frame.displaySize.x, (int)frame.displaySize.y);
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+                glFinish();
+            }
+        }
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    FrameTimeSummary summary = SummarizeFrameTimes(frameMs);
+    printf("%s: %zu frames | mean %.3f ms | p50 %.3f ms | p95 %.3f ms | p99 %.3f ms | max %.3f ms\n",
+           scriptPath.c_str(), summary.frames, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    int result = 0;
+    if (!reportPath.empty() && !WriteReplayReport(reportPath, scriptPath, withGl, summary, frameMs)) {
+        std::cerr << "Cannot write " << reportPath << "\n";
+        result = 1;
+    }
+
+    ShutdownBackgroundWork();
+    if (withGl) ImGui_ImplOpenGL3_Shutdown();
+    ImGui::DestroyContext();
+    if (withGl) {
+        glfwDestroyWindow(g_window);
+        g_window = nullptr;
+        glfwTerminate();
+    }
+    return result;
+}
+
+static void PrintUsage() {
+    std::cerr << "Usage: Edifier [--record FILE] [--no-session] [--undo-tab-mb N] [--undo-total-mb N]\n"
+                 "               [--tab-memory-mb N]\n"
+                 "       Edifier --replay FILE [--report FILE.json] [--gl]\n";
+}
+
+int main(int argc, char** argv) {
+    std::string recordPath, replayPath, reportPath;
+    bool replayGl = false;
+    bool useSession = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            replayPath = argv[++i];
+        } else if (arg == "--report" && hasValue) {
+            reportPath = argv[++i];
+        } else if (arg == "--gl") {
+            replayGl = true;
+        } else if (arg == "--no-session") {
+            useSession = false;
+        } else if (arg == "--undo-tab-mb" && hasValue) {
+            g_undoTabBudget = (size_t)std::max(0, std::atoi(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--undo-total-mb" && hasValue) {
+            g_undoTotalBudget = (size_t)std::max(0, std::atoi(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--tab-memory-mb" && hasValue) {
+            g_tabMemoryBudget = (size_t)std::max(0, std::atoi(argv[++i])) * 1024 * 1024;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    g_fileWatcher.SetCallback(OnFilesChanged);
+    if (!replayPath.empty()) return RunReplay(replayPath, reportPath, replayGl);
+
+    if (!recordPath.empty()) {
+        std::string error;
+        if (!g_inputRecorder.Start(recordPath, &error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         return -1;
@@ -1369,70 +3397,101 @@ int main() {
         return -1;
     }
 
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
+    CreateImGuiContext(true);
     ImGuiIO& io = ImGui::GetIO();
 
-    io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-    io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
-
-    ImFont* defaultFont = io.Fonts->AddFontDefault();
+    ImGui_ImplGlfw_InitForOpenGL(g_window, true);
+    ImGui_ImplOpenGL3_Init("#version 330 core");
 
-    
+    // Initialize GTK once here at startup, not per-dialog.
+    gtkInit();
 
-    ImFont* mainFont = io.Fonts->AddFontFromFileTTF("fonts/JetBrainsMonoNerdFontMono-Bold.ttf", 16.0f);
+    PROFILE_THREAD("Main");
 
-    io.FontDefault = mainFont;
+    // Frames are drawn on demand: the loop sleeps until input arrives, a worker
+    // posts a result, or something on screen asked for a frame (frame_pacer.h).
+    Jobs().SetMainThreadWaker([] { glfwPostEmptyEvent(); });
 
-    SetupInitialStyle();
-    ImGuiStyle& style = ImGui::GetStyle();
-    if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-        style.WindowRounding = 0.0f;
-        style.Colors[ImGuiCol_WindowBg].w = 1.0f;
+    // Recorded sessions start empty, so a replay sees the same tabs; they also
+    // leave the journaled session alone.
+    if (useSession && recordPath.empty() && g_sessionJournal.Open(SessionJournal::DefaultDirectory())) {
+        RestoreSession();
     }
+    const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    const double refreshRate = videoMode && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60.0;
+    double lastFrameTime = glfwGetTime();
+    bool settling = false;
+    RequestFrame();
 
-    ImGui_ImplGlfw_InitForOpenGL(g_window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
+    while (!glfwWindowShouldClose(g_window)) {
+        double wait = SecondsUntilRequestedFrame();
+        if (wait < 0.0) {
+            glfwWaitEvents();
+        } else if (wait > 0.0) {
+            glfwWaitEventsTimeout(wait);
+        } else {
+            glfwPollEvents();
+        }
 
-    // Initialize GTK once here at startup, not per-dialog.
-    gtkInit();
+        PROFILE_ZONE(kFrameZone);
 
-    while (!glfwWindowShouldClose(g_window)) {
-        glfwPollEvents();
+        // Widgets often react to input a frame late, so each woken frame gets one
+        // follow-up before the loop sleeps again.
+        ClearFrameRequests();
+        settling = !settling;
+        if (settling) RequestFrame();
+        if (ImGui::IsAnyMouseDown() || AnyRepeatingKeyDown()) RequestFrameIn(io.KeyRepeatRate);
 
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        double now = glfwGetTime();
+        double refreshes = std::floor((now - lastFrameTime) * refreshRate + 0.5);
+        if (refreshes > 1.0) g_frameStats.skipped += (uint64_t)(refreshes - 1.0);
+        ++g_frameStats.rendered;
+        lastFrameTime = now;
 
-        HandleKeyboardShortcuts();
+        UpdateBackgroundState();
 
-        RenderMainDockSpace();
-        RenderMenuBar();
-        ThemeEditorMenu();
-        RenderEditor();
-        RenderExplorer();
-        RenderDialogs();
+        {
+            PROFILE_ZONE("NewFrame");
+            {
+                MEMORY_SCOPE(MemoryTag::Fonts);  // the first call builds the glyph atlas
+                ImGui_ImplOpenGL3_NewFrame();
+            }
+            ImGui_ImplGlfw_NewFrame();
+            g_inputRecorder.CaptureFrame();
+            ImGui::NewFrame();
+        }
 
-        ImGui::Render();
+        RenderFrameContents();
 
-        int display_w, display_h;
-        glfwGetFramebufferSize(g_window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        {
+            PROFILE_ZONE("Render");
+            ImGui::Render();
+            if (g_appState.showMemory) RecordDrawListMemory();
 
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            int display_w, display_h;
+            glfwGetFramebufferSize(g_window, &display_w, &display_h);
+            glViewport(0, 0, display_w, display_h);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+            PROFILE_ZONE("PlatformWindows");
             GLFWwindow* backup_current_context = glfwGetCurrentContext();
             ImGui::UpdatePlatformWindows();
             ImGui::RenderPlatformWindowsDefault();
             glfwMakeContextCurrent(backup_current_context);
         }
 
+        PROFILE_ZONE("SwapBuffers");
         glfwSwapBuffers(g_window);
     }
 
+    ShutdownBackgroundWork();
+    g_inputRecorder.Stop();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,180 @@
+#include "memory_stats.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+// Counters are updated from every thread on every allocation, so they are relaxed
+// atomics; a reader may see a block's bytes before its count, which is harmless.
+// Zero-initialized before any constructor runs, so allocations made during static
+// initialization are counted too.
+struct AtomicCounter {
+    std::atomic<int64_t> bytes;
+    std::atomic<int64_t> blocks;
+    std::atomic<uint64_t> allocations;
+};
+
+static AtomicCounter g_counters[kMemoryTagCount];
+static std::atomic<bool> g_counting{false};
+static thread_local MemoryTag t_tag = MemoryTag::Other;
+
+// Ahead of every TaggedAlloc block: its size and tag. Sixteen bytes keep the block
+// as aligned as malloc's.
+static const size_t kHeaderBytes = 16;
+
+const char* MemoryTagName(MemoryTag tag) {
+    switch (tag) {
+    case MemoryTag::Other: return "Other";
+    case MemoryTag::Documents: return "Documents";
+    case MemoryTag::Undo: return "Undo";
+    case MemoryTag::Syntax: return "Syntax";
+    case MemoryTag::Search: return "Search";
+    case MemoryTag::Directories: return "Directories";
+    case MemoryTag::Index: return "Index";
+    case MemoryTag::Journal: return "Journal";
+    case MemoryTag::ImGui: return "ImGui";
+    case MemoryTag::Fonts: return "Fonts";
+    case MemoryTag::Count: break;
+    }
+    return "?";
+}
+
+void CollectMemoryCounters(std::vector<MemoryCounter>& out, bool* counting) {
+    out.resize(kMemoryTagCount);
+    for (size_t i = 0; i < kMemoryTagCount; ++i) {
+        out[i].bytes = g_counters[i].bytes.load(std::memory_order_relaxed);
+        out[i].blocks = g_counters[i].blocks.load(std::memory_order_relaxed);
+        out[i].allocations = g_counters[i].allocations.load(std::memory_order_relaxed);
+    }
+    if (counting) *counting = g_counting.load(std::memory_order_relaxed);
+}
+
+void* TaggedAlloc(size_t size, MemoryTag tag) {
+    if (size > SIZE_MAX - kHeaderBytes) return nullptr;
+    uint64_t* header = static_cast<uint64_t*>(std::malloc(size + kHeaderBytes));
+    if (!header) return nullptr;
+    header[0] = size;
+    header[1] = (uint64_t)tag;
+    AtomicCounter& counter = g_counters[(size_t)tag];
+    counter.bytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+    counter.blocks.fetch_add(1, std::memory_order_relaxed);
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    if (!g_counting.load(std::memory_order_relaxed)) g_counting.store(true, std::memory_order_relaxed);
+    return reinterpret_cast<char*>(header) + kHeaderBytes;
+}
+
+void TaggedFree(void* p) {
+    if (!p) return;
+    uint64_t* header = reinterpret_cast<uint64_t*>(static_cast<char*>(p) - kHeaderBytes);
+    AtomicCounter& counter = g_counters[header[1] < kMemoryTagCount ? header[1] : 0];
+    counter.bytes.fetch_sub((int64_t)header[0], std::memory_order_relaxed);
+    counter.blocks.fetch_sub(1, std::memory_order_relaxed);
+    std::free(header);
+}
+
+MemoryTag CurrentMemoryTag() {
+    return t_tag;
+}
+
+uint64_t ProcessResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size;
+#else
+    // /proc/self/statm: total and resident pages, first two of seven numbers.
+    FILE* file = std::fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    unsigned long long pages = 0, resident = 0;
+    int read = std::fscanf(file, "%llu %llu", &pages, &resident);
+    std::fclose(file);
+    if (read != 2) return 0;
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static void AppendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        unsigned char u = (unsigned char)c;
+        if (u == '"' || u == '\\') {
+            out += '\\';
+            out += c;
+        } else if (u < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", u);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+bool WriteMemoryReport(const MemoryReport& report, const std::string& path, std::string* error) {
+    char number[256];
+    std::string json = "{\n";
+    snprintf(number, sizeof(number),
+             "\"resident_bytes\": %llu,\n\"counting\": %s,\n\"draw_lists\": {\"used\": %zu, \"capacity\": %zu},\n"
+             "\"tab_budget\": %zu,\n\"subsystems\": [",
+             (unsigned long long)report.resident, report.counting ? "true" : "false", report.drawListUsed,
+             report.drawListCapacity, report.tabBudget);
+    json += number;
+    for (size_t i = 0; i < report.counters.size() && i < kMemoryTagCount; ++i) {
+        const MemoryCounter& counter = report.counters[i];
+        json += i ? ",\n  {\"name\": " : "\n  {\"name\": ";
+        AppendJsonString(json, MemoryTagName((MemoryTag)i));
+        snprintf(number, sizeof(number), ", \"bytes\": %lld, \"blocks\": %lld, \"allocations\": %llu}",
+                 (long long)counter.bytes, (long long)counter.blocks, (unsigned long long)counter.allocations);
+        json += number;
+    }
+    json += "\n],\n\"tabs\": [";
+    for (size_t i = 0; i < report.tabs.size(); ++i) {
+        const MemoryTabReport& tab = report.tabs[i];
+        json += i ? ",\n  {\"name\": " : "\n  {\"name\": ";
+        AppendJsonString(json, tab.name);
+        const DocumentMemory& doc = tab.document;
+        snprintf(number, sizeof(number),
+                 ", \"loaded\": %s, \"original\": %zu, \"mapped\": %zu, \"add_used\": %zu, \"add_capacity\": %zu, "
+                 "\"newline_index\": %zu, \"pieces\": %zu, \"undo\": %zu, \"syntax\": %zu, \"search\": %zu}",
+                 tab.loaded ? "true" : "false", doc.original, doc.mapped, doc.addUsed, doc.addCapacity,
+                 doc.newlineIndex, doc.pieces, tab.undo, tab.syntax, tab.search);
+        json += number;
+    }
+    json += "\n]\n}\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (out) out.write(json.data(), (std::streamsize)json.size());
+    if (!out) {
+        if (error) *error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+#if EDIFIER_MEMORY_STATS
+
+MemoryScope::MemoryScope(MemoryTag tag) : m_previous(t_tag) {
+    t_tag = tag;
+}
+
+MemoryScope::~MemoryScope() {
+    t_tag = m_previous;
+}
+
+#endif
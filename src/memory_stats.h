@@ -0,0 +1,107 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Heap accounting per subsystem. MEMORY_SCOPE(tag) charges the calling thread's
+// allocations to tag until the scope ends; scopes nest, the innermost winning.
+// The counting itself is done by whoever owns the allocator: the editor replaces
+// operator new with TaggedAlloc/TaggedFree, which keep each block's size and tag
+// in a header, so a block freed on another thread still credits the right counter.
+// Tools that don't (the benchmarks) simply count nothing.
+//
+// Built with EDIFIER_MEMORY_STATS=0 the scopes expand to nothing.
+
+#ifndef EDIFIER_MEMORY_STATS
+#define EDIFIER_MEMORY_STATS 1
+#endif
+
+enum class MemoryTag : uint8_t {
+    Other,            // anything outside a scope
+    Documents,        // loaded and typed text, piece trees
+    Undo,
+    Syntax,
+    Search,           // find bar, Find in Files, quick open
+    Directories,      // explorer and file browser listings
+    Index,            // trigram index
+    Journal,          // hot-exit journal writer
+    ImGui,            // widgets, draw lists
+    Fonts,            // font files and the glyph atlas
+    Count
+};
+
+static const size_t kMemoryTagCount = (size_t)MemoryTag::Count;
+
+const char* MemoryTagName(MemoryTag tag);
+
+struct MemoryCounter {
+    int64_t bytes = 0;                 // live bytes
+    int64_t blocks = 0;                // live allocations
+    uint64_t allocations = 0;          // allocations ever
+};
+
+// Counters as of now, by tag. counting is false until something has been counted,
+// i.e. when nothing hooks the allocator.
+void CollectMemoryCounters(std::vector<MemoryCounter>& out, bool* counting = nullptr);
+
+// malloc/free with accounting, for allocator hooks. TaggedFree takes only blocks
+// from TaggedAlloc.
+void* TaggedAlloc(size_t size, MemoryTag tag);
+void TaggedFree(void* p);
+
+MemoryTag CurrentMemoryTag();
+
+// Resident set of the whole process, 0 where it can't be read.
+uint64_t ProcessResidentBytes();
+
+// One tab in a memory report.
+struct MemoryTabReport {
+    std::string name;
+    bool loaded = false;               // stubs hold no text
+    DocumentMemory document;
+    size_t undo = 0;
+    size_t syntax = 0;
+    size_t search = 0;
+};
+
+// A one-shot picture of where memory goes, for bug reports.
+struct MemoryReport {
+    uint64_t resident = 0;
+    bool counting = false;
+    std::vector<MemoryCounter> counters;    // by MemoryTag
+    size_t drawListUsed = 0;               // vertex, index and command bytes drawn last frame
+    size_t drawListCapacity = 0;
+    size_t tabBudget = 0;
+    std::vector<MemoryTabReport> tabs;
+};
+
+// Write the report as JSON.
+bool WriteMemoryReport(const MemoryReport& report, const std::string& path, std::string* error = nullptr);
+
+#if EDIFIER_MEMORY_STATS
+
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+    MemoryTag m_previous;
+};
+
+#define EDIFIER_MEMORY_CONCAT2(a, b) a##b
+#define EDIFIER_MEMORY_CONCAT(a, b) EDIFIER_MEMORY_CONCAT2(a, b)
+#define MEMORY_SCOPE(tag) MemoryScope EDIFIER_MEMORY_CONCAT(memoryScope, __LINE__)(tag)
+
+#else
+
+#define MEMORY_SCOPE(tag) ((void)0)
+
+#endif
@@ -0,0 +1,255 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+uint64_t ProfileNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if EDIFIER_PROFILER
+
+static_assert((kProfileRingSize & (kProfileRingSize - 1)) == 0, "ring size must be a power of two");
+
+// Rings are written by one thread and read by the UI thread at the same time, so
+// every field is a relaxed atomic and readers validate what they copied afterwards
+// (a seqlock per slot, with begun/written as the sequence).
+struct ProfileSlot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+    std::atomic<uint32_t> depth{0};
+};
+
+struct ProfileRing {
+    uint32_t id = 0;
+    std::string name;                  // guarded by the registry mutex
+    bool owned = false;                // a live thread writes here; same
+    std::unique_ptr<ProfileSlot[]> slots;
+    std::atomic<uint64_t> begun{0};    // slots whose write has started
+    std::atomic<uint64_t> written{0};  // slots whose write has finished
+};
+
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileRing>> rings;   // never shrinks, so rings outlive threads
+};
+
+// A thread's ring, handed back when the thread exits so the next thread with the
+// same name continues its track.
+struct ThreadRing {
+    ProfileRing* ring = nullptr;
+    bool unavailable = false;
+    ~ThreadRing();
+};
+
+// Beyond this many rings, further threads don't record.
+static const size_t kMaxRings = 64;
+
+// Leaked on purpose: worker threads can still exit during static destruction.
+static ProfileRegistry& GetRegistry() {
+    static ProfileRegistry* registry = new ProfileRegistry;
+    return *registry;
+}
+
+static thread_local ThreadRing t_ring;
+static thread_local uint32_t t_depth = 0;
+
+ThreadRing::~ThreadRing() {
+    if (!ring) return;
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    ring->owned = false;
+}
+
+// Caller holds the registry mutex.
+static ProfileRing* AcquireRing(const std::string& name) {
+    ProfileRegistry& registry = GetRegistry();
+    for (auto& ring : registry.rings) {
+        if (!ring->owned && ring->name == name) {
+            ring->owned = true;
+            return ring.get();
+        }
+    }
+    if (registry.rings.size() >= kMaxRings) return nullptr;
+
+    auto ring = std::make_unique<ProfileRing>();
+    ring->id = (uint32_t)registry.rings.size();
+    ring->name = name;
+    ring->owned = true;
+    ring->slots.reset(new ProfileSlot[kProfileRingSize]);
+    registry.rings.push_back(std::move(ring));
+    return registry.rings.back().get();
+}
+
+void SetProfileThreadName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    if (t_ring.ring) {
+        if (t_ring.ring->name == name) return;
+        t_ring.ring->owned = false;
+    }
+    t_ring.ring = AcquireRing(name);
+    t_ring.unavailable = !t_ring.ring;
+}
+
+static ProfileRing* CurrentRing() {
+    if (t_ring.ring || t_ring.unavailable) return t_ring.ring;
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    t_ring.ring = AcquireRing("Thread");
+    t_ring.unavailable = !t_ring.ring;
+    return t_ring.ring;
+}
+
+ProfileZone::ProfileZone(const char* name) : m_name(name), m_start(ProfileNow()) {
+    ++t_depth;
+}
+
+ProfileZone::~ProfileZone() {
+    uint64_t end = ProfileNow();
+    uint32_t depth = --t_depth;
+    ProfileRing* ring = CurrentRing();
+    if (!ring) return;
+
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    ring->begun.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ProfileSlot& slot = ring->slots[index & (kProfileRingSize - 1)];
+    slot.name.store(m_name, std::memory_order_relaxed);
+    slot.start.store(m_start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+void CollectProfile(uint64_t since, std::vector<ProfileTrack>& tracks) {
+    tracks.clear();
+
+    std::vector<ProfileRing*> rings;
+    {
+        ProfileRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& ring : registry.rings) {
+            rings.push_back(ring.get());
+            tracks.emplace_back();
+            tracks.back().id = ring->id;
+            tracks.back().name = ring->name;
+        }
+    }
+
+    for (size_t r = 0; r < rings.size(); ++r) {
+        ProfileRing& ring = *rings[r];
+        std::vector<ProfileEvent>& events = tracks[r].events;
+
+        // Newest first, stopping at the first zone that ended before since: a thread
+        // writes its zones in the order they end.
+        uint64_t written = ring.written.load(std::memory_order_acquire);
+        uint64_t oldest = written > kProfileRingSize ? written - kProfileRingSize : 0;
+        uint64_t index = written;
+        while (index > oldest) {
+            const ProfileSlot& slot = ring.slots[(index - 1) & (kProfileRingSize - 1)];
+            ProfileEvent event;
+            event.end = slot.end.load(std::memory_order_relaxed);
+            if (event.end < since) break;
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.start = slot.start.load(std::memory_order_relaxed);
+            event.depth = slot.depth.load(std::memory_order_relaxed);
+            events.push_back(event);
+            --index;
+        }
+
+        // Drop what the writer may have overwritten while it was copied.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t begun = ring.begun.load(std::memory_order_relaxed);
+        uint64_t valid = begun > kProfileRingSize ? begun - kProfileRingSize : 0;
+        if (valid >= written) {
+            events.clear();     // lapped entirely while copying
+        } else if (valid > index) {
+            events.resize((size_t)std::min<uint64_t>(events.size(), written - valid));
+        }
+        std::reverse(events.begin(), events.end());
+    }
+}
+
+static void AppendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text; *c; ++c) {
+        unsigned char u = (unsigned char)*c;
+        if (u == '"' || u == '\\') {
+            out += '\\';
+            out += *c;
+        } else if (u < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", u);
+            out += escaped;
+        } else {
+            out += *c;
+        }
+    }
+    out += '"';
+}
+
+bool WriteChromeTrace(const std::string& path, double seconds, std::string* error) {
+    uint64_t now = ProfileNow();
+    uint64_t span = (uint64_t)(std::max(0.0, seconds) * 1e9);
+    std::vector<ProfileTrack> tracks;
+    CollectProfile(span < now ? now - span : 0, tracks);
+
+    uint64_t origin = now;
+    for (const auto& track : tracks) {
+        if (!track.events.empty()) origin = std::min(origin, track.events.front().start);
+    }
+
+    std::string json = "{\"traceEvents\":[\n";
+    bool first = true;
+    char number[160];
+    for (const auto& track : tracks) {
+        if (track.events.empty()) continue;
+        json += first ? "" : ",\n";
+        first = false;
+        snprintf(number, sizeof(number), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", track.id);
+        json += number;
+        AppendJsonString(json, track.name.c_str());
+        snprintf(number, sizeof(number), "}},\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%u}}",
+                 track.id, track.id);
+        json += number;
+
+        for (const auto& event : track.events) {
+            json += ",\n{\"name\":";
+            AppendJsonString(json, event.name ? event.name : "?");
+            snprintf(number, sizeof(number), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", track.id,
+                     (double)(event.start - std::min(origin, event.start)) / 1000.0,
+                     (double)(event.end - event.start) / 1000.0);
+            json += number;
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (out) out.write(json.data(), (std::streamsize)json.size());
+    if (!out) {
+        if (error) *error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+#else
+
+void SetProfileThreadName(const std::string&) {}
+
+void CollectProfile(uint64_t, std::vector<ProfileTrack>& tracks) {
+    tracks.clear();
+}
+
+bool WriteChromeTrace(const std::string&, double, std::string* error) {
+    if (error) *error = "Built without the profiler (EDIFIER_PROFILER=0)";
+    return false;
+}
+
+#endif
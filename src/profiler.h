@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped-zone profiler. PROFILE_ZONE("name") times the enclosing scope on the
+// calling thread; each thread writes into its own ring of recent zones without
+// locks, and the UI thread copies them out for the Profiler window or a Chrome
+// trace. Built with EDIFIER_PROFILER=0 the macros expand to nothing.
+//
+// Zone names must be string literals (or otherwise live for the whole run): only
+// the pointer is recorded.
+
+#ifndef EDIFIER_PROFILER
+#define EDIFIER_PROFILER 1
+#endif
+
+// Zones kept per thread; older ones are overwritten.
+static const size_t kProfileRingSize = 1 << 15;
+
+struct ProfileEvent {
+    const char* name = nullptr;
+    uint64_t start = 0;       // ProfileNow() nanoseconds
+    uint64_t end = 0;
+    uint32_t depth = 0;       // nesting level on its thread
+};
+
+struct ProfileTrack {
+    uint32_t id = 0;          // stable per ring; used as the trace's tid
+    std::string name;         // "Main", "Jobs 2", "Search 5", ...
+    std::vector<ProfileEvent> events;   // by end time
+};
+
+// Monotonic nanoseconds.
+uint64_t ProfileNow();
+
+// Label the calling thread's track. Threads that record zones without a name get
+// "Thread". A name whose previous owner has exited reuses that thread's ring.
+void SetProfileThreadName(const std::string& name);
+
+// Copy every recorded zone that ended at or after since.
+void CollectProfile(uint64_t since, std::vector<ProfileTrack>& tracks);
+
+// Write the last seconds of zones as Chrome trace_event JSON (chrome://tracing,
+// Perfetto). Each thread is its own track.
+bool WriteChromeTrace(const std::string& path, double seconds, std::string* error = nullptr);
+
+#if EDIFIER_PROFILER
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name);
+    ~ProfileZone();
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_start;
+};
+
+#define EDIFIER_PROFILE_CONCAT2(a, b) a##b
+#define EDIFIER_PROFILE_CONCAT(a, b) EDIFIER_PROFILE_CONCAT2(a, b)
+#define PROFILE_ZONE(name) ProfileZone EDIFIER_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) SetProfileThreadName(name)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+#endif
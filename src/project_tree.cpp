@@ -0,0 +1,360 @@
+#include "project_tree.h"
+#include "job_system.h"
+#include "memory_stats.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static bool EntryLess(const std::string& aName, bool aDir, const std::string& bName, bool bDir) {
+    if (aDir != bDir) return aDir;
+    return aName < bName;
+}
+
+ProjectTree::ProjectTree(bool hideDotFiles) : m_hideDotFiles(hideDotFiles) {}
+
+ProjectTree::~ProjectTree() {
+    StopWatching();
+}
+
+void ProjectTree::StopWatching() {
+#ifdef __linux__
+    if (m_watcher.joinable()) {
+        char wake = 1;
+        if (write(m_wakePipe[1], &wake, 1) < 0) {
+            // The reader polls the pipe; nothing else to do if it is already gone.
+        }
+        m_watcher.join();
+    }
+    if (m_inotifyFd >= 0) close(m_inotifyFd);
+    if (m_wakePipe[0] >= 0) close(m_wakePipe[0]);
+    if (m_wakePipe[1] >= 0) close(m_wakePipe[1]);
+    m_inotifyFd = -1;
+    m_wakePipe[0] = m_wakePipe[1] = -1;
+#endif
+    for (Node& node : m_nodes) node.watch = -1;
+    m_watchToNode.clear();
+    m_watchingStopped = true;
+}
+
+void ProjectTree::SetRoot(const std::string& path) {
+    if (!m_nodes.empty()) FreeSubtree(kRoot);
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_watchToNode.clear();
+    m_rowsDirty = true;
+    m_rootPath = path;
+    if (path.empty()) return;
+
+    std::string name = fs::path(path).filename().string();
+    NewNode(name.empty() ? path : name, path, kNone, true);
+    m_nodes[kRoot].expanded = true;
+}
+
+void ProjectTree::Request(uint32_t dir) {
+    Node& node = m_nodes[dir];
+    if (!node.isDirectory || node.state == ScanState::Scanning) return;
+    if (node.state == ScanState::Unscanned || node.stale) StartScan(dir);
+}
+
+void ProjectTree::Refresh(uint32_t dir) {
+    if (m_nodes[dir].isDirectory) m_nodes[dir].stale = true;
+}
+
+void ProjectTree::SetExpanded(uint32_t dir, bool expanded) {
+    if (!m_nodes[dir].isDirectory || m_nodes[dir].expanded == expanded) return;
+    m_nodes[dir].expanded = expanded;
+    m_rowsDirty = true;
+}
+
+const std::vector<ProjectTree::Row>& ProjectTree::Rows() {
+    if (m_rowsDirty) RebuildRows();
+    return m_rows;
+}
+
+uint32_t ProjectTree::RowOf(uint32_t node) {
+    if (m_rowsDirty) RebuildRows();
+    return node < m_rowOfNode.size() ? m_rowOfNode[node] : kNone;
+}
+
+void ProjectTree::RequestExpanded() {
+    if (m_rowsDirty) RebuildRows();
+    for (uint32_t dir : m_expandedDirs) Request(dir);
+}
+
+// Iterative pre-order walk of the expanded part of the tree.
+void ProjectTree::RebuildRows() {
+    m_rowsDirty = false;
+    m_rows.clear();
+    m_expandedDirs.clear();
+    m_rowOfNode.assign(m_nodes.size(), kNone);
+    if (m_nodes.empty()) return;
+
+    std::vector<Row> stack;
+    auto pushChildren = [&](uint32_t dir, uint32_t depth) {
+        const Node& node = m_nodes[dir];
+        m_expandedDirs.push_back(dir);
+        if (node.children.empty() && node.state != ScanState::Ready) {
+            stack.push_back({ dir, depth, RowKind::Status });
+            return;
+        }
+        for (size_t i = node.children.size(); i-- > 0;) {
+            stack.push_back({ node.children[i], depth, RowKind::Entry });
+        }
+    };
+
+    pushChildren(kRoot, 0);
+    while (!stack.empty()) {
+        Row row = stack.back();
+        stack.pop_back();
+        if (row.kind == RowKind::Entry) m_rowOfNode[row.node] = (uint32_t)m_rows.size();
+        m_rows.push_back(row);
+
+        const Node& node = m_nodes[row.node];
+        if (row.kind == RowKind::Entry && node.isDirectory && node.expanded) {
+            pushChildren(row.node, row.depth + 1);
+        }
+    }
+}
+
+uint32_t ProjectTree::FindNode(const std::string& path) const {
+    if (m_nodes.empty()) return kNone;
+    fs::path relative = fs::path(path).lexically_relative(m_rootPath);
+    if (relative.empty() || *relative.begin() == "..") return kNone;
+
+    uint32_t current = kRoot;
+    for (auto part = relative.begin(); part != relative.end(); ++part) {
+        std::string name = part->string();
+        if (name == ".") continue;
+        bool last = std::next(part) == relative.end();
+        const std::vector<uint32_t>& children = m_nodes[current].children;
+
+        // Children are sorted, so each level is a binary search. The last component
+        // may be a file or a directory; intermediate ones are directories.
+        uint32_t found = kNone;
+        for (bool isDirectory : { true, false }) {
+            if (!isDirectory && !last) break;
+            auto it = std::lower_bound(children.begin(), children.end(), name, [&](uint32_t child, const std::string& key) {
+                return EntryLess(m_nodes[child].name, m_nodes[child].isDirectory, key, isDirectory);
+            });
+            if (it != children.end() && m_nodes[*it].name == name && m_nodes[*it].isDirectory == isDirectory) {
+                found = *it;
+                break;
+            }
+        }
+        if (found == kNone) return kNone;
+        current = found;
+    }
+    return current;
+}
+
+ProjectTree::Listing ProjectTree::ListDirectory(const std::string& path, bool hideDotFiles) {
+    PROFILE_ZONE("ListDirectory");
+    MEMORY_SCOPE(MemoryTag::Directories);
+    Listing listing;
+    std::error_code ec;
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        listing.error = ec.message();
+        return listing;
+    }
+
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        Entry entry;
+        entry.name = it->path().filename().string();
+        // Hidden file filtering is Linux-only (leading dot convention).
+        // On Windows, hidden status is a filesystem attribute, not a naming convention.
+#ifdef __linux__
+        if (hideDotFiles && entry.name.rfind(".", 0) == 0) continue;
+#else
+        (void)hideDotFiles;
+#endif
+        std::error_code typeEc;
+        entry.isDirectory = it->is_directory(typeEc);
+        listing.entries.push_back(std::move(entry));
+    }
+    if (ec) {
+        listing.error = ec.message();
+        return listing;
+    }
+
+    std::sort(listing.entries.begin(), listing.entries.end(), [](const Entry& a, const Entry& b) {
+        return EntryLess(a.name, a.isDirectory, b.name, b.isDirectory);
+    });
+    listing.ok = true;
+    return listing;
+}
+
+void ProjectTree::StartScan(uint32_t dir) {
+    Node& node = m_nodes[dir];
+    node.state = ScanState::Scanning;
+    node.stale = false;  // changes from here on need another scan
+    if (node.children.empty()) m_rowsDirty = true;  // gains a "Loading..." row
+
+    std::string path = node.path;
+    bool hideDotFiles = m_hideDotFiles;
+    Jobs().Submit([this, dir, path, hideDotFiles] {
+        auto listing = std::make_shared<Listing>(ListDirectory(path, hideDotFiles));
+        Jobs().PostToMain([this, dir, path, listing] { ApplyListing(dir, path, *listing); });
+    });
+}
+
+// Old and new children are sorted the same way, so one merge pass keeps every
+// surviving node (and its scanned subtree) and frees only what disappeared.
+void ProjectTree::ApplyListing(uint32_t dir, const std::string& path, Listing& listing) {
+    // The root may have changed or the node been recycled while the scan ran.
+    if (dir >= m_nodes.size() || !m_nodes[dir].isDirectory || m_nodes[dir].path != path) return;
+
+    m_rowsDirty = true;
+    if (!listing.ok) {
+        m_nodes[dir].state = ScanState::Failed;
+        m_nodes[dir].error = listing.error;
+        return;
+    }
+
+    std::vector<uint32_t> oldChildren = std::move(m_nodes[dir].children);
+    std::vector<uint32_t> children;
+    children.reserve(listing.entries.size());
+
+    size_t i = 0;
+    for (Entry& entry : listing.entries) {
+        while (i < oldChildren.size()) {
+            const Node& old = m_nodes[oldChildren[i]];
+            if (!EntryLess(old.name, old.isDirectory, entry.name, entry.isDirectory)) break;
+            FreeSubtree(oldChildren[i++]);
+        }
+        if (i < oldChildren.size() && m_nodes[oldChildren[i]].name == entry.name &&
+            m_nodes[oldChildren[i]].isDirectory == entry.isDirectory) {
+            children.push_back(oldChildren[i++]);
+        } else {
+            std::string childPath = (fs::path(path) / entry.name).string();
+            children.push_back(NewNode(entry.name, childPath, dir, entry.isDirectory));
+        }
+    }
+    for (; i < oldChildren.size(); ++i) FreeSubtree(oldChildren[i]);
+
+    Node& node = m_nodes[dir];
+    node.children = std::move(children);
+    node.state = ScanState::Ready;
+    node.error.clear();
+    if (node.watch < 0) AddWatch(dir);
+}
+
+uint32_t ProjectTree::NewNode(const std::string& name, const std::string& path, uint32_t parent, bool isDirectory) {
+    uint32_t index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[index];
+    node.name = name;
+    node.path = path;
+    node.parent = parent;
+    node.isDirectory = isDirectory;
+    return index;
+}
+
+void ProjectTree::FreeSubtree(uint32_t index) {
+    std::vector<uint32_t> children = std::move(m_nodes[index].children);
+    for (uint32_t child : children) FreeSubtree(child);
+    RemoveWatch(index);
+    m_nodes[index] = Node();
+    m_freeNodes.push_back(index);
+}
+
+void ProjectTree::AddWatch(uint32_t dir) {
+#ifdef __linux__
+    if (m_watchingStopped) return;
+    if (m_inotifyFd < 0) {
+        m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotifyFd < 0) return;
+        if (pipe(m_wakePipe) != 0) {
+            close(m_inotifyFd);
+            m_inotifyFd = -1;
+            return;
+        }
+        m_watcher = std::thread([this] { WatchLoop(); });
+    }
+
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    int wd = inotify_add_watch(m_inotifyFd, m_nodes[dir].path.c_str(), mask);
+    if (wd < 0) return;  // e.g. out of watches: the directory just won't auto-refresh
+    m_nodes[dir].watch = wd;
+    m_watchToNode[wd] = dir;
+#else
+    (void)dir;
+#endif
+}
+
+void ProjectTree::RemoveWatch(uint32_t dir) {
+    Node& node = m_nodes[dir];
+    if (node.watch < 0) return;
+#ifdef __linux__
+    if (m_inotifyFd >= 0) inotify_rm_watch(m_inotifyFd, node.watch);
+#endif
+    m_watchToNode.erase(node.watch);
+    node.watch = -1;
+}
+
+// Events only mark directories stale; the rescan happens when one is next drawn,
+// so a burst of changes (a checkout, a build) costs at most one scan per visible
+// directory.
+void ProjectTree::OnChanged(const std::vector<int>& watches, bool overflow) {
+    if (overflow) {
+        for (Node& node : m_nodes) {
+            if (node.isDirectory && node.state != ScanState::Unscanned) node.stale = true;
+        }
+        return;
+    }
+    for (int wd : watches) {
+        auto it = m_watchToNode.find(wd);
+        // A watch id may have been reused after a root change; a spurious rescan is harmless.
+        if (it != m_watchToNode.end()) m_nodes[it->second].stale = true;
+    }
+}
+
+void ProjectTree::WatchLoop() {
+#ifdef __linux__
+    PROFILE_THREAD("Watcher");
+    MEMORY_SCOPE(MemoryTag::Directories);
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        pollfd fds[2] = { { m_inotifyFd, POLLIN, 0 }, { m_wakePipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+        PROFILE_ZONE("WatchEvents");
+
+        std::vector<int> watches;
+        bool overflow = false;
+        for (;;) {
+            ssize_t n = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            for (char* p = buffer; p < buffer + n;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->mask & IN_Q_OVERFLOW) overflow = true;
+                if (!(event->mask & IN_IGNORED) && event->wd >= 0) watches.push_back(event->wd);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (watches.empty() && !overflow) continue;
+
+        std::sort(watches.begin(), watches.end());
+        watches.erase(std::unique(watches.begin(), watches.end()), watches.end());
+        Jobs().PostToMain([this, watches, overflow] { OnChanged(watches, overflow); });
+    }
+#endif
+}
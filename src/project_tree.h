@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Cached directory tree behind the explorer. Each directory is listed once, on a
+// worker, the first time it is shown; names, full paths and the sorted child order
+// are stored in the nodes. The expanded part of the tree is kept flattened into a
+// row array, so drawing only touches the rows on screen. On Linux an
+// inotify thread marks directories stale when their contents change, and they are
+// rescanned the next time they are visible. Elsewhere Refresh does that by hand.
+//
+// Everything except the scan and watcher threads runs on the UI thread; results
+// come back through Jobs().PostToMain.
+class ProjectTree {
+public:
+    enum class ScanState : uint8_t { Unscanned, Scanning, Ready, Failed };
+
+    static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        std::string name;
+        std::string path;
+        uint32_t parent = kNone;
+        bool isDirectory = false;
+
+        // Directories only.
+        bool expanded = false;
+        ScanState state = ScanState::Unscanned;
+        bool stale = false;                // changed on disk since the last scan started
+        int watch = -1;
+        std::string error;                 // why the last scan failed
+        std::vector<uint32_t> children;    // directories first, then files, each by name
+    };
+
+    static constexpr uint32_t kRoot = 0;
+
+    // One line of the flattened explorer. Status rows stand for a directory's
+    // "Loading..." or error line; node is then that directory.
+    enum class RowKind : uint8_t { Entry, Status };
+    struct Row {
+        uint32_t node = 0;
+        uint32_t depth = 0;
+        RowKind kind = RowKind::Entry;
+    };
+
+    explicit ProjectTree(bool hideDotFiles = true);
+    ~ProjectTree();
+
+    ProjectTree(const ProjectTree&) = delete;
+    ProjectTree& operator=(const ProjectTree&) = delete;
+
+    // Drop the cached tree and start over at path (empty clears it).
+    void SetRoot(const std::string& path);
+    const std::string& RootPath() const { return m_rootPath; }
+    bool Empty() const { return m_nodes.empty(); }
+
+    // Node references stay valid until the next RunMainThreadCallbacks.
+    const Node& GetNode(uint32_t index) const { return m_nodes[index]; }
+
+    // Called for each directory that is drawn: starts a background scan if its
+    // children were never listed or are stale. Cheap when they are current.
+    void Request(uint32_t dir);
+
+    // Rescan dir the next time it is requested.
+    void Refresh(uint32_t dir);
+
+    // Everything under the root, with expanded directories opened, in display
+    // order. Rebuilt only after expansion or directory contents change.
+    const std::vector<Row>& Rows();
+    uint32_t RowOf(uint32_t node);    // kNone if the node isn't shown
+    void SetExpanded(uint32_t dir, bool expanded);
+
+    // Request() every expanded directory, keeping whatever is on screen current.
+    void RequestExpanded();
+
+    // Node for a path under the root, if its directory has been listed.
+    uint32_t FindNode(const std::string& path) const;
+
+    // Stop the watcher thread for good. Call before the job system goes away.
+    void StopWatching();
+
+private:
+    struct Entry {
+        std::string name;
+        bool isDirectory = false;
+    };
+    struct Listing {
+        bool ok = false;
+        std::string error;
+        std::vector<Entry> entries;        // sorted like Node::children
+    };
+
+    static Listing ListDirectory(const std::string& path, bool hideDotFiles);
+
+    void RebuildRows();
+    void StartScan(uint32_t dir);
+    void ApplyListing(uint32_t dir, const std::string& path, Listing& listing);
+    uint32_t NewNode(const std::string& name, const std::string& path, uint32_t parent, bool isDirectory);
+    void FreeSubtree(uint32_t index);
+
+    void AddWatch(uint32_t dir);
+    void RemoveWatch(uint32_t dir);
+    void OnChanged(const std::vector<int>& watches, bool overflow);
+    void WatchLoop();
+
+    bool m_hideDotFiles;
+    std::string m_rootPath;
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_freeNodes;
+
+    std::vector<Row> m_rows;
+    std::vector<uint32_t> m_rowOfNode;    // node index -> row, kNone when hidden
+    std::vector<uint32_t> m_expandedDirs; // root plus every expanded directory on screen
+    bool m_rowsDirty = true;
+
+    std::unordered_map<int, uint32_t> m_watchToNode;
+    int m_inotifyFd = -1;
+    int m_wakePipe[2] = { -1, -1 };
+    std::thread m_watcher;
+    bool m_watchingStopped = false;
+};
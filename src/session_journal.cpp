@@ -0,0 +1,694 @@
+#include "session_journal.h"
+#include "memory_stats.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// After a batch is synced, the writer waits this long for the next one, so fast
+// typing costs one sync per interval instead of one per key.
+static const std::chrono::milliseconds kCommitInterval(100);
+
+static const char kJournalMagic[8] = { 'E', 'D', 'F', 'J', 'R', 'N', 'L', '1' };
+static const char kManifestMagic[8] = { 'E', 'D', 'F', 'S', 'E', 'S', 'S', '2' };
+
+// Every record is framed as [u64 payload length][u8 type][payload][u64 hash of type
+// and payload]. Numbers are in host byte order; the files never leave the machine.
+enum RecordType : uint8_t { kSnapshotRecord = 1, kEditRecord = 2, kManifestRecord = 3 };
+static const size_t kFrameBytes = 8 + 1 + 8;
+
+// Snapshot pieces: a range of the base file, or text stored inline.
+enum PieceKind : uint8_t { kFileRange = 0, kInlineText = 1 };
+
+static void PutU8(std::string& out, uint8_t v) {
+    out.push_back((char)v);
+}
+
+static void PutU64(std::string& out, uint64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), 8);
+}
+
+static void PutString(std::string& out, const std::string& s) {
+    PutU64(out, s.size());
+    out += s;
+}
+
+// Bounds-checked reads over one record's payload; any overrun fails the record.
+struct RecordReader {
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    uint8_t U8() {
+        if (end - p < 1) return Fail();
+        return (uint8_t)*p++;
+    }
+    uint64_t U64() {
+        if (end - p < 8) return Fail();
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        p += 8;
+        return v;
+    }
+    const char* Bytes(uint64_t len) {
+        if ((uint64_t)(end - p) < len) {
+            Fail();
+            return nullptr;
+        }
+        const char* data = p;
+        p += len;
+        return data;
+    }
+    std::string String() {
+        uint64_t len = U64();
+        const char* data = Bytes(len);
+        return data ? std::string(data, len) : std::string();
+    }
+    uint8_t Fail() {
+        ok = false;
+        p = end;
+        return 0;
+    }
+};
+
+struct Record {
+    RecordType type;
+    const char* payload;
+    size_t len;
+};
+
+// Intact records after the magic, up to the first torn or corrupt one.
+static std::vector<Record> ReadRecords(const char* data, size_t size, const char (&magic)[8]) {
+    std::vector<Record> records;
+    if (size < sizeof(magic) || std::memcmp(data, magic, sizeof(magic)) != 0) return records;
+    const char* p = data + sizeof(magic);
+    const char* end = data + size;
+    while ((size_t)(end - p) >= kFrameBytes) {
+        uint64_t len;
+        std::memcpy(&len, p, 8);
+        if (len > (uint64_t)(end - p) - kFrameBytes) break;
+        const char* typed = p + 8;
+        uint64_t stored;
+        std::memcpy(&stored, typed + 1 + len, 8);
+        ContentHash hash;
+        hash.Update(typed, 1 + len);
+        if (hash.Digest() != stored) break;
+        records.push_back({ (RecordType)(uint8_t)typed[0], typed + 1, (size_t)len });
+        p = typed + 1 + len + 8;
+    }
+    return records;
+}
+
+// Streams one framed record whose payload length is known up front.
+class RecordSink {
+public:
+    RecordSink(const std::function<void(const char*, size_t)>& write, RecordType type, uint64_t len)
+        : m_write(write) {
+        std::string head;
+        PutU64(head, len);
+        m_write(head.data(), head.size());
+        char t = (char)type;
+        Write(&t, 1);
+    }
+
+    void Write(const char* data, size_t len) {
+        m_write(data, len);
+        m_hash.Update(data, len);
+    }
+    void Write(const std::string& s) { Write(s.data(), s.size()); }
+
+    void Finish() {
+        uint64_t digest = m_hash.Digest();
+        m_write(reinterpret_cast<const char*>(&digest), 8);
+    }
+
+private:
+    const std::function<void(const char*, size_t)>& m_write;
+    ContentHash m_hash;
+};
+
+static uint64_t JournalIdOf(const fs::path& path) {
+    std::string name = path.filename().string();
+    if (name.size() <= 8 || name.compare(0, 4, "tab-") != 0 || name.compare(name.size() - 4, 4, ".wal") != 0) return 0;
+    return std::strtoull(name.c_str() + 4, nullptr, 10);
+}
+
+// Append-only handle of a journal file, plus records written to it but not synced.
+struct SessionJournal::OpenJournal {
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    std::string pending;
+    uint64_t pendingTicket = 0;            // newest command among the pending records
+
+    bool Open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+        return file != INVALID_HANDLE_VALUE;
+#else
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        return fd >= 0;
+#endif
+    }
+
+    // Write pending records and sync the data; metadata (the size) goes with it.
+    bool Sync() {
+        const char* data = pending.data();
+        size_t len = pending.size();
+#ifdef _WIN32
+        while (len > 0) {
+            DWORD written = 0;
+            if (!WriteFile(file, data, (DWORD)std::min<size_t>(len, 1u << 30), &written, NULL)) return false;
+            data += written;
+            len -= written;
+        }
+        pending.clear();
+        return FlushFileBuffers(file) != 0;
+#else
+        while (len > 0) {
+            ssize_t written = write(fd, data, len);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            len -= (size_t)written;
+        }
+        pending.clear();
+        return fdatasync(fd) == 0;
+#endif
+    }
+
+    ~OpenJournal() {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (fd >= 0) close(fd);
+#endif
+    }
+};
+
+std::string SessionJournal::DefaultDirectory() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (!base || !*base) return std::string();
+    return (fs::path(base) / "Edifier" / "session").string();
+#else
+    const char* xdg = std::getenv("XDG_STATE_HOME");
+    if (xdg && *xdg) return (fs::path(xdg) / "edifier" / "session").string();
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return std::string();
+    return (fs::path(home) / ".local" / "state" / "edifier" / "session").string();
+#endif
+}
+
+SessionJournal::SessionJournal() = default;
+
+SessionJournal::~SessionJournal() {
+    Close();
+}
+
+bool SessionJournal::Open(const std::string& dir) {
+    if (IsOpen() || dir.empty()) return false;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Cannot create session directory " << dir << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    // One instance per session directory; a second one just runs without a journal.
+    std::string lockPath = (fs::path(dir) / "lock").string();
+#ifdef _WIN32
+    HANDLE lock = CreateFileA(lockPath.c_str(), GENERIC_WRITE, 0, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (lock == INVALID_HANDLE_VALUE) {
+        std::cerr << "Session in " << dir << " is in use; unsaved tabs won't be journaled\n";
+        return false;
+    }
+    m_lock = lock;
+#else
+    int lock = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock < 0 || flock(lock, LOCK_EX | LOCK_NB) != 0) {
+        if (lock >= 0) close(lock);
+        std::cerr << "Session in " << dir << " is in use; unsaved tabs won't be journaled\n";
+        return false;
+    }
+    m_lock = reinterpret_cast<void*>((intptr_t)lock);
+#endif
+
+    m_dir = dir;
+    for (fs::directory_iterator it(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        m_nextJournal = std::max(m_nextJournal, JournalIdOf(it->path()) + 1);
+    }
+    m_stopping = false;
+    m_writer = std::thread([this] { WriterLoop(); });
+    return true;
+}
+
+void SessionJournal::Close() {
+    if (m_writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        m_writer.join();
+    }
+    m_journals.clear();
+    if (m_lock) {
+#ifdef _WIN32
+        CloseHandle(m_lock);
+#else
+        close((int)reinterpret_cast<intptr_t>(m_lock));
+#endif
+        m_lock = nullptr;
+    }
+}
+
+std::string SessionJournal::JournalPath(uint64_t journal) const {
+    return (fs::path(m_dir) / ("tab-" + std::to_string(journal) + ".wal")).string();
+}
+
+bool SessionJournal::ReadManifest(SessionManifest& out) const {
+    if (m_dir.empty()) return false;
+    std::shared_ptr<MappedFile> file = MapFile((fs::path(m_dir) / "session").string());
+    if (!file) return false;
+    std::vector<Record> records = ReadRecords(file->data, file->size, kManifestMagic);
+    if (records.size() != 1 || records[0].type != kManifestRecord) return false;
+
+    RecordReader in{ records[0].payload, records[0].payload + records[0].len };
+    SessionManifest manifest;
+    manifest.activeTab = (int)(int64_t)in.U64();
+    uint64_t count = in.U64();
+    for (uint64_t i = 0; i < count && in.ok; ++i) {
+        SessionTab tab;
+        tab.path = in.String();
+        tab.journal = in.U64();
+        tab.size = in.U64();
+        tab.modified = (int64_t)in.U64();
+        tab.cursor = in.U64();
+        tab.anchor = in.U64();
+        uint64_t topLine = in.U64();
+        std::memcpy(&tab.topLine, &topLine, 8);
+        manifest.tabs.push_back(std::move(tab));
+    }
+    if (!in.ok) return false;
+    out = std::move(manifest);
+    return true;
+}
+
+RestoredDocument SessionJournal::ReadJournal(uint64_t journal) const {
+    PROFILE_ZONE("ReadJournal");
+    MEMORY_SCOPE(MemoryTag::Documents);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        uint64_t target = m_pushed;
+        m_writtenSignal.wait(lock, [&] { return m_written >= target; });
+    }
+    RestoredDocument result;
+    std::shared_ptr<MappedFile> file = MapFile(JournalPath(journal));
+    std::vector<Record> records;
+    if (file) records = ReadRecords(file->data, file->size, kJournalMagic);
+
+    size_t snapshot = records.size();
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].type == kSnapshotRecord) snapshot = i;
+    }
+    if (snapshot == records.size()) {
+        result.error = "no intact snapshot";
+        return result;
+    }
+
+    RecordReader in{ records[snapshot].payload, records[snapshot].payload + records[snapshot].len };
+    std::shared_ptr<TextBuffer> base;
+    uint8_t eol = in.U8();
+    result.format.eol = eol <= (uint8_t)LineEnding::Mixed ? (LineEnding)eol : LineEnding::LF;
+    result.format.normalized = in.U8() != 0;
+    if (in.U8()) {
+        std::string path = in.String();
+        uint64_t size = in.U64();
+        uint64_t hash = in.U64();
+        LoadedFile loaded = LoadFile(path);
+        if (!loaded.ok || !loaded.disk.hashed || loaded.disk.size != size || loaded.disk.hash != hash) {
+            result.error = path + " changed on disk since";
+            return result;
+        }
+        base = loaded.buffer;
+        result.format = loaded.format;
+        result.disk = loaded.disk;
+        result.document.SetOriginal(base);
+        result.baseGeneration = result.document.Generation();
+    }
+
+    // Inline text is gathered into one buffer, so the pieces are built without copies.
+    struct PieceRef {
+        bool inFile;
+        uint64_t start;
+        uint64_t len;
+    };
+    std::vector<PieceRef> refs;
+    std::string text;
+    uint64_t count = in.U64();
+    for (uint64_t i = 0; i < count && in.ok; ++i) {
+        if (in.U8() == kFileRange) {
+            uint64_t start = in.U64();
+            uint64_t len = in.U64();
+            if (!base || start > base->size || len > base->size - start) in.Fail();
+            refs.push_back({ true, start, len });
+        } else {
+            uint64_t len = in.U64();
+            const char* data = in.Bytes(len);
+            if (data) {
+                refs.push_back({ false, text.size(), len });
+                text.append(data, len);
+            }
+        }
+    }
+    if (!in.ok) {
+        result.error = "corrupt snapshot";
+        return result;
+    }
+
+    DocumentSnapshot pieces;
+    std::shared_ptr<TextBuffer> inlineText = MakeTextBuffer(std::move(text));
+    pieces.buffers.push_back(inlineText);
+    if (base) pieces.buffers.push_back(base);
+    for (const PieceRef& ref : refs) {
+        const TextBuffer& buffer = ref.inFile ? *base : *inlineText;
+        pieces.pieces.push_back({ &buffer, ref.start, ref.len, Document::CountNewlines(&buffer, ref.start, ref.start + ref.len) });
+        pieces.length += ref.len;
+    }
+    Document& doc = result.document;
+    doc.Replace(0, doc.Length(), pieces);
+
+    for (size_t i = snapshot + 1; i < records.size(); ++i) {
+        if (records[i].type != kEditRecord) continue;
+        RecordReader edit{ records[i].payload, records[i].payload + records[i].len };
+        uint64_t pos = edit.U64();
+        uint64_t removed = edit.U64();
+        uint64_t len = edit.U64();
+        const char* data = edit.Bytes(len);
+        if (!edit.ok || pos > doc.Length() || removed > doc.Length() - pos) break;
+        doc.Replace(pos, removed, data, len);
+    }
+
+    result.stats = CountDocumentStats(doc);
+    result.ok = true;
+    return result;
+}
+
+uint64_t SessionJournal::Push(Command command) {
+    MEMORY_SCOPE(MemoryTag::Journal);
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ticket = command.ticket = ++m_pushed;
+        m_queue.push_back(std::move(command));
+    }
+    m_wake.notify_one();
+    return ticket;
+}
+
+JournalStatus SessionJournal::Status(uint64_t journal) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_status.find(journal);
+    return it == m_status.end() ? JournalStatus() : it->second;
+}
+
+// Writer thread: the outcome of the command with this ticket.
+void SessionJournal::Report(uint64_t journal, uint64_t ticket, bool ok) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    JournalStatus& status = m_status[journal];
+    uint64_t& mark = ok ? status.written : status.failed;
+    mark = std::max(mark, ticket);
+}
+
+uint64_t SessionJournal::WriteSnapshot(uint64_t journal, const JournalBase& base, const FileFormat& format,
+                                       DocumentSnapshot snapshot) {
+    if (!IsOpen()) return 0;
+    Command command;
+    command.kind = Command::Kind::Snapshot;
+    command.journal = journal;
+    command.base = base;
+    command.format = format;
+    command.snapshot = std::move(snapshot);
+    return Push(std::move(command));
+}
+
+// Edits queued back to back for one journal share a command, so typing costs an
+// append to its buffer rather than a queue entry per key.
+uint64_t SessionJournal::AppendEdit(uint64_t journal, size_t pos, size_t removed, const char* text, size_t len) {
+    if (!IsOpen()) return 0;
+    MEMORY_SCOPE(MemoryTag::Journal);
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.empty() || m_queue.back().kind != Command::Kind::Edit || m_queue.back().journal != journal) {
+            m_queue.emplace_back();
+            m_queue.back().kind = Command::Kind::Edit;
+            m_queue.back().journal = journal;
+            m_queue.back().ticket = ++m_pushed;
+        }
+        ticket = m_queue.back().ticket;
+        std::string& edits = m_queue.back().edits;
+        PutU64(edits, 24 + len);
+        PutU64(edits, pos);
+        PutU64(edits, removed);
+        PutU64(edits, len);
+        edits.append(text, len);
+    }
+    m_wake.notify_one();
+    return ticket;
+}
+
+void SessionJournal::Discard(uint64_t journal) {
+    if (!IsOpen()) return;
+    Command command;
+    command.kind = Command::Kind::Discard;
+    command.journal = journal;
+    Push(std::move(command));
+}
+
+void SessionJournal::WriteManifest(const SessionManifest& manifest) {
+    if (!IsOpen()) return;
+    Command command;
+    command.kind = Command::Kind::Manifest;
+    command.manifest = manifest;
+    Push(std::move(command));
+}
+
+void SessionJournal::WriterLoop() {
+    PROFILE_THREAD("Journal");
+    MEMORY_SCOPE(MemoryTag::Journal);
+    std::deque<Command> batch;
+    for (;;) {
+        uint64_t through;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) return;
+            batch.swap(m_queue);
+            through = m_pushed;
+        }
+        {
+            PROFILE_ZONE("JournalBatch");
+            for (Command& command : batch) Run(command);
+            batch.clear();
+            Commit();
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_written = through;
+        m_writtenSignal.notify_all();
+        m_wake.wait_for(lock, kCommitInterval, [this] { return m_stopping; });
+    }
+}
+
+void SessionJournal::Run(Command& command) {
+    switch (command.kind) {
+    case Command::Kind::Snapshot:
+        WriteSnapshotFile(command);
+        break;
+    case Command::Kind::Edit: {
+        auto it = m_journals.find(command.journal);
+        if (it == m_journals.end()) {
+            // Its snapshot failed: the edits have nothing to apply to until the next one.
+            Report(command.journal, command.ticket, false);
+            break;
+        }
+        it->second->pendingTicket = command.ticket;
+        std::string& out = it->second->pending;
+        const char type = (char)kEditRecord;
+        for (size_t offset = 0; offset < command.edits.size();) {
+            uint64_t len;
+            std::memcpy(&len, command.edits.data() + offset, 8);
+            const char* payload = command.edits.data() + offset + 8;
+            ContentHash hash;
+            hash.Update(&type, 1);
+            hash.Update(payload, len);
+            out.append(command.edits.data() + offset, 8);
+            out.push_back(type);
+            out.append(payload, len);
+            PutU64(out, hash.Digest());
+            offset += 8 + len;
+        }
+        break;
+    }
+    case Command::Kind::Discard: {
+        m_journals.erase(command.journal);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_status.erase(command.journal);
+        }
+        std::error_code ec;
+        fs::remove(JournalPath(command.journal), ec);
+        break;
+    }
+    case Command::Kind::Manifest:
+        WriteManifestFile(command.manifest);
+        break;
+    }
+}
+
+// A fresh journal holding just the snapshot, renamed over the old one; edits queued
+// before it are in the snapshot already.
+void SessionJournal::WriteSnapshotFile(const Command& command) {
+    const JournalBase& base = command.base;
+    const DocumentSnapshot& snapshot = command.snapshot;
+    // Text cut short under a mapping is NULs now; the journal it would replace is better.
+    if (SnapshotFaulted(snapshot)) {
+        std::cerr << "Not journaling a document whose file was cut short while open\n";
+        Report(command.journal, command.ticket, false);
+        return;
+    }
+    m_journals.erase(command.journal);
+
+    std::string head;
+    PutU8(head, (uint8_t)command.format.eol);
+    PutU8(head, command.format.normalized ? 1 : 0);
+    PutU8(head, base.buffer ? 1 : 0);
+    if (base.buffer) {
+        PutString(head, base.path);
+        PutU64(head, base.disk.size);
+        PutU64(head, base.disk.hash);
+    }
+    PutU64(head, snapshot.pieces.size());
+    uint64_t len = head.size();
+    for (const auto& piece : snapshot.pieces) {
+        len += 1 + (piece.buffer == base.buffer ? 16 : 8 + piece.length);
+    }
+
+    std::string path = JournalPath(command.journal);
+    std::string error;
+    bool written = WriteFileAtomically(path, [&](const std::function<void(const char*, size_t)>& write) {
+        write(kJournalMagic, sizeof(kJournalMagic));
+        RecordSink record(write, kSnapshotRecord, len);
+        record.Write(head);
+        std::string piece;
+        for (const auto& p : snapshot.pieces) {
+            piece.clear();
+            if (p.buffer == base.buffer) {
+                PutU8(piece, kFileRange);
+                PutU64(piece, p.start);
+                PutU64(piece, p.length);
+                record.Write(piece);
+            } else {
+                PutU8(piece, kInlineText);
+                PutU64(piece, p.length);
+                record.Write(piece);
+                record.Write(p.buffer->data + p.start, p.length);
+            }
+        }
+        record.Finish();
+    }, error);
+    if (!written) {
+        std::cerr << "Failed to write session journal " << path << ": " << error << "\n";
+        Report(command.journal, command.ticket, false);
+        return;
+    }
+    // Reading the text can be what finds the cut. Edits can't build on this one either.
+    if (SnapshotFaulted(snapshot)) {
+        Report(command.journal, command.ticket, false);
+        return;
+    }
+    Report(command.journal, command.ticket, true);
+
+    // Without a handle the edits that follow fail, and say so, until the next snapshot.
+    auto journal = std::make_unique<OpenJournal>();
+    if (journal->Open(path)) m_journals[command.journal] = std::move(journal);
+}
+
+void SessionJournal::WriteManifestFile(const SessionManifest& manifest) {
+    std::string payload;
+    PutU64(payload, (uint64_t)(int64_t)manifest.activeTab);
+    PutU64(payload, manifest.tabs.size());
+    for (const SessionTab& tab : manifest.tabs) {
+        PutString(payload, tab.path);
+        PutU64(payload, tab.journal);
+        PutU64(payload, tab.size);
+        PutU64(payload, (uint64_t)tab.modified);
+        PutU64(payload, tab.cursor);
+        PutU64(payload, tab.anchor);
+        uint64_t topLine;
+        std::memcpy(&topLine, &tab.topLine, 8);
+        PutU64(payload, topLine);
+    }
+
+    std::string path = (fs::path(m_dir) / "session").string();
+    std::string error;
+    bool written = WriteFileAtomically(path, [&](const std::function<void(const char*, size_t)>& write) {
+        write(kManifestMagic, sizeof(kManifestMagic));
+        RecordSink record(write, kManifestRecord, payload.size());
+        record.Write(payload);
+        record.Finish();
+    }, error);
+    if (!written) {
+        std::cerr << "Failed to write session " << path << ": " << error << "\n";
+        return;
+    }
+
+    // Journals of tabs closed without saving go once the session no longer lists them.
+    std::unordered_set<uint64_t> listed;
+    for (const SessionTab& tab : manifest.tabs) listed.insert(tab.journal);
+    std::error_code ec;
+    std::vector<fs::path> unlisted;
+    for (fs::directory_iterator it(m_dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        uint64_t id = JournalIdOf(it->path());
+        if (id && !listed.count(id)) unlisted.push_back(it->path());
+    }
+    for (const fs::path& stale : unlisted) {
+        uint64_t id = JournalIdOf(stale);
+        m_journals.erase(id);
+        fs::remove(stale, ec);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status.erase(id);
+    }
+}
+
+void SessionJournal::Commit() {
+    for (auto& [id, journal] : m_journals) {
+        if (journal->pending.empty()) continue;
+        bool synced = journal->Sync();
+        if (!synced) std::cerr << "Failed to sync session journal " << JournalPath(id) << "\n";
+        Report(id, journal->pendingTicket, synced);
+    }
+}
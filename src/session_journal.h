@@ -0,0 +1,178 @@
+#pragma once
+
+#include "document.h"
+#include "file_io.h"
+#include "text_stats.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Hot-exit journal: the open tabs and every tab's unsaved text survive a crash, a
+// reboot or a plain quit, and come back on the next start.
+//
+// Each modified tab has an append-only journal file. It starts with a snapshot of
+// the document and continues with the edit deltas made since. A snapshot is the
+// piece list, not the text: pieces still pointing into the file the tab loaded are
+// written as ranges of that file, identified by its fingerprint, so journaling a
+// huge file costs what was typed, not its size. Snapshots are rewritten (a new
+// file renamed over the old one) when the deltas grow past a threshold or an edit
+// can't be written as a delta, e.g. a Replace All.
+//
+// The UI thread only queues records. A writer thread writes them and group-commits:
+// every journal touched by a batch is synced once, then the thread waits a moment
+// for the next batch. Records carry a checksum, and reading stops at the first torn
+// one, so a crash loses at most the last moments of typing.
+//
+// Restoring loads the base file the normal way and replays the journal's records
+// on top, which is proportional to what was journaled. If the base file has
+// changed since, its ranges can't be trusted and reading fails; the journal is
+// left alone for the user to retry or discard. At exit the editor rewrites the
+// journals of all but huge documents with their text inline, so that only a crash
+// can leave one depending on its base file.
+
+// Where a snapshot's unchanged text comes from: the file the tab loaded.
+struct JournalBase {
+    std::string path;
+    FileFingerprint disk;                  // as loaded; must still match on restore
+    const TextBuffer* buffer = nullptr;    // pieces of it become file ranges; null writes all text
+};
+
+// One tab of a session, in tab order. Enough to show the tab and put its view back
+// without reading the file: restored tabs load when first activated.
+struct SessionTab {
+    std::string path;                      // empty for untitled tabs
+    uint64_t journal = 0;                  // journal with unsaved text; 0 when the file has none
+    uint64_t size = 0;                     // the file as last seen; the view applies only if it still matches
+    int64_t modified = 0;                  // file_time_type ticks
+    uint64_t cursor = 0;
+    uint64_t anchor = 0;
+    double topLine = 0.0;
+
+    bool operator==(const SessionTab& other) const {
+        return path == other.path && journal == other.journal && size == other.size &&
+               modified == other.modified && cursor == other.cursor && anchor == other.anchor &&
+               topLine == other.topLine;
+    }
+};
+
+struct SessionManifest {
+    std::vector<SessionTab> tabs;
+    int activeTab = -1;
+
+    bool operator==(const SessionManifest& other) const {
+        return activeTab == other.activeTab && tabs == other.tabs;
+    }
+    bool operator!=(const SessionManifest& other) const { return !(*this == other); }
+};
+
+// A journal read back, as of its last intact record.
+struct RestoredDocument {
+    bool ok = false;
+    std::string error;
+    Document document;
+    FileFormat format;
+    TextStats stats;
+    FileFingerprint disk;                  // the base file; exists is false without one
+    uint64_t baseGeneration = 0;           // document generation that matches the base file
+};
+
+// What the writer has made of one journal, by the tickets WriteSnapshot and
+// AppendEdit hand out in queue order. Everything up to written is on disk. failed
+// is the last command that couldn't be written; while it is newer than written the
+// journal is behind the document, until a snapshot succeeds.
+struct JournalStatus {
+    uint64_t written = 0;
+    uint64_t failed = 0;
+
+    bool Failing() const { return failed > written; }
+};
+
+class SessionJournal {
+public:
+    SessionJournal();
+    ~SessionJournal();
+
+    SessionJournal(const SessionJournal&) = delete;
+    SessionJournal& operator=(const SessionJournal&) = delete;
+
+    // $XDG_STATE_HOME/edifier/session, or ~/.local/state/edifier/session.
+    static std::string DefaultDirectory();
+
+    // Take the session kept in dir, creating it if needed, and start the writer.
+    // False if another instance holds it or it can't be created; journaling is
+    // then off and every call below does nothing.
+    bool Open(const std::string& dir);
+    bool IsOpen() const { return m_writer.joinable(); }
+
+    // Write and sync everything queued, then stop the writer.
+    void Close();
+
+    // The session as last written, to restore. Call after Open.
+    bool ReadManifest(SessionManifest& out) const;
+
+    // Rebuild a journal's document. Blocking; meant for a worker. Waits for records
+    // queued before the call, so a tab spilled a moment ago reads back whole.
+    RestoredDocument ReadJournal(uint64_t journal) const;
+
+    // An id no journal in the directory uses yet.
+    uint64_t NewJournal() { return m_nextJournal++; }
+
+    // UI thread. Each call copies what it needs and returns; the writer thread
+    // does the rest. A journal's edits apply to its latest snapshot. The ticket
+    // returned shows up in Status once the command is on disk; 0 when closed.
+    uint64_t WriteSnapshot(uint64_t journal, const JournalBase& base, const FileFormat& format,
+                           DocumentSnapshot snapshot);
+    uint64_t AppendEdit(uint64_t journal, size_t pos, size_t removed, const char* text, size_t len);
+    JournalStatus Status(uint64_t journal) const;
+    void Discard(uint64_t journal);
+    // Journals the manifest doesn't list are deleted once it is on disk.
+    void WriteManifest(const SessionManifest& manifest);
+
+private:
+    struct Command {
+        enum class Kind : uint8_t { Snapshot, Edit, Discard, Manifest };
+        Kind kind = Kind::Edit;
+        uint64_t journal = 0;
+        uint64_t ticket = 0;               // its place in the queue
+        JournalBase base;
+        FileFormat format;
+        DocumentSnapshot snapshot;
+        std::string edits;                 // [u64 length][edit payload], one after another
+        SessionManifest manifest;
+    };
+
+    struct OpenJournal;
+
+    std::string JournalPath(uint64_t journal) const;
+    uint64_t Push(Command command);
+    void Report(uint64_t journal, uint64_t ticket, bool ok);
+    void WriterLoop();
+    void Run(Command& command);
+    void WriteSnapshotFile(const Command& command);
+    void WriteManifestFile(const SessionManifest& manifest);
+    void Commit();
+
+    std::string m_dir;
+    uint64_t m_nextJournal = 1;
+    void* m_lock = nullptr;                // lock file handle held while open
+
+    std::thread m_writer;
+    mutable std::mutex m_mutex;            // guards the queue, the counts and m_stopping
+    std::condition_variable m_wake;
+    mutable std::condition_variable m_writtenSignal;
+    std::deque<Command> m_queue;
+    uint64_t m_pushed = 0;                 // commands queued so far
+    uint64_t m_written = 0;                // of those, written to their files
+    bool m_stopping = false;
+    std::unordered_map<uint64_t, JournalStatus> m_status;
+
+    // Writer thread only.
+    std::unordered_map<uint64_t, std::unique_ptr<OpenJournal>> m_journals;
+};
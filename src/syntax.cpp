@@ -0,0 +1,589 @@
+#include "syntax.h"
+
+#include "memory_stats.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+// What a language's lexer recognizes. Lists are space separated.
+struct LanguageSpec {
+    const char* name;
+    const char* extensions;            // lowercase, with the dot
+    const char* lineComments[2];
+    const char* blockComment[2];       // open, close
+    const char* longStrings[2][2];     // multi-line string delimiters: open, close
+    const char* quotes;                // single-line string quotes; '\' escapes
+    bool preprocessor;                 // '#' directives at the start of a line
+    bool markup;                       // <tag> names are keywords; quotes only count inside tags
+    bool caseInsensitive;              // keyword lists are lowercase
+    const char* keywords;
+    const char* types;
+};
+
+static const LanguageSpec kLanguageSpecs[] = {
+    { "C/C++", ".c .h .cpp .hpp .cc .cxx",
+      { "//" }, { "/*", "*/" }, {}, "\"'", true, false, false,
+      "alignas alignof asm auto break case catch class const consteval constexpr constinit const_cast "
+      "continue co_await co_return co_yield decltype default delete do dynamic_cast else enum explicit "
+      "export extern false final for friend goto if inline mutable namespace new noexcept nullptr "
+      "operator override private protected public register reinterpret_cast requires return sizeof "
+      "static static_assert static_cast struct switch template this thread_local throw true try typedef "
+      "typeid typename union using virtual volatile while NULL",
+      "bool char char8_t char16_t char32_t double float int long short signed unsigned void wchar_t "
+      "size_t ptrdiff_t int8_t int16_t int32_t int64_t uint8_t uint16_t uint32_t uint64_t intptr_t uintptr_t "
+      "std string vector map" },
+    { "C#", ".cs",
+      { "//" }, { "/*", "*/" }, {}, "\"'", true, false, false,
+      "abstract as async await base break case catch checked class const continue default delegate do "
+      "else enum event explicit extern false finally fixed for foreach get goto if implicit in interface "
+      "internal is lock namespace new null operator out override params private protected public readonly "
+      "record ref return sealed set sizeof stackalloc static struct switch this throw true try typeof "
+      "unchecked unsafe using var virtual volatile when where while yield",
+      "bool byte char decimal double dynamic float int long nint nuint object sbyte short string uint ulong "
+      "ushort void" },
+    { "Java", ".java",
+      { "//" }, { "/*", "*/" }, { { "\"\"\"", "\"\"\"" } }, "\"'", false, false, false,
+      "abstract assert break case catch class const continue default do else enum extends false final "
+      "finally for goto if implements import instanceof interface native new null package private "
+      "protected public record return sealed static strictfp super switch synchronized this throw throws "
+      "transient true try var volatile while yield",
+      "boolean byte char double float int long short void String Object" },
+    { "JavaScript", ".js .jsx .ts .tsx",
+      { "//" }, { "/*", "*/" }, { { "`", "`" } }, "\"'", false, false, false,
+      "abstract as async await break case catch class const continue debugger declare default delete do "
+      "else enum export extends false finally for from function get if implements import in instanceof "
+      "interface let namespace new null of private protected public readonly return set static super "
+      "switch this throw true try type typeof undefined var void while with yield",
+      "any bigint boolean never number object string symbol unknown Array Map Promise Set" },
+    { "Go", ".go",
+      { "//" }, { "/*", "*/" }, { { "`", "`" } }, "\"'", false, false, false,
+      "break case chan const continue default defer else fallthrough false for func go goto if import "
+      "interface iota map nil package range return select struct switch true type var",
+      "any bool byte complex64 complex128 error float32 float64 int int8 int16 int32 int64 rune string "
+      "uint uint8 uint16 uint32 uint64 uintptr" },
+    { "Rust", ".rs",
+      { "//" }, { "/*", "*/" }, {}, "\"", false, false, false,
+      "as async await break const continue crate dyn else enum extern false fn for if impl in let loop "
+      "match mod move mut pub ref return self Self static struct super trait true type unsafe use where "
+      "while",
+      "bool char f32 f64 i8 i16 i32 i64 i128 isize str u8 u16 u32 u64 u128 usize Box Option Result String Vec" },
+    { "Swift", ".swift",
+      { "//" }, { "/*", "*/" }, { { "\"\"\"", "\"\"\"" } }, "\"", false, false, false,
+      "as associatedtype async await break case catch class continue default defer deinit do else enum "
+      "extension fallthrough false fileprivate for func guard if import in init inout internal is let nil "
+      "open operator private protocol public repeat rethrows return self Self static struct subscript "
+      "super switch throw throws true try typealias var where while",
+      "Any Bool Character Double Float Int Int8 Int16 Int32 Int64 String UInt UInt8 UInt16 UInt32 UInt64 Void" },
+    { "Kotlin", ".kt",
+      { "//" }, { "/*", "*/" }, { { "\"\"\"", "\"\"\"" } }, "\"'", false, false, false,
+      "as break class companion continue data do else enum false for fun if import in interface internal "
+      "is lateinit null object open override package private protected public return sealed super this "
+      "throw true try typealias val var when while",
+      "Any Boolean Byte Char Double Float Int Long Nothing Short String Unit" },
+    { "Scala", ".scala",
+      { "//" }, { "/*", "*/" }, { { "\"\"\"", "\"\"\"" } }, "\"'", false, false, false,
+      "abstract case catch class def do else enum extends false final finally for given if implicit import "
+      "lazy match new null object override package private protected return sealed super then this throw "
+      "trait true try type using val var while with yield",
+      "Any AnyRef Boolean Byte Char Double Float Int Long Nothing Short String Unit" },
+    { "Python", ".py",
+      { "#" }, {}, { { "\"\"\"", "\"\"\"" }, { "'''", "'''" } }, "\"'", false, false, false,
+      "and as assert async await break class continue def del elif else except False finally for from "
+      "global if import in is lambda None nonlocal not or pass raise return True try while with yield",
+      "bool bytes dict float int list object set str tuple" },
+    { "Ruby", ".rb",
+      { "#" }, { "=begin", "=end" }, {}, "\"'", false, false, false,
+      "alias and begin break case class def defined do else elsif end ensure false for if in module next "
+      "nil not or redo rescue retry return self super then true undef unless until when while yield",
+      "" },
+    { "Shell", ".sh .bash .zsh .fish",
+      { "#" }, {}, {}, "\"'", false, false, false,
+      "case do done elif else esac export fi for function if in local readonly return select set shift "
+      "then trap until unset while",
+      "" },
+    { "PowerShell", ".ps1",
+      { "#" }, { "<#", "#>" }, {}, "\"'", false, false, true,
+      "begin break catch class continue data do dynamicparam else elseif end enum exit filter finally for "
+      "foreach function if in param process return switch throw trap try until using while",
+      "" },
+    { "CSS", ".css",
+      {}, { "/*", "*/" }, {}, "\"'", false, false, false,
+      "important inherit initial none auto",
+      "" },
+    { "JSON", ".json",
+      {}, {}, {}, "\"", false, false, false,
+      "true false null",
+      "" },
+    { "YAML", ".yaml .yml",
+      { "#" }, {}, {}, "\"'", false, false, false,
+      "true false null yes no on off",
+      "" },
+    { "Config", ".toml .ini .cfg .env",
+      { "#", ";" }, {}, { { "\"\"\"", "\"\"\"" }, { "'''", "'''" } }, "\"'", false, false, false,
+      "true false",
+      "" },
+    { "HTML/XML", ".html .htm .xml",
+      {}, { "<!--", "-->" }, {}, "\"'", false, true, false,
+      "",
+      "" },
+};
+
+// Byte classes, looked up once per byte by the lexer.
+enum : uint8_t {
+    kCharSpace = 1,
+    kCharWordStart = 2,
+    kCharWord = 4,
+    kCharDigit = 8,
+    kCharDelimiter = 16,    // may open a comment, string or tag, or end a tag
+};
+
+struct LanguageDef {
+    const LanguageSpec* spec = nullptr;
+    std::unordered_set<std::string_view> keywords;
+    std::unordered_set<std::string_view> types;
+    uint8_t charClass[256] = {};
+    uint32_t wordLengths[256] = {};     // bit n: some keyword or type of length n starts with this byte
+};
+
+static const size_t kMaxKeywordLength = 31;
+
+// States past normal: a block comment, then one per long-string delimiter.
+static const LexState kLexBlockComment = 1;
+static const LexState kLexLongString = 2;
+
+static void AddWords(LanguageDef& lang, std::unordered_set<std::string_view>& set, const char* list) {
+    std::string_view words(list ? list : "");
+    size_t pos = 0;
+    while (pos < words.size()) {
+        size_t end = words.find(' ', pos);
+        if (end == std::string_view::npos) end = words.size();
+        size_t len = end - pos;
+        if (len > 0 && len <= kMaxKeywordLength) {
+            set.insert(words.substr(pos, len));
+            unsigned char first = (unsigned char)words[pos];
+            lang.wordLengths[first] |= 1u << len;
+            if (lang.spec->caseInsensitive) lang.wordLengths[std::toupper(first)] |= 1u << len;
+        }
+        pos = end + 1;
+    }
+}
+
+static void MarkDelimiter(LanguageDef& lang, const char* delimiter) {
+    if (delimiter && *delimiter) lang.charClass[(unsigned char)*delimiter] |= kCharDelimiter;
+}
+
+static LanguageDef BuildLanguage(const LanguageSpec& spec) {
+    LanguageDef lang;
+    lang.spec = &spec;
+    AddWords(lang, lang.keywords, spec.keywords);
+    AddWords(lang, lang.types, spec.types);
+
+    for (int c = 0; c < 256; ++c) {
+        uint8_t cls = 0;
+        if (c == ' ' || c == '\t' || c == '\r') cls |= kCharSpace;
+        if (std::isalpha(c) || c == '_') cls |= kCharWordStart | kCharWord;
+        if (std::isdigit(c)) cls |= kCharWord | kCharDigit;
+        lang.charClass[c] = cls;
+    }
+    for (const char* comment : spec.lineComments) MarkDelimiter(lang, comment);
+    MarkDelimiter(lang, spec.blockComment[0]);
+    for (const auto& delimiters : spec.longStrings) MarkDelimiter(lang, delimiters[0]);
+    for (const char* quote = spec.quotes; *quote; ++quote) lang.charClass[(unsigned char)*quote] |= kCharDelimiter;
+    if (spec.preprocessor) MarkDelimiter(lang, "#");
+    if (spec.markup) {
+        MarkDelimiter(lang, "<");
+        MarkDelimiter(lang, ">");
+    }
+    return lang;
+}
+
+static const std::vector<LanguageDef>& Languages() {
+    static const std::vector<LanguageDef> languages = [] {
+        std::vector<LanguageDef> result;
+        for (const LanguageSpec& spec : kLanguageSpecs) result.push_back(BuildLanguage(spec));
+        return result;
+    }();
+    return languages;
+}
+
+const char* TokenKindName(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::Text: return "Text";
+        case TokenKind::Keyword: return "Keyword";
+        case TokenKind::Type: return "Type";
+        case TokenKind::Number: return "Number";
+        case TokenKind::String: return "String";
+        case TokenKind::Comment: return "Comment";
+        case TokenKind::Preprocessor: return "Preprocessor";
+        default: return "?";
+    }
+}
+
+const LanguageDef* LanguageForPath(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    if (ext.empty()) return nullptr;
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
+
+    for (const LanguageDef& lang : Languages()) {
+        std::string_view list(lang.spec->extensions);
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(' ', pos);
+            if (end == std::string_view::npos) end = list.size();
+            if (list.substr(pos, end - pos) == ext) return &lang;
+            pos = end + 1;
+        }
+    }
+    return nullptr;
+}
+
+const char* LanguageName(const LanguageDef* lang) {
+    return lang ? lang->spec->name : "Plain Text";
+}
+
+static bool StartsWith(const char* text, size_t len, size_t pos, const char* s) {
+    size_t n = std::strlen(s);
+    return len - pos >= n && std::memcmp(text + pos, s, n) == 0;
+}
+
+// Position just past the first close at or after from, or npos. With escapes a
+// backslash hides the byte after it.
+static size_t FindClose(const char* text, size_t len, size_t from, const char* close, bool escapes) {
+    size_t n = std::strlen(close);
+    for (size_t i = from; i + n <= len; ++i) {
+        if (escapes && text[i] == '\\') {
+            ++i;
+            continue;
+        }
+        if (std::memcmp(text + i, close, n) == 0) return i + n;
+    }
+    return std::string_view::npos;
+}
+
+static TokenKind ClassifyWord(const LanguageDef& lang, const char* word, size_t len) {
+    // Most words are neither; the length filter keeps them away from the hash sets.
+    if (len > kMaxKeywordLength || !(lang.wordLengths[(unsigned char)word[0]] & (1u << len))) return TokenKind::Text;
+    std::string_view key(word, len);
+    char lower[kMaxKeywordLength];
+    if (lang.spec->caseInsensitive) {
+        for (size_t i = 0; i < len; ++i) lower[i] = (char)std::tolower((unsigned char)word[i]);
+        key = std::string_view(lower, len);
+    }
+    if (lang.keywords.count(key)) return TokenKind::Keyword;
+    if (lang.types.count(key)) return TokenKind::Type;
+    return TokenKind::Text;
+}
+
+LexState LexLine(const LanguageDef& lang, LexState state, const char* text, size_t len,
+                 std::vector<SyntaxToken>* out) {
+    const LanguageSpec& spec = *lang.spec;
+    const uint8_t* charClass = lang.charClass;
+    auto emit = [&](size_t begin, size_t end, TokenKind kind) {
+        if (out && end > begin && kind != TokenKind::Text) {
+            out->push_back(SyntaxToken{ (uint32_t)begin, (uint32_t)end, kind });
+        }
+    };
+    auto isWordChar = [&](size_t at) { return (charClass[(unsigned char)text[at]] & kCharWord) != 0; };
+
+    // Finish what the previous line left open.
+    size_t i = 0;
+    const char* openClose = nullptr;
+    TokenKind openKind = TokenKind::Comment;
+    if (state == kLexBlockComment && spec.blockComment[1]) {
+        openClose = spec.blockComment[1];
+    } else if (state >= kLexLongString && state - kLexLongString < 2 && spec.longStrings[state - kLexLongString][1]) {
+        openClose = spec.longStrings[state - kLexLongString][1];
+        openKind = TokenKind::String;
+    }
+    if (openClose) {
+        size_t end = FindClose(text, len, 0, openClose, openKind == TokenKind::String);
+        if (end == std::string_view::npos) {
+            emit(0, len, openKind);
+            return state;
+        }
+        emit(0, end, openKind);
+        i = end;
+    }
+
+    bool lineStart = i == 0;     // nothing but whitespace so far
+    bool inTag = false;
+    while (i < len) {
+        unsigned char c = (unsigned char)text[i];
+        uint8_t cls = charClass[c];
+        if (cls & kCharSpace) {
+            ++i;
+            continue;
+        }
+        bool atLineStart = lineStart;
+        lineStart = false;
+
+        if (cls & kCharWordStart) {
+            size_t j = i + 1;
+            while (j < len && isWordChar(j)) ++j;
+            if (!spec.markup) emit(i, j, ClassifyWord(lang, text + i, j - i));
+            i = j;
+            continue;
+        }
+
+        if ((cls & kCharDigit) || (c == '.' && i + 1 < len && (charClass[(unsigned char)text[i + 1]] & kCharDigit))) {
+            size_t j = i + 1;
+            while (j < len && (isWordChar(j) || text[j] == '.')) ++j;
+            emit(i, j, TokenKind::Number);
+            i = j;
+            continue;
+        }
+
+        if (!(cls & kCharDelimiter)) {
+            ++i;
+            continue;
+        }
+
+        if (spec.preprocessor && atLineStart && c == '#') {
+            size_t end = len;
+            for (const char* comment : spec.lineComments) {
+                if (!comment) continue;
+                const char* found = std::search(text + i, text + len, comment, comment + std::strlen(comment));
+                end = std::min(end, (size_t)(found - text));
+            }
+            emit(i, end, TokenKind::Preprocessor);
+            i = end;
+            continue;
+        }
+
+        if (spec.blockComment[0] && StartsWith(text, len, i, spec.blockComment[0])) {
+            size_t end = FindClose(text, len, i + std::strlen(spec.blockComment[0]), spec.blockComment[1], false);
+            if (end == std::string_view::npos) {
+                emit(i, len, TokenKind::Comment);
+                return kLexBlockComment;
+            }
+            emit(i, end, TokenKind::Comment);
+            i = end;
+            continue;
+        }
+
+        bool lineComment = false;
+        for (const char* comment : spec.lineComments) {
+            if (comment && StartsWith(text, len, i, comment)) lineComment = true;
+        }
+        if (lineComment) {
+            emit(i, len, TokenKind::Comment);
+            return kLexNormal;
+        }
+
+        bool longString = false;
+        for (size_t k = 0; k < 2 && !longString; ++k) {
+            const char* open = spec.longStrings[k][0];
+            if (!open || !StartsWith(text, len, i, open)) continue;
+            longString = true;
+            size_t end = FindClose(text, len, i + std::strlen(open), spec.longStrings[k][1], true);
+            if (end == std::string_view::npos) {
+                emit(i, len, TokenKind::String);
+                return (LexState)(kLexLongString + k);
+            }
+            emit(i, end, TokenKind::String);
+            i = end;
+        }
+        if (longString) continue;
+
+        if (spec.markup && c == '<') {
+            size_t j = i + 1;
+            if (j < len && (text[j] == '/' || text[j] == '?' || text[j] == '!')) ++j;
+            size_t nameStart = j;
+            while (j < len && (isWordChar(j) || text[j] == '-' || text[j] == ':')) ++j;
+            emit(nameStart, j, TokenKind::Keyword);
+            inTag = true;
+            i = j;
+            continue;
+        }
+        if (spec.markup && c == '>') {
+            inTag = false;
+            ++i;
+            continue;
+        }
+
+        if (c != '\0' && std::strchr(spec.quotes, c) && (!spec.markup || inTag)) {
+            size_t j = i + 1;
+            while (j < len) {
+                if (text[j] == '\\') {
+                    j += 2;
+                } else if ((unsigned char)text[j++] == c) {
+                    break;
+                }
+            }
+            j = std::min(j, len);
+            emit(i, j, TokenKind::String);
+            i = j;
+            continue;
+        }
+        ++i;
+    }
+    return kLexNormal;
+}
+
+// Lexed as one run, then cut back to its last complete line. The first block of an
+// Update is small, since after an edit the states usually converge within a few
+// lines, and each one after is twice as large.
+static const size_t kLexFirstBlock = 512;
+static const size_t kLexBlock = 256 * 1024;
+
+// doc[pos, pos + len) as one contiguous run: in place when it lies inside a single
+// piece, else copied into scratch.
+static const char* ContiguousRange(const Document& doc, size_t pos, size_t len, std::string& scratch) {
+    const char* first = nullptr;
+    size_t firstLen = 0;
+    doc.ForEachChunk(pos, len, [&](const char* data, size_t n) {
+        if (!first) {
+            first = data;
+            firstLen = n;
+        }
+    });
+    if (first && firstLen == len) return first;
+
+    scratch.clear();
+    doc.CopyRange(pos, len, scratch);
+    return scratch.data();
+}
+
+void SyntaxHighlighter::SetLanguage(const LanguageDef* lang) {
+    if (lang == m_lang) return;
+    m_lang = lang;
+    Reset();
+}
+
+void SyntaxHighlighter::Reset() {
+    m_endStates.clear();
+    m_endStates.shrink_to_fit();
+    m_verified = 0;
+    m_editEnd = 0;
+    m_lineCount = 0;
+    m_generation = (uint64_t)-1;
+}
+
+LexState SyntaxHighlighter::LineStartState(size_t line) const {
+    if (line == 0 || line - 1 >= m_endStates.size()) return kLexNormal;
+    return m_endStates[line - 1];
+}
+
+// Records the end state of line, the first unverified one. True when the state
+// converged with the one from before the edits, which makes every line after it
+// current again.
+bool SyntaxHighlighter::StoreEndState(size_t line, LexState state) {
+    if (line < m_endStates.size()) {
+        bool converged = line >= m_editEnd && m_endStates[line] == state;
+        m_endStates[line] = state;
+        if (converged) {
+            m_verified = m_endStates.size();
+            m_editEnd = 0;
+            return true;
+        }
+    } else {
+        m_endStates.push_back(state);
+    }
+    m_verified = line + 1;
+    if (m_verified == m_endStates.size()) m_editEnd = 0;   // past every edit
+    return false;
+}
+
+bool SyntaxHighlighter::Update(const Document& doc, size_t throughLine, size_t budget) {
+    if (!m_lang) return true;
+    if (doc.Generation() != m_generation) {
+        Reset();
+        m_generation = doc.Generation();
+        m_lineCount = doc.LineCount();
+    }
+    // The start state of throughLine is the end state of the line before it.
+    throughLine = std::min(throughLine, m_lineCount - 1);
+    if (m_verified >= throughLine) return true;
+
+    PROFILE_ZONE("SyntaxUpdate");
+    MEMORY_SCOPE(MemoryTag::Syntax);
+    const size_t docLen = doc.Length();
+    size_t line = m_verified;
+    size_t pos = doc.LineStart(line);
+    size_t spent = 0;
+    size_t block = kLexFirstBlock;
+    while (line < throughLine && spent < budget) {
+        size_t blockLen = std::min(block, docLen - pos);
+        block = std::min(block * 2, kLexBlock);
+        const char* data = ContiguousRange(doc, pos, blockLen, m_scratch);
+        size_t offset = 0;
+        bool converged = false;
+        while (line < throughLine && offset < blockLen && !converged) {
+            const char* newline = (const char*)std::memchr(data + offset, '\n', blockLen - offset);
+            if (!newline && pos + blockLen < docLen) break;     // the line goes on past the block
+            size_t lineLen = newline ? (size_t)(newline - data) - offset : blockLen - offset;
+            LexState state = LexLine(*m_lang, LineStartState(line), data + offset, lineLen, nullptr);
+            converged = StoreEndState(line++, state);
+            offset += lineLen + 1;
+        }
+
+        if (offset == 0 && !converged) {
+            // A line longer than the block: lexed on its own, or not at all.
+            size_t lineLen = doc.LineEnd(line) - pos;
+            LexState state = kLexNormal;
+            if (lineLen <= kMaxLineBytes) {
+                data = ContiguousRange(doc, pos, lineLen, m_scratch);
+                state = LexLine(*m_lang, LineStartState(line), data, lineLen, nullptr);
+            }
+            converged = StoreEndState(line++, state);
+            offset = lineLen + 1;
+        }
+
+        spent += offset;
+        if (converged) {
+            line = m_verified;
+            if (line >= throughLine) break;
+            pos = doc.LineStart(line);
+        } else {
+            pos = std::min(docLen, pos + offset);
+        }
+    }
+    return m_verified >= throughLine;
+}
+
+void SyntaxHighlighter::OnEdit(const Document& doc, const EditDelta& delta) {
+    MEMORY_SCOPE(MemoryTag::Syntax);
+    if (!m_lang || m_generation == (uint64_t)-1) return;
+    // Replace bumps the generation at most twice; anything else means the document
+    // changed without us.
+    if (delta.generation - m_generation > 2) {
+        m_generation = (uint64_t)-1;    // out of step; Update starts over
+        return;
+    }
+
+    // The edited lines, in new and old numbering; lines before first are unchanged.
+    size_t first = doc.LineOfOffset(delta.pos);
+    size_t newLast = doc.LineOfOffset(delta.pos + delta.inserted);
+    size_t lineCount = doc.LineCount();
+    size_t oldLast = newLast + m_lineCount - lineCount;
+
+    // Earlier edits not yet lexed through stay inside the convergence window.
+    if (m_editEnd > oldLast) m_editEnd = m_editEnd + lineCount - m_lineCount;
+    m_editEnd = std::max(m_editEnd, newLast + 1);
+    m_generation = delta.generation;
+    m_lineCount = lineCount;
+
+    if (first >= m_endStates.size()) return;
+    if (oldLast >= m_endStates.size()) {
+        m_endStates.resize(first);      // nothing known past the edit
+    } else if (oldLast == newLast) {
+        std::fill(m_endStates.begin() + first, m_endStates.begin() + newLast + 1, kLexNormal);
+    } else {
+        m_endStates.erase(m_endStates.begin() + first, m_endStates.begin() + oldLast + 1);
+        m_endStates.insert(m_endStates.begin() + first, newLast - first + 1, kLexNormal);
+    }
+    m_verified = std::min(m_verified, first);
+}
+
+void SyntaxHighlighter::LexVisibleLine(size_t line, const char* text, size_t len, std::vector<SyntaxToken>& out) const {
+    out.clear();
+    if (!m_lang) return;
+    LexLine(*m_lang, LineStartState(line), text, len, &out);
+}
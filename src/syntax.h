@@ -0,0 +1,94 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Syntax highlighting for the editor. Each language is a small table (comment and
+// string delimiters, keyword and type lists) read by one line-at-a-time lexer; the
+// state a line ends in (inside a block comment or a multi-line string) is what the
+// next line starts with, so it is the only thing cached between frames.
+
+enum class TokenKind : uint8_t { Text, Keyword, Type, Number, String, Comment, Preprocessor, Count };
+
+const char* TokenKindName(TokenKind kind);
+
+// A colored span of a line, in bytes. Plain text between spans has none.
+struct SyntaxToken {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    TokenKind kind = TokenKind::Text;
+};
+
+struct LanguageDef;
+
+// Language of a file by extension (case-insensitive); null for plain text.
+const LanguageDef* LanguageForPath(const std::string& path);
+const char* LanguageName(const LanguageDef* lang);
+
+// Lexer state at a line boundary: normal code, a block comment, or a multi-line
+// string (one state per kind of delimiter the language has).
+using LexState = uint8_t;
+static const LexState kLexNormal = 0;
+
+// Lex one line (without its '\n') starting in state, appending its colored spans
+// to out when given. Returns the state the next line starts in.
+LexState LexLine(const LanguageDef& lang, LexState state, const char* text, size_t len,
+                 std::vector<SyntaxToken>* out);
+
+// The lexer state at every line start of one document, filled in lazily. Update
+// only lexes up to the line the view needs, a budget of bytes per call, so a frame
+// never pays for text nobody is looking at; the view then lexes just its visible
+// lines from the cached start states.
+//
+// Edits are folded in from their EditDelta: the states of the edited lines are
+// dropped and the ones after are shifted but kept. Lexing resumes at the first
+// edited line and stops as soon as a line past the edit ends in the state it had
+// before, since every later line is then unchanged too.
+class SyntaxHighlighter {
+public:
+    // Lines longer than this are not lexed; the next line starts in normal state.
+    static const size_t kMaxLineBytes = 1024 * 1024;
+
+    void SetLanguage(const LanguageDef* lang);
+    const LanguageDef* Language() const { return m_lang; }
+    bool Active() const { return m_lang != nullptr; }
+
+    // Forget every state, e.g. after the text was replaced wholesale.
+    void Reset();
+
+    // Lex up to budget more bytes, stopping once the state at the start of
+    // throughLine is known. Restarts if the document changed without an OnEdit.
+    // True when nothing up to throughLine is left to lex.
+    bool Update(const Document& doc, size_t throughLine, size_t budget);
+
+    // Call after every edit, with the delta Document::Replace returned.
+    void OnEdit(const Document& doc, const EditDelta& delta);
+
+    // State at the start of line. Lines not lexed yet since an edit get the state
+    // from before it, and lines never reached get normal state, until Update
+    // catches up.
+    LexState LineStartState(size_t line) const;
+
+    // Colored spans of a line's text (or a prefix of it), lexed from its start state.
+    void LexVisibleLine(size_t line, const char* text, size_t len, std::vector<SyntaxToken>& out) const;
+
+    size_t VerifiedLines() const { return m_verified; }
+
+    // Heap held by the line states and scratch space.
+    size_t MemoryUsage() const { return m_endStates.capacity() * sizeof(LexState) + m_scratch.capacity(); }
+
+private:
+    bool StoreEndState(size_t line, LexState state);
+
+    const LanguageDef* m_lang = nullptr;
+    std::vector<LexState> m_endStates;     // state after line i, i < size()
+    size_t m_verified = 0;                 // m_endStates[0, m_verified) are current
+    size_t m_editEnd = 0;                  // first line past the edits since; convergence is checked from here
+    size_t m_lineCount = 0;                // line count the states refer to
+    uint64_t m_generation = (uint64_t)-1;
+    std::string m_scratch;                 // blocks that straddle pieces are copied here
+};
@@ -0,0 +1,447 @@
+#include "text_search.h"
+#include "file_io.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "text_stats.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EDIFIER_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Files below this are read into a reused buffer; mapping them costs more than it saves.
+static const size_t kReadThreshold = 64 * 1024;
+
+// Longer lines (minified code, data dumps) are not handed to std::regex, whose
+// backtracking recurses per character and can exhaust the stack.
+static const size_t kMaxRegexLine = 64 * 1024;
+
+// Preview text kept per hit.
+static const size_t kPreviewBytes = 200;
+static const size_t kPreviewContext = 60;
+
+static inline unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static inline unsigned char OtherCase(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return (unsigned char)(c - 32);
+    if (c >= 'A' && c <= 'Z') return (unsigned char)(c + 32);
+    return c;
+}
+
+static inline unsigned CountTrailingZeros(uint32_t v) {
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(v);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return (unsigned)index;
+#else
+    unsigned n = 0;
+    while (!(v & 1u)) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+// Longest run of plain characters outside groups in an ECMAScript pattern. Every
+// match contains it unless the pattern has a top-level alternative.
+static std::string RequiredRegexLiteral(const std::string& pattern) {
+    std::string best, run;
+    int depth = 0;
+    auto endRun = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+    auto dropLast = [&] {    // the previous character turned out optional
+        while (!run.empty() && ((unsigned char)run.back() & 0xC0) == 0x80) run.pop_back();
+        if (!run.empty()) run.pop_back();
+        endRun();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        switch (c) {
+        case '|':
+            if (depth == 0) return std::string();
+            break;
+        case '(':
+            ++depth;
+            endRun();
+            break;
+        case ')':
+            if (depth > 0) --depth;
+            endRun();
+            break;
+        case '[':
+            // Skip the class; a ']' right after '[' or '[^' is a member, not the end.
+            ++i;
+            if (i < pattern.size() && pattern[i] == '^') ++i;
+            if (i < pattern.size() && pattern[i] == ']') ++i;
+            while (i < pattern.size() && pattern[i] != ']') {
+                if (pattern[i] == '\\') ++i;
+                ++i;
+            }
+            endRun();
+            break;
+        case '?':
+        case '*':
+            dropLast();
+            break;
+        case '{':
+            dropLast();
+            while (i < pattern.size() && pattern[i] != '}') ++i;
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            endRun();
+            break;
+        case '\\':
+            if (i + 1 < pattern.size() && depth == 0 && std::ispunct((unsigned char)pattern[i + 1])) {
+                run += pattern[++i];
+            } else {
+                ++i;    // \d, \w, \b and friends
+                endRun();
+            }
+            break;
+        default:
+            if (depth == 0) run += c;
+            break;
+        }
+    }
+    endRun();
+    return best;
+}
+
+ProjectEntry ClassifyProjectEntry(const fs::directory_entry& entry) {
+    std::string name = entry.path().filename().string();
+    if (name.empty() || name[0] == '.') return ProjectEntry::Skip;
+
+    std::error_code ec;
+    if (entry.is_directory(ec)) {
+        return entry.is_symlink(ec) ? ProjectEntry::Skip : ProjectEntry::Directory;
+    }
+    return entry.is_regular_file(ec) ? ProjectEntry::File : ProjectEntry::Skip;
+}
+
+bool TextMatcher::Compile(const SearchQuery& query, std::string* error) {
+    m_caseSensitive = query.caseSensitive;
+    m_isRegex = query.regex;
+    m_literal.clear();
+
+    if (query.pattern.empty()) {
+        if (error) *error = "Empty search pattern";
+        return false;
+    }
+
+    if (m_isRegex) {
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        if (!m_caseSensitive) flags |= std::regex::icase;
+        try {
+            m_regex.assign(query.pattern, flags);
+        } catch (const std::regex_error& e) {
+            if (error) *error = e.what();
+            return false;
+        }
+        m_literal = RequiredRegexLiteral(query.pattern);
+    } else {
+        m_literal = query.pattern;
+    }
+
+    if (!m_caseSensitive) {
+        for (char& c : m_literal) c = (char)FoldCase((unsigned char)c);
+    }
+    return true;
+}
+
+bool TextMatcher::LiteralAt(const char* p) const {
+    if (m_caseSensitive) return std::memcmp(p, m_literal.data(), m_literal.size()) == 0;
+    for (size_t k = 0; k < m_literal.size(); ++k) {
+        if (FoldCase((unsigned char)p[k]) != (unsigned char)m_literal[k]) return false;
+    }
+    return true;
+}
+
+size_t TextMatcher::FindLiteral(const char* data, size_t len, size_t from) const {
+    const size_t n = m_literal.size();
+    if (n == 0 || len < n || from > len - n) return std::string::npos;
+
+    const unsigned char first = (unsigned char)m_literal[0];
+    const unsigned char last = (unsigned char)m_literal[n - 1];
+    size_t i = from;
+
+#ifdef EDIFIER_SEARCH_SSE2
+    const __m128i first1 = _mm_set1_epi8((char)first);
+    const __m128i first2 = _mm_set1_epi8((char)(m_caseSensitive ? first : OtherCase(first)));
+    const __m128i last1 = _mm_set1_epi8((char)last);
+    const __m128i last2 = _mm_set1_epi8((char)(m_caseSensitive ? last : OtherCase(last)));
+
+    for (; i + n - 1 + 16 <= len; i += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i tail = _mm_loadu_si128((const __m128i*)(data + i + n - 1));
+        __m128i headEq = _mm_or_si128(_mm_cmpeq_epi8(head, first1), _mm_cmpeq_epi8(head, first2));
+        __m128i tailEq = _mm_or_si128(_mm_cmpeq_epi8(tail, last1), _mm_cmpeq_epi8(tail, last2));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(headEq, tailEq));
+        while (mask) {
+            size_t candidate = i + CountTrailingZeros(mask);
+            if (LiteralAt(data + candidate)) return candidate;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i + n <= len; ++i) {
+        if (LiteralAt(data + i)) return i;
+    }
+    return std::string::npos;
+}
+
+bool TextMatcher::Find(const char* data, size_t len, size_t from, size_t& matchPos, size_t& matchLen) const {
+    if (!m_isRegex) {
+        matchPos = FindLiteral(data, len, from);
+        matchLen = m_literal.size();
+        return matchPos != std::string::npos;
+    }
+
+    size_t pos = from;
+    while (pos <= len) {
+        size_t candidate = pos;
+        if (!m_literal.empty()) {
+            candidate = FindLiteral(data, len, pos);
+            if (candidate == std::string::npos) return false;
+        }
+
+        size_t lineStart = candidate;
+        while (lineStart > pos && data[lineStart - 1] != '\n') --lineStart;
+        const char* newline = (const char*)std::memchr(data + candidate, '\n', len - candidate);
+        size_t lineEnd = newline ? (size_t)(newline - data) : len;
+        size_t textEnd = lineEnd;
+        if (textEnd > lineStart && data[textEnd - 1] == '\r') --textEnd;
+
+        if (textEnd - lineStart <= kMaxRegexLine) {
+            // Starting mid-line, '^' must not match and '\b' must see the byte before.
+            auto flags = (lineStart > 0 && data[lineStart - 1] != '\n')
+                ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+            std::cmatch match;
+            if (std::regex_search(data + lineStart, data + textEnd, match, m_regex, flags)) {
+                matchPos = lineStart + (size_t)match.position(0);
+                matchLen = (size_t)match.length(0);
+                return true;
+            }
+        }
+        if (!newline) return false;
+        pos = lineEnd + 1;
+    }
+    return false;
+}
+
+// The line around a match, clipped to kPreviewBytes on UTF-8 boundaries.
+static void FillPreview(SearchHit& hit, const char* line, size_t lineLen) {
+    while (lineLen > 0 && line[lineLen - 1] == '\r') --lineLen;
+
+    size_t begin = 0;
+    if (lineLen > kPreviewBytes && hit.column > kPreviewContext) {
+        begin = std::min<size_t>(hit.column - kPreviewContext, lineLen - kPreviewBytes);
+        while (begin > 0 && ((unsigned char)line[begin] & 0xC0) == 0x80) --begin;
+    }
+    size_t end = std::min(lineLen, begin + kPreviewBytes);
+    while (end < lineLen && end > begin && ((unsigned char)line[end] & 0xC0) == 0x80) --end;
+
+    hit.preview.assign(line + begin, end - begin);
+    std::replace(hit.preview.begin(), hit.preview.end(), '\t', ' ');
+    hit.previewColumn = (uint32_t)(hit.column - begin);
+}
+
+SearchSession::SearchSession(const std::string& root, const TextMatcher& matcher)
+    : m_root(root), m_matcher(matcher) {
+    std::vector<WorkItem> seeds;
+    seeds.push_back(WorkItem{ root, true });
+    Start(seeds);
+}
+
+SearchSession::SearchSession(const std::string& root, const TextMatcher& matcher, std::vector<std::string> files)
+    : m_root(root), m_matcher(matcher) {
+    std::vector<WorkItem> seeds;
+    seeds.reserve(files.size());
+    for (auto& file : files) seeds.push_back(WorkItem{ std::move(file), false });
+    Start(seeds);
+}
+
+// Deal the seeds round-robin so every worker starts with something of its own.
+void SearchSession::Start(std::vector<WorkItem>& seeds) {
+    unsigned workerCount = std::min(16u, std::max(1u, std::thread::hardware_concurrency()));
+    for (unsigned i = 0; i < workerCount; ++i) m_queues.push_back(std::make_unique<WorkQueue>());
+
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        m_queues[i % workerCount]->items.push_back(std::move(seeds[i]));
+    }
+    m_pending = seeds.size();
+    m_activeWorkers = workerCount;
+    for (unsigned i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+SearchSession::~SearchSession() {
+    Cancel();
+    for (auto& worker : m_workers) worker.join();
+}
+
+void SearchSession::TakeResults(std::vector<std::string>& files, std::vector<SearchHit>& hits) {
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    files.insert(files.end(), std::make_move_iterator(m_newFiles.begin()), std::make_move_iterator(m_newFiles.end()));
+    hits.insert(hits.end(), std::make_move_iterator(m_newHits.begin()), std::make_move_iterator(m_newHits.end()));
+    m_newFiles.clear();
+    m_newHits.clear();
+}
+
+void SearchSession::WorkerLoop(unsigned self) {
+    PROFILE_THREAD("Search " + std::to_string(self));
+    MEMORY_SCOPE(MemoryTag::Search);
+    std::vector<char> readBuffer;
+    WorkItem item;
+    while (!m_cancelled) {
+        if (!PopWork(self, item)) {
+            // Nothing to steal right now; another worker may still be listing a directory.
+            if (m_pending.load() == 0) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        if (item.isDirectory) ScanDirectory(self, item.path);
+        else ScanFile(item.path, readBuffer);
+        m_pending.fetch_sub(1);
+    }
+    m_activeWorkers.fetch_sub(1);
+}
+
+bool SearchSession::PopWork(unsigned self, WorkItem& item) {
+    {
+        WorkQueue& own = *m_queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.items.empty()) {
+            item = std::move(own.items.back());
+            own.items.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < m_queues.size(); ++k) {
+        WorkQueue& victim = *m_queues[(self + k) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.items.empty()) {
+            item = std::move(victim.items.front());
+            victim.items.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void SearchSession::PushWork(unsigned self, std::vector<WorkItem>& items) {
+    if (items.empty()) return;
+    // Count before publishing, so pending never reads zero while work exists.
+    m_pending.fetch_add(items.size());
+    WorkQueue& own = *m_queues[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    for (auto& item : items) own.items.push_back(std::move(item));
+}
+
+void SearchSession::ScanDirectory(unsigned self, const std::string& path) {
+    PROFILE_ZONE("ScanDirectory");
+    std::error_code ec;
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
+    std::vector<WorkItem> items;
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (m_cancelled) return;
+        ProjectEntry kind = ClassifyProjectEntry(*it);
+        if (kind != ProjectEntry::Skip) items.push_back(WorkItem{ it->path().string(), kind == ProjectEntry::Directory });
+    }
+    PushWork(self, items);
+}
+
+void SearchSession::ScanFile(const std::string& path, std::vector<char>& readBuffer) {
+    PROFILE_ZONE("ScanFile");
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) return;
+
+    if (size < kReadThreshold) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return;
+        readBuffer.resize((size_t)size);
+        file.read(readBuffer.data(), (std::streamsize)size);
+        size_t got = (size_t)file.gcount();
+        SearchText(path, readBuffer.data(), got);
+        m_bytesScanned.fetch_add(got);
+    } else {
+        std::shared_ptr<MappedFile> mapped = MapFile(path);
+        if (!mapped) return;
+#ifndef _WIN32
+        madvise(const_cast<char*>(mapped->data), mapped->size, MADV_SEQUENTIAL);
+#endif
+        SearchText(path, mapped->data, mapped->size);
+        m_bytesScanned.fetch_add(mapped->size);
+    }
+    m_filesScanned.fetch_add(1);
+}
+
+void SearchSession::SearchText(const std::string& path, const char* data, size_t len) {
+    if (!IsTextData(path, data, len)) return;
+
+    std::vector<SearchHit> hits;
+    size_t lineStart = 0;     // start of the line after the previous hit
+    uint32_t line = 0;        // its line number
+    size_t matchPos, matchLen;
+    while (!m_cancelled && hits.size() < kMaxHits && m_matcher.Find(data, len, lineStart, matchPos, matchLen)) {
+        line += (uint32_t)CountLineEndings(data + lineStart, matchPos - lineStart).lf;
+        size_t start = matchPos;
+        while (start > lineStart && data[start - 1] != '\n') --start;
+        const char* newline = (const char*)std::memchr(data + matchPos, '\n', len - matchPos);
+        size_t end = newline ? (size_t)(newline - data) : len;
+
+        SearchHit hit;
+        hit.line = line;
+        hit.column = (uint32_t)(matchPos - start);
+        hit.length = (uint32_t)std::min(matchLen, end - matchPos);
+        FillPreview(hit, data + start, end - start);
+        hits.push_back(std::move(hit));
+
+        if (!newline) break;
+        lineStart = end + 1;    // one hit per line
+        ++line;
+    }
+    if (hits.empty()) return;
+
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    size_t room = kMaxHits - m_hitCount;
+    if (hits.size() >= room) {
+        hits.resize(room);
+        m_truncated = true;
+        m_cancelled = true;
+        if (hits.empty()) return;
+    }
+    uint32_t index = m_fileCount++;
+    for (auto& hit : hits) hit.file = index;
+    m_newFiles.push_back(path);
+    m_newHits.insert(m_newHits.end(), std::make_move_iterator(hits.begin()), std::make_move_iterator(hits.end()));
+    m_hitCount += hits.size();
+}
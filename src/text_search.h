@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How project-wide scans (Find in Files, the trigram index, quick open) treat a
+// directory entry. Dot-entries are skipped, and so are symlinked directories,
+// which can lead back up the tree.
+enum class ProjectEntry { Skip, Directory, File };
+ProjectEntry ClassifyProjectEntry(const std::filesystem::directory_entry& entry);
+
+struct SearchQuery {
+    std::string pattern;
+    bool caseSensitive = false;
+    bool regex = false;               // ECMAScript syntax, matched one line at a time
+};
+
+// Compiled query. Literals are scanned with SSE2 (first and last byte of the
+// needle compared 16 positions at a time, the middle verified per candidate).
+// A regex is only run on lines that contain its longest required literal, when
+// the pattern has one, so most of a file is skipped at literal speed.
+class TextMatcher {
+public:
+    // False (with a message in error) for an empty pattern or bad regex.
+    bool Compile(const SearchQuery& query, std::string* error = nullptr);
+
+    // First match starting at or after from in data[0, len). Regex matches never
+    // span lines.
+    bool Find(const char* data, size_t len, size_t from, size_t& matchPos, size_t& matchLen) const;
+
+    // Bytes every match contains (case-folded when case-insensitive); empty for a
+    // regex with none.
+    const std::string& RequiredLiteral() const { return m_literal; }
+    bool CaseSensitive() const { return m_caseSensitive; }
+
+private:
+    size_t FindLiteral(const char* data, size_t len, size_t from) const;   // npos when absent
+    bool LiteralAt(const char* p) const;
+
+    std::string m_literal;
+    bool m_caseSensitive = true;
+    bool m_isRegex = false;
+    std::regex m_regex;
+};
+
+struct SearchHit {
+    uint32_t file = 0;                // index into the session's file list
+    uint32_t line = 0;                // 0-based
+    uint32_t column = 0;              // byte offset of the match in its line
+    uint32_t length = 0;              // match length in bytes
+    std::string preview;              // the line, clipped around the match
+    uint32_t previewColumn = 0;       // match offset within preview
+};
+
+// One find-in-files run over a directory tree. Its own threads walk the tree with
+// per-thread work queues, stealing from each other when they run dry, so a deep
+// directory doesn't leave the rest idle. Dot-entries and symlinked directories are
+// skipped, as are files IsTextData calls binary. Small files are read, large ones
+// mapped. Hits are reported one per line and can be collected while the search runs.
+class SearchSession {
+public:
+    // Stop collecting after this many hits; Truncated() then reports it.
+    static const size_t kMaxHits = 100000;
+
+    SearchSession(const std::string& root, const TextMatcher& matcher);
+
+    // Search only these files, e.g. candidates from a TrigramIndex, instead of
+    // walking root. root is still what results are shown relative to.
+    SearchSession(const std::string& root, const TextMatcher& matcher, std::vector<std::string> files);
+
+    ~SearchSession();    // cancels and joins
+
+    SearchSession(const SearchSession&) = delete;
+    SearchSession& operator=(const SearchSession&) = delete;
+
+    // Move out files and hits found since the last call. Files come in index order
+    // and each one's hits follow it, so appending both keeps indices valid.
+    void TakeResults(std::vector<std::string>& files, std::vector<SearchHit>& hits);
+
+    void Cancel() { m_cancelled = true; }
+    bool Done() const { return m_activeWorkers.load() == 0; }
+    bool Truncated() const { return m_truncated.load(); }
+
+    const std::string& Root() const { return m_root; }
+    uint64_t FilesScanned() const { return m_filesScanned.load(); }
+    uint64_t BytesScanned() const { return m_bytesScanned.load(); }
+
+private:
+    struct WorkItem {
+        std::string path;
+        bool isDirectory = false;
+    };
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<WorkItem> items;    // owner pops the back, thieves take the front
+    };
+
+    void Start(std::vector<WorkItem>& seeds);
+    void WorkerLoop(unsigned self);
+    bool PopWork(unsigned self, WorkItem& item);
+    void PushWork(unsigned self, std::vector<WorkItem>& items);
+    void ScanDirectory(unsigned self, const std::string& path);
+    void ScanFile(const std::string& path, std::vector<char>& readBuffer);
+    void SearchText(const std::string& path, const char* data, size_t len);
+
+    std::string m_root;
+    TextMatcher m_matcher;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<uint64_t> m_pending{0};        // queued or running work items
+    std::atomic<unsigned> m_activeWorkers{0};
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_truncated{false};
+    std::atomic<uint64_t> m_filesScanned{0};
+    std::atomic<uint64_t> m_bytesScanned{0};
+
+    std::mutex m_resultsMutex;
+    std::vector<std::string> m_newFiles;
+    std::vector<SearchHit> m_newHits;
+    uint32_t m_fileCount = 0;
+    size_t m_hitCount = 0;
+};
@@ -0,0 +1,248 @@
+#include "text_stats.h"
+#include "document.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EDIFIER_STATS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(EDIFIER_STATS_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EDIFIER_STATS_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Below this size a range is counted on the calling thread.
+static const size_t kParallelThreshold = 8 * 1024 * 1024;
+
+static inline bool IsSpaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline uint32_t Popcount(uint32_t v) {
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcount(v);
+#elif defined(_MSC_VER)
+    return (uint32_t)__popcnt(v);
+#else
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return (((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+}
+
+static void CountScalar(const unsigned char* p, size_t len, bool& prevSpace, TextStats& s) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = p[i];
+        bool space = IsSpaceByte(c);
+        s.words += (!space && prevSpace);
+        s.chars += ((c & 0xC0) != 0x80);
+        s.newlines += (c == '\n');
+        prevSpace = space;
+    }
+}
+
+#ifdef EDIFIER_STATS_SSE2
+// 16 bytes per step: whitespace, newline and UTF-8 lead-byte masks via compares,
+// word starts as (non-space & previous-byte-was-space) with a carry between blocks.
+static size_t CountSse2(const unsigned char* p, size_t len, bool& prevSpace, TextStats& s) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i contMask = _mm_set1_epi8((char)0xC0);
+    const __m128i contTag = _mm_set1_epi8((char)0x80);
+
+    uint32_t carry = prevSpace ? 1u : 0u;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i ctrl = _mm_sub_epi8(v, tab);
+        __m128i isCtrlSpace = _mm_cmpeq_epi8(_mm_min_epu8(ctrl, four), ctrl);  // '\t'..'\r'
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(v, space), isCtrlSpace);
+
+        uint32_t spaceBits = (uint32_t)_mm_movemask_epi8(isSpace);
+        uint32_t starts = ~spaceBits & ((spaceBits << 1) | carry) & 0xFFFFu;
+        carry = spaceBits >> 15;
+
+        s.words += Popcount(starts);
+        s.newlines += Popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        s.chars += 16 - Popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, contMask), contTag)));
+    }
+    prevSpace = carry != 0;
+    return i;
+}
+#endif
+
+#ifdef EDIFIER_STATS_AVX2
+__attribute__((target("avx2")))
+static size_t CountAvx2(const unsigned char* p, size_t len, bool& prevSpace, TextStats& s) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i contMask = _mm256_set1_epi8((char)0xC0);
+    const __m256i contTag = _mm256_set1_epi8((char)0x80);
+
+    uint64_t carry = prevSpace ? 1u : 0u;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i ctrl = _mm256_sub_epi8(v, tab);
+        __m256i isCtrlSpace = _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, four), ctrl);
+        __m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), isCtrlSpace);
+
+        uint32_t spaceBits = (uint32_t)_mm256_movemask_epi8(isSpace);
+        uint32_t starts = (uint32_t)(~(uint64_t)spaceBits & (((uint64_t)spaceBits << 1) | carry));
+        carry = spaceBits >> 31;
+
+        s.words += (uint32_t)__builtin_popcount(starts);
+        s.newlines += (uint32_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        s.chars += 32 - (uint32_t)__builtin_popcount(
+            (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, contMask), contTag)));
+    }
+    prevSpace = carry != 0;
+    return i;
+}
+
+static bool HasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+#ifdef EDIFIER_STATS_SSE2
+// A pair is an '\n' whose previous byte is '\r', the same shifted-mask-with-carry
+// trick as word starts.
+static size_t CountEolSse2(const unsigned char* p, size_t len, bool& prevCr, LineEndingCounts& counts) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    uint32_t carry = prevCr ? 1u : 0u;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        uint32_t crBits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+        uint32_t lfBits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+        if ((crBits | lfBits) == 0) {
+            carry = 0;
+            continue;
+        }
+        counts.cr += Popcount(crBits);
+        counts.lf += Popcount(lfBits);
+        counts.crlf += Popcount(lfBits & ((crBits << 1) | carry));
+        carry = crBits >> 15;
+    }
+    prevCr = carry != 0;
+    return i;
+}
+#endif
+
+LineEndingCounts CountLineEndings(const char* data, size_t len) {
+    LineEndingCounts counts;
+    bool prevCr = false;
+    CountLineEndings(data, len, prevCr, counts);
+    return counts;
+}
+
+void CountLineEndings(const char* data, size_t len, bool& prevCr, LineEndingCounts& counts) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+#ifdef EDIFIER_STATS_SSE2
+    i = CountEolSse2(p, len, prevCr, counts);
+#endif
+    for (; i < len; ++i) {
+        counts.cr += (p[i] == '\r');
+        counts.lf += (p[i] == '\n');
+        counts.crlf += (p[i] == '\n' && prevCr);
+        prevCr = p[i] == '\r';
+    }
+}
+
+static TextStats CountSerial(const char* data, size_t len, bool prevIsSpace) {
+    TextStats s;
+    s.bytes = len;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    bool prevSpace = prevIsSpace;
+    size_t done = 0;
+
+#if defined(EDIFIER_STATS_AVX2)
+    if (HasAvx2()) done = CountAvx2(p, len, prevSpace, s);
+#endif
+#if defined(EDIFIER_STATS_SSE2)
+    done += CountSse2(p + done, len - done, prevSpace, s);
+#endif
+    CountScalar(p + done, len - done, prevSpace, s);
+    return s;
+}
+
+static void Accumulate(TextStats& into, const TextStats& s) {
+    into.bytes += s.bytes;
+    into.chars += s.chars;
+    into.words += s.words;
+    into.newlines += s.newlines;
+}
+
+TextStats CountTextStats(const char* data, size_t len, bool prevIsSpace) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (len < kParallelThreshold || threads == 1) {
+        return CountSerial(data, len, prevIsSpace);
+    }
+
+    // Each chunk judges its first byte against the byte before it, so the partial
+    // results simply add up.
+    size_t chunks = std::min<size_t>(threads, len / (kParallelThreshold / 4));
+    size_t chunkLen = (len + chunks - 1) / chunks;
+    std::vector<TextStats> partial(chunks);
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t start = c * chunkLen;
+        size_t n = std::min(chunkLen, len - start);
+        workers.emplace_back([&partial, data, start, n, c] {
+            partial[c] = CountSerial(data + start, n, IsSpaceByte((unsigned char)data[start - 1]));
+        });
+    }
+    partial[0] = CountSerial(data, std::min(chunkLen, len), prevIsSpace);
+    for (auto& w : workers) w.join();
+
+    TextStats total;
+    for (const auto& s : partial) Accumulate(total, s);
+    return total;
+}
+
+void TextStatsCounter::Add(const char* data, size_t len) {
+    if (len == 0) return;
+    Accumulate(m_stats, CountTextStats(data, len, m_prevIsSpace));
+    m_prevIsSpace = IsSpaceByte((unsigned char)data[len - 1]);
+}
+
+TextStats CountDocumentStats(const Document& doc, size_t pos, size_t len) {
+    TextStatsCounter counter(pos == 0 || IsSpaceByte((unsigned char)doc.CharAt(pos - 1)));
+    doc.ForEachChunk(pos, len, [&](const char* data, size_t n) { counter.Add(data, n); });
+    return counter.Stats();
+}
+
+TextStats CountDocumentStats(const Document& doc) {
+    return CountDocumentStats(doc, 0, doc.Length());
+}
+
+// The byte after the edited span is included on both sides: its word-start status
+// may flip, while its byte/char/newline contribution cancels out.
+TextStats StatsBeforeEdit(const Document& doc, size_t pos, size_t removed) {
+    return CountDocumentStats(doc, pos, removed + 1);
+}
+
+void StatsAfterEdit(TextStats& stats, const TextStats& before, const Document& doc, size_t pos, size_t inserted) {
+    TextStats after = CountDocumentStats(doc, pos, inserted + 1);
+    stats.bytes = stats.bytes - before.bytes + after.bytes;
+    stats.chars = stats.chars - before.chars + after.chars;
+    stats.words = stats.words - before.words + after.words;
+    stats.newlines = stats.newlines - before.newlines + after.newlines;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Document;
+
+// Word/character/line statistics for a tab. Words are runs of non-whitespace
+// (the C-locale isspace set), chars are UTF-8 code points.
+struct TextStats {
+    uint64_t bytes = 0;
+    uint64_t chars = 0;
+    uint64_t words = 0;
+    uint64_t newlines = 0;
+
+    uint64_t Lines() const { return newlines + 1; }
+};
+
+// Raw counts over a byte range. A word is counted where a non-space byte follows
+// a space byte; prevIsSpace says what precedes the first byte.
+// Uses AVX2 or SSE2 when available and splits large ranges across threads.
+TextStats CountTextStats(const char* data, size_t len, bool prevIsSpace = true);
+
+// CountTextStats over a stream handed over in consecutive pieces, e.g. as a file
+// is read; the word-start state is carried from one piece to the next.
+class TextStatsCounter {
+public:
+    explicit TextStatsCounter(bool prevIsSpace = true) : m_prevIsSpace(prevIsSpace) {}
+
+    void Add(const char* data, size_t len);
+    const TextStats& Stats() const { return m_stats; }
+
+private:
+    TextStats m_stats;
+    bool m_prevIsSpace;
+};
+
+// Same over doc[pos, pos + len), judged against the byte before pos.
+TextStats CountDocumentStats(const Document& doc, size_t pos, size_t len);
+TextStats CountDocumentStats(const Document& doc);
+
+// Incremental maintenance around one edit at pos. Call StatsBeforeEdit before the
+// document is modified and StatsAfterEdit after; only the edited span plus one byte
+// of context on each side is examined.
+TextStats StatsBeforeEdit(const Document& doc, size_t pos, size_t removed);
+void StatsAfterEdit(TextStats& stats, const TextStats& before, const Document& doc, size_t pos, size_t inserted);
+
+// Line-break census used to detect a file's EOL style: '\n' bytes, '\r' bytes and
+// the "\r\n" pairs among them, counted 16 or 32 bytes at a time.
+struct LineEndingCounts {
+    uint64_t lf = 0;
+    uint64_t cr = 0;
+    uint64_t crlf = 0;
+};
+
+LineEndingCounts CountLineEndings(const char* data, size_t len);
+
+// Adds one piece of a stream to counts; prevCr says whether the previous piece
+// ended in '\r', and is updated for the next.
+void CountLineEndings(const char* data, size_t len, bool& prevCr, LineEndingCounts& counts);
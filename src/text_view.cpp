@@ -0,0 +1,686 @@
+#include "text_view.h"
+#include "frame_pacer.h"
+#include "profiler.h"
+#include "imgui_internal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+ImVec4 g_syntaxColors[(int)TokenKind::Count];
+
+static const size_t kTabSize = 4;
+
+struct ViewLayout {
+    ImFont* font = nullptr;
+    float fontSize = 0.0f;
+    float lineHeight = 0.0f;
+    float charWidth = 0.0f;
+    ImVec2 textMin;        // clip rect of the text area (right of the gutter)
+    ImVec2 textMax;
+    int visibleLines = 1;
+    size_t visibleColumns = 1;
+};
+
+static size_t Utf8SequenceLength(unsigned char c) {
+    if (c < 0x80) return 1;
+    if ((c >> 5) == 0x6) return 2;
+    if ((c >> 4) == 0xE) return 3;
+    if ((c >> 3) == 0x1E) return 4;
+    return 1;  // continuation or malformed byte: step over it alone
+}
+
+static size_t NextColumn(size_t column, unsigned char c) {
+    return c == '\t' ? (column / kTabSize + 1) * kTabSize : column + 1;
+}
+
+// Column reached after the first n bytes of a line.
+static size_t ColumnOf(const char* text, size_t n) {
+    size_t column = 0;
+    for (size_t i = 0; i < n;) {
+        unsigned char c = (unsigned char)text[i];
+        column = NextColumn(column, c);
+        i += Utf8SequenceLength(c);
+    }
+    return column;
+}
+
+// Byte offset within a line closest to the given column.
+static size_t ByteAtColumn(const char* text, size_t len, size_t column) {
+    size_t current = 0;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = (unsigned char)text[i];
+        size_t step = std::min(Utf8SequenceLength(c), len - i);
+        size_t next = NextColumn(current, c);
+        if (next > column) {
+            return (column - current) * 2 >= (next - current) ? i + step : i;
+        }
+        current = next;
+        i += step;
+    }
+    return len;
+}
+
+// End of a line's text. Documents kept with raw CRLF endings (mapped or mixed-EOL
+// files) have a '\r' before the '\n'; it belongs to the line break, not the text.
+static size_t TextLineEnd(const Document& doc, size_t line) {
+    size_t end = doc.LineEnd(line);
+    if (end < doc.Length() && end > doc.LineStart(line) && doc.CharAt(end - 1) == '\r') --end;
+    return end;
+}
+
+// Copy up to maxBytes of a line (without its line break) into out. A caret or column
+// at most maxBytes / 4 columns in can always be resolved from the fetched prefix.
+static size_t FetchLine(const Document& doc, size_t line, size_t maxBytes, std::string& out) {
+    size_t start = doc.LineStart(line);
+    size_t len = TextLineEnd(doc, line) - start;
+    out.clear();
+    doc.CopyRange(start, std::min(len, maxBytes), out);
+    return start;
+}
+
+static bool IsWordChar(char c) {
+    unsigned char u = (unsigned char)c;
+    return u >= 0x80 || std::isalnum(u) || c == '_';
+}
+
+static bool IsCrlfAt(const Document& doc, size_t pos) {
+    return pos + 1 < doc.Length() && doc.CharAt(pos) == '\r' && doc.CharAt(pos + 1) == '\n';
+}
+
+static size_t PrevCodepoint(const Document& doc, size_t pos) {
+    if (pos == 0) return 0;
+    if (pos >= 2 && IsCrlfAt(doc, pos - 2)) return pos - 2;
+    --pos;
+    while (pos > 0 && ((unsigned char)doc.CharAt(pos) & 0xC0) == 0x80) --pos;
+    return pos;
+}
+
+static size_t NextCodepoint(const Document& doc, size_t pos) {
+    size_t len = doc.Length();
+    if (pos >= len) return len;
+    if (IsCrlfAt(doc, pos)) return pos + 2;
+    return std::min(len, pos + Utf8SequenceLength((unsigned char)doc.CharAt(pos)));
+}
+
+static size_t PrevWord(const Document& doc, size_t pos) {
+    while (pos > 0 && !IsWordChar(doc.CharAt(pos - 1))) --pos;
+    while (pos > 0 && IsWordChar(doc.CharAt(pos - 1))) --pos;
+    return pos;
+}
+
+static size_t NextWord(const Document& doc, size_t pos) {
+    size_t len = doc.Length();
+    while (pos < len && !IsWordChar(doc.CharAt(pos))) ++pos;
+    while (pos < len && IsWordChar(doc.CharAt(pos))) ++pos;
+    return pos;
+}
+
+static void SetCursor(TextViewState& state, size_t pos, bool extend) {
+    state.cursor = pos;
+    if (!extend) state.anchor = pos;
+    state.scrollToCursor = true;
+    state.lastInputTime = ImGui::GetTime();
+}
+
+static void ReplaceRange(const Document& doc, TextViewState& state, const TextEditFn& applyEdit,
+                         size_t pos, size_t removeLen, const char* text, size_t len, bool recordUndo = true) {
+    if (removeLen == 0 && len == 0) return;
+
+    if (recordUndo) state.history.RecordEdit(doc, pos, removeLen, text, len);
+    applyEdit(pos, removeLen, text, len, nullptr);
+    state.history.Trim(doc);
+    state.preferredColumn = (size_t)-1;
+    SetCursor(state, pos + len, false);
+}
+
+static void InsertText(const Document& doc, TextViewState& state, const TextEditFn& applyEdit,
+                       const char* text, size_t len) {
+    size_t selMin = std::min(state.cursor, state.anchor);
+    size_t selMax = std::max(state.cursor, state.anchor);
+    ReplaceRange(doc, state, applyEdit, selMin, selMax - selMin, text, len);
+}
+
+static void UndoRedo(const Document& doc, TextViewState& state, const TextEditFn& applyEdit, bool undo) {
+    UndoRecord record;
+    if (!(undo ? state.history.Undo(doc, record) : state.history.Redo(doc, record))) return;
+
+    const UndoText& text = record.text;
+    if (!text.ByReference()) {
+        ReplaceRange(doc, state, applyEdit, record.pos, record.replaceLen, text.bytes.data(), text.length, false);
+        return;
+    }
+    applyEdit(record.pos, record.replaceLen, nullptr, text.length, &text.pieces);
+    state.history.Trim(doc);
+    state.preferredColumn = (size_t)-1;
+    SetCursor(state, record.pos + text.length, false);
+}
+
+void TextViewReplace(const Document& doc, TextViewState& state, const TextEditFn& applyEdit,
+                     size_t pos, size_t removeLen, const char* text, size_t len) {
+    ReplaceRange(doc, state, applyEdit, pos, removeLen, text, len);
+}
+
+void RecordDocumentRewrite(const Document& doc, TextViewState& state, size_t newLength) {
+    state.history.RecordRewrite(doc, newLength);
+}
+
+// Caret position after moving vertically by delta lines, keeping the sticky column.
+static size_t MoveVertical(const Document& doc, TextViewState& state, long long delta, std::string& scratch) {
+    size_t line = doc.LineOfOffset(state.cursor);
+    if (state.preferredColumn == (size_t)-1) {
+        size_t start = doc.LineStart(line);
+        scratch.clear();
+        doc.CopyRange(start, state.cursor - start, scratch);
+        state.preferredColumn = ColumnOf(scratch.data(), scratch.size());
+    }
+
+    long long target = (long long)line + delta;
+    target = std::max(0LL, std::min(target, (long long)doc.LineCount() - 1));
+    size_t start = FetchLine(doc, (size_t)target, state.preferredColumn * 4 + 4, scratch);
+    return start + ByteAtColumn(scratch.data(), scratch.size(), state.preferredColumn);
+}
+
+// Document offset under a screen position.
+static size_t HitTest(const Document& doc, const TextViewState& state, const ViewLayout& layout,
+                      const ImVec2& pos, std::string& scratch) {
+    double lineF = state.topLine + (pos.y - layout.textMin.y) / layout.lineHeight;
+    long long line = (long long)std::floor(lineF);
+    if (line < 0) return 0;
+    if ((size_t)line >= doc.LineCount()) return doc.Length();
+
+    float x = pos.x - layout.textMin.x + state.scrollX;
+    size_t column = (size_t)std::max(0.0f, std::round(x / layout.charWidth));
+    size_t start = FetchLine(doc, (size_t)line, column * 4 + 4, scratch);
+    return start + ByteAtColumn(scratch.data(), scratch.size(), column);
+}
+
+// Draw the columns [firstColumn, lastColumn] of a line. Text is emitted in runs split
+// at tabs so tab stops line up, and at token boundaries when tokens are given (colored
+// by tokenCols, indexed by kind); bytes left of the viewport are skipped, not drawn.
+static void DrawLineText(ImDrawList* drawList, const ViewLayout& layout, const char* text, size_t len,
+                         float originX, float y, size_t firstColumn, size_t lastColumn, ImU32 col,
+                         const std::vector<SyntaxToken>* tokens = nullptr, const ImU32* tokenCols = nullptr) {
+    size_t column = 0;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = (unsigned char)text[i];
+        size_t next = NextColumn(column, c);
+        if (next > firstColumn) break;
+        column = next;
+        i += std::min(Utf8SequenceLength(c), len - i);
+    }
+
+    // Color of the byte at pos and where the next color change is.
+    size_t token = 0;
+    auto colorAt = [&](size_t pos, size_t& boundary) {
+        boundary = (size_t)-1;
+        if (!tokens) return col;
+        while (token < tokens->size() && (*tokens)[token].end <= pos) ++token;
+        if (token == tokens->size()) return col;
+        const SyntaxToken& t = (*tokens)[token];
+        if (t.begin > pos) {
+            boundary = t.begin;
+            return col;
+        }
+        boundary = t.end;
+        return tokenCols[(int)t.kind];
+    };
+
+    size_t runStart = i;
+    size_t runColumn = column;
+    size_t boundary;
+    ImU32 runCol = colorAt(i, boundary);
+    auto flush = [&](size_t end) {
+        if (end > runStart) {
+            drawList->AddText(layout.font, layout.fontSize, ImVec2(originX + runColumn * layout.charWidth, y),
+                              runCol, text + runStart, text + end);
+        }
+    };
+
+    while (i < len && column <= lastColumn) {
+        unsigned char c = (unsigned char)text[i];
+        if (i >= boundary) {
+            flush(i);
+            runStart = i;
+            runColumn = column;
+            runCol = colorAt(i, boundary);
+        }
+        if (c == '\t') {
+            flush(i);
+            column = NextColumn(column, c);
+            ++i;
+            runStart = i;
+            runColumn = column;
+            continue;
+        }
+        column += 1;
+        i += std::min(Utf8SequenceLength(c), len - i);
+    }
+    flush(i);
+}
+
+// Scrollbar built on an invisible button; returns the updated scroll value.
+static double ScrollbarBehavior(const char* id, const ImVec2& min, const ImVec2& max, bool vertical,
+                                double value, double maxValue, double visible, float& grabOffset) {
+    if (maxValue <= 0.0) return 0.0;
+
+    const ImGuiStyle& style = ImGui::GetStyle();
+    float trackLen = vertical ? max.y - min.y : max.x - min.x;
+    float grabLen = (float)std::max((double)style.GrabMinSize, trackLen * visible / (maxValue + visible));
+    grabLen = std::min(grabLen, trackLen);
+    float travel = std::max(1.0f, trackLen - grabLen);
+    float grabPos = (float)(value / maxValue) * travel;
+
+    ImGui::SetCursorScreenPos(min);
+    ImGui::InvisibleButton(id, ImVec2(max.x - min.x, max.y - min.y));
+    bool hovered = ImGui::IsItemHovered();
+    bool active = ImGui::IsItemActive();
+
+    if (ImGui::IsItemActivated()) {
+        float mouse = (vertical ? ImGui::GetMousePos().y - min.y : ImGui::GetMousePos().x - min.x);
+        bool onGrab = mouse >= grabPos && mouse <= grabPos + grabLen;
+        grabOffset = onGrab ? mouse - grabPos : grabLen * 0.5f;
+    }
+    if (active) {
+        float mouse = (vertical ? ImGui::GetMousePos().y - min.y : ImGui::GetMousePos().x - min.x);
+        value = std::max(0.0, std::min(maxValue, (double)(mouse - grabOffset) / travel * maxValue));
+        grabPos = (float)(value / maxValue) * travel;
+    }
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(min, max, ImGui::GetColorU32(ImGuiCol_ScrollbarBg));
+    ImGuiCol grabCol = active ? ImGuiCol_ScrollbarGrabActive
+                              : hovered ? ImGuiCol_ScrollbarGrabHovered : ImGuiCol_ScrollbarGrab;
+    ImVec2 grabMin = vertical ? ImVec2(min.x + 2.0f, min.y + grabPos) : ImVec2(min.x + grabPos, min.y + 2.0f);
+    ImVec2 grabMax = vertical ? ImVec2(max.x - 2.0f, min.y + grabPos + grabLen)
+                              : ImVec2(min.x + grabPos + grabLen, max.y - 2.0f);
+    drawList->AddRectFilled(grabMin, grabMax, ImGui::GetColorU32(grabCol), style.ScrollbarRounding);
+    return value;
+}
+
+static void HandleKeyboard(const Document& doc, TextViewState& state, const ViewLayout& layout,
+                           const TextEditFn& applyEdit, bool readOnly, std::string& scratch) {
+    ImGuiIO& io = ImGui::GetIO();
+    const bool shift = io.KeyShift;
+    const bool ctrl = io.KeyCtrl;
+    const size_t selMin = std::min(state.cursor, state.anchor);
+    const size_t selMax = std::max(state.cursor, state.anchor);
+    const bool hasSelection = selMin != selMax;
+
+    auto keepColumn = [&](size_t pos) {
+        size_t column = state.preferredColumn;
+        SetCursor(state, pos, shift);
+        state.preferredColumn = column;
+    };
+
+    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+        size_t pos = (!shift && hasSelection) ? selMin
+                   : ctrl ? PrevWord(doc, state.cursor) : PrevCodepoint(doc, state.cursor);
+        SetCursor(state, pos, shift);
+        state.preferredColumn = (size_t)-1;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+        size_t pos = (!shift && hasSelection) ? selMax
+                   : ctrl ? NextWord(doc, state.cursor) : NextCodepoint(doc, state.cursor);
+        SetCursor(state, pos, shift);
+        state.preferredColumn = (size_t)-1;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) keepColumn(MoveVertical(doc, state, -1, scratch));
+    if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) keepColumn(MoveVertical(doc, state, 1, scratch));
+    if (ImGui::IsKeyPressed(ImGuiKey_PageUp)) {
+        state.topLine = std::max(0.0, state.topLine - layout.visibleLines);
+        keepColumn(MoveVertical(doc, state, -layout.visibleLines, scratch));
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_PageDown)) {
+        state.topLine += layout.visibleLines;
+        keepColumn(MoveVertical(doc, state, layout.visibleLines, scratch));
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Home)) {
+        SetCursor(state, ctrl ? 0 : doc.LineStart(doc.LineOfOffset(state.cursor)), shift);
+        state.preferredColumn = (size_t)-1;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_End)) {
+        SetCursor(state, ctrl ? doc.Length() : TextLineEnd(doc, doc.LineOfOffset(state.cursor)), shift);
+        state.preferredColumn = (size_t)-1;
+    }
+
+    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_A, false)) {
+        state.anchor = 0;
+        state.cursor = doc.Length();
+    }
+    if (ctrl && (ImGui::IsKeyPressed(ImGuiKey_C, false) || ImGui::IsKeyPressed(ImGuiKey_X, false)) && hasSelection) {
+        scratch.clear();
+        doc.CopyRange(selMin, selMax - selMin, scratch);
+        ImGui::SetClipboardText(scratch.c_str());
+        if (!readOnly && ImGui::IsKeyPressed(ImGuiKey_X, false)) {
+            ReplaceRange(doc, state, applyEdit, selMin, selMax - selMin, "", 0);
+        }
+    }
+
+    if (readOnly) return;
+
+    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_V, false)) {
+        if (const char* clip = ImGui::GetClipboardText()) {
+            // Pasted line breaks take the document's style.
+            scratch.clear();
+            for (const char* c = clip; *c; ++c) {
+                if (*c == '\r' || *c == '\n') {
+                    if (*c == '\r' && c[1] == '\n') ++c;
+                    scratch += state.newline;
+                } else {
+                    scratch += *c;
+                }
+            }
+            InsertText(doc, state, applyEdit, scratch.data(), scratch.size());
+        }
+    }
+    if (ctrl && !shift && ImGui::IsKeyPressed(ImGuiKey_Z)) UndoRedo(doc, state, applyEdit, true);
+    if (ctrl && (ImGui::IsKeyPressed(ImGuiKey_Y) || (shift && ImGui::IsKeyPressed(ImGuiKey_Z)))) {
+        UndoRedo(doc, state, applyEdit, false);
+    }
+
+    if (ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
+        if (hasSelection) {
+            ReplaceRange(doc, state, applyEdit, selMin, selMax - selMin, "", 0);
+        } else if (state.cursor > 0) {
+            size_t from = ctrl ? PrevWord(doc, state.cursor) : PrevCodepoint(doc, state.cursor);
+            ReplaceRange(doc, state, applyEdit, from, state.cursor - from, "", 0);
+        }
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Delete)) {
+        if (hasSelection) {
+            ReplaceRange(doc, state, applyEdit, selMin, selMax - selMin, "", 0);
+        } else if (state.cursor < doc.Length()) {
+            size_t to = ctrl ? NextWord(doc, state.cursor) : NextCodepoint(doc, state.cursor);
+            ReplaceRange(doc, state, applyEdit, state.cursor, to - state.cursor, "", 0);
+        }
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter)) {
+        InsertText(doc, state, applyEdit, state.newline.data(), state.newline.size());
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Tab) && !ctrl) {
+        InsertText(doc, state, applyEdit, "\t", 1);
+    }
+
+    // Typed characters, encoded back to UTF-8.
+    if (!ctrl && io.InputQueueCharacters.Size > 0) {
+        std::string typed;
+        for (int i = 0; i < io.InputQueueCharacters.Size; ++i) {
+            unsigned int c = io.InputQueueCharacters[i];
+            if (c < 32 || c == 127) continue;
+            if (c < 0x80) {
+                typed += (char)c;
+            } else if (c < 0x800) {
+                typed += (char)(0xC0 | (c >> 6));
+                typed += (char)(0x80 | (c & 0x3F));
+            } else if (c < 0x10000) {
+                typed += (char)(0xE0 | (c >> 12));
+                typed += (char)(0x80 | ((c >> 6) & 0x3F));
+                typed += (char)(0x80 | (c & 0x3F));
+            } else {
+                typed += (char)(0xF0 | (c >> 18));
+                typed += (char)(0x80 | ((c >> 12) & 0x3F));
+                typed += (char)(0x80 | ((c >> 6) & 0x3F));
+                typed += (char)(0x80 | (c & 0x3F));
+            }
+        }
+        if (!typed.empty()) InsertText(doc, state, applyEdit, typed.data(), typed.size());
+        io.InputQueueCharacters.resize(0);
+    }
+}
+
+bool TextView(const char* id, const Document& doc, TextViewState& state, const ImVec2& size,
+              const TextEditFn& applyEdit, bool readOnly, const std::vector<TextRange>* highlights,
+              const SyntaxHighlighter* syntax) {
+    PROFILE_ZONE("TextView");
+    bool edited = false;
+    TextEditFn trackedEdit = [&](size_t pos, size_t removeLen, const char* text, size_t len,
+                                 const DocumentSnapshot* pieces) {
+        applyEdit(pos, removeLen, text, len, pieces);
+        edited = true;
+    };
+
+    ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
+    ImGui::BeginChild(id, size, ImGuiChildFlags_Borders,
+                      ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoNav);
+    ImGui::PopStyleVar();
+
+    static std::string scratch;  // reused line buffer; the UI is single-threaded
+
+    // The document may have shrunk underneath us (revert, reload).
+    state.cursor = std::min(state.cursor, doc.Length());
+    state.anchor = std::min(state.anchor, doc.Length());
+
+    const ImGuiStyle& style = ImGui::GetStyle();
+    ImGuiIO& io = ImGui::GetIO();
+
+    ViewLayout layout;
+    layout.font = ImGui::GetFont();
+    layout.fontSize = ImGui::GetFontSize();
+    layout.lineHeight = ImGui::GetTextLineHeight();
+    layout.charWidth = std::max(1.0f, layout.font->CalcTextSizeA(layout.fontSize, FLT_MAX, 0.0f, "M").x);
+
+    size_t lineCount = doc.LineCount();
+    char gutterLabel[32];
+    int digits = snprintf(gutterLabel, sizeof(gutterLabel), "%zu", lineCount);
+    const float gutterWidth = (digits + 2) * layout.charWidth;
+
+    ImVec2 winMin = ImGui::GetCursorScreenPos();
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    const float sb = style.ScrollbarSize;
+    bool showHScroll = state.maxLineWidth > avail.x - gutterWidth - sb;
+    layout.textMin = ImVec2(winMin.x + gutterWidth, winMin.y);
+    layout.textMax = ImVec2(winMin.x + avail.x - sb, winMin.y + avail.y - (showHScroll ? sb : 0.0f));
+    float textHeight = std::max(layout.lineHeight, layout.textMax.y - layout.textMin.y);
+    float textWidth = std::max(layout.charWidth, layout.textMax.x - layout.textMin.x);
+    layout.visibleLines = std::max(1, (int)(textHeight / layout.lineHeight));
+    layout.visibleColumns = (size_t)(textWidth / layout.charWidth) + 1;
+
+    // Text area item: owns mouse interaction and keyboard focus.
+    ImGui::SetCursorScreenPos(winMin);
+    ImGui::InvisibleButton("##text", ImVec2(std::max(1.0f, layout.textMax.x - winMin.x), textHeight));
+    const bool hovered = ImGui::IsItemHovered();
+    if (hovered) ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
+
+    if (state.focusRequested) {
+        ImGui::SetWindowFocus();
+        state.focused = true;
+        state.focusRequested = false;
+        state.scrollToCursor = true;
+    }
+    if (ImGui::IsItemActivated()) {
+        state.focused = true;
+        size_t pos = HitTest(doc, state, layout, io.MousePos, scratch);
+        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+            size_t from = pos, to = pos;
+            while (from > 0 && IsWordChar(doc.CharAt(from - 1))) --from;
+            while (to < doc.Length() && IsWordChar(doc.CharAt(to))) ++to;
+            state.anchor = from;
+            state.cursor = to;
+        } else {
+            SetCursor(state, pos, io.KeyShift);
+        }
+        state.preferredColumn = (size_t)-1;
+    } else if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+        // Drag-select; auto-scrolls when the mouse leaves the text area.
+        state.cursor = HitTest(doc, state, layout, io.MousePos, scratch);
+        state.scrollToCursor = true;
+    } else if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !ImGui::IsWindowHovered()) {
+        state.focused = false;
+    }
+
+    const bool hasKeyboard = state.focused && ImGui::IsWindowFocused();
+    if (hasKeyboard) {
+        HandleKeyboard(doc, state, layout, trackedEdit, readOnly, scratch);
+        lineCount = doc.LineCount();
+    }
+
+    // Mouse wheel scrolling.
+    if (ImGui::IsWindowHovered()) {
+        if (io.KeyShift && io.MouseWheel != 0.0f) {
+            state.scrollX -= io.MouseWheel * layout.charWidth * 8.0f;
+        } else {
+            state.topLine -= io.MouseWheel * 3.0;
+        }
+        state.scrollX -= io.MouseWheelH * layout.charWidth * 8.0f;
+    }
+
+    // Keep the caret on screen after keyboard/mouse movement.
+    if (state.caretGeneration != doc.Generation() || state.caretOffset != state.cursor) {
+        state.caretLine = doc.LineOfOffset(state.cursor);
+        size_t lineStart = doc.LineStart(state.caretLine);
+        scratch.clear();
+        doc.CopyRange(lineStart, state.cursor - lineStart, scratch);
+        state.caretColumn = ColumnOf(scratch.data(), scratch.size());
+        state.caretGeneration = doc.Generation();
+        state.caretOffset = state.cursor;
+    }
+    const size_t cursorLine = state.caretLine;
+    const size_t cursorColumn = state.caretColumn;
+    if (state.scrollToCursor) {
+        if ((double)cursorLine < state.topLine) {
+            state.topLine = (double)cursorLine;
+        } else if ((double)cursorLine >= state.topLine + layout.visibleLines) {
+            state.topLine = (double)cursorLine - layout.visibleLines + 1;
+        }
+        // The caret's line may not have been drawn yet; it is at least this wide.
+        float cursorX = cursorColumn * layout.charWidth;
+        state.maxLineWidth = std::max(state.maxLineWidth, cursorX + layout.charWidth);
+        if (cursorX < state.scrollX) {
+            state.scrollX = std::max(0.0f, cursorX - textWidth * 0.25f);
+        } else if (cursorX > state.scrollX + textWidth - layout.charWidth) {
+            state.scrollX = cursorX - textWidth * 0.75f;
+        }
+        state.scrollToCursor = false;
+    }
+
+    const double maxTopLine = std::max(0.0, (double)lineCount - layout.visibleLines);
+    state.topLine = std::max(0.0, std::min(state.topLine, maxTopLine));
+    const float maxScrollX = std::max(0.0f, state.maxLineWidth - textWidth + layout.charWidth * 4.0f);
+    state.scrollX = std::max(0.0f, std::min(state.scrollX, maxScrollX));
+
+    // Draw only the lines intersecting the viewport.
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    const size_t firstLine = (size_t)state.topLine;
+    const float lineOffset = (float)(state.topLine - (double)firstLine) * layout.lineHeight;
+    const size_t lastLine = std::min(lineCount, firstLine + layout.visibleLines + 2);
+    const size_t firstColumn = (size_t)(state.scrollX / layout.charWidth);
+    const size_t fetchLimit = (firstColumn + layout.visibleColumns + 1) * 4 + 4;
+
+    const size_t selMin = std::min(state.cursor, state.anchor);
+    const size_t selMax = std::max(state.cursor, state.anchor);
+    const ImU32 textCol = ImGui::GetColorU32(ImGuiCol_Text);
+    const ImU32 dimCol = ImGui::GetColorU32(ImGuiCol_TextDisabled);
+    const ImU32 selCol = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+    const ImU32 highlightCol = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+    ImU32 tokenCols[(int)TokenKind::Count];
+    for (int kind = 0; kind < (int)TokenKind::Count; ++kind) tokenCols[kind] = ImGui::GetColorU32(g_syntaxColors[kind]);
+    tokenCols[(int)TokenKind::Text] = textCol;
+    const bool colored = syntax && syntax->Active();
+
+    const size_t lineSpan = lastLine - firstLine;
+    if (state.cacheGeneration != doc.Generation() || state.cacheFirstLine != firstLine ||
+        state.lineCache.size() != lineSpan || state.cacheFetchLimit != fetchLimit) {
+        state.lineCache.resize(lineSpan);
+        for (size_t i = 0; i < lineSpan; ++i) {
+            TextViewState::CachedLine& cached = state.lineCache[i];
+            cached.start = doc.LineStart(firstLine + i);
+            cached.length = TextLineEnd(doc, firstLine + i) - cached.start;
+            cached.text.clear();
+            doc.CopyRange(cached.start, std::min(cached.length, fetchLimit), cached.text);
+        }
+        state.cacheGeneration = doc.Generation();
+        state.cacheFirstLine = firstLine;
+        state.cacheFetchLimit = fetchLimit;
+    }
+
+    drawList->PushClipRect(winMin, ImVec2(layout.textMax.x, layout.textMax.y), true);
+    for (size_t line = firstLine; line < lastLine; ++line) {
+        const float y = layout.textMin.y - lineOffset + (float)(line - firstLine) * layout.lineHeight;
+        const TextViewState::CachedLine& cached = state.lineCache[line - firstLine];
+        const size_t lineStart = cached.start;
+        const size_t lineLen = cached.length;
+        const char* text = cached.text.data();
+        const size_t fetched = cached.text.size();
+
+        snprintf(gutterLabel, sizeof(gutterLabel), "%*zu", digits, line + 1);
+        drawList->AddText(layout.font, layout.fontSize, ImVec2(winMin.x + layout.charWidth * 0.5f, y),
+                          line == cursorLine ? textCol : dimCol, gutterLabel);
+
+        const float originX = layout.textMin.x - state.scrollX;
+        const size_t fullWidthColumns = fetched == lineLen ? ColumnOf(text, fetched) : lineLen;
+        state.maxLineWidth = std::max(state.maxLineWidth, fullWidthColumns * layout.charWidth);
+
+        drawList->PushClipRect(layout.textMin, layout.textMax, true);
+
+        // Highlights. They never span lines, so the first one for this line is the
+        // first starting at or after its start.
+        if (highlights) {
+            auto it = std::lower_bound(highlights->begin(), highlights->end(), lineStart,
+                                       [](const TextRange& r, size_t pos) { return r.pos < pos; });
+            for (; it != highlights->end() && it->pos <= lineStart + lineLen; ++it) {
+                size_t a = it->pos - lineStart;
+                size_t b = std::min(it->pos + it->len, lineStart + lineLen) - lineStart;
+                if (a > fetched) break;
+                float x0 = originX + ColumnOf(text, a) * layout.charWidth;
+                float x1 = originX + ColumnOf(text, std::min(b, fetched)) * layout.charWidth;
+                x1 = std::max(x1, x0 + 2.0f);  // empty regex matches get a sliver
+                drawList->AddRectFilled(ImVec2(x0, y), ImVec2(x1, y + layout.lineHeight), highlightCol);
+            }
+        }
+
+        // Selection background.
+        if (selMin < selMax && selMin <= lineStart + lineLen && selMax > lineStart) {
+            size_t a = std::max(selMin, lineStart) - lineStart;
+            size_t b = std::min(selMax, lineStart + lineLen) - lineStart;
+            float x0 = originX + ColumnOf(text, std::min(a, fetched)) * layout.charWidth;
+            float x1 = originX + ColumnOf(text, std::min(b, fetched)) * layout.charWidth;
+            if (selMax > lineStart + lineLen) x1 += layout.charWidth * 0.5f;  // newline is selected
+            drawList->AddRectFilled(ImVec2(x0, y), ImVec2(x1, y + layout.lineHeight), selCol);
+        }
+
+        // Only the fetched prefix is lexed, from the line's cached start state.
+        if (colored) syntax->LexVisibleLine(line, text, fetched, state.tokens);
+        DrawLineText(drawList, layout, text, fetched, originX, y, firstColumn,
+                     firstColumn + layout.visibleColumns, textCol,
+                     colored ? &state.tokens : nullptr, tokenCols);
+
+        // Caret.
+        if (line == cursorLine && hasKeyboard) {
+            double phase = std::fmod(ImGui::GetTime() - state.lastInputTime, 1.2);
+            bool blinkOn = phase < 0.8;
+            RequestFrameIn((blinkOn ? 0.8 : 1.2) - phase);
+            float cx = originX + cursorColumn * layout.charWidth;
+            if (blinkOn) {
+                drawList->AddLine(ImVec2(cx, y), ImVec2(cx, y + layout.lineHeight - 1.0f), textCol, 1.5f);
+            }
+
+            // Position the platform IME candidate window at the caret.
+            ImGuiContext& g = *ImGui::GetCurrentContext();
+            g.PlatformImeData.WantVisible = true;
+            g.PlatformImeData.InputPos = ImVec2(cx - 1.0f, y);
+            g.PlatformImeData.InputLineHeight = layout.lineHeight;
+        }
+
+        drawList->PopClipRect();
+    }
+    drawList->PopClipRect();
+
+    // Scrollbars.
+    state.topLine = ScrollbarBehavior("##vscroll", ImVec2(layout.textMax.x, winMin.y),
+                                      ImVec2(winMin.x + avail.x, layout.textMax.y), true,
+                                      state.topLine, maxTopLine, layout.visibleLines, state.scrollbarGrabOffset);
+    if (showHScroll) {
+        state.scrollX = (float)ScrollbarBehavior("##hscroll", ImVec2(layout.textMin.x, layout.textMax.y),
+                                                 ImVec2(layout.textMax.x, winMin.y + avail.y), false,
+                                                 state.scrollX, maxScrollX, textWidth, state.scrollbarGrabOffset);
+    }
+
+    ImGui::EndChild();
+    return edited;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "imgui.h"
+#include "document.h"
+#include "syntax.h"
+#include "undo_history.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Per-tab state of the editor widget: caret, selection and scroll position.
+struct TextViewState {
+    size_t cursor = 0;
+    size_t anchor = 0;                 // selection is [min(anchor, cursor), max(anchor, cursor))
+    size_t preferredColumn = (size_t)-1;  // sticky column for up/down movement
+
+    // Vertical scroll is kept in lines rather than pixels: float pixel offsets lose
+    // precision long before a multi-million-line file ends.
+    double topLine = 0.0;
+    float scrollX = 0.0f;
+    float maxLineWidth = 0.0f;         // widest line drawn so far; sizes the horizontal range
+
+    std::string newline = "\n";       // inserted by Enter; pasted line breaks are converted to it
+
+    bool focused = false;
+    bool focusRequested = false;
+    bool scrollToCursor = false;
+    float scrollbarGrabOffset = 0.0f;
+    double lastInputTime = 0.0;
+
+    // Visible lines fetched last frame, reused while the document generation and the
+    // viewport are unchanged so idle frames read no document text at all.
+    struct CachedLine {
+        size_t start = 0;
+        size_t length = 0;             // full line length; text may hold only a prefix
+        std::string text;
+    };
+    std::vector<CachedLine> lineCache;
+    uint64_t cacheGeneration = (uint64_t)-1;
+    size_t cacheFirstLine = 0;
+    size_t cacheFetchLimit = 0;
+
+    uint64_t caretGeneration = (uint64_t)-1;  // caret line/column cache, same idea
+    size_t caretOffset = 0;
+    size_t caretLine = 0;
+    size_t caretColumn = 0;
+
+    std::vector<SyntaxToken> tokens;   // spans of the line being drawn, reused across lines
+
+    UndoHistory history;               // Ctrl+Z / Ctrl+Y; survives tab switches and reverts
+};
+
+// Replaces [pos, pos + removeLen) with text, or with pieces when they are given
+// (undoing a large edit: len is then their length and text is null). The widget
+// never mutates the document itself, so the owning tab sees every change.
+using TextEditFn = std::function<void(size_t pos, size_t removeLen, const char* text, size_t len,
+                                      const DocumentSnapshot* pieces)>;
+
+// Replace [pos, pos + removeLen) with text through applyEdit as if typed: the change
+// is recorded for undo and the caret moves to its end.
+void TextViewReplace(const Document& doc, TextViewState& state, const TextEditFn& applyEdit,
+                     size_t pos, size_t removeLen, const char* text, size_t len);
+
+// Record that doc is about to be replaced wholesale by newLength bytes (Replace All,
+// revert), so undo can restore it. The old text is kept by reference, not copied.
+void RecordDocumentRewrite(const Document& doc, TextViewState& state, size_t newLength);
+
+// Virtualized editor widget. Only lines inside the viewport are fetched, measured and
+// drawn, so per-frame cost is O(visible lines) regardless of document size.
+// Assumes a monospace font (the bundled JetBrains Mono or ImGui's default).
+// highlights, sorted by position, are tinted behind the text (search matches).
+// syntax, when given, colors the visible lines; it is only read, so keep it updated
+// up to the viewport before the call.
+// Returns true if the document was edited this frame.
+bool TextView(const char* id, const Document& doc, TextViewState& state, const ImVec2& size,
+              const TextEditFn& applyEdit, bool readOnly = false,
+              const std::vector<TextRange>* highlights = nullptr,
+              const SyntaxHighlighter* syntax = nullptr);
+
+// Token colors of the editor, indexed by TokenKind, set with the theme. Text uses
+// the style's text color instead.
+extern ImVec4 g_syntaxColors[(int)TokenKind::Count];
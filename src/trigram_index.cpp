@@ -0,0 +1,762 @@
+#include "trigram_index.h"
+#include "file_io.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "text_search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Cache file layout, little-endian:
+//   Header
+//   files:    varint root length, root, then per live file: varint path length,
+//             path, varint size, varint mtime
+//   postings: per trigram, its file ids as a first id followed by gaps, all varints
+//   table:    trigramCount TableRecords, sorted by trigram
+static const char kMagic[4] = { 'E', 'D', 'T', 'G' };
+static const uint32_t kVersion = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t fileCount;
+    uint32_t trigramCount;
+    uint64_t postingsOffset;
+    uint64_t postingsSize;
+    uint64_t tableOffset;
+    uint32_t complete;        // written after a full walk; informational, every open walks again
+    uint32_t reserved;
+};
+static_assert(sizeof(CacheHeader) == 48, "cache header layout");
+
+struct TableRecord {
+    uint32_t trigram;
+    uint32_t count;
+    uint64_t offset;          // into the postings section
+};
+static_assert(sizeof(TableRecord) == 16, "cache table layout");
+
+static const uint32_t kTrigramSpace = 1u << 24;
+static const uint32_t kDeadId = 0xFFFFFFFFu;
+
+// Same cut-off as SearchSession: smaller files are read, larger ones mapped.
+static const size_t kReadThreshold = 64 * 1024;
+
+static inline unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static void AppendVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return false;
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static TableRecord RecordAt(const uint8_t* table, uint32_t index) {
+    TableRecord record;
+    std::memcpy(&record, table + (size_t)index * sizeof(TableRecord), sizeof(record));
+    return record;
+}
+
+static std::string CacheDirectory() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (!base || !*base) return std::string();
+    return (fs::path(base) / "Edifier" / "index").string();
+#else
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return (fs::path(xdg) / "edifier" / "index").string();
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return std::string();
+    return (fs::path(home) / ".cache" / "edifier" / "index").string();
+#endif
+}
+
+// One cache file per root, named by a hash of its path; the path itself is stored
+// inside and checked on load.
+static std::string CachePathFor(const std::string& root) {
+    std::string dir = CacheDirectory();
+    if (dir.empty()) return std::string();
+
+    uint64_t hash = 14695981039346656037ull;    // FNV-1a
+    for (unsigned char c : root) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.trigrams", (unsigned long long)hash);
+    return (fs::path(dir) / name).string();
+}
+
+// Distinct trigrams of data, case-folded, none spanning a line break, sorted.
+// seen is a kTrigramSpace-bit scratch bitmap and is left cleared.
+static void ExtractTrigrams(const char* data, size_t len, std::vector<uint64_t>& seen, std::vector<uint32_t>& out) {
+    uint32_t trigram = 0;
+    size_t run = 0;    // bytes since the last line break
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\n' || c == '\r') {
+            run = 0;
+            continue;
+        }
+        trigram = ((trigram << 8) | FoldCase(c)) & (kTrigramSpace - 1);
+        if (++run < 3) continue;
+
+        uint64_t bit = 1ull << (trigram & 63);
+        uint64_t& word = seen[trigram >> 6];
+        if (!(word & bit)) {
+            word |= bit;
+            out.push_back(trigram);
+        }
+    }
+    for (uint32_t t : out) seen[t >> 6] = 0;
+    std::sort(out.begin(), out.end());
+}
+
+// Trigrams of a text file on disk; none for binaries or unreadable files, which
+// then never come up as candidates, just as SearchSession would skip them.
+static void FileTrigrams(const std::string& path, uint64_t size, std::vector<char>& buffer,
+                         std::vector<uint64_t>& seen, std::vector<uint32_t>& out) {
+    out.clear();
+    if (size < kReadThreshold) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return;
+        buffer.resize((size_t)size);
+        file.read(buffer.data(), (std::streamsize)size);
+        size_t got = (size_t)file.gcount();
+        if (IsTextData(path, buffer.data(), got)) ExtractTrigrams(buffer.data(), got, seen, out);
+        return;
+    }
+
+    std::shared_ptr<MappedFile> mapped = MapFile(path);
+    if (!mapped) return;
+#ifndef _WIN32
+    madvise(const_cast<char*>(mapped->data), mapped->size, MADV_SEQUENTIAL);
+#endif
+    if (IsTextData(path, mapped->data, mapped->size)) ExtractTrigrams(mapped->data, mapped->size, seen, out);
+}
+
+TrigramIndex::TrigramIndex() = default;
+
+TrigramIndex::~TrigramIndex() {
+    Close();
+}
+
+void TrigramIndex::Open(const std::string& root) {
+    Close();
+    m_root = root;
+    m_cachePath = CachePathFor(root);
+    m_stopping = false;
+    m_refreshRequested = true;
+#ifdef __linux__
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    m_indexer = std::thread([this] { IndexerLoop(); });
+}
+
+void TrigramIndex::Close() {
+    if (m_indexer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_requestMutex);
+            m_stopping = true;
+        }
+        m_requestReady.notify_all();
+        m_indexer.join();
+    }
+    // A walk cut short still leaves every indexed file correct, so it's worth keeping.
+    if (m_dirty) Save();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_base = Base();
+    m_files.clear();
+    m_ids.clear();
+    m_added.clear();
+    m_dirty = false;
+    m_ready = false;
+    m_indexing = false;
+    m_refreshRequested = false;
+    m_walking = false;
+    m_updates.clear();
+    m_inFlight.clear();
+#ifdef __linux__
+    if (m_inotifyFd >= 0) close(m_inotifyFd);
+#endif
+    m_inotifyFd = -1;
+    m_watchDirs.clear();
+    m_watched = false;
+    m_root.clear();
+    m_cachePath.clear();
+}
+
+void TrigramIndex::Refresh() {
+    if (!m_indexer.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_refreshRequested = true;
+    }
+    m_requestReady.notify_one();
+}
+
+void TrigramIndex::UpdateFile(const std::string& path) {
+    if (!m_indexer.joinable()) return;
+    fs::path relative = fs::path(path).lexically_relative(m_root);
+    if (relative.empty()) return;
+    // Same rule as the walk: nothing under a dot-entry, which also rules out "..".
+    for (const auto& part : relative) {
+        std::string name = part.string();
+        if (name.empty() || name[0] == '.') return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_updates.push_back(relative.generic_string());
+    }
+    m_requestReady.notify_one();
+}
+
+bool TrigramIndex::Candidates(const TextMatcher& matcher, std::vector<std::string>& files) {
+    const std::string& literal = matcher.RequiredLiteral();
+    if (literal.size() < 3) return false;
+
+    std::vector<uint32_t> trigrams;
+    for (size_t i = 0; i + 3 <= literal.size(); ++i) {
+        trigrams.push_back((uint32_t)FoldCase((unsigned char)literal[i]) << 16 |
+                           (uint32_t)FoldCase((unsigned char)literal[i + 1]) << 8 |
+                           (uint32_t)FoldCase((unsigned char)literal[i + 2]));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Events already queued by the kernel cover every change made before this call;
+    // files they name are searched directly, whatever the index still says.
+    std::unordered_set<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        DrainEvents();
+        if (!m_watched || m_walking || m_refreshRequested) return false;
+        pending.insert(m_updates.begin(), m_updates.end());
+        pending.insert(m_inFlight.begin(), m_inFlight.end());
+    }
+    if (!pending.empty()) m_requestReady.notify_one();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_ready) return false;
+
+    // Shortest lists first keeps the running intersection small.
+    std::vector<std::pair<uint32_t, uint32_t>> bySize;
+    for (uint32_t t : trigrams) bySize.emplace_back(ListLength(t), t);
+    std::sort(bySize.begin(), bySize.end());
+
+    std::vector<uint32_t> result, list, merged;
+    DecodeList(bySize[0].second, result);
+    for (size_t k = 1; k < bySize.size() && !result.empty(); ++k) {
+        DecodeList(bySize[k].second, list);
+        merged.clear();
+        std::set_intersection(result.begin(), result.end(), list.begin(), list.end(), std::back_inserter(merged));
+        result.swap(merged);
+    }
+
+    for (uint32_t id : result) {
+        if (id < m_files.size() && m_files[id].alive && !pending.count(m_files[id].path)) {
+            files.push_back(FullPath(m_files[id].path));
+        }
+    }
+    for (const std::string& relative : pending) files.push_back(FullPath(relative));
+    return true;
+}
+
+std::string TrigramIndex::FullPath(const std::string& relative) const {
+    return (fs::path(m_root) / fs::path(relative).make_preferred()).string();
+}
+
+uint32_t TrigramIndex::ListLength(uint32_t trigram) const {
+    uint32_t length = 0;
+    uint32_t lo = 0, hi = m_base.trigrams;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (RecordAt(m_base.table, mid).trigram < trigram) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < m_base.trigrams) {
+        TableRecord record = RecordAt(m_base.table, lo);
+        if (record.trigram == trigram) length += record.count;
+    }
+    auto added = m_added.find(trigram);
+    if (added != m_added.end()) length += added->second.count;
+    return length;
+}
+
+// Base ids first, then the layer's; the layer's are all newer, so the result is sorted.
+void TrigramIndex::DecodeList(uint32_t trigram, std::vector<uint32_t>& ids) const {
+    ids.clear();
+    auto decode = [&ids](const uint8_t* p, const uint8_t* end, uint32_t count) {
+        uint64_t id = 0, value;
+        for (uint32_t i = 0; i < count && ReadVarint(p, end, value); ++i) {
+            id = (i == 0) ? value : id + value;
+            ids.push_back((uint32_t)id);
+        }
+    };
+
+    uint32_t lo = 0, hi = m_base.trigrams;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (RecordAt(m_base.table, mid).trigram < trigram) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < m_base.trigrams) {
+        TableRecord record = RecordAt(m_base.table, lo);
+        if (record.trigram == trigram) {
+            uint64_t end = lo + 1 < m_base.trigrams ? RecordAt(m_base.table, lo + 1).offset : m_base.postingsSize;
+            decode(m_base.postings + record.offset, m_base.postings + end, record.count);
+        }
+    }
+
+    auto added = m_added.find(trigram);
+    if (added != m_added.end()) {
+        const PostingList& list = added->second;
+        decode(list.bytes.data(), list.bytes.data() + list.bytes.size(), list.count);
+    }
+}
+
+// Maps and validates the cache file for m_root. Offsets are all checked here, so
+// decoding can trust them later; varints are still read with bounds.
+bool TrigramIndex::ReadCache(Base& base, std::vector<FileEntry>& files) const {
+    if (m_cachePath.empty()) return false;
+    std::error_code ec;
+    if (!fs::exists(m_cachePath, ec)) return false;
+
+    std::shared_ptr<MappedFile> mapped = MapFile(m_cachePath);
+    if (!mapped || mapped->size < sizeof(CacheHeader)) return false;
+    const uint8_t* data = (const uint8_t*)mapped->data;
+    const uint64_t size = mapped->size;
+
+    CacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+    if (header.postingsOffset < sizeof(CacheHeader) || header.postingsOffset > size ||
+        header.postingsSize > size - header.postingsOffset ||
+        header.tableOffset != header.postingsOffset + header.postingsSize ||
+        (uint64_t)header.trigramCount * sizeof(TableRecord) > size - header.tableOffset) {
+        return false;
+    }
+
+    const uint8_t* p = data + sizeof(CacheHeader);
+    const uint8_t* end = data + header.postingsOffset;
+    uint64_t length, value;
+    if (!ReadVarint(p, end, length) || length > (uint64_t)(end - p)) return false;
+    if (std::string((const char*)p, (size_t)length) != m_root) return false;
+    p += length;
+
+    files.clear();
+    files.reserve(header.fileCount);
+    for (uint32_t i = 0; i < header.fileCount; ++i) {
+        FileEntry entry;
+        if (!ReadVarint(p, end, length) || length > (uint64_t)(end - p)) return false;
+        entry.path.assign((const char*)p, (size_t)length);
+        p += length;
+        if (!ReadVarint(p, end, entry.size) || !ReadVarint(p, end, value)) return false;
+        entry.mtime = (int64_t)value;
+        files.push_back(std::move(entry));
+    }
+
+    base.table = data + header.tableOffset;
+    base.trigrams = header.trigramCount;
+    base.postings = data + header.postingsOffset;
+    base.postingsSize = header.postingsSize;
+    uint64_t previousOffset = 0;
+    for (uint32_t i = 0; i < base.trigrams; ++i) {
+        TableRecord record = RecordAt(base.table, i);
+        if (record.offset < previousOffset || record.offset > base.postingsSize) return false;
+        if (i > 0 && record.trigram <= RecordAt(base.table, i - 1).trigram) return false;
+        previousOffset = record.offset;
+    }
+    base.file = std::move(mapped);
+    return true;
+}
+
+// Make base the whole index. Call with m_mutex held.
+void TrigramIndex::Install(Base& base, std::vector<FileEntry>& files) {
+    m_base = std::move(base);
+    m_files = std::move(files);
+    m_added.clear();
+    m_ids.clear();
+    for (uint32_t id = 0; id < m_files.size(); ++id) m_ids[m_files[id].path] = id;
+}
+
+// Writes base and layer, minus dead files, as a new cache file and maps that in
+// their place. Live files are renumbered densely in id order, which keeps every
+// list sorted. Runs on the indexer thread, or after it has stopped.
+void TrigramIndex::Save() {
+    if (m_cachePath.empty()) return;
+    PROFILE_ZONE("SaveIndex");
+    MEMORY_SCOPE(MemoryTag::Index);
+    std::error_code ec;
+    fs::create_directories(fs::path(m_cachePath).parent_path(), ec);
+
+    std::vector<uint32_t> remap(m_files.size(), kDeadId);
+    uint32_t liveCount = 0;
+    std::vector<uint8_t> bytes;
+    AppendVarint(bytes, m_root.size());
+    bytes.insert(bytes.end(), m_root.begin(), m_root.end());
+    for (uint32_t id = 0; id < m_files.size(); ++id) {
+        const FileEntry& entry = m_files[id];
+        if (!entry.alive) continue;
+        remap[id] = liveCount++;
+        AppendVarint(bytes, entry.path.size());
+        bytes.insert(bytes.end(), entry.path.begin(), entry.path.end());
+        AppendVarint(bytes, entry.size);
+        AppendVarint(bytes, (uint64_t)entry.mtime);
+    }
+
+    std::string tempPath = m_cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to write search index: " << tempPath << "\n";
+        return;
+    }
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.fileCount = liveCount;
+    header.complete = m_ready ? 1 : 0;
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+    header.postingsOffset = sizeof(header) + bytes.size();
+
+    std::vector<uint32_t> keys;
+    keys.reserve(m_base.trigrams + m_added.size());
+    for (uint32_t i = 0; i < m_base.trigrams; ++i) keys.push_back(RecordAt(m_base.table, i).trigram);
+    for (const auto& added : m_added) keys.push_back(added.first);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<TableRecord> table;
+    std::vector<uint32_t> ids;
+    for (uint32_t trigram : keys) {
+        DecodeList(trigram, ids);
+        bytes.clear();
+        uint32_t count = 0, last = 0;
+        for (uint32_t id : ids) {
+            if (id >= remap.size() || remap[id] == kDeadId) continue;
+            uint32_t mapped = remap[id];
+            AppendVarint(bytes, count ? mapped - last : mapped);
+            last = mapped;
+            ++count;
+        }
+        if (count == 0) continue;
+        table.push_back(TableRecord{ trigram, count, header.postingsSize });
+        out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+        header.postingsSize += bytes.size();
+    }
+    header.tableOffset = header.postingsOffset + header.postingsSize;
+    header.trigramCount = (uint32_t)table.size();
+    out.write((const char*)table.data(), (std::streamsize)(table.size() * sizeof(TableRecord)));
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write search index: " << tempPath << "\n";
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_base = Base();    // unmap first: Windows won't replace a mapped file
+    fs::rename(tempPath, m_cachePath, ec);
+    bool renamed = !ec;
+
+    Base base;
+    std::vector<FileEntry> files;
+    if (ReadCache(base, files)) {
+        if (renamed) {
+            Install(base, files);
+            m_dirty = false;
+        } else {
+            m_base = std::move(base);    // the old file, which files and layer still match
+        }
+        return;
+    }
+
+    // Neither the new nor the old file is usable; the next walk re-reads everything.
+    std::cerr << "Failed to replace search index: " << m_cachePath << "\n";
+    fs::remove(tempPath, ec);
+    m_files.clear();
+    m_ids.clear();
+    m_added.clear();
+    m_dirty = false;
+    m_ready = false;
+}
+
+void TrigramIndex::IndexerLoop() {
+    PROFILE_THREAD("Indexer");
+    MEMORY_SCOPE(MemoryTag::Index);
+    {
+        PROFILE_ZONE("ReadCache");
+        // The cache isn't queried until the walk below has checked it against the tree.
+        Base base;
+        std::vector<FileEntry> files;
+        if (ReadCache(base, files)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Install(base, files);
+        }
+    }
+
+    for (;;) {
+        bool refresh = false;
+        std::vector<std::string> updates;
+        {
+            std::unique_lock<std::mutex> lock(m_requestMutex);
+            for (;;) {
+                DrainEvents();
+                if (m_stopping || m_refreshRequested || !m_updates.empty()) break;
+                if (m_inotifyFd >= 0) m_requestReady.wait_for(lock, std::chrono::milliseconds(250));
+                else m_requestReady.wait(lock);
+            }
+            if (m_stopping) return;
+            refresh = m_refreshRequested;
+            m_refreshRequested = false;
+            if (refresh) m_walking = true;
+            updates.swap(m_updates);
+            std::sort(updates.begin(), updates.end());
+            updates.erase(std::unique(updates.begin(), updates.end()), updates.end());
+            m_inFlight = updates;
+        }
+        m_indexing = true;
+
+        if (refresh) {
+            // The walk picks up any updated file too.
+            std::vector<PendingFile> changed;
+            std::vector<bool> seen;
+            Walk(changed, seen);
+            IndexFiles(changed);
+            if (!m_stopping) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (uint32_t id = 0; id < seen.size(); ++id) {
+                    FileEntry& entry = m_files[id];
+                    if (entry.alive && !seen[id]) {    // deleted, or replaced by a newer id
+                        entry.alive = false;
+                        m_ids.erase(entry.path);
+                        m_dirty = true;
+                    }
+                }
+                m_ready = true;
+            }
+            if (!m_stopping && m_dirty) Save();
+        } else {
+            std::vector<PendingFile> changed;
+            for (const std::string& relative : updates) {
+                PendingFile file;
+                file.path = relative;
+                std::error_code ec;
+                fs::directory_entry entry(FullPath(relative), ec);
+                if (!ec && ClassifyProjectEntry(entry) == ProjectEntry::File) {
+                    file.size = entry.file_size(ec);
+                    if (!ec) file.mtime = entry.last_write_time(ec).time_since_epoch().count();
+                } else {
+                    ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                }
+                if (ec) RemoveFile(relative);
+                else changed.push_back(std::move(file));
+            }
+            IndexFiles(changed);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_requestMutex);
+            m_inFlight.clear();
+            m_walking = false;
+        }
+        m_indexing = false;
+    }
+}
+
+// Turns queued inotify events into updates, or a walk for anything a single file
+// update can't cover. Call with m_requestMutex held.
+void TrigramIndex::DrainEvents() {
+#ifdef __linux__
+    if (m_inotifyFd < 0) return;
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        ssize_t n = read(m_inotifyFd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        for (char* p = buffer; p < buffer + n;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_refreshRequested = true;
+                continue;
+            }
+            auto dir = m_watchDirs.find(event->wd);
+            if (dir == m_watchDirs.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                m_watchDirs.erase(dir);    // its parent saw it go and asked for a walk
+                continue;
+            }
+            // A new, moved or removed directory: only a walk lists and watches it.
+            if (event->mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                m_refreshRequested = true;
+                continue;
+            }
+            std::string name = event->len ? event->name : "";
+            if (name.empty() || name[0] == '.') continue;
+            m_updates.push_back(dir->second.empty() ? name : dir->second + "/" + name);
+        }
+    }
+#endif
+}
+
+// Watch before listing, so nothing changed in between goes unseen.
+void TrigramIndex::WatchDirectory(const std::string& relative) {
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (m_inotifyFd < 0) return;
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM |
+                          IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    std::string path = relative.empty() ? m_root : FullPath(relative);
+    int wd = inotify_add_watch(m_inotifyFd, path.c_str(), mask);
+    if (wd < 0) {
+        m_watched = false;    // e.g. out of watches: queries scan everything instead
+        return;
+    }
+    m_watchDirs[wd] = relative;    // a moved directory keeps its watch; this renames it
+#else
+    (void)relative;
+#endif
+}
+
+// Lists the tree with ClassifyProjectEntry's rules and collects files that are new
+// or whose size or mtime changed. seen marks ids confirmed unchanged.
+void TrigramIndex::Walk(std::vector<PendingFile>& changed, std::vector<bool>& seen) {
+    PROFILE_ZONE("Walk");
+    seen.assign(m_files.size(), false);
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_watched = m_inotifyFd >= 0;
+    }
+    std::vector<std::string> dirs(1);    // relative; "" is the root
+    while (!dirs.empty() && !m_stopping) {
+        std::string dir = std::move(dirs.back());
+        dirs.pop_back();
+        WatchDirectory(dir);
+
+        std::error_code ec;
+        fs::directory_iterator it(dir.empty() ? m_root : FullPath(dir), fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry = *it;
+            ProjectEntry kind = ClassifyProjectEntry(entry);
+            if (kind == ProjectEntry::Skip) continue;
+            std::string name = entry.path().filename().string();
+            std::string relative = dir.empty() ? name : dir + "/" + name;
+            if (kind == ProjectEntry::Directory) {
+                dirs.push_back(std::move(relative));
+                continue;
+            }
+
+            std::error_code typeEc;
+            PendingFile file;
+            file.size = entry.file_size(typeEc);
+            if (typeEc) continue;
+            file.mtime = entry.last_write_time(typeEc).time_since_epoch().count();
+            if (typeEc) continue;
+
+            auto found = m_ids.find(relative);
+            if (found != m_ids.end() && m_files[found->second].size == file.size &&
+                m_files[found->second].mtime == file.mtime) {
+                seen[found->second] = true;
+            } else {
+                file.path = std::move(relative);
+                changed.push_back(std::move(file));
+            }
+        }
+    }
+}
+
+// Reads and tokenizes files on a few threads; each result is merged as it is done.
+void TrigramIndex::IndexFiles(const std::vector<PendingFile>& files) {
+    if (files.empty()) return;
+    PROFILE_ZONE("IndexFiles");
+    m_filesIndexed = 0;
+    m_filesToIndex = files.size();
+
+    std::atomic<size_t> next{0};
+    auto work = [this, &files, &next] {
+        std::vector<uint64_t> seen(kTrigramSpace / 64);
+        std::vector<uint32_t> trigrams;
+        std::vector<char> buffer;
+        for (size_t i = next++; i < files.size() && !m_stopping; i = next++) {
+            PROFILE_ZONE("IndexFile");
+            FileTrigrams(FullPath(files[i].path), files[i].size, buffer, seen, trigrams);
+            AddFile(files[i], trigrams);
+            ++m_filesIndexed;
+        }
+    };
+
+    size_t workerCount = std::min<size_t>(files.size(), std::min(8u, std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back([&work, i] {
+            PROFILE_THREAD("Indexer " + std::to_string(i));
+            MEMORY_SCOPE(MemoryTag::Index);
+            work();
+        });
+    }
+    work();
+    for (auto& worker : workers) worker.join();
+}
+
+void TrigramIndex::AddFile(const PendingFile& file, const std::vector<uint32_t>& trigrams) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_ids.find(file.path);
+    if (found != m_ids.end()) m_files[found->second].alive = false;
+
+    uint32_t id = (uint32_t)m_files.size();
+    m_files.push_back(FileEntry{ file.path, file.size, file.mtime, true });
+    m_ids[file.path] = id;
+    for (uint32_t trigram : trigrams) {
+        PostingList& list = m_added[trigram];
+        AppendVarint(list.bytes, list.count ? id - list.last : id);
+        list.last = id;
+        ++list.count;
+    }
+    m_dirty = true;
+}
+
+void TrigramIndex::RemoveFile(const std::string& relative) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_ids.find(relative);
+    if (found == m_ids.end()) return;
+    m_files[found->second].alive = false;
+    m_ids.erase(found);
+    m_dirty = true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TextMatcher;
+struct MappedFile;
+
+// Trigram index of the text files under a project root, so repeated searches only
+// read files that can match. Each file's distinct three-byte sequences (ASCII
+// case-folded, none spanning a line break) are recorded in per-trigram posting
+// lists of file ids. A query intersects the lists for its required literal.
+//
+// The index is cached on disk with delta- and varint-encoded postings, and the
+// cache file stays mapped: queries decode its lists in place. Files indexed since
+// it was written go into an in-memory layer on top, with the same encoding. A
+// changed file gets a new id and its old one is marked dead, so lists only ever
+// grow at the end. Saving writes base and layer into a compacted new cache file.
+//
+// A background thread keeps it current: on Open it walks the tree, re-reading
+// only files whose size or mtime changed, and does that again on Refresh.
+// UpdateFile re-indexes a single file, e.g. after a save. The walk watches every
+// directory it lists (inotify, Linux only), so changes made outside the editor
+// are re-indexed as they happen; a new directory or a lost event means another walk.
+class TrigramIndex {
+public:
+    TrigramIndex();
+    ~TrigramIndex();    // Close()
+
+    TrigramIndex(const TrigramIndex&) = delete;
+    TrigramIndex& operator=(const TrigramIndex&) = delete;
+
+    // Load root's cached index, if any, and start bringing it up to date.
+    void Open(const std::string& root);
+
+    // Stop the indexer and write the cache if anything changed since it was loaded.
+    void Close();
+
+    const std::string& Root() const { return m_root; }
+
+    // Re-walk the tree for changes. Coalesces with a walk already queued.
+    void Refresh();
+
+    // Re-index one file under the root. Ignored for paths outside it.
+    void UpdateFile(const std::string& path);
+
+    // Files that can contain matcher's required literal, as full paths, plus every
+    // file changed since it was last indexed. False if the index can't narrow the
+    // search: no literal of three bytes or more, a walk queued or running (as after
+    // Open, even with a cache), or the tree isn't fully watched, so outside changes
+    // could go unseen. The caller then scans everything.
+    bool Candidates(const TextMatcher& matcher, std::vector<std::string>& files);
+
+    bool Ready() const { return m_ready.load(); }
+    bool Indexing() const { return m_indexing.load(); }
+    uint64_t FilesIndexed() const { return m_filesIndexed.load(); }
+    uint64_t FilesToIndex() const { return m_filesToIndex.load(); }
+
+private:
+    struct FileEntry {
+        std::string path;     // relative to the root, '/' separated
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool alive = true;
+    };
+    struct PostingList {      // delta/varint bytes, the on-disk encoding
+        std::vector<uint8_t> bytes;
+        uint32_t last = 0;
+        uint32_t count = 0;
+    };
+    struct Base {             // the mapped cache file
+        std::shared_ptr<MappedFile> file;
+        const uint8_t* table = nullptr;       // (trigram, count, offset) records, by trigram
+        uint32_t trigrams = 0;
+        const uint8_t* postings = nullptr;
+        uint64_t postingsSize = 0;
+    };
+    struct PendingFile {
+        std::string path;     // relative
+        uint64_t size = 0;
+        int64_t mtime = 0;
+    };
+
+    void IndexerLoop();
+    void DrainEvents();
+    void WatchDirectory(const std::string& relative);
+    bool ReadCache(Base& base, std::vector<FileEntry>& files) const;
+    void Install(Base& base, std::vector<FileEntry>& files);
+    void Save();
+    void Walk(std::vector<PendingFile>& changed, std::vector<bool>& seen);
+    void IndexFiles(const std::vector<PendingFile>& files);
+    void AddFile(const PendingFile& file, const std::vector<uint32_t>& trigrams);
+    void RemoveFile(const std::string& relative);
+    void DecodeList(uint32_t trigram, std::vector<uint32_t>& ids) const;
+    uint32_t ListLength(uint32_t trigram) const;
+    std::string FullPath(const std::string& relative) const;
+
+    std::string m_root;
+    std::string m_cachePath;
+
+    // Guards everything below against queries from the UI thread. The indexer is
+    // the only writer, so it reads without the lock when no extraction runs.
+    mutable std::mutex m_mutex;
+    std::vector<FileEntry> m_files;                    // by id
+    std::unordered_map<std::string, uint32_t> m_ids;   // live path -> id
+    Base m_base;
+    std::unordered_map<uint32_t, PostingList> m_added; // ids assigned since the cache was written
+    bool m_dirty = false;
+
+    // Indexer thread and its requests.
+    std::thread m_indexer;
+    std::mutex m_requestMutex;
+    std::condition_variable m_requestReady;
+    bool m_refreshRequested = false;
+    bool m_walking = false;                            // from taking a refresh until it's installed
+    std::vector<std::string> m_updates;                // relative paths
+    std::vector<std::string> m_inFlight;               // updates being indexed right now
+
+    // Directory watches, guarded by m_requestMutex. m_watched is false when the last
+    // walk couldn't watch every directory, e.g. past the inotify watch limit.
+    int m_inotifyFd = -1;
+    std::unordered_map<int, std::string> m_watchDirs;  // watch -> relative directory
+    bool m_watched = false;
+    std::atomic<bool> m_stopping{false};
+
+    std::atomic<bool> m_ready{false};
+    std::atomic<bool> m_indexing{false};
+    std::atomic<uint64_t> m_filesIndexed{0};
+    std::atomic<uint64_t> m_filesToIndex{0};
+};
@@ -0,0 +1,189 @@
+#include "undo_history.h"
+
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint64_t g_nextUndoSerial = 1;
+
+// What a record costs by itself, not counting the buffers it shares.
+static size_t RecordBytes(const UndoRecord& record) {
+    return sizeof(UndoRecord) + record.text.bytes.capacity() +
+           record.text.pieces.pieces.capacity() * sizeof(Document::Piece) +
+           record.text.pieces.buffers.capacity() * sizeof(std::shared_ptr<TextBuffer>);
+}
+
+UndoText UndoHistory::Capture(const Document& doc, size_t pos, size_t len) const {
+    UndoText text;
+    len = std::min(len, doc.Length() - std::min(pos, doc.Length()));
+    text.length = len;
+    if (len <= kInlineBytes) {
+        doc.CopyRange(pos, len, text.bytes);
+    } else {
+        text.pieces = doc.Snapshot(pos, len);
+    }
+    return text;
+}
+
+void UndoHistory::Push(std::deque<UndoRecord>& stack, UndoRecord record) {
+    record.serial = g_nextUndoSerial++;
+    Account(record, true);
+    stack.push_back(std::move(record));
+}
+
+void UndoHistory::Account(const UndoRecord& record, bool adding) {
+    size_t bytes = RecordBytes(record);
+    if (adding) {
+        m_recordBytes += bytes;
+        for (const auto& buffer : record.text.pieces.buffers) ++m_pinned[buffer.get()];
+    } else {
+        m_recordBytes -= bytes;
+        for (const auto& buffer : record.text.pieces.buffers) {
+            auto it = m_pinned.find(buffer.get());
+            if (--it->second == 0) m_pinned.erase(it);
+        }
+    }
+}
+
+void UndoHistory::ClearRedo() {
+    for (const auto& record : m_redo) Account(record, false);
+    m_redo.clear();
+}
+
+// Extends the last undo record instead of adding one when the edit continues it:
+// a character typed right after the last, or one more character deleted at the
+// same place. Line breaks end a run.
+bool UndoHistory::Coalesce(const Document& doc, size_t pos, size_t removeLen, const char* text, size_t len) {
+    if (m_undo.empty()) return false;
+    UndoRecord& last = m_undo.back();
+    if (last.text.ByReference()) return false;
+
+    // Typing: one character that isn't a newline, after an insertion that ends
+    // with one that isn't either.
+    if (removeLen == 0 && len == 1 && text[0] != '\n' && last.text.length == 0 && last.replaceLen > 0 &&
+        last.pos + last.replaceLen == pos && pos > 0 && doc.CharAt(pos - 1) != '\n') {
+        last.replaceLen += len;
+        return true;
+    }
+
+    // Backspace or Delete: a few bytes (one code point) without a line break.
+    if (len != 0 || removeLen == 0 || removeLen > 4 || last.replaceLen != 0 || last.text.length == 0) return false;
+    bool backspace = pos + removeLen == last.pos;
+    if (!backspace && pos != last.pos) return false;
+    std::string removed;
+    doc.CopyRange(pos, removeLen, removed);
+    if (removed.find('\n') != std::string::npos || last.text.bytes.find('\n') != std::string::npos) return false;
+
+    Account(last, false);
+    if (backspace) {
+        last.text.bytes.insert(0, removed);
+        last.pos = pos;
+    } else {
+        last.text.bytes += removed;
+    }
+    last.text.length = last.text.bytes.size();
+    Account(last, true);
+    return true;
+}
+
+void UndoHistory::RecordEdit(const Document& doc, size_t pos, size_t removeLen, const char* text, size_t len) {
+    MEMORY_SCOPE(MemoryTag::Undo);
+    if (removeLen == 0 && len == 0) return;
+    ClearRedo();
+    if (Coalesce(doc, pos, removeLen, text, len)) return;
+
+    UndoRecord record;
+    record.pos = pos;
+    record.replaceLen = len;
+    record.text = Capture(doc, pos, removeLen);
+    Push(m_undo, std::move(record));
+}
+
+void UndoHistory::RecordRewrite(const Document& doc, size_t newLength) {
+    MEMORY_SCOPE(MemoryTag::Undo);
+    ClearRedo();
+    UndoRecord record;
+    record.pos = 0;
+    record.replaceLen = newLength;
+    record.text = Capture(doc, 0, doc.Length());
+    Push(m_undo, std::move(record));
+}
+
+bool UndoHistory::Undo(const Document& doc, UndoRecord& out) {
+    MEMORY_SCOPE(MemoryTag::Undo);
+    if (m_undo.empty()) return false;
+    out = std::move(m_undo.back());
+    m_undo.pop_back();
+    Account(out, false);
+
+    UndoRecord inverse;
+    inverse.pos = out.pos;
+    inverse.replaceLen = out.text.length;
+    inverse.text = Capture(doc, out.pos, out.replaceLen);
+    Push(m_redo, std::move(inverse));
+    return true;
+}
+
+bool UndoHistory::Redo(const Document& doc, UndoRecord& out) {
+    MEMORY_SCOPE(MemoryTag::Undo);
+    if (m_redo.empty()) return false;
+    out = std::move(m_redo.back());
+    m_redo.pop_back();
+    Account(out, false);
+
+    UndoRecord inverse;
+    inverse.pos = out.pos;
+    inverse.replaceLen = out.text.length;
+    inverse.text = Capture(doc, out.pos, out.replaceLen);
+    Push(m_undo, std::move(inverse));
+    return true;
+}
+
+void UndoHistory::Clear() {
+    m_undo.clear();
+    m_redo.clear();
+    m_recordBytes = 0;
+    m_pinned.clear();
+    m_usage = 0;
+}
+
+// Record bytes and pinned buffers are kept as records come and go. Buffers the
+// document still holds cost the history nothing extra; which those are changes
+// with every edit, so that part is looked up here.
+void UndoHistory::Measure(const Document& doc) {
+    size_t usage = m_recordBytes;
+    for (const auto& pinned : m_pinned) {
+        if (!doc.Holds(pinned.first)) usage += BufferHeapBytes(*pinned.first);
+    }
+    m_usage = usage;
+}
+
+uint64_t UndoHistory::OldestSerial() const {
+    uint64_t oldest = UINT64_MAX;
+    if (!m_undo.empty()) oldest = m_undo.front().serial;
+    if (!m_redo.empty()) oldest = std::min(oldest, m_redo.front().serial);
+    return oldest;
+}
+
+// The front of either stack is its oldest record: the first edit still undoable,
+// or the redo furthest away. Its cost, and that of any buffer only it pinned, comes
+// off the usage last measured, so evicting many records doesn't re-measure for each.
+void UndoHistory::EvictOldest(const Document& doc) {
+    bool fromUndo = !m_undo.empty() && (m_redo.empty() || m_undo.front().serial < m_redo.front().serial);
+    std::deque<UndoRecord>& stack = fromUndo ? m_undo : m_redo;
+    if (stack.empty()) return;
+    const UndoRecord& record = stack.front();
+    size_t freed = RecordBytes(record);
+    for (const auto& buffer : record.text.pieces.buffers) {
+        if (m_pinned[buffer.get()] == 1 && !doc.Holds(buffer.get())) freed += BufferHeapBytes(*buffer);
+    }
+    m_usage -= std::min(m_usage, freed);
+    Account(record, false);
+    stack.pop_front();
+}
+
+void UndoHistory::Trim(const Document& doc) {
+    Measure(doc);
+    while (m_usage > m_budget && (!m_undo.empty() || !m_redo.empty())) EvictOldest(doc);
+}
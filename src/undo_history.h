@@ -0,0 +1,91 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Text an undo record puts back. Short spans are copied; longer ones are kept as
+// pieces of the document's buffers, which never change once written, so undoing a
+// large deletion or a whole-file rewrite costs no copy of its text.
+struct UndoText {
+    std::string bytes;
+    DocumentSnapshot pieces;           // used instead of bytes when it has any
+    size_t length = 0;
+
+    bool ByReference() const { return !pieces.pieces.empty(); }
+};
+
+// One step of history: applying it replaces [pos, pos + replaceLen) with text. Undo
+// records hold what an edit removed and replace what it inserted; redo records the
+// other way round.
+struct UndoRecord {
+    size_t pos = 0;
+    size_t replaceLen = 0;
+    UndoText text;
+    uint64_t serial = 0;               // global age, for evicting the oldest history first
+};
+
+// Undo and redo stacks of one document, kept as edit deltas. Consecutive typing,
+// backspacing and forward deletes within a line coalesce into one record. The text
+// an undo reverts to is only captured when the undo happens, from the document as
+// it is then, so a record never holds both sides of an edit.
+//
+// Memory is accounted per history: copied bytes and piece lists, plus the heap of
+// any buffer the history alone keeps alive (e.g. the original of a file rewritten
+// by Replace All). Buffers are counted by how many records pin them, so measuring
+// looks at each once and an eviction updates the total in place. Over budget, the
+// oldest records go first.
+class UndoHistory {
+public:
+    // Removed text up to this long is copied rather than referenced.
+    static const size_t kInlineBytes = 4096;
+
+    void SetByteBudget(size_t bytes) { m_budget = bytes; }
+
+    // Call before an edit that replaces [pos, pos + removeLen) of doc with text.
+    // Clears the redo stack.
+    void RecordEdit(const Document& doc, size_t pos, size_t removeLen, const char* text, size_t len);
+
+    // Call before doc is replaced wholesale by newLength bytes (Replace All, revert).
+    void RecordRewrite(const Document& doc, size_t newLength);
+
+    // Pop the next undo (redo) record into out and push its inverse, captured from
+    // doc before out is applied. The caller then applies out. False when empty.
+    bool Undo(const Document& doc, UndoRecord& out);
+    bool Redo(const Document& doc, UndoRecord& out);
+
+    bool CanUndo() const { return !m_undo.empty(); }
+    bool CanRedo() const { return !m_redo.empty(); }
+    void Clear();
+
+    // Drop the oldest records until the history fits its budget. Call after edits.
+    void Trim(const Document& doc);
+
+    // Bytes the history costs as of the last Trim or EvictOldest.
+    size_t MemoryUsage() const { return m_usage; }
+
+    // Serial of the oldest record, or UINT64_MAX when empty; lets a global budget
+    // evict across documents oldest-first.
+    uint64_t OldestSerial() const;
+    void EvictOldest(const Document& doc);
+
+private:
+    UndoText Capture(const Document& doc, size_t pos, size_t len) const;
+    bool Coalesce(const Document& doc, size_t pos, size_t removeLen, const char* text, size_t len);
+    void Push(std::deque<UndoRecord>& stack, UndoRecord record);
+    void Account(const UndoRecord& record, bool adding);
+    void ClearRedo();
+    void Measure(const Document& doc);
+
+    std::deque<UndoRecord> m_undo;     // back is the next undo
+    std::deque<UndoRecord> m_redo;     // back is the next redo
+    size_t m_budget = (size_t)-1;
+    size_t m_recordBytes = 0;          // RecordBytes of every record
+    std::unordered_map<const TextBuffer*, size_t> m_pinned;  // buffer -> records holding pieces of it
+    size_t m_usage = 0;
+};